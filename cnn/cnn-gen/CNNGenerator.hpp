@@ -3,6 +3,14 @@
 #include <fstream>
 #include <sstream>
 #include <cstdio>
+#include <vector>
+
+#include "../cnn/winograd.hpp"
+#include "../cnn/activation.hpp"
+#include "../cnn/precision.hpp"
+#include "../cnn/connection.hpp"
+#include "../cnn/sparse.hpp"
+#include "../cnn/ingest.hpp"
 
 class CNNGenerator {
 public:
@@ -13,6 +21,12 @@ public:
         RBF
     };
 
+    // Algorithm of the generated convolution kernel.
+    enum ConvAlgorithm {
+        DIRECT,
+        WINOGRAD
+    };
+
 #define INNER (0)
 #define FRONT (1)
 #define BACK  (1 << 1)
@@ -34,12 +48,38 @@ public:
         size_t oHeightTile;
         size_t oDepthTile;
         size_t iDepthTile;
+        // Winograd F(m x m, kernelSize x kernelSize) with m = winogradTile.
+        ConvAlgorithm algorithm;
+        size_t winogradTile;
+        cnn::Activation activation;
+        // INT8 conv and full kernels take the quantized weights and the scales.
+        // FP16 kernels store the weights, the local buffers and the output as half.
+        cnn::Precision precision;
+        // Accumulation of an FP16 kernel, FP32 or FP16 (needs cl_khr_fp16).
+        cnn::Precision accumulation;
+        // Input maps of every output map of a conv layer, empty for all of them.
+        // The weights of the other pairs are zero and the kernel skips them.
+        cnn::connection::Table connection;
+        // Fraction of the weights of a full layer kept by magnitude pruning, 0 keeps them all.
+        // At or below the density threshold the layer gets the CSR kernel.
+        float density;
+        // Classes an RBF kernel ranks on the device, nearest first, 0 only writes the distances.
+        // The ranking needs the whole output in one work group.
+        size_t topK;
+    };
+
+    // Kernel padding and normalizing raw uint8 images into the input of the first layer.
+    struct InputParam {
+        std::string kernelName;
+        size_t workGroupSize[3];
+        cnn::ingest::Format format;
     };
 
     static void genCNN(const std::string &XMLFileName,
         const std::string &kernelFileName,
         size_t layerNum,
-        const LayerParam *params
+        const LayerParam *params,
+        const InputParam *input = NULL
         ) {
 
         std::ofstream xml(XMLFileName);
@@ -61,13 +101,37 @@ public:
         writeXMLTag(xml, "inSize", params[0].iWidth * params[0].iHeight * params[0].iDepth);
         writeXMLTag(xml, "queueBarrier", static_cast<size_t>(10));
 
-        // Write some basic information in the cl kernel file.
-        fprintf(kernel, "%s\n", activateFunc.c_str());
+        if (input) {
+            genInput(xml, kernel, kernelFileName, *input, params[0]);
+        }
 
-        // Write the internal buffer.
+        // Write the activation functions used by the layers.
+        std::vector<bool> used(cnn::NUM_ACTIVATIONS, false);
+        for (size_t i = 0; i < layerNum; ++i) {
+            // The RBF output has no activation.
+            if (params[i].type != RBF) {
+                used[params[i].activation] = true;
+            }
+        }
+        for (size_t a = 0; a < cnn::NUM_ACTIVATIONS; ++a) {
+            if (used[a]) {
+                writeActivationFunc(kernel, (cnn::Activation)a);
+            }
+        }
+
+        // Half arithmetic for the FP16 accumulation.
+        for (size_t i = 0; i < layerNum; ++i) {
+            if (params[i].precision == cnn::FP16 && params[i].accumulation == cnn::FP16) {
+                fprintf(kernel, "#pragma OPENCL EXTENSION cl_khr_fp16 : enable\n");
+                break;
+            }
+        }
+
+        // Write the internal buffer, in half after an FP16 layer.
         for (size_t i = 1; i < layerNum; ++i) {
             fprintf(kernel,
-                "__global float buf%zu[%zu];\n",
+                "__global %s buf%zu[%zu];\n",
+                params[i - 1].precision == cnn::FP16 ? "ushort" : "float",
                 i,
                 params[i].iWidth * params[i].iHeight * params[i].iDepth);
         }
@@ -80,25 +144,112 @@ public:
             if (i == layerNum - 1) {
                 flag |= BACK;
             }
-            genLayer(xml, kernel, kernelFileName, params[i], i, flag);
+            bool halfIn = i > 0 && params[i - 1].precision == cnn::FP16;
+            genLayer(xml, kernel, kernelFileName, params[i], i, flag, halfIn);
         }
 
         writeXMLCloseTag(xml, "cnn");
 
         xml.close();
         fclose(kernel);
+
+        writeActivationReport(std::cout, XMLFileName, layerNum, params);
+        writePrecisionReport(std::cout, XMLFileName, layerNum, params);
+        writeConnectionReport(std::cout, XMLFileName, layerNum, params);
+        writeSparseReport(std::cout, XMLFileName, layerNum, params);
     }
 
 private:
 
-    static void genLayer(std::ofstream &xml, FILE *kernel, const std::string &kernelFileName, const LayerParam &param, size_t idx, Flag flag) {
+    static void genInput(std::ofstream &xml, FILE *kernel, const std::string &kernelFileName, const InputParam &input, const LayerParam &first) {
+        const cnn::ingest::Format &format = input.format;
+        cnn::ingest::validate(format, first.iWidth, first.iHeight, first.iDepth, input.kernelName);
+
+        writeXMLOpenTag(xml, "input");
+        writeXMLTag(xml, "kernelName", input.kernelName);
+        writeXMLTag(xml, "xclbinFileName", first.xclbinFileName);
+        writeXMLTag(xml, "kernelFileName", kernelFileName);
+        writeXMLOpenTag(xml, "workGroupSize");
+        for (size_t i = 0; i < sizeof(input.workGroupSize) / sizeof(size_t); ++i) {
+            writeXMLTag(xml, "item", input.workGroupSize[i]);
+        }
+        writeXMLCloseTag(xml, "workGroupSize");
+        writeXMLTag(xml, "rawWidth", format.width);
+        writeXMLTag(xml, "rawHeight", format.height);
+        writeXMLTag(xml, "rawDepth", format.depth);
+        writeXMLTag(xml, "scale", format.scale);
+        writeXMLTag(xml, "bias", format.bias);
+        writeXMLCloseTag(xml, "input");
+
+        writeDefine(kernel, "KERNEL_NAME", input.kernelName);
+        writeDefine(kernel, "WORK_GROUP_DIM_0", input.workGroupSize[0]);
+        writeDefine(kernel, "WORK_GROUP_DIM_1", input.workGroupSize[1]);
+        writeDefine(kernel, "WORK_GROUP_DIM_2", input.workGroupSize[2]);
+        writeDefine(kernel, "RAW_WIDTH", format.width);
+        writeDefine(kernel, "RAW_HEIGHT", format.height);
+        writeDefine(kernel, "OWIDTH", first.iWidth);
+        writeDefine(kernel, "OHEIGHT", first.iHeight);
+        writeDefine(kernel, "PAD_LEFT", cnn::ingest::padding(format.width, first.iWidth));
+        writeDefine(kernel, "PAD_TOP", cnn::ingest::padding(format.height, first.iHeight));
+        writeDefine(kernel, "SCALE", floatLiteral(format.scale));
+        writeDefine(kernel, "BIAS", floatLiteral(format.bias));
+        fprintf(kernel, "%s\n", inputKernel.c_str());
+        const char *macros[] = { "KERNEL_NAME", "WORK_GROUP_DIM_0", "WORK_GROUP_DIM_1", "WORK_GROUP_DIM_2",
+            "RAW_WIDTH", "RAW_HEIGHT", "OWIDTH", "OHEIGHT", "PAD_LEFT", "PAD_TOP", "SCALE", "BIAS" };
+        for (size_t i = 0; i < sizeof(macros) / sizeof(macros[0]); ++i) {
+            writeUndef(kernel, macros[i]);
+        }
+
+        size_t rawBytes = format.size();
+        size_t floatBytes = first.iWidth * first.iHeight * first.iDepth * sizeof(float);
+        std::cout << kernelFileName << " input: " << rawBytes << " raw bytes instead of " << floatBytes
+            << " float bytes per image (" << (float)floatBytes / (float)rawBytes << "x less)" << std::endl;
+    }
+
+    static void genLayer(std::ofstream &xml, FILE *kernel, const std::string &kernelFileName, const LayerParam &param, size_t idx, Flag flag, bool halfIn) {
+        if (param.precision == cnn::INT8 && !(param.type == CONV || param.type == FULL)) {
+            std::cerr << "Only conv and full layers can be INT8: " << param.kernelName << std::endl;
+            exit(-1);
+        }
+        if (param.precision != cnn::FP32 && param.type == CONV && param.algorithm == WINOGRAD) {
+            std::cerr << "No " << cnn::getPrecisionName(param.precision) << " Winograd kernel: " << param.kernelName << std::endl;
+            exit(-1);
+        }
+        if (!param.connection.empty()) {
+            if (param.type != CONV || param.algorithm == WINOGRAD || param.precision == cnn::INT8) {
+                std::cerr << "Only direct fp32 and fp16 conv layers can have a connection table: " << param.kernelName << std::endl;
+                exit(-1);
+            }
+            cnn::connection::validate(param.connection, param.iDepth, param.oDepth, param.kernelName);
+        }
+        if (isCSR(param) && param.precision == cnn::INT8) {
+            std::cerr << "No int8 CSR kernel: " << param.kernelName << std::endl;
+            exit(-1);
+        }
+        if (param.topK > 0) {
+            size_t outSize = param.oWidth * param.oHeight * param.oDepth;
+            if (param.type != RBF || !(flag & BACK) || param.topK > outSize ||
+                param.workGroupSize[0] < outSize || param.workGroupSize[1] != 1 || param.workGroupSize[2] != 1) {
+                std::cerr << "Only the last RBF layer with every output in one work group can rank the classes: "
+                    << param.kernelName << std::endl;
+                exit(-1);
+            }
+        }
         writeXMLOpenTag(xml, "layer");
-        writeKernelDefine(kernel, param, idx, flag);
+        writeKernelDefine(kernel, param, idx, flag, halfIn);
         writeXMLInfo(xml, kernelFileName, param);
         switch (param.type) {
         case CONV:
             genXMLConvLayer(xml, param);
-            fprintf(kernel, "%s\n", convKernel.c_str());
+            if (param.precision == cnn::INT8) {
+                fprintf(kernel, "%s\n", convInt8Kernel.c_str());
+            }
+            else if (!param.connection.empty()) {
+                fprintf(kernel, "%s\n", convSparseKernel.c_str());
+            }
+            else {
+                fprintf(kernel, "%s\n", param.algorithm == WINOGRAD ? winogradKernel.c_str() : convKernel.c_str());
+            }
             break;
         case POOL:
             genXMLPoolLayer(xml, param);
@@ -106,7 +257,12 @@ private:
             break;
         case FULL:
             genXMLFullLayer(xml, param);
-            fprintf(kernel, "%s\n", fullKernel.c_str());
+            if (isCSR(param)) {
+                fprintf(kernel, "%s\n", fullSparseKernel.c_str());
+            }
+            else {
+                fprintf(kernel, "%s\n", param.precision == cnn::INT8 ? fullInt8Kernel.c_str() : fullKernel.c_str());
+            }
             break;
         case RBF:
             genXMLRBFLayer(xml, param);
@@ -116,7 +272,7 @@ private:
             std::cerr << "Unsupported layer type. " << std::endl;
             exit(-1);
         }
-        writeKernelUndefine(kernel, flag);
+        writeKernelUndefine(kernel, param, flag);
         writeXMLCloseTag(xml, "layer");
     }
 
@@ -141,15 +297,43 @@ private:
     static void genXMLFullLayer(std::ofstream &xml, const LayerParam &param) {
         writeXMLTag(xml, "type", "full");
 
-        // Randomly write the weight.
-        writeXMLOpenTag(xml, "weight");
-        for (int i = 0; i < param.oWidth * param.oHeight * param.oDepth; ++i) {
-            // For each output feature map.
-            for (int k = 0; k < param.iWidth * param.iHeight * param.iDepth; ++k) {
-                writeXMLTag(xml, "item", static_cast<float>(rand()) / static_cast<float>(RAND_MAX));
+        // Randomly write the weight, pruned to the density.
+        size_t inSize = param.iWidth * param.iHeight * param.iDepth;
+        size_t outSize = param.oWidth * param.oHeight * param.oDepth;
+        std::vector<float> weight(inSize * outSize);
+        for (size_t i = 0; i < weight.size(); ++i) {
+            weight[i] = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+        }
+        if (param.density > 0.0f) {
+            cnn::sparse::prune(&weight[0], weight.size(), param.density);
+        }
+        if (isCSR(param)) {
+            cnn::sparse::Matrix m = cnn::sparse::fromDense(&weight[0], outSize, inSize);
+            writeXMLOpenTag(xml, "sparseWeight");
+            writeXMLOpenTag(xml, "rowBegin");
+            for (size_t i = 0; i < m.rowBegin.size(); ++i) {
+                writeXMLTag(xml, "item", m.rowBegin[i]);
+            }
+            writeXMLCloseTag(xml, "rowBegin");
+            writeXMLOpenTag(xml, "column");
+            for (size_t i = 0; i < m.column.size(); ++i) {
+                writeXMLTag(xml, "item", m.column[i]);
             }
+            writeXMLCloseTag(xml, "column");
+            writeXMLOpenTag(xml, "value");
+            for (size_t i = 0; i < m.value.size(); ++i) {
+                writeXMLTag(xml, "item", m.value[i]);
+            }
+            writeXMLCloseTag(xml, "value");
+            writeXMLCloseTag(xml, "sparseWeight");
+        }
+        else {
+            writeXMLOpenTag(xml, "weight");
+            for (size_t i = 0; i < weight.size(); ++i) {
+                writeXMLTag(xml, "item", weight[i]);
+            }
+            writeXMLCloseTag(xml, "weight");
         }
-        writeXMLCloseTag(xml, "weight");
 
         // Randomly write the offset.
         writeXMLOpenTag(xml, "offset");
@@ -162,7 +346,9 @@ private:
     static void genXMLConvLayer(std::ofstream &xml, const LayerParam &param) {
         writeXMLTag(xml, "type", "conv");
 
-        // Randomly write the weight.
+        // Randomly write the weight, zero for the unconnected pairs.
+        std::vector<bool> connected = cnn::connection::mask(param.connection, param.iDepth, param.oDepth);
+        std::vector<float> weight;
         writeXMLOpenTag(xml, "weight");
         for (int i = 0; i < param.oDepth; ++i) {
             // For each output feature map.
@@ -172,7 +358,13 @@ private:
                 for (int k = 0; k < param.kernelSize; ++k) {
                     writeXMLOpenTag(xml, "line");
                     for (int k = 0; k < param.kernelSize; ++k) {
-                        writeXMLTag(xml, "item", static_cast<float>(rand()) / static_cast<float>(RAND_MAX));
+                        float value = connected[i * param.iDepth + j] ? static_cast<float>(rand()) / static_cast<float>(RAND_MAX) : 0.0f;
+                        writeXMLTag(xml, "item", value);
+                        // Transform the weight as the host reads it back.
+                        std::stringstream ss;
+                        ss << value;
+                        ss >> value;
+                        weight.push_back(value);
                     }
                     writeXMLCloseTag(xml, "line");
                 }
@@ -182,6 +374,36 @@ private:
         }
         writeXMLCloseTag(xml, "weight");
 
+        // Write the input maps of every output map.
+        if (!param.connection.empty()) {
+            writeXMLOpenTag(xml, "connection");
+            for (size_t i = 0; i < param.connection.size(); ++i) {
+                writeXMLOpenTag(xml, "oFeatureMap");
+                for (size_t j = 0; j < param.connection[i].size(); ++j) {
+                    writeXMLTag(xml, "item", param.connection[i][j]);
+                }
+                writeXMLCloseTag(xml, "oFeatureMap");
+            }
+            writeXMLCloseTag(xml, "connection");
+        }
+
+        // Transform the weight offline for the Winograd kernel.
+        if (param.algorithm == WINOGRAD) {
+            cnn::winograd::Transform t = cnn::winograd::makeTransform(param.winogradTile, param.kernelSize);
+            std::vector<float> transformed(param.oDepth * param.iDepth * t.n * t.n);
+            cnn::winograd::transformWeight(t, &weight[0], param.oDepth, param.iDepth, &transformed[0]);
+
+            writeXMLTag(xml, "algorithm", "winograd");
+            writeXMLTag(xml, "winogradTile", param.winogradTile);
+            writeXMLOpenTag(xml, "winogradWeight");
+            std::streamsize precision = xml.precision(9);
+            for (size_t i = 0; i < transformed.size(); ++i) {
+                writeXMLTag(xml, "item", transformed[i]);
+            }
+            xml.precision(precision);
+            writeXMLCloseTag(xml, "winogradWeight");
+        }
+
         // Randomly write the offset.
         writeXMLOpenTag(xml, "offset");
         for (int i = 0; i < param.oDepth; ++i) {
@@ -207,6 +429,243 @@ private:
         writeXMLCloseTag(xml, "offset");
     }
 
+    /***********************************************************************
+    Activation functions.
+    ************************************************************************/
+    static std::string activateFuncName(cnn::Activation activation) {
+        switch (activation) {
+        case cnn::RELU:
+            return "relu";
+        case cnn::HARD_SIGMOID:
+            return "hardSigmoid";
+        case cnn::TANH:
+            return "tanhActivate";
+        case cnn::LUT_SIGMOID:
+            return "lutSigmoid";
+        default:
+            return "sigmod";
+        }
+    }
+
+    static void writeActivationFunc(FILE *kernel, cnn::Activation activation) {
+        switch (activation) {
+        case cnn::RELU:
+            fprintf(kernel, "float relu(float in) {\n    return fmax(in, 0.0f);\n}\n");
+            break;
+        case cnn::HARD_SIGMOID:
+            fprintf(kernel, "float hardSigmoid(float in) {\n    return clamp(0.2f * in + 0.5f, 0.0f, 1.0f);\n}\n");
+            break;
+        case cnn::TANH:
+            fprintf(kernel, "float tanhActivate(float in) {\n    return tanh(in);\n}\n");
+            break;
+        case cnn::LUT_SIGMOID: {
+            // One slope and intercept per segment, read from a ROM.
+            const cnn::lut::Table &table = cnn::lut::table();
+            std::vector<float> slope(table.slope.begin(), table.slope.end());
+            std::vector<float> intercept(table.intercept.begin(), table.intercept.end());
+            writeDefine(kernel, "LUT_SLOPE", slope);
+            writeDefine(kernel, "LUT_INTERCEPT", intercept);
+            fprintf(kernel, "__constant float lutSlope[%u] = LUT_SLOPE;\n", (unsigned int)cnn::lut::LUT_SEGMENTS);
+            fprintf(kernel, "__constant float lutIntercept[%u] = LUT_INTERCEPT;\n", (unsigned int)cnn::lut::LUT_SEGMENTS);
+            writeUndef(kernel, "LUT_SLOPE");
+            writeUndef(kernel, "LUT_INTERCEPT");
+            fprintf(kernel,
+                "float lutSigmoid(float in) {\n"
+                "    if (in <= %s) {\n"
+                "        return 0.0f;\n"
+                "    }\n"
+                "    if (in >= %s) {\n"
+                "        return 1.0f;\n"
+                "    }\n"
+                "    int i = min((int)((in - (%s)) * %s), %u);\n"
+                "    return lutSlope[i] * in + lutIntercept[i];\n"
+                "}\n",
+                floatLiteral(cnn::lut::LUT_MIN).c_str(),
+                floatLiteral(cnn::lut::LUT_MAX).c_str(),
+                floatLiteral(cnn::lut::LUT_MIN).c_str(),
+                floatLiteral(cnn::lut::LUT_SEGMENTS / (cnn::lut::LUT_MAX - cnn::lut::LUT_MIN)).c_str(),
+                (unsigned int)cnn::lut::LUT_SEGMENTS - 1);
+            break;
+        }
+        default:
+            fprintf(kernel, "%s\n", activateFunc.c_str());
+            break;
+        }
+    }
+
+    // Estimated cost of one activation unit, summed over the single precision
+    // operators it instantiates (DSP48 slices and pipeline latency in cycles).
+    // These are operator level estimates to compare the choices, the real
+    // figures come from the HLS report of the synthesized kernel.
+    struct ActivationCost {
+        size_t dsp;
+        size_t latency;
+        const char *operators;
+    };
+
+    static ActivationCost getActivationCost(cnn::Activation activation) {
+        // fadd: 2 DSP, 4 cycles. fmul: 3 DSP, 3 cycles. fdiv: 0 DSP, 16 cycles.
+        // fexp: 7 DSP, 17 cycles. fcmp/select: 0 DSP, 1 cycle. fptosi: 0 DSP, 3 cycles. ROM read: 1 cycle.
+        static const ActivationCost COSTS[cnn::NUM_ACTIVATIONS] = {
+            { 9, 37, "fexp + fadd + fdiv" },
+            { 0, 1, "fcmp" },
+            { 5, 9, "fmul + fadd + 2 fcmp" },
+            { 12, 44, "fmul + fexp + 2 fadd + fdiv" },
+            { 10, 15, "fadd + fmul + fptosi + ROM + fmul + fadd" }
+        };
+        return COSTS[activation];
+    }
+
+    static void writeActivationReport(std::ostream &o, const std::string &XMLFileName, size_t layerNum, const LayerParam *params) {
+        o << "Activations of " << XMLFileName << std::endl;
+        for (size_t a = 0; a < cnn::NUM_ACTIVATIONS; ++a) {
+            ActivationCost cost = getActivationCost((cnn::Activation)a);
+            o << "    " << cnn::getActivationName((cnn::Activation)a) << ": "
+                << cost.dsp << " DSP, " << cost.latency << " cycles (" << cost.operators << ")" << std::endl;
+        }
+        ActivationCost sigmoid = getActivationCost(cnn::SIGMOID);
+        for (size_t i = 0; i < layerNum; ++i) {
+            if (params[i].type == RBF) {
+                continue;
+            }
+            ActivationCost cost = getActivationCost(params[i].activation);
+            o << "    " << params[i].kernelName << ": " << cnn::getActivationName(params[i].activation)
+                << " on " << params[i].oWidth * params[i].oHeight * params[i].oDepth << " outputs, "
+                << cost.dsp << " DSP and " << cost.latency << " cycles per unit (sigmoid: "
+                << sigmoid.dsp << " DSP and " << sigmoid.latency << " cycles)" << std::endl;
+        }
+    }
+
+    // Bytes of the weight and of the local buffers of the generated kernel of a layer.
+    static size_t getWeightBytes(const LayerParam &param, size_t element) {
+        size_t inSize = param.iWidth * param.iHeight * param.iDepth;
+        size_t outSize = param.oWidth * param.oHeight * param.oDepth;
+        switch (param.type) {
+        case CONV:
+            return getConnections(param) * param.kernelSize * param.kernelSize * element;
+        case POOL:
+            return param.oDepth * element;
+        case FULL:
+            // CSR adds a 4 byte column index per nonzero and the row begins.
+            return isCSR(param) ? getNonzeros(param) * (element + 4) + (outSize + 1) * 4 : inSize * outSize * element;
+        default:
+            return inSize * outSize * element;
+        }
+    }
+
+    static size_t getLocalBytes(const LayerParam &param, size_t element) {
+        size_t inSize = param.iWidth * param.iHeight * param.iDepth;
+        switch (param.type) {
+        case CONV:
+            return (inSize + getConnections(param) * param.kernelSize * param.kernelSize) * element +
+                param.oDepth * sizeof(float);
+        case POOL:
+            return inSize * element + 2 * param.workGroupSize[2] * sizeof(float);
+        case FULL:
+            if (isCSR(param)) {
+                return inSize * element;
+            }
+            return (inSize + param.workGroupSize[0] * inSize) * element + param.workGroupSize[0] * sizeof(float);
+        default:
+            return (inSize + param.workGroupSize[0] * inSize) * element;
+        }
+    }
+
+    static size_t getConnections(const LayerParam &param) {
+        return cnn::connection::count(param.connection, param.iDepth, param.oDepth);
+    }
+
+    // Whether the full layer is pruned enough for the CSR kernel.
+    static bool isCSR(const LayerParam &param) {
+        return param.type == FULL && param.density > 0.0f && param.density <= cnn::sparse::DENSITY_THRESHOLD;
+    }
+
+    // Weights kept by pruning.
+    static size_t getNonzeros(const LayerParam &param) {
+        size_t n = param.iWidth * param.iHeight * param.iDepth * param.oWidth * param.oHeight * param.oDepth;
+        if (param.density <= 0.0f) {
+            return n;
+        }
+        return std::min(n, (size_t)std::floor(std::min(param.density, 1.0f) * n + 0.5f));
+    }
+
+    static void writeSparseReport(std::ostream &o, const std::string &XMLFileName, size_t layerNum, const LayerParam *params) {
+        bool isPruned = false;
+        for (size_t i = 0; i < layerNum; ++i) {
+            isPruned |= params[i].type == FULL && params[i].density > 0.0f;
+        }
+        if (!isPruned) {
+            return;
+        }
+        o << "Sparsity of " << XMLFileName << std::endl;
+        for (size_t i = 0; i < layerNum; ++i) {
+            const LayerParam &param = params[i];
+            if (param.type != FULL || param.density <= 0.0f) {
+                continue;
+            }
+            size_t element = param.precision == cnn::FP16 ? 2 : 4;
+            LayerParam dense = param;
+            dense.density = 0.0f;
+            o << "    " << param.kernelName << ": " << getNonzeros(param) << " of " << getNonzeros(dense)
+                << " weights, " << (isCSR(param) ? "csr" : "dense") << " kernel, weight " << getWeightBytes(param, element)
+                << " bytes (dense: " << getWeightBytes(dense, element) << "), local memory " << getLocalBytes(param, element)
+                << " bytes (dense: " << getLocalBytes(dense, element) << ")" << std::endl;
+        }
+    }
+
+    static void writeConnectionReport(std::ostream &o, const std::string &XMLFileName, size_t layerNum, const LayerParam *params) {
+        bool isSparse = false;
+        for (size_t i = 0; i < layerNum; ++i) {
+            isSparse |= !params[i].connection.empty();
+        }
+        if (!isSparse) {
+            return;
+        }
+        o << "Connections of " << XMLFileName << std::endl;
+        size_t dense = 0;
+        size_t sparse = 0;
+        for (size_t i = 0; i < layerNum; ++i) {
+            const LayerParam &param = params[i];
+            if (param.type != CONV) {
+                continue;
+            }
+            size_t pairMultiplies = cnn::winograd::directMultiplies(param.kernelSize, param.oWidth, param.oHeight, 1, 1);
+            dense += pairMultiplies * param.iDepth * param.oDepth;
+            sparse += pairMultiplies * getConnections(param);
+            o << "    " << param.kernelName << ": " << getConnections(param) << " of " << param.iDepth * param.oDepth
+                << " pairs, " << pairMultiplies * getConnections(param) << " multiplies (dense: "
+                << pairMultiplies * param.iDepth * param.oDepth << ")" << std::endl;
+        }
+        o << "    conv multiplies: " << sparse << " (dense: " << dense << ", -"
+            << 100.0 * (1.0 - (double)sparse / dense) << "%)" << std::endl;
+    }
+
+    static void writePrecisionReport(std::ostream &o, const std::string &XMLFileName, size_t layerNum, const LayerParam *params) {
+        bool isMixed = false;
+        for (size_t i = 0; i < layerNum; ++i) {
+            isMixed |= params[i].precision == cnn::FP16;
+        }
+        if (!isMixed) {
+            return;
+        }
+        o << "Precision of " << XMLFileName << std::endl;
+        for (size_t i = 0; i < layerNum; ++i) {
+            const LayerParam &param = params[i];
+            if (param.precision == cnn::INT8) {
+                o << "    " << param.kernelName << ": int8" << std::endl;
+                continue;
+            }
+            size_t element = param.precision == cnn::FP16 ? 2 : 4;
+            o << "    " << param.kernelName << ": " << cnn::getPrecisionName(param.precision);
+            if (param.precision == cnn::FP16) {
+                o << " with " << cnn::getPrecisionName(param.accumulation) << " accumulation";
+            }
+            o << ", weight " << getWeightBytes(param, element) << " bytes (fp32: " << getWeightBytes(param, 4)
+                << "), local memory " << getLocalBytes(param, element) << " bytes (fp32: " << getLocalBytes(param, 4)
+                << ")" << std::endl;
+        }
+    }
+
     /***********************************************************************
     Helper function to generate the xml tags.
     ************************************************************************/
@@ -259,6 +718,17 @@ private:
         writeXMLTag(xml, "oHeightTile", param.oHeightTile);
         writeXMLTag(xml, "oDepthTile", param.oDepthTile);
         writeXMLTag(xml, "iDepthTile", param.iDepthTile);
+        writeXMLTag(xml, "activation", cnn::getActivationName(param.activation));
+        writeXMLTag(xml, "precision", cnn::getPrecisionName(param.precision));
+        if (param.precision == cnn::FP16) {
+            writeXMLTag(xml, "accumulation", cnn::getPrecisionName(param.accumulation));
+        }
+        if (isCSR(param)) {
+            writeXMLTag(xml, "weightFormat", cnn::getWeightFormatName(cnn::CSR));
+        }
+        if (param.topK > 0) {
+            writeXMLTag(xml, "topK", param.topK);
+        }
     }
 
     /***********************************************************************
@@ -272,6 +742,30 @@ private:
         fprintf(o, "#define %s %s\n", macro.c_str(), value.c_str());
     }
 
+    static void writeDefine(FILE *o, const std::string &macro, const std::vector<size_t> &values) {
+        fprintf(o, "#define %s {", macro.c_str());
+        for (size_t i = 0; i < values.size(); ++i) {
+            fprintf(o, "%s%u", i == 0 ? "" : ", ", (unsigned int)values[i]);
+        }
+        fprintf(o, "}\n");
+    }
+
+    static void writeDefine(FILE *o, const std::string &macro, const std::vector<float> &values) {
+        fprintf(o, "#define %s {", macro.c_str());
+        for (size_t i = 0; i < values.size(); ++i) {
+            fprintf(o, "%s%s", i == 0 ? "" : ", ", floatLiteral(values[i]).c_str());
+        }
+        fprintf(o, "}\n");
+    }
+
+    // Keep a decimal point so the f suffix makes a float literal.
+    static std::string floatLiteral(float value) {
+        char literal[32];
+        snprintf(literal, sizeof(literal), "%.9g", value);
+        bool isInteger = std::string(literal).find_first_of(".e") == std::string::npos;
+        return std::string(literal) + (isInteger ? ".0f" : "f");
+    }
+
     static void writeUndef(FILE *o, const std::string &macro) {
         fprintf(o, "#undef %s\n", macro.c_str());
     }
@@ -288,7 +782,7 @@ private:
         return text;
     }
 
-    static void writeKernelDefine(FILE *kernel, const LayerParam &param, size_t idx, Flag flag) {
+    static void writeKernelDefine(FILE *kernel, const LayerParam &param, size_t idx, Flag flag, bool halfIn) {
         writeDefine(kernel, "KERNEL_SIZE", param.kernelSize);
         writeDefine(kernel, "KERNEL_LEN", param.kernelSize * param.kernelSize);
         writeDefine(kernel, "IWIDTH", param.iWidth);
@@ -307,25 +801,72 @@ private:
         writeDefine(kernel, "WORK_GROUP_DIM_1", param.workGroupSize[1]);
         writeDefine(kernel, "WORK_GROUP_DIM_2", param.workGroupSize[2]);
         writeDefine(kernel, "KERNEL_NAME", param.kernelName);
+        writeDefine(kernel, "ACTIVATE", activateFuncName(param.activation));
+
+        if (param.type == CONV && param.algorithm == WINOGRAD) {
+            cnn::winograd::Transform t = cnn::winograd::makeTransform(param.winogradTile, param.kernelSize);
+            writeDefine(kernel, "WINOGRAD_M", t.m);
+            writeDefine(kernel, "WINOGRAD_N", t.n);
+            writeDefine(kernel, "WINOGRAD_TILES_W", cnn::winograd::numTiles(param.oWidth, t.m));
+            writeDefine(kernel, "WINOGRAD_TILES_H", cnn::winograd::numTiles(param.oHeight, t.m));
+            writeDefine(kernel, "WINOGRAD_AT", t.AT);
+            writeDefine(kernel, "WINOGRAD_BT", t.BT);
+        }
+
+        if (param.topK > 0) {
+            writeDefine(kernel, "TOP_K", param.topK);
+        }
 
+        if (param.type == CONV && !param.connection.empty()) {
+            std::vector<size_t> begin;
+            std::vector<size_t> input;
+            cnn::connection::flatten(param.connection, begin, input);
+            writeDefine(kernel, "CONNECTIONS", input.size());
+            writeDefine(kernel, "CONNECTION_BEGIN", begin);
+            writeDefine(kernel, "CONNECTION_INPUT", input);
+        }
+
+        // Storage of the weight, the local buffers and the accumulator.
+        bool isHalf = param.precision == cnn::FP16;
+        writeDefine(kernel, "WEIGHT_TYPE", isHalf ? "half" : "float");
+        writeDefine(kernel, "WEIGHT_LOAD(i)", isHalf ? "vload_half(i, weight)" : "weight[i]");
+        writeDefine(kernel, "LOCAL_TYPE", isHalf ? "ushort" : "float");
+        writeDefine(kernel, "LOCAL_LOAD(p, i)", isHalf ? "vload_half(i, (__local half *)p)" : "p[i]");
+        writeDefine(kernel, "LOCAL_STORE(p, i, v)", isHalf ? "vstore_half(v, i, (__local half *)p)" : "p[i] = (v)");
+        writeDefine(kernel, "ACC_TYPE", isHalf && param.accumulation == cnn::FP16 ? "half" : "float");
+
+        // The host side input and output are float, the internal buffers follow the layer writing them.
         std::stringstream ss;
         if (!(flag & FRONT)) {
-            fprintf(kernel, "#define in buf%zu\n", idx);
+            if (halfIn) {
+                fprintf(kernel, "#define in ((__global half *)buf%zu)\n", idx);
+            }
+            else {
+                fprintf(kernel, "#define in buf%zu\n", idx);
+            }
         }
         else {
             ss << "__global float *in, ";
         }
+        writeDefine(kernel, "IN_LOAD(i)", halfIn ? "vload_half(i, in)" : "in[i]");
 
+        bool halfOut = isHalf && !(flag & BACK);
         if (!(flag & BACK)) {
-            fprintf(kernel, "#define out buf%zu\n", idx + 1);
+            if (halfOut) {
+                fprintf(kernel, "#define out ((__global half *)buf%zu)\n", idx + 1);
+            }
+            else {
+                fprintf(kernel, "#define out buf%zu\n", idx + 1);
+            }
         }
         else {
             ss << "__global float *out,";
         }
+        writeDefine(kernel, "OUT_STORE(i, v)", halfOut ? "vstore_half(v, i, out)" : "out[i] = (v)");
         writeDefine(kernel, "KERNEL_PARAM", ss.str());
     }
 
-    static void writeKernelUndefine(FILE *kernel, Flag flag) {
+    static void writeKernelUndefine(FILE *kernel, const LayerParam &param, Flag flag) {
         if (!(flag &FRONT)) {
             writeUndef(kernel, "in");
         }
@@ -351,6 +892,31 @@ private:
         writeUndef(kernel, "WORK_GROUP_DIM_2");
         writeUndef(kernel, "KERNEL_NAME");
         writeUndef(kernel, "KERNEL_PARAM");
+        writeUndef(kernel, "ACTIVATE");
+        writeUndef(kernel, "WEIGHT_TYPE");
+        writeUndef(kernel, "WEIGHT_LOAD");
+        writeUndef(kernel, "LOCAL_TYPE");
+        writeUndef(kernel, "LOCAL_LOAD");
+        writeUndef(kernel, "LOCAL_STORE");
+        writeUndef(kernel, "ACC_TYPE");
+        writeUndef(kernel, "IN_LOAD");
+        writeUndef(kernel, "OUT_STORE");
+        if (param.type == CONV && param.algorithm == WINOGRAD) {
+            writeUndef(kernel, "WINOGRAD_M");
+            writeUndef(kernel, "WINOGRAD_N");
+            writeUndef(kernel, "WINOGRAD_TILES_W");
+            writeUndef(kernel, "WINOGRAD_TILES_H");
+            writeUndef(kernel, "WINOGRAD_AT");
+            writeUndef(kernel, "WINOGRAD_BT");
+        }
+        if (param.topK > 0) {
+            writeUndef(kernel, "TOP_K");
+        }
+        if (param.type == CONV && !param.connection.empty()) {
+            writeUndef(kernel, "CONNECTIONS");
+            writeUndef(kernel, "CONNECTION_BEGIN");
+            writeUndef(kernel, "CONNECTION_INPUT");
+        }
     }
 
     /********************************************************************************************
@@ -361,4 +927,10 @@ private:
     static const std::string poolKernel;
     static const std::string fullKernel;
     static const std::string rbfKernel;
+    static const std::string winogradKernel;
+    static const std::string convInt8Kernel;
+    static const std::string fullInt8Kernel;
+    static const std::string convSparseKernel;
+    static const std::string fullSparseKernel;
+    static const std::string inputKernel;
 };
\ No newline at end of file
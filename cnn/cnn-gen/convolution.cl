@@ -1,7 +1,7 @@
 __attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, WORK_GROUP_DIM_1, WORK_GROUP_DIM_2)))
 __kernel void KERNEL_NAME(
     KERNEL_PARAM
-    __constant float *weight,
+    __constant WEIGHT_TYPE *weight,
     __constant float *offset
     ) {
 
@@ -13,8 +13,8 @@ __kernel void KERNEL_NAME(
     int rLocal = get_local_id(1);
     int oLocal = get_local_id(2);
 
-    __local float inLocal[IN_SIZE];
-    __local float weightLocal[IDEPTH * ODEPTH * KERNEL_LEN];
+    __local LOCAL_TYPE inLocal[IN_SIZE];
+    __local LOCAL_TYPE weightLocal[IDEPTH * ODEPTH * KERNEL_LEN];
     __local float offsetLocal[ODEPTH];
     // __local float outLocal[OUT_SIZE];
 
@@ -26,14 +26,14 @@ __kernel void KERNEL_NAME(
         __attribute__((xcl_pipeline_loop))
         #endif
         for (int i = 0; i < IN_SIZE; ++i) {
-            inLocal[i] = in[i];
+            LOCAL_STORE(inLocal, i, IN_LOAD(i));
         }
 
         #ifdef __xilinx__
         __attribute__((xcl_pipeline_loop))
         #endif
         for (int i = 0; i < IDEPTH * ODEPTH * KERNEL_LEN; ++i) {
-            weightLocal[i] = weight[i];
+            LOCAL_STORE(weightLocal, i, WEIGHT_LOAD(i));
         }
 
 
@@ -49,12 +49,12 @@ __kernel void KERNEL_NAME(
     barrier(CLK_LOCAL_MEM_FENCE);
 
     // Initialize the private output buffer to zero.
-    float outPrivate[OWIDTH_TILE * OHEIGHT_TILE * ODEPTH_TILE];
+    ACC_TYPE outPrivate[OWIDTH_TILE * OHEIGHT_TILE * ODEPTH_TILE];
     #ifdef __xilinx__
     __attribute__((xcl_pipeline_loop))
     #endif
     for (int i = 0; i < OWIDTH_TILE * OHEIGHT_TILE * ODEPTH_TILE; ++i) {
-        outPrivate[i] = 0.0f;
+        outPrivate[i] = 0;
     }
 
     // Tile the input feature map.
@@ -68,8 +68,8 @@ __kernel void KERNEL_NAME(
                         int weightIdx = 0;
                         for (int x = 0; x < KERNEL_SIZE; ++x) {
                             for (int y = 0; y < KERNEL_SIZE; ++y, ++weightIdx) {
-                                outPrivate[oPrivateIdx] += inLocal[((i + iTile) * IHEIGHT + r + rTile + x) * IWIDTH + c + cTile + y]
-                                    * weightLocal[((o + oTile) * IDEPTH + i + iTile) * KERNEL_LEN + weightIdx];
+                                outPrivate[oPrivateIdx] += (ACC_TYPE)LOCAL_LOAD(inLocal, ((i + iTile) * IHEIGHT + r + rTile + x) * IWIDTH + c + cTile + y)
+                                    * (ACC_TYPE)LOCAL_LOAD(weightLocal, ((o + oTile) * IDEPTH + i + iTile) * KERNEL_LEN + weightIdx);
                             }
                         }
                     }
@@ -83,7 +83,7 @@ __kernel void KERNEL_NAME(
     for (int r = 0; r < OHEIGHT_TILE; ++r) {
         for (int c = 0; c < OWIDTH_TILE; ++c) {
             for (int o = 0; o < ODEPTH_TILE; ++o, ++oPrivateIdx) {
-                out[((o + oTile) * OHEIGHT + r + rTile) * OWIDTH + c + cTile] = sigmod(outPrivate[oPrivateIdx] + offsetLocal[o + oTile]);
+                OUT_STORE(((o + oTile) * OHEIGHT + r + rTile) * OWIDTH + c + cTile, ACTIVATE(outPrivate[oPrivateIdx] + offsetLocal[o + oTile]));
             }
         }
     }
@@ -0,0 +1,96 @@
+__attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, WORK_GROUP_DIM_1, WORK_GROUP_DIM_2)))
+__kernel void KERNEL_NAME(
+    KERNEL_PARAM
+    __constant char *weight,
+    __constant float *offset,
+    __constant float *scale
+    ) {
+
+    // scale[0] quantizes the input, scale[1 + o] dequantizes output map o.
+
+    int cTile = get_global_id(0) * OWIDTH_TILE;
+    int rTile = get_global_id(1) * OHEIGHT_TILE;
+    int oTile = get_global_id(2) * ODEPTH_TILE;
+
+    int cLocal = get_local_id(0);
+    int rLocal = get_local_id(1);
+    int oLocal = get_local_id(2);
+
+    __local char inLocal[IN_SIZE];
+    __local char weightLocal[IDEPTH * ODEPTH * KERNEL_LEN];
+    __local float offsetLocal[ODEPTH];
+    __local float scaleLocal[ODEPTH];
+
+    // This the the first work item in the group,
+    // Quantize the input and copy the weight into the local buffer.
+    if (cLocal == 0 && rLocal == 0 && oLocal == 0) {
+
+        float inScale = scale[0];
+
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int i = 0; i < IN_SIZE; ++i) {
+            inLocal[i] = (char)clamp(floor(IN_LOAD(i) * inScale + 0.5f), -127.0f, 127.0f);
+        }
+
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int i = 0; i < IDEPTH * ODEPTH * KERNEL_LEN; ++i) {
+            weightLocal[i] = weight[i];
+        }
+
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int i = 0; i < ODEPTH; ++i) {
+            offsetLocal[i] = offset[i];
+            scaleLocal[i] = scale[1 + i];
+        }
+    }
+
+    // Set a barrier.
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Initialize the private int32 accumulators to zero.
+    int outPrivate[OWIDTH_TILE * OHEIGHT_TILE * ODEPTH_TILE];
+    #ifdef __xilinx__
+    __attribute__((xcl_pipeline_loop))
+    #endif
+    for (int i = 0; i < OWIDTH_TILE * OHEIGHT_TILE * ODEPTH_TILE; ++i) {
+        outPrivate[i] = 0;
+    }
+
+    // Tile the input feature map.
+    for (int iTile = 0; iTile < IDEPTH; iTile += IDEPTH_TILE) {
+
+        int oPrivateIdx = 0;
+        for (int r = 0; r < OHEIGHT_TILE; ++r) {
+            for (int c = 0; c < OWIDTH_TILE; ++c) {
+                for (int o = 0; o < ODEPTH_TILE; ++o, ++oPrivateIdx) {
+                    for (int i = 0; i < IDEPTH_TILE; ++i) {
+                        int weightIdx = 0;
+                        for (int x = 0; x < KERNEL_SIZE; ++x) {
+                            for (int y = 0; y < KERNEL_SIZE; ++y, ++weightIdx) {
+                                outPrivate[oPrivateIdx] += (int)inLocal[((i + iTile) * IHEIGHT + r + rTile + x) * IWIDTH + c + cTile + y]
+                                    * (int)weightLocal[((o + oTile) * IDEPTH + i + iTile) * KERNEL_LEN + weightIdx];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Dequantize into the output buffer.
+    int oPrivateIdx = 0;
+    for (int r = 0; r < OHEIGHT_TILE; ++r) {
+        for (int c = 0; c < OWIDTH_TILE; ++c) {
+            for (int o = 0; o < ODEPTH_TILE; ++o, ++oPrivateIdx) {
+                OUT_STORE(((o + oTile) * OHEIGHT + r + rTile) * OWIDTH + c + cTile,
+                    ACTIVATE((float)outPrivate[oPrivateIdx] * scaleLocal[o + oTile] + offsetLocal[o + oTile]));
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+__attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, WORK_GROUP_DIM_1, WORK_GROUP_DIM_2)))
+__kernel void KERNEL_NAME(
+    KERNEL_PARAM
+    __constant WEIGHT_TYPE *weight,
+    __constant float *offset
+    ) {
+
+    // Output map o sums the input maps connectionInput[connectionBegin[o]..connectionBegin[o + 1]),
+    // the weight holds the kernels of these pairs one after another.
+    const int connectionBegin[ODEPTH + 1] = CONNECTION_BEGIN;
+    const int connectionInput[CONNECTIONS] = CONNECTION_INPUT;
+
+    int cTile = get_global_id(0) * OWIDTH_TILE;
+    int rTile = get_global_id(1) * OHEIGHT_TILE;
+    int oTile = get_global_id(2) * ODEPTH_TILE;
+
+    int cLocal = get_local_id(0);
+    int rLocal = get_local_id(1);
+    int oLocal = get_local_id(2);
+
+    __local LOCAL_TYPE inLocal[IN_SIZE];
+    __local LOCAL_TYPE weightLocal[CONNECTIONS * KERNEL_LEN];
+    __local float offsetLocal[ODEPTH];
+
+    // This the the first work item in the group,
+    // Copy the input, output and weight into the local buffer.
+    if (cLocal == 0 && rLocal == 0 && oLocal == 0) {
+
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int i = 0; i < IN_SIZE; ++i) {
+            LOCAL_STORE(inLocal, i, IN_LOAD(i));
+        }
+
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int i = 0; i < CONNECTIONS * KERNEL_LEN; ++i) {
+            LOCAL_STORE(weightLocal, i, WEIGHT_LOAD(i));
+        }
+
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int i = 0; i < ODEPTH; ++i) {
+            offsetLocal[i] = offset[i];
+        }
+    }
+
+    // Set a barrier.
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Only the connected pairs are multiplied.
+    for (int r = 0; r < OHEIGHT_TILE; ++r) {
+        for (int c = 0; c < OWIDTH_TILE; ++c) {
+            for (int o = 0; o < ODEPTH_TILE; ++o) {
+                ACC_TYPE outPrivate = 0;
+                for (int p = connectionBegin[o + oTile]; p < connectionBegin[o + oTile + 1]; ++p) {
+                    int i = connectionInput[p];
+                    int weightIdx = 0;
+                    for (int x = 0; x < KERNEL_SIZE; ++x) {
+                        for (int y = 0; y < KERNEL_SIZE; ++y, ++weightIdx) {
+                            outPrivate += (ACC_TYPE)LOCAL_LOAD(inLocal, (i * IHEIGHT + r + rTile + x) * IWIDTH + c + cTile + y)
+                                * (ACC_TYPE)LOCAL_LOAD(weightLocal, p * KERNEL_LEN + weightIdx);
+                        }
+                    }
+                }
+                OUT_STORE(((o + oTile) * OHEIGHT + r + rTile) * OWIDTH + c + cTile, ACTIVATE(outPrivate + offsetLocal[o + oTile]));
+            }
+        }
+    }
+}
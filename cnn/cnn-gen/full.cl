@@ -1,25 +1,25 @@
 __attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, 1, 1)))
 __kernel void KERNEL_NAME(
     KERNEL_PARAM
-    __constant float *weight,
+    __constant WEIGHT_TYPE *weight,
     __constant float *offset
     ) {
 
     int o = get_global_id(0);
     int oLocal = get_local_id(0);
 
-    __local float inLocal[IN_SIZE];
-    __local float weightLocal[WORK_GROUP_DIM_0 * IN_SIZE];
+    __local LOCAL_TYPE inLocal[IN_SIZE];
+    __local LOCAL_TYPE weightLocal[WORK_GROUP_DIM_0 * IN_SIZE];
     __local float offsetLocal[WORK_GROUP_DIM_0];
 
     if (oLocal == 0) {
 
         for (int i = 0; i < IN_SIZE; ++i) {
-            inLocal[i] = in[i];
+            LOCAL_STORE(inLocal, i, IN_LOAD(i));
         }
 
         for (int i = 0; i < WORK_GROUP_DIM_0 * IN_SIZE; ++i) {
-            weightLocal[i] = weight[o * IN_SIZE + i];
+            LOCAL_STORE(weightLocal, i, WEIGHT_LOAD(o * IN_SIZE + i));
         }
 
         for (int i = 0; i < WORK_GROUP_DIM_0; ++i) {
@@ -32,7 +32,7 @@ __kernel void KERNEL_NAME(
 
     if (o < OUT_SIZE) {
 
-        float sum = 0;
+        ACC_TYPE sum = 0;
         #ifdef __xilinx__
                 __attribute__((xcl_pipeline_loop))
         #endif
@@ -44,18 +44,18 @@ __kernel void KERNEL_NAME(
             __attribute__((opencl_unroll_hint))
             #endif
             for (int j = 0; j < KERNEL_SIZE; ++j) {
-                inBuf[j] = inLocal[i + j];
-                weightBuf[j] = weightLocal[oLocal * IN_SIZE + i + j];
+                inBuf[j] = LOCAL_LOAD(inLocal, i + j);
+                weightBuf[j] = LOCAL_LOAD(weightLocal, oLocal * IN_SIZE + i + j);
             }
 
             #ifdef __xilinx__
             __attribute__((opencl_unroll_hint))
             #endif
             for (int j = 0; j < KERNEL_SIZE; ++j) {
-                sum += weightBuf[j] * inBuf[j];
+                sum += (ACC_TYPE)weightBuf[j] * (ACC_TYPE)inBuf[j];
             }
         }
         sum += offsetLocal[oLocal]; 
-        out[o] = sigmod(sum);
+        OUT_STORE(o, ACTIVATE(sum));
     }
 }
@@ -0,0 +1,64 @@
+__attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, 1, 1)))
+__kernel void KERNEL_NAME(
+    KERNEL_PARAM
+    __constant char *weight,
+    __constant float *offset,
+    __constant float *scale
+    ) {
+
+    // scale[0] quantizes the input, scale[1 + o] dequantizes output o.
+
+    int o = get_global_id(0);
+    int oLocal = get_local_id(0);
+
+    __local char inLocal[IN_SIZE];
+    __local char weightLocal[WORK_GROUP_DIM_0 * IN_SIZE];
+    __local float offsetLocal[WORK_GROUP_DIM_0];
+    __local float scaleLocal[WORK_GROUP_DIM_0];
+
+    if (oLocal == 0) {
+
+        float inScale = scale[0];
+
+        for (int i = 0; i < IN_SIZE; ++i) {
+            inLocal[i] = (char)clamp(floor(IN_LOAD(i) * inScale + 0.5f), -127.0f, 127.0f);
+        }
+
+        for (int i = 0; i < WORK_GROUP_DIM_0 * IN_SIZE; ++i) {
+            weightLocal[i] = weight[o * IN_SIZE + i];
+        }
+
+        for (int i = 0; i < WORK_GROUP_DIM_0; ++i) {
+            offsetLocal[i] = offset[o + i];
+            scaleLocal[i] = scale[1 + o + i];
+        }
+    }
+
+    // Set a barrier.
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (o < OUT_SIZE) {
+
+        int sum = 0;
+        char inBuf[KERNEL_SIZE];
+        char weightBuf[KERNEL_SIZE];
+        for (int i = 0; i < IN_SIZE; i += KERNEL_SIZE) {
+
+            #ifdef __xilinx__
+            __attribute__((opencl_unroll_hint))
+            #endif
+            for (int j = 0; j < KERNEL_SIZE; ++j) {
+                inBuf[j] = inLocal[i + j];
+                weightBuf[j] = weightLocal[oLocal * IN_SIZE + i + j];
+            }
+
+            #ifdef __xilinx__
+            __attribute__((opencl_unroll_hint))
+            #endif
+            for (int j = 0; j < KERNEL_SIZE; ++j) {
+                sum += (int)weightBuf[j] * (int)inBuf[j];
+            }
+        }
+        OUT_STORE(o, ACTIVATE((float)sum * scaleLocal[oLocal] + offsetLocal[oLocal]));
+    }
+}
@@ -0,0 +1,41 @@
+__attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, 1, 1)))
+__kernel void KERNEL_NAME(
+    KERNEL_PARAM
+    __global WEIGHT_TYPE *weight,
+    __constant float *offset,
+    __global int *column,
+    __global int *rowBegin
+    ) {
+
+    int o = get_global_id(0);
+    int oLocal = get_local_id(0);
+
+    // Only the input is shared, every work item streams the nonzeros of its own row.
+    __local LOCAL_TYPE inLocal[IN_SIZE];
+
+    if (oLocal == 0) {
+
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int i = 0; i < IN_SIZE; ++i) {
+            LOCAL_STORE(inLocal, i, IN_LOAD(i));
+        }
+    }
+
+    // Set a barrier.
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (o < OUT_SIZE) {
+
+        ACC_TYPE sum = 0;
+        int end = rowBegin[o + 1];
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int p = rowBegin[o]; p < end; ++p) {
+            sum += (ACC_TYPE)WEIGHT_LOAD(p) * (ACC_TYPE)LOCAL_LOAD(inLocal, column[p]);
+        }
+        OUT_STORE(o, ACTIVATE(sum + offset[o]));
+    }
+}
@@ -0,0 +1,21 @@
+__attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, WORK_GROUP_DIM_1, WORK_GROUP_DIM_2)))
+__kernel void KERNEL_NAME(
+    __global uchar *raw,
+    __global float *out
+    ) {
+
+    int c = get_global_id(0);
+    int r = get_global_id(1);
+    int d = get_global_id(2);
+
+    // Center the raw image, the padding takes the value of a 0 pixel.
+    if (c < OWIDTH) {
+        int rawC = c - PAD_LEFT;
+        int rawR = r - PAD_TOP;
+        float value = BIAS;
+        if (rawC >= 0 && rawC < RAW_WIDTH && rawR >= 0 && rawR < RAW_HEIGHT) {
+            value = (float)raw[(d * RAW_HEIGHT + rawR) * RAW_WIDTH + rawC] * SCALE + BIAS;
+        }
+        out[(d * OHEIGHT + r) * OWIDTH + c] = value;
+    }
+}
@@ -1,5 +1,7 @@
 #include "CNNGenerator.hpp"
 
+#include <algorithm>
+
 /* Initialize the constant value. */
 const std::string CNNGenerator::activateFunc = "\
 float sigmod(float in) {\n\
@@ -10,6 +12,12 @@ const std::string CNNGenerator::convKernel = CNNGenerator::fileToString("convolu
 const std::string CNNGenerator::poolKernel = CNNGenerator::fileToString("pool.cl");
 const std::string CNNGenerator::fullKernel = CNNGenerator::fileToString("full.cl");
 const std::string CNNGenerator::rbfKernel = CNNGenerator::fileToString("rbf.cl");
+const std::string CNNGenerator::winogradKernel = CNNGenerator::fileToString("winograd.cl");
+const std::string CNNGenerator::convInt8Kernel = CNNGenerator::fileToString("convolution_int8.cl");
+const std::string CNNGenerator::fullInt8Kernel = CNNGenerator::fileToString("full_int8.cl");
+const std::string CNNGenerator::convSparseKernel = CNNGenerator::fileToString("convolution_sparse.cl");
+const std::string CNNGenerator::fullSparseKernel = CNNGenerator::fileToString("full_sparse.cl");
+const std::string CNNGenerator::inputKernel = CNNGenerator::fileToString("input.cl");
 
 int main(int argc, char *argv[]) {
 
@@ -144,5 +152,88 @@ int main(int argc, char *argv[]) {
     CNNGenerator::genCNN("../cnn/kernel/rbf7.xml", "../cnn/kernel/rbf7.cl", 1, &paramsUntile[6]);
     CNNGenerator::genCNN("../cnn/kernel/lenet5.xml", "../cnn/kernel/lenet5.cl", 7, paramsUntile);
 
+    // Winograd F(2x2, 5x5) for conv1 and conv3, one work item per output tile.
+    // conv5 has a 1x1 output where the transform costs more than it saves.
+    CNNGenerator::LayerParam paramsWinograd[7];
+    std::copy(paramsUntile, paramsUntile + 7, paramsWinograd);
+    for (size_t i = 0; i < 3; i += 2) {
+        paramsWinograd[i].algorithm = CNNGenerator::WINOGRAD;
+        paramsWinograd[i].winogradTile = 2;
+    }
+    paramsWinograd[2].workGroupSize[0] = 5;
+    paramsWinograd[2].workGroupSize[1] = 5;
+
+    CNNGenerator::genCNN("../cnn/kernel/conv1_winograd.xml", "../cnn/kernel/conv1_winograd.cl", 1, &paramsWinograd[0]);
+    CNNGenerator::genCNN("../cnn/kernel/conv3_winograd.xml", "../cnn/kernel/conv3_winograd.cl", 1, &paramsWinograd[2]);
+    CNNGenerator::genCNN("../cnn/kernel/lenet5_winograd.xml", "../cnn/kernel/lenet5_winograd.cl", 7, paramsWinograd);
+
+    // Cheap activations: ReLU in the hidden layers, the LUT sigmoid before the RBF output.
+    CNNGenerator::LayerParam paramsActivation[7];
+    std::copy(paramsUntile, paramsUntile + 7, paramsActivation);
+    for (size_t i = 0; i < 5; ++i) {
+        paramsActivation[i].activation = cnn::RELU;
+    }
+    paramsActivation[5].activation = cnn::LUT_SIGMOID;
+
+    CNNGenerator::genCNN("../cnn/kernel/lenet5_activation.xml", "../cnn/kernel/lenet5_activation.cl", 7, paramsActivation);
+
+    // INT8 conv and full layers, the host quantizes the weights and calibration sets the scales.
+    // Pooling and the RBF output stay in fp32.
+    CNNGenerator::LayerParam paramsInt8[7];
+    std::copy(paramsUntile, paramsUntile + 7, paramsInt8);
+    for (size_t i = 0; i < 7; ++i) {
+        if (paramsInt8[i].type == CNNGenerator::CONV || paramsInt8[i].type == CNNGenerator::FULL) {
+            paramsInt8[i].precision = cnn::INT8;
+        }
+    }
+
+    CNNGenerator::genCNN("../cnn/kernel/lenet5_int8.xml", "../cnn/kernel/lenet5_int8.cl", 7, paramsInt8);
+
+    // Half storage with fp32 accumulation, the RBF output keeps fp32 for the distances.
+    CNNGenerator::LayerParam paramsFP16[7];
+    std::copy(paramsUntile, paramsUntile + 7, paramsFP16);
+    for (size_t i = 0; i < 6; ++i) {
+        paramsFP16[i].precision = cnn::FP16;
+        paramsFP16[i].accumulation = cnn::FP32;
+    }
+
+    CNNGenerator::genCNN("../cnn/kernel/lenet5_fp16.xml", "../cnn/kernel/lenet5_fp16.cl", 7, paramsFP16);
+
+    // Half accumulation as well where the sums are short, full6 sums 120 products in fp32.
+    for (size_t i = 0; i < 5; ++i) {
+        paramsFP16[i].accumulation = cnn::FP16;
+    }
+
+    CNNGenerator::genCNN("../cnn/kernel/lenet5_fp16_acc16.xml", "../cnn/kernel/lenet5_fp16_acc16.cl", 7, paramsFP16);
+
+    // The LeNet-5 connection table in conv3, 60 of the 6 x 16 map pairs.
+    CNNGenerator::LayerParam paramsSparse[7];
+    std::copy(paramsUntile, paramsUntile + 7, paramsSparse);
+    paramsSparse[2].connection = cnn::connection::lenet5C3();
+
+    CNNGenerator::genCNN("../cnn/kernel/conv3_sparse.xml", "../cnn/kernel/conv3_sparse.cl", 1, &paramsSparse[2]);
+    CNNGenerator::genCNN("../cnn/kernel/lenet5_sparse.xml", "../cnn/kernel/lenet5_sparse.cl", 7, paramsSparse);
+
+    // full6 pruned to a quarter of its weights, streamed from CSR.
+    CNNGenerator::LayerParam paramsPruned[7];
+    std::copy(paramsUntile, paramsUntile + 7, paramsPruned);
+    paramsPruned[5].density = 0.25f;
+
+    CNNGenerator::genCNN("../cnn/kernel/full6_sparse.xml", "../cnn/kernel/full6_sparse.cl", 1, &paramsPruned[5]);
+    CNNGenerator::genCNN("../cnn/kernel/lenet5_pruned.xml", "../cnn/kernel/lenet5_pruned.cl", 7, paramsPruned);
+
+    // rbf7 ranks the 3 nearest classes so the host only reads them back.
+    CNNGenerator::LayerParam paramsHead[7];
+    std::copy(paramsUntile, paramsUntile + 7, paramsHead);
+    paramsHead[6].topK = 3;
+
+    CNNGenerator::genCNN("../cnn/kernel/rbf7_head.xml", "../cnn/kernel/rbf7_head.cl", 1, &paramsHead[6]);
+    CNNGenerator::genCNN("../cnn/kernel/lenet5_head.xml", "../cnn/kernel/lenet5_head.cl", 7, paramsHead);
+
+    // The 28 x 28 digits are padded and normalized on the device.
+    CNNGenerator::InputParam input = { "input0", { 32, 1, 1 }, cnn::ingest::lenet5() };
+
+    CNNGenerator::genCNN("../cnn/kernel/lenet5_u8.xml", "../cnn/kernel/lenet5_u8.cl", 7, paramsUntile, &input);
+
     return 0;
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
 __attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, WORK_GROUP_DIM_1, WORK_GROUP_DIM_2)))
 __kernel void KERNEL_NAME(
     KERNEL_PARAM
-    __global float *weight,
+    __global WEIGHT_TYPE *weight,
     __global float *offset) {
     int c = get_global_id(0);
     int r = get_global_id(1);
@@ -11,7 +11,7 @@ __kernel void KERNEL_NAME(
     int rLocal = get_local_id(1);
     int oLocal = get_local_id(2);
 
-    __local float inLocal[IWIDTH * IHEIGHT * IDEPTH];
+    __local LOCAL_TYPE inLocal[IWIDTH * IHEIGHT * IDEPTH];
     __local float weightLocal[WORK_GROUP_DIM_2];
     __local float offsetLocal[WORK_GROUP_DIM_2];
     // This the the first work item in the group,
@@ -22,14 +22,14 @@ __kernel void KERNEL_NAME(
             __attribute__((xcl_pipeline_loop))
             #endif
             for (int i = 0; i < IWIDTH * IHEIGHT * IDEPTH; ++i) {
-                inLocal[i] = in[i];
+                LOCAL_STORE(inLocal, i, IN_LOAD(i));
             }
 
             #ifdef __xilinx__
             __attribute__((xcl_pipeline_loop))
             #endif
             for (int i = 0; i < WORK_GROUP_DIM_2; ++i) {
-                weightLocal[i] = weight[o + i];
+                weightLocal[i] = WEIGHT_LOAD(o + i);
                 offsetLocal[i] = offset[o + i];
             }
     }
@@ -39,18 +39,18 @@ __kernel void KERNEL_NAME(
 
     if (c < OWIDTH && r < OHEIGHT && o < ODEPTH) {
 
-        float sum = 0.0f;
+        ACC_TYPE sum = 0;
 
         for (int x = 0; x < KERNEL_SIZE; ++x) {
             for (int y = 0; y < KERNEL_SIZE; ++y) {
-                sum += inLocal[(o * IHEIGHT + r * KERNEL_SIZE + x) * IWIDTH + c * KERNEL_SIZE + y];
+                sum += (ACC_TYPE)LOCAL_LOAD(inLocal, (o * IHEIGHT + r * KERNEL_SIZE + x) * IWIDTH + c * KERNEL_SIZE + y);
             }
         }
 
-        sum = sum * weightLocal[oLocal] + offsetLocal[oLocal];
+        float pooled = sum * weightLocal[oLocal] + offsetLocal[oLocal];
 
         // Get the output index.
         int outIdx = (o * OHEIGHT + r) * OWIDTH + c;
-        out[outIdx] = sigmod(sum);
+        OUT_STORE(outIdx, ACTIVATE(pooled));
     }
 }
\ No newline at end of file
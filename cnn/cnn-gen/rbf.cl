@@ -1,31 +1,36 @@
 __attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, WORK_GROUP_DIM_1, WORK_GROUP_DIM_2)))
 __kernel void KERNEL_NAME(
     KERNEL_PARAM
-    __global float *weight,
+    __global WEIGHT_TYPE *weight,
     __global float *offset
+#ifdef TOP_K
+    , __global int *head
+#endif
     ) {
 
     int o = get_global_id(0);
     int oLocal = get_local_id(0);
 
-    __local float inLocal[IN_SIZE];
-    __local float weightLocal[IN_SIZE * WORK_GROUP_DIM_0];
+    __local LOCAL_TYPE inLocal[IN_SIZE];
+    __local LOCAL_TYPE weightLocal[IN_SIZE * WORK_GROUP_DIM_0];
+#ifdef TOP_K
+    __local float distanceLocal[OUT_SIZE];
+#endif
 
     if (oLocal == 0) {
         for (int i = 0; i < IN_SIZE; ++i) {
-            inLocal[i] = in[i];
+            LOCAL_STORE(inLocal, i, IN_LOAD(i));
         }
         for (int i = 0; i < IN_SIZE * WORK_GROUP_DIM_0; ++i) {
-            weightLocal[i] = weight[o * IN_SIZE + i];
+            LOCAL_STORE(weightLocal, i, WEIGHT_LOAD(o * IN_SIZE + i));
         }
     }
 
     // Set a barrier.
     barrier(CLK_LOCAL_MEM_FENCE);
     
+    ACC_TYPE sum = 0;
     if (o < OUT_SIZE) {
-        float sum = 0.0f;
-
         float inBuf[KERNEL_SIZE];
         float weightBuf[KERNEL_SIZE];
 
@@ -38,18 +43,49 @@ __kernel void KERNEL_NAME(
             __attribute__((opencl_unroll_hint))
             #endif
             for (int j = 0; j < KERNEL_SIZE; ++j) {
-                inBuf[j] = inLocal[i + j];
-                weightBuf[j] = weightLocal[oLocal * IN_SIZE + i + j];
+                inBuf[j] = LOCAL_LOAD(inLocal, i + j);
+                weightBuf[j] = LOCAL_LOAD(weightLocal, oLocal * IN_SIZE + i + j);
             }
         
             #ifdef __xilinx__
             __attribute__((opencl_unroll_hint))
             #endif
             for (int j = 0; j < KERNEL_SIZE; ++j) {
-                float diff = weightBuf[j] - inBuf[j];
+                ACC_TYPE diff = (ACC_TYPE)weightBuf[j] - (ACC_TYPE)inBuf[j];
                 sum += diff * diff;
             }
         }
-        out[o] = sum;
+        OUT_STORE(o, sum);
+    }
+
+#ifdef TOP_K
+    // The only work group holds every distance, its first item ranks them:
+    // head[k] is the k-th nearest class and head[TOP_K + k] the bits of its distance.
+    if (o < OUT_SIZE) {
+        distanceLocal[o] = sum;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (oLocal == 0) {
+        int taken[TOP_K];
+        for (int k = 0; k < TOP_K; ++k) {
+            int best = -1;
+            float bestDistance = 0.0f;
+            for (int c = 0; c < OUT_SIZE; ++c) {
+                int isTaken = 0;
+                for (int j = 0; j < k; ++j) {
+                    isTaken |= taken[j] == c;
+                }
+                // Ties go to the lower class.
+                if (!isTaken && (best < 0 || distanceLocal[c] < bestDistance)) {
+                    best = c;
+                    bestDistance = distanceLocal[c];
+                }
+            }
+            taken[k] = best;
+            head[k] = best;
+            head[TOP_K + k] = as_int(bestDistance);
+        }
     }
+#endif
 }
@@ -0,0 +1,114 @@
+#ifndef ACTIVATION_HEADER
+#define ACTIVATION_HEADER
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+/******************************************************************************************
+
+    Activation functions of a layer.
+
+    The sigmoid needs an exp and a division, the most expensive operators of
+    a layer on the FPGA fabric. The cheaper choices are
+        relu            max(x, 0),
+        hard sigmoid    clamp(0.2 x + 0.5, 0, 1),
+        tanh            for models trained with it,
+        lut sigmoid     the sigmoid as LUT_SEGMENTS linear pieces on
+                        [LUT_MIN, LUT_MAX], saturated outside.
+
+    This header only needs the standard library so the generator can share
+    the names and the table it writes into the kernels.
+
+*******************************************************************************************/
+
+namespace cnn {
+
+    enum Activation {
+        SIGMOID,
+        RELU,
+        HARD_SIGMOID,
+        TANH,
+        LUT_SIGMOID
+    };
+
+    const size_t NUM_ACTIVATIONS = 5;
+
+    inline const char *getActivationName(Activation activation) {
+        static const char *NAMES[NUM_ACTIVATIONS] = { "sigmoid", "relu", "hardSigmoid", "tanh", "lutSigmoid" };
+        return NAMES[activation];
+    }
+
+    inline Activation parseActivation(const std::string &name) {
+        for (size_t i = 0; i < NUM_ACTIVATIONS; ++i) {
+            if (name == getActivationName((Activation)i)) {
+                return (Activation)i;
+            }
+        }
+        std::cerr << "parseActivation: Unsupported activation: " << name << std::endl;
+        exit(-1);
+    }
+
+    namespace lut {
+
+        const float LUT_MIN = -8.0f;
+        const float LUT_MAX = 8.0f;
+        const size_t LUT_SEGMENTS = 64;
+
+        // Slope and intercept of the chord of the sigmoid over every segment.
+        struct Table {
+            Table() : slope(LUT_SEGMENTS), intercept(LUT_SEGMENTS) {
+                double width = ((double)LUT_MAX - LUT_MIN) / LUT_SEGMENTS;
+                for (size_t i = 0; i < LUT_SEGMENTS; ++i) {
+                    double x0 = LUT_MIN + i * width;
+                    double x1 = x0 + width;
+                    double y0 = 1.0 / (1.0 + std::exp(-x0));
+                    double y1 = 1.0 / (1.0 + std::exp(-x1));
+                    slope[i] = (float)((y1 - y0) / width);
+                    intercept[i] = (float)(y0 - slope[i] * x0);
+                }
+            }
+            std::vector<float> slope;
+            std::vector<float> intercept;
+        };
+
+        inline const Table &table() {
+            static const Table t;
+            return t;
+        }
+
+        inline float sigmoid(float x, const Table &t) {
+            if (x <= LUT_MIN) {
+                return 0.0f;
+            }
+            if (x >= LUT_MAX) {
+                return 1.0f;
+            }
+            size_t i = (size_t)((x - LUT_MIN) * (LUT_SEGMENTS / (LUT_MAX - LUT_MIN)));
+            i = i < LUT_SEGMENTS ? i : LUT_SEGMENTS - 1;
+            return t.slope[i] * x + t.intercept[i];
+        }
+    }
+
+    // Reference of every activation on one value.
+    inline float activate(Activation activation, float x) {
+        switch (activation) {
+        case RELU:
+            return x > 0.0f ? x : 0.0f;
+        case HARD_SIGMOID: {
+            float y = 0.2f * x + 0.5f;
+            return y < 0.0f ? 0.0f : (y > 1.0f ? 1.0f : y);
+        }
+        case TANH:
+            return std::tanh(x);
+        case LUT_SIGMOID:
+            return lut::sigmoid(x, lut::table());
+        default:
+            return 1.0f / (1.0f + std::exp(-x));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef ANALYSIS_HEADER
+#define ANALYSIS_HEADER
+
+#include <iomanip>
+
+#include "timeline.hpp"
+
+/******************************************************************************************
+
+    Utilization and bottleneck report of a timeline.
+
+        busy            per stage, the sum of END - START of its commands
+        idle gaps       the device runs nothing between the first START and
+                        the last END, none of the commands covering them
+        queued->start   per stage, how long its commands wait in the queue
+        concurrency     the summed busy time of the stages over the time
+                        the device runs anything, 1 without any overlap
+        overlap         the share of that time with two commands or more
+        II              the median time between the ends of the reads of
+                        consecutive inputs, without the first and the last
+                        quarter of the inputs: the fill and the drain
+        critical stage  the stage of the longest mean command
+
+    The II bound is the mean command of the critical stage when the stages
+    overlap (pipeline) and the sum of the mean commands when they don't
+    (batch): the efficiency is the bound over the achieved II.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace analysis {
+
+        struct StageReport {
+            std::string name;
+            long long busy;
+            double utilization;
+            double meanDuration;
+            long long maxDuration;
+            double meanQueuedToStart;
+            long long maxQueuedToStart;
+        };
+
+        // Nanoseconds, but the ratios.
+        struct Report {
+            timeline::Schedule schedule;
+            size_t n;
+            long long makespan;
+            long long busy;
+            long long idle;
+            size_t gaps;
+            long long maxGap;
+            double concurrency;
+            double overlap;
+            double ii;
+            double iiBound;
+            double efficiency;
+            size_t criticalStage;
+            std::vector<StageReport> stages;
+        };
+
+        inline Report analyze(const timeline::Timeline &timeline) {
+            size_t n = timeline.n;
+            size_t stageSize = timeline.stages.size();
+
+            Report report;
+            report.schedule = timeline.schedule;
+            report.n = n;
+
+            // Per stage.
+            long long first = LLONG_MAX;
+            long long last = LLONG_MIN;
+            long long summed = 0;
+            report.criticalStage = 0;
+            for (size_t s = 0; s < stageSize; ++s) {
+                StageReport stage = { timeline.stages[s], 0, 0.0, 0.0, 0, 0.0, 0 };
+                long long queuedToStart = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    const timeline::Command &c = timeline.at(i, s);
+                    stage.busy += c.end - c.start;
+                    stage.maxDuration = std::max(stage.maxDuration, c.end - c.start);
+                    queuedToStart += c.start - c.queued;
+                    stage.maxQueuedToStart = std::max(stage.maxQueuedToStart, c.start - c.queued);
+                    first = std::min(first, c.start);
+                    last = std::max(last, c.end);
+                }
+                stage.meanDuration = (double)stage.busy / (double)n;
+                stage.meanQueuedToStart = (double)queuedToStart / (double)n;
+                summed += stage.busy;
+                report.stages.push_back(stage);
+                if (stage.meanDuration > report.stages[report.criticalStage].meanDuration) {
+                    report.criticalStage = s;
+                }
+            }
+            report.makespan = last - first;
+            for (size_t s = 0; s < stageSize; ++s) {
+                report.stages[s].utilization = report.makespan > 0 ? (double)report.stages[s].busy / (double)report.makespan : 0.0;
+            }
+
+            // Sweep the starts and ends for the busy time, the gaps and the overlap.
+            // An end sorts before a start at the same time, back to back commands leave no gap.
+            std::vector<std::pair<long long, int> > edges;
+            edges.reserve(timeline.commands.size() * 2);
+            for (size_t e = 0; e < timeline.commands.size(); ++e) {
+                edges.push_back(std::make_pair(timeline.commands[e].start, 1));
+                edges.push_back(std::make_pair(timeline.commands[e].end, -1));
+            }
+            std::sort(edges.begin(), edges.end());
+            report.busy = 0;
+            report.gaps = 0;
+            report.maxGap = 0;
+            long long overlapped = 0;
+            int running = 0;
+            long long previous = first;
+            for (size_t e = 0; e < edges.size(); ++e) {
+                long long t = edges[e].first;
+                if (running == 0 && t > previous) {
+                    report.gaps++;
+                    report.maxGap = std::max(report.maxGap, t - previous);
+                }
+                if (running >= 1) {
+                    report.busy += t - previous;
+                }
+                if (running >= 2) {
+                    overlapped += t - previous;
+                }
+                running += edges[e].second;
+                previous = t;
+            }
+            report.idle = report.makespan - report.busy;
+            report.concurrency = report.busy > 0 ? (double)summed / (double)report.busy : 0.0;
+            report.overlap = report.busy > 0 ? (double)overlapped / (double)report.busy : 0.0;
+
+            // Steady state initiation interval.
+            std::vector<long long> intervals;
+            size_t trim = (n - 1) / 4;
+            for (size_t i = 1 + trim; i + trim < n; ++i) {
+                intervals.push_back(timeline.at(i, stageSize - 1).end - timeline.at(i - 1, stageSize - 1).end);
+            }
+            report.ii = 0.0;
+            if (!intervals.empty()) {
+                std::sort(intervals.begin(), intervals.end());
+                size_t half = intervals.size() / 2;
+                report.ii = intervals.size() % 2 ? (double)intervals[half] : 0.5 * (double)(intervals[half - 1] + intervals[half]);
+            }
+            report.iiBound = timeline.schedule == timeline::SCHEDULE_PIPELINE ?
+                report.stages[report.criticalStage].meanDuration : (double)summed / (double)n;
+            report.efficiency = report.ii > 0.0 ? report.iiBound / report.ii : 0.0;
+            return report;
+        }
+
+        inline void writeSummary(std::ostream &o, const Report &report) {
+            const StageReport &critical = report.stages[report.criticalStage];
+            o << std::fixed << std::setprecision(2);
+            o << "Timeline of " << report.n << " inputs, "
+                << (report.schedule == timeline::SCHEDULE_PIPELINE ? "pipeline" : "batch") << ", "
+                << report.stages.size() << " stages" << std::endl;
+            o << "  makespan " << report.makespan * 1e-3 << " us, busy " << report.busy * 1e-3 << " us, idle "
+                << report.idle * 1e-3 << " us in " << report.gaps << " gaps, largest " << report.maxGap * 1e-3 << " us" << std::endl;
+            o << "  concurrency " << report.concurrency << ", overlap " << report.overlap * 100.0 << "% of the busy time" << std::endl;
+            o << "  II " << report.ii * 1e-3 << " us, bound " << report.iiBound * 1e-3 << " us, efficiency "
+                << report.efficiency * 100.0 << "%" << std::endl;
+            o << "  critical stage " << report.criticalStage << " " << critical.name << ", "
+                << critical.meanDuration * 1e-3 << " us per command" << std::endl;
+            o << "  " << std::left << std::setw(24) << "stage" << std::right << std::setw(12) << "busy us"
+                << std::setw(8) << "util" << std::setw(12) << "mean us" << std::setw(12) << "max us"
+                << std::setw(14) << "queued us" << std::setw(14) << "max queued us" << std::endl;
+            for (size_t s = 0; s < report.stages.size(); ++s) {
+                const StageReport &stage = report.stages[s];
+                std::ostringstream name;
+                name << s << " " << stage.name;
+                o << "  " << std::left << std::setw(24) << name.str() << std::right
+                    << std::setw(12) << stage.busy * 1e-3 << std::setw(7) << stage.utilization * 100.0 << "%"
+                    << std::setw(12) << stage.meanDuration * 1e-3 << std::setw(12) << stage.maxDuration * 1e-3
+                    << std::setw(14) << stage.meanQueuedToStart * 1e-3 << std::setw(14) << stage.maxQueuedToStart * 1e-3 << std::endl;
+            }
+            o.unsetf(std::ios::floatfield);
+        }
+
+        inline void writeJSON(std::ostream &o, const Report &report) {
+            o << std::setprecision(9);
+            o << "{" << std::endl;
+            o << "  \"schedule\": \"" << (report.schedule == timeline::SCHEDULE_PIPELINE ? "pipeline" : "batch") << "\"," << std::endl;
+            o << "  \"inputs\": " << report.n << "," << std::endl;
+            o << "  \"unit\": \"ns\"," << std::endl;
+            o << "  \"makespan\": " << report.makespan << "," << std::endl;
+            o << "  \"busy\": " << report.busy << "," << std::endl;
+            o << "  \"idle\": " << report.idle << "," << std::endl;
+            o << "  \"gaps\": " << report.gaps << "," << std::endl;
+            o << "  \"maxGap\": " << report.maxGap << "," << std::endl;
+            o << "  \"concurrency\": " << report.concurrency << "," << std::endl;
+            o << "  \"overlap\": " << report.overlap << "," << std::endl;
+            o << "  \"ii\": " << report.ii << "," << std::endl;
+            o << "  \"iiBound\": " << report.iiBound << "," << std::endl;
+            o << "  \"efficiency\": " << report.efficiency << "," << std::endl;
+            o << "  \"criticalStage\": " << report.criticalStage << "," << std::endl;
+            o << "  \"stages\": [" << std::endl;
+            for (size_t s = 0; s < report.stages.size(); ++s) {
+                const StageReport &stage = report.stages[s];
+                o << "    {\"name\": " << jsonString(stage.name) << ", \"busy\": " << stage.busy
+                    << ", \"utilization\": " << stage.utilization << ", \"meanDuration\": " << stage.meanDuration
+                    << ", \"maxDuration\": " << stage.maxDuration << ", \"meanQueuedToStart\": " << stage.meanQueuedToStart
+                    << ", \"maxQueuedToStart\": " << stage.maxQueuedToStart << "}"
+                    << (s + 1 < report.stages.size() ? "," : "") << std::endl;
+            }
+            o << "  ]" << std::endl;
+            o << "}" << std::endl;
+        }
+    }
+}
+
+#endif
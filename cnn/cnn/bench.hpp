@@ -0,0 +1,586 @@
+#ifndef BENCH_HEADER
+#define BENCH_HEADER
+
+#include <random>
+#include <iomanip>
+
+#include "cnn.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include "analysis.hpp"
+
+/******************************************************************************************
+
+    Benchmark driver.
+
+        cnn --model <xml> [--mode single|batch|pipeline|stream|cpu] [--batch n]
+            [--in-flight n] [--warmup n] [--reps n] [--seed n] [--device n]
+            [--xclbin file] [--threads n] [--confidence 0.90|0.95|0.99]
+            [--json file] [--csv file] [--trace file] [--analysis file]
+            [--sample-every n] [--profile-ring file] [--list-devices]
+        cnn --conv1-variants ..., see variants.hpp
+        cnn --profile-report ..., see wallclock.hpp
+        cnn --regress ..., see regress.hpp
+        cnn --microbench ..., see microbench.hpp
+        cnn --loadgen ..., see loadgen.hpp
+
+    Every repetition forwards the same batch of inputs, drawn uniformly from
+    [-0.5, 0.5) by a generator seeded with --seed, and is timed on the wall
+    clock. The time per input of the repetitions after the warm-up gives the
+    mean and its confidence interval.
+
+        single      one input at a time, blocking, i.e. the latency
+        batch       the in order queue, at most --in-flight inputs enqueued
+        pipeline    the out of order queue with the event pool
+        stream      as batch, also the latency of every input from the
+                    profiling of its first and last command
+        cpu         the CPU forward with --threads workers
+
+    The JSON file gets the options, the device, the summary, the samples and
+    a checksum of the outputs, which is the same for the same seed. The CSV
+    file gets one row per run and its header if it is new. The trace file
+    gets the Chrome trace of the last repetition of batch, pipeline or
+    stream, see trace.hpp; the analysis file its utilization and bottleneck
+    report, also printed, see analysis.hpp.
+
+    --sample-every n turns profiling off on the hot queue and profiles 1 in
+    n inputs on a second queue, 0 none of them: the production mode, see
+    sampling.hpp. --profile-ring writes the ring of their profiles. It
+    leaves no profile of every command for stream, --trace or --analysis.
+
+*******************************************************************************************/
+
+namespace cnn {
+
+    enum BenchMode {
+        BENCH_SINGLE,
+        BENCH_BATCH,
+        BENCH_PIPELINE,
+        BENCH_STREAM,
+        BENCH_CPU
+    };
+
+    const size_t NUM_BENCH_MODES = 5;
+
+    inline const char *getBenchModeName(BenchMode mode) {
+        static const char *NAMES[NUM_BENCH_MODES] = { "single", "batch", "pipeline", "stream", "cpu" };
+        return NAMES[mode];
+    }
+
+    inline BenchMode parseBenchMode(const std::string &name) {
+        for (size_t i = 0; i < NUM_BENCH_MODES; ++i) {
+            if (name == getBenchModeName((BenchMode)i)) {
+                return (BenchMode)i;
+            }
+        }
+        std::cerr << "parseBenchMode: Unsupported mode: " << name << std::endl;
+        exit(-1);
+    }
+
+    namespace bench {
+
+        struct Options {
+            Options() : xclbin("NONE"), device(0), mode(BENCH_BATCH), batch(100), inFlight(0),
+                warmup(2), reps(10), seed(1), threads(1), confidence(0.95), isSampling(false), sampleEvery(0),
+                tolerance(0.10), kernelDir("kernel"), isListDevices(false), isConv1Variants(false),
+                isProfileReport(false), result("result_current.xml"), isRegress(false),
+                isMicrobench(false), arrival("poisson"), qps(100.0), isQPS(false), requests(1000), burst(8),
+                isLoadgen(false) {
+            }
+
+            std::string model;
+            std::string xclbin;
+            size_t device;
+            BenchMode mode;
+            size_t batch;
+            // Inputs enqueued before waiting for the queue, 0 keeps the model's queueBarrier.
+            size_t inFlight;
+            size_t warmup;
+            size_t reps;
+            unsigned int seed;
+            size_t threads;
+            double confidence;
+            std::string json;
+            std::string csv;
+            std::string trace;
+            std::string analysis;
+            bool isSampling;
+            size_t sampleEvery;
+            std::string profileRing;
+            // SDAccel summaries and the traces of the same runs, a baseline report and
+            // the relative increase over it flagged as a regression.
+            std::vector<std::string> sdaccel;
+            std::vector<std::string> hostTraces;
+            std::string baseline;
+            double tolerance;
+            // Where the conv1 variant models are.
+            std::string kernelDir;
+            bool isListDevices;
+            bool isConv1Variants;
+            bool isProfileReport;
+            // The result file of the regression gate and the stored one compared instead of a run.
+            std::string result;
+            std::string current;
+            bool isRegress;
+            bool isMicrobench;
+            // The arrivals of the load generator, the rate given or the one of the trace.
+            std::string arrival;
+            double qps;
+            bool isQPS;
+            size_t requests;
+            size_t burst;
+            std::string arrivalTrace;
+            bool isLoadgen;
+        };
+
+        struct Result {
+            std::string device;
+            size_t inFlight;
+            // Seconds per input of every repetition.
+            std::vector<double> samples;
+            stats::Summary time;
+            // Seconds from enqueuing the input to reading its output, stream only.
+            std::vector<double> latencies;
+            stats::Summary latency;
+            double checksum;
+            // The last repetition, with --trace or --analysis only.
+            timeline::Timeline timeline;
+            // The sampled profiles, with --sample-every only.
+            sampling::RingBuffer ring;
+        };
+
+        inline void printUsage(std::ostream &o) {
+            o << "Usage: cnn <xml> <result> [xclbin]" << std::endl;
+            o << "       cnn --model <xml> [--mode single|batch|pipeline|stream|cpu] [--batch n] [--in-flight n]" << std::endl;
+            o << "           [--warmup n] [--reps n] [--seed n] [--device n] [--xclbin file] [--threads n]" << std::endl;
+            o << "           [--confidence 0.90|0.95|0.99] [--json file] [--csv file] [--trace file]" << std::endl;
+            o << "           [--analysis file] [--sample-every n] [--profile-ring file] [--list-devices]" << std::endl;
+            o << "       cnn --conv1-variants [--kernel-dir dir] [--device n] [--warmup n] [--reps n] [--seed n]" << std::endl;
+            o << "           [--confidence 0.90|0.95|0.99] [--json file] [--csv file]" << std::endl;
+            o << "       cnn --profile-report --sdaccel csv [--host-trace json] ... [--baseline json]" << std::endl;
+            o << "           [--tolerance x] [--json file]" << std::endl;
+            o << "       cnn --regress --baseline xml (--model xml [--xclbin file] [--device n] [--batch n]" << std::endl;
+            o << "           [--result file] | --current xml) [--tolerance x] [--confidence 0.90|0.95|0.99]" << std::endl;
+            o << "       cnn --microbench [--device n] [--kernel-dir dir] [--xclbin file] [--warmup n] [--reps n]" << std::endl;
+            o << "           [--confidence 0.90|0.95|0.99] [--json file]" << std::endl;
+            o << "       cnn --loadgen --model <xml> [--arrival poisson|bursty|trace] [--qps x] [--requests n]" << std::endl;
+            o << "           [--burst n] [--arrival-trace file] [--mode single|batch|pipeline|cpu] [--batch n]" << std::endl;
+            o << "           [--in-flight n] [--warmup n] [--seed n] [--device n] [--xclbin file] [--threads n] [--json file]" << std::endl;
+        }
+
+        inline size_t parseCount(const std::string &flag, const std::string &value) {
+            char *end;
+            long n = std::strtol(value.c_str(), &end, 10);
+            if (*end != '\0' || n < 0) {
+                std::cerr << "bench: " << flag << " needs a count, got " << value << std::endl;
+                exit(-1);
+            }
+            return (size_t)n;
+        }
+
+        inline bool isTraced(const Options &options) {
+            return !options.trace.empty() || !options.analysis.empty();
+        }
+
+        inline Options parseOptions(int argc, char *argv[]) {
+            Options options;
+            for (int i = 1; i < argc; ++i) {
+                std::string flag(argv[i]);
+                if (flag == "--list-devices") {
+                    options.isListDevices = true;
+                    continue;
+                }
+                if (flag == "--conv1-variants") {
+                    options.isConv1Variants = true;
+                    continue;
+                }
+                if (flag == "--profile-report") {
+                    options.isProfileReport = true;
+                    continue;
+                }
+                if (flag == "--regress") {
+                    options.isRegress = true;
+                    continue;
+                }
+                if (flag == "--microbench") {
+                    options.isMicrobench = true;
+                    continue;
+                }
+                if (flag == "--loadgen") {
+                    options.isLoadgen = true;
+                    continue;
+                }
+                if (i + 1 == argc) {
+                    std::cerr << "bench: " << flag << " needs a value" << std::endl;
+                    printUsage(std::cerr);
+                    exit(-1);
+                }
+                std::string value(argv[++i]);
+                if (flag == "--model") {
+                    options.model = value;
+                }
+                else if (flag == "--xclbin") {
+                    options.xclbin = value;
+                }
+                else if (flag == "--device") {
+                    options.device = parseCount(flag, value);
+                }
+                else if (flag == "--mode") {
+                    options.mode = parseBenchMode(value);
+                }
+                else if (flag == "--batch") {
+                    options.batch = parseCount(flag, value);
+                }
+                else if (flag == "--in-flight") {
+                    options.inFlight = parseCount(flag, value);
+                }
+                else if (flag == "--warmup") {
+                    options.warmup = parseCount(flag, value);
+                }
+                else if (flag == "--reps") {
+                    options.reps = parseCount(flag, value);
+                }
+                else if (flag == "--seed") {
+                    options.seed = (unsigned int)parseCount(flag, value);
+                }
+                else if (flag == "--threads") {
+                    options.threads = parseCount(flag, value);
+                }
+                else if (flag == "--confidence") {
+                    options.confidence = std::atof(value.c_str());
+                    stats::tQuantile(options.confidence, 1);
+                }
+                else if (flag == "--json") {
+                    options.json = value;
+                }
+                else if (flag == "--csv") {
+                    options.csv = value;
+                }
+                else if (flag == "--trace") {
+                    options.trace = value;
+                }
+                else if (flag == "--analysis") {
+                    options.analysis = value;
+                }
+                else if (flag == "--sample-every") {
+                    options.isSampling = true;
+                    options.sampleEvery = parseCount(flag, value);
+                }
+                else if (flag == "--profile-ring") {
+                    options.profileRing = value;
+                }
+                else if (flag == "--kernel-dir") {
+                    options.kernelDir = value;
+                }
+                else if (flag == "--sdaccel") {
+                    options.sdaccel.push_back(value);
+                }
+                else if (flag == "--host-trace") {
+                    options.hostTraces.push_back(value);
+                }
+                else if (flag == "--baseline") {
+                    options.baseline = value;
+                }
+                else if (flag == "--tolerance") {
+                    options.tolerance = std::atof(value.c_str());
+                }
+                else if (flag == "--result") {
+                    options.result = value;
+                }
+                else if (flag == "--current") {
+                    options.current = value;
+                }
+                else if (flag == "--arrival") {
+                    options.arrival = value;
+                }
+                else if (flag == "--qps") {
+                    options.qps = std::atof(value.c_str());
+                    options.isQPS = true;
+                }
+                else if (flag == "--requests") {
+                    options.requests = parseCount(flag, value);
+                }
+                else if (flag == "--burst") {
+                    options.burst = parseCount(flag, value);
+                }
+                else if (flag == "--arrival-trace") {
+                    options.arrivalTrace = value;
+                }
+                else {
+                    std::cerr << "bench: Unknown flag " << flag << std::endl;
+                    printUsage(std::cerr);
+                    exit(-1);
+                }
+            }
+            if (isTraced(options) && (options.mode == BENCH_SINGLE || options.mode == BENCH_CPU)) {
+                std::cerr << "bench: --trace and --analysis need the batch, pipeline or stream mode" << std::endl;
+                exit(-1);
+            }
+            if (options.isSampling && (isTraced(options) || options.mode == BENCH_STREAM)) {
+                std::cerr << "bench: --sample-every leaves no profile of every command for stream, --trace or --analysis" << std::endl;
+                exit(-1);
+            }
+            if (!options.profileRing.empty() && !options.isSampling) {
+                std::cerr << "bench: --profile-ring needs --sample-every" << std::endl;
+                exit(-1);
+            }
+            if (options.isLoadgen && (options.qps <= 0.0 || options.requests == 0)) {
+                std::cerr << "bench: --loadgen needs a positive --qps and --requests" << std::endl;
+                exit(-1);
+            }
+            bool isModelFree = options.isListDevices || options.isConv1Variants || options.isProfileReport ||
+                options.isMicrobench || (options.isRegress && !options.current.empty());
+            if (options.reps == 0 || (!isModelFree && (options.model.empty() || options.batch == 0))) {
+                std::cerr << "bench: Needs a model, a batch and repetitions" << std::endl;
+                printUsage(std::cerr);
+                exit(-1);
+            }
+            return options;
+        }
+
+        // n inputs of size floats uniform in [-0.5, 0.5), the same for the same seed.
+        inline void fillInputs(vec &in, size_t n, size_t size, unsigned int seed) {
+            std::mt19937 generator(seed);
+            std::uniform_real_distribution<float> uniform(-0.5f, 0.5f);
+            in.resize(n * size);
+            for (size_t i = 0; i < in.size(); ++i) {
+                in[i] = uniform(generator);
+            }
+        }
+
+        inline void releaseEvents(std::vector<cl_event> &events) {
+            if (!events.empty()) {
+                clWaitForEvents((cl_uint)events.size(), &events[0]);
+            }
+            for (size_t i = 0; i < events.size(); ++i) {
+                clReleaseEvent(events[i]);
+            }
+            events.clear();
+        }
+
+        // Seconds from queuing the first command of every input to the end of its last one.
+        inline void appendLatencies(const std::vector<cl_event> &events, size_t n, std::vector<double> &latencies) {
+            size_t eventSize = events.size() / n;
+            for (size_t i = 0; i < n; ++i) {
+                cl_ulong queued;
+                cl_ulong end;
+                cl_int err = clGetEventProfilingInfo(events[i * eventSize], CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &queued, NULL);
+                err |= clGetEventProfilingInfo(events[(i + 1) * eventSize - 1], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+                handleError(err, "Failed profiling the stream. ");
+                latencies.push_back((double)(end - queued) * 1e-9);
+            }
+        }
+
+        // Forward the batch once, returns the seconds per input.
+        // Collects the timeline of the commands into timeline if not NULL.
+        inline double runOnce(CNN &cnn, const Options &options, const vec &in, vec &out,
+            std::vector<double> *latencies, timeline::Timeline *timeline) {
+            size_t n = options.batch;
+            InSpan inSpan(&in[0], n, cnn.getInSize());
+            OutSpan outSpan(&out[0], n, cnn.getOutSize());
+            std::vector<cl_event> events;
+            double averageTime;
+            double start = wallTime();
+            switch (options.mode) {
+            case BENCH_SINGLE:
+                for (size_t i = 0; i < n; ++i) {
+                    cnn.forwardCL(inSpan[i], outSpan[i]);
+                }
+                break;
+            case BENCH_BATCH:
+            case BENCH_STREAM:
+                events = cnn.forwardCLBatch(inSpan, outSpan, &averageTime);
+                clWaitForEvents((cl_uint)events.size(), &events[0]);
+                break;
+            case BENCH_PIPELINE:
+                events = cnn.forwardCLPipeline(inSpan, outSpan, &averageTime);
+                clWaitForEvents((cl_uint)events.size(), &events[0]);
+                break;
+            case BENCH_CPU:
+                cnn.forwardCPUBatch(inSpan, outSpan, &averageTime);
+                break;
+            }
+            double seconds = (wallTime() - start) / (double)n;
+            if (latencies && options.mode == BENCH_STREAM) {
+                appendLatencies(events, n, *latencies);
+            }
+            if (timeline) {
+                *timeline = timeline::collect(events, cnn.getEnqueues(), n, cnn.getStageNames(),
+                    options.mode == BENCH_PIPELINE ? timeline::SCHEDULE_PIPELINE : timeline::SCHEDULE_BATCH);
+            }
+            releaseEvents(events);
+            return seconds;
+        }
+
+        inline Result run(const Options &options) {
+            CNN cnn(options.model, options.mode != BENCH_PIPELINE, options.xclbin, options.device);
+            if (options.inFlight > 0) {
+                cnn.setQueueBarrier(options.inFlight);
+            }
+            cnn.setThreads(options.threads);
+            if (options.isSampling) {
+                cnn.setProfileSampling(options.sampleEvery);
+            }
+
+            vec in;
+            fillInputs(in, options.batch, cnn.getInSize(), options.seed);
+            vec out(options.batch * cnn.getOutSize());
+
+            Result result;
+            result.device = getDeviceName(cnn.device);
+            result.inFlight = cnn.getQueueBarrier();
+            for (size_t r = 0; r < options.warmup + options.reps; ++r) {
+                bool isWarm = r >= options.warmup;
+                bool isLast = r + 1 == options.warmup + options.reps;
+                double seconds = runOnce(cnn, options, in, out, isWarm ? &result.latencies : NULL,
+                    isTraced(options) && isLast ? &result.timeline : NULL);
+                if (isWarm) {
+                    result.samples.push_back(seconds);
+                }
+            }
+            result.time = stats::summarize(result.samples, options.confidence);
+            result.latency = stats::summarize(result.latencies, options.confidence);
+
+            if (options.isSampling) {
+                result.ring = cnn.flushProfile();
+            }
+
+            result.checksum = 0.0;
+            for (size_t i = 0; i < out.size(); ++i) {
+                result.checksum += out[i];
+            }
+            return result;
+        }
+
+        inline void writeJSONSummary(std::ostream &o, const std::string &name, const stats::Summary &s) {
+            o << "  " << jsonString(name) << ": {\"n\": " << s.n << ", \"mean\": " << s.mean << ", \"stddev\": " << s.stddev
+                << ", \"min\": " << s.min << ", \"median\": " << s.median << ", \"max\": " << s.max
+                << ", \"confidence\": " << s.confidence << ", \"ciLow\": " << s.ciLow << ", \"ciHigh\": " << s.ciHigh << "}";
+        }
+
+        inline void writeJSONArray(std::ostream &o, const std::string &name, const std::vector<double> &values) {
+            o << "  " << jsonString(name) << ": [";
+            for (size_t i = 0; i < values.size(); ++i) {
+                o << (i == 0 ? "" : ", ") << values[i];
+            }
+            o << "]";
+        }
+
+        inline void writeJSON(std::ostream &o, const Options &options, const Result &result) {
+            o << std::setprecision(9);
+            o << "{" << std::endl;
+            o << "  \"model\": " << jsonString(options.model) << "," << std::endl;
+            o << "  \"device\": " << jsonString(result.device) << "," << std::endl;
+            o << "  \"deviceIndex\": " << options.device << "," << std::endl;
+            o << "  \"mode\": " << jsonString(getBenchModeName(options.mode)) << "," << std::endl;
+            o << "  \"batch\": " << options.batch << "," << std::endl;
+            o << "  \"inFlight\": " << result.inFlight << "," << std::endl;
+            o << "  \"threads\": " << options.threads << "," << std::endl;
+            o << "  \"warmup\": " << options.warmup << "," << std::endl;
+            o << "  \"reps\": " << options.reps << "," << std::endl;
+            o << "  \"seed\": " << options.seed << "," << std::endl;
+            if (options.isSampling) {
+                o << "  \"sampleEvery\": " << options.sampleEvery << "," << std::endl;
+            }
+            o << "  \"unit\": \"s\"," << std::endl;
+            writeJSONSummary(o, "time", result.time);
+            o << "," << std::endl;
+            writeJSONArray(o, "samples", result.samples);
+            if (options.mode == BENCH_STREAM) {
+                o << "," << std::endl;
+                writeJSONSummary(o, "latency", result.latency);
+                o << "," << std::endl;
+                writeJSONArray(o, "latencies", result.latencies);
+            }
+            o << "," << std::endl;
+            o << "  \"checksum\": " << result.checksum << std::endl;
+            o << "}" << std::endl;
+        }
+
+        inline void writeCSVHeader(std::ostream &o) {
+            o << "model,device,mode,batch,inFlight,threads,warmup,reps,seed,"
+                << "mean,stddev,min,median,max,confidence,ciLow,ciHigh,latencyMean,latencyCiHigh,checksum" << std::endl;
+        }
+
+        inline void writeCSVRow(std::ostream &o, const Options &options, const Result &result) {
+            const stats::Summary &t = result.time;
+            o << std::setprecision(9) << options.model << "," << result.device << "," << getBenchModeName(options.mode) << ","
+                << options.batch << "," << result.inFlight << "," << options.threads << "," << options.warmup << ","
+                << options.reps << "," << options.seed << "," << t.mean << "," << t.stddev << "," << t.min << ","
+                << t.median << "," << t.max << "," << t.confidence << "," << t.ciLow << "," << t.ciHigh << ","
+                << result.latency.mean << "," << result.latency.ciHigh << "," << result.checksum << std::endl;
+        }
+
+        inline void listDevices(std::ostream &o) {
+            std::vector<std::pair<cl_platform_id, cl_device_id> > devices = getDevices();
+            for (size_t i = 0; i < devices.size(); ++i) {
+                o << i << ": " << getDeviceName(devices[i].second) << std::endl;
+            }
+        }
+
+        // Run the benchmark of the options and write its reports.
+        inline int main(const Options &options) {
+            if (options.isListDevices) {
+                listDevices(std::cout);
+                return 0;
+            }
+
+            Result result = run(options);
+            const stats::Summary &t = result.time;
+            std::cout << options.model << " " << getBenchModeName(options.mode) << " on " << result.device
+                << ": " << t.mean * 1e3 << " ms/input, " << t.confidence * 100.0 << "% CI ["
+                << t.ciLow * 1e3 << ", " << t.ciHigh * 1e3 << "] ms over " << t.n << " reps of " << options.batch << std::endl;
+            if (options.mode == BENCH_STREAM) {
+                std::cout << "Latency: " << result.latency.mean * 1e3 << " ms mean, "
+                    << result.latency.median * 1e3 << " ms median, " << result.latency.max * 1e3 << " ms max" << std::endl;
+            }
+
+            if (!options.json.empty()) {
+                std::ofstream o(options.json.c_str());
+                if (!o.is_open()) {
+                    std::cerr << "Can't open file " << options.json << std::endl;
+                    exit(-1);
+                }
+                writeJSON(o, options, result);
+            }
+            if (!options.csv.empty()) {
+                bool isNew = !std::ifstream(options.csv.c_str()).good();
+                std::ofstream o(options.csv.c_str(), std::ios::app);
+                if (!o.is_open()) {
+                    std::cerr << "Can't open file " << options.csv << std::endl;
+                    exit(-1);
+                }
+                if (isNew) {
+                    writeCSVHeader(o);
+                }
+                writeCSVRow(o, options, result);
+            }
+            if (!options.trace.empty()) {
+                trace::writeChromeTrace(options.trace, result.timeline, result.device, getBenchModeName(options.mode));
+            }
+            if (!options.analysis.empty()) {
+                analysis::Report report = analysis::analyze(result.timeline);
+                analysis::writeSummary(std::cout, report);
+                std::ofstream o(options.analysis.c_str());
+                if (!o.is_open()) {
+                    std::cerr << "Can't open file " << options.analysis << std::endl;
+                    exit(-1);
+                }
+                analysis::writeJSON(o, report);
+            }
+            if (!options.profileRing.empty()) {
+                std::ofstream o(options.profileRing.c_str(), std::ios::binary);
+                if (!o.is_open()) {
+                    std::cerr << "Can't open file " << options.profileRing << std::endl;
+                    exit(-1);
+                }
+                result.ring.write(o);
+                std::cout << "Profiled " << result.ring.size() << " commands, " << result.ring.getOverwritten()
+                    << " overwritten" << std::endl;
+            }
+            return 0;
+        }
+    }
+}
+
+#endif
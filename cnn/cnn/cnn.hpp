@@ -2,6 +2,7 @@
 #define CNN_HEADER
 
 #include <map>
+#include <algorithm>
 
 #include "util.hpp"
 #include "convolution.hpp"
@@ -9,6 +10,12 @@
 #include "fullconnect.hpp"
 #include "rbf.hpp"
 #include "eventpool.hpp"
+#include "threadpool.hpp"
+#include "span.hpp"
+#include "plan.hpp"
+#include "ingest.hpp"
+#include "timeline.hpp"
+#include "sampling.hpp"
 
 
 #define BUFSIZE (64 * 1024 * 1024)
@@ -17,7 +24,9 @@ namespace cnn {
     class CNN {
     public:
 
-        CNN(const std::string &xmlFileName, bool isQueueInOrder = true, const std::string &xclbinFile = "NONE") {
+        // deviceIndex counts the devices of every platform, see getDevices.
+        CNN(const std::string &xmlFileName, bool isQueueInOrder = true, const std::string &xclbinFile = "NONE", size_t deviceIndex = 0)
+            : rawKernel(NULL), clRaw(NULL), raw(NULL), isQuiet(false), sampleQueue(NULL), sampleEvery(0), sampleSequence(0), isLastSampled(false), pool(NULL), xmlFileName(xmlFileName), latencyContext(new CPUContext) {
 
             this->isQueueInOrder = isQueueInOrder;
 
@@ -36,7 +45,7 @@ namespace cnn {
             queueBarrier = getSizeT(root, "queueBarrier");
 
             // Initialize the OpenCL.
-            initOpenCL(isQueueInOrder, inSize);
+            initOpenCL(inSize, deviceIndex);
 
             // For every layer.
             bool isFront = true;
@@ -52,69 +61,186 @@ namespace cnn {
                 layers.push_back(createLayer(layer, xclbinFile != "NONE", flag));
             }
 
+            // Get the kernel taking raw uint8 images, if any.
+            if (hasNode(root, "input")) {
+                initRawInput(root->first_node("input"), xclbinFile != "NONE");
+            }
+
             delete[] buf;
         }
 
         ~CNN() {
+            delete pool;
+            delete latencyContext;
+            for (size_t i = 0; i < batchContexts.size(); ++i) {
+                delete batchContexts[i];
+            }
             for (int i = 0; i < layers.size(); ++i) {
                 delete layers[i];
             }
             for (std::map<std::string, cl_program>::iterator iter = programs.begin(); iter != programs.end(); ++iter) {
                 clReleaseProgram(iter->second);
             }
+            if (rawKernel) {
+                clReleaseKernel(rawKernel);
+                clReleaseMemObject(clRaw);
+            }
+            clReleaseMemObject(clIn);
+            if (sampleQueue) {
+                flushProfile();
+                clReleaseCommandQueue(sampleQueue);
+            }
             clReleaseCommandQueue(queue);
             clReleaseContext(context);
         }
 
-        // Forward with CPU.
-        unsigned long long forwardCPU(const vec &in) {
+        // Let at most n inputs of a batch in flight before waiting for the queue,
+        // the model sets it with <queueBarrier>.
+        void setQueueBarrier(size_t n) {
+            queueBarrier = std::max<size_t>(n, 1);
+        }
 
-            unsigned long long totalTime = layers[0]->forwardCPU(in);
-            for (size_t i = 1; i < layers.size(); ++i) {
-                totalTime += layers[i]->forwardCPU(layers[i - 1]->out);
+        size_t getQueueBarrier() const {
+            return queueBarrier;
+        }
+
+        // Stop the batch and pipelined forwards printing their average time,
+        // for callers timing them from the outside.
+        void setQuiet(bool isQuiet) {
+            this->isQuiet = isQuiet;
+        }
+
+        // Turn profiling off on the hot queue and profile 1 in every inputs of the batch and
+        // pipelined forwards on a second queue into a ring of capacity records, see sampling.hpp.
+        // every 0 profiles none. The single input forwards keep timing their kernels on the
+        // profiled queue, and the events of the other inputs can't be profiled.
+        void setProfileSampling(size_t every, size_t capacity = 4096) {
+            cl_int err;
+            if (!sampleQueue) {
+                err = clFinish(queue);
+                handleError(err, "Failed waiting for the queue. ");
+                clReleaseCommandQueue(queue);
+                queue = createQueue(false);
+                sampleQueue = createQueue(true);
             }
+            flushProfile();
+            sampleEvery = every;
+            sampleSequence = 0;
+            profileRing = sampling::RingBuffer(capacity);
+        }
 
-            return totalTime;
+        bool isSampling() const {
+            return sampleQueue != NULL;
         }
 
-        unsigned long long forwardCPUBatch(const vec &in, vec &out, size_t n, double *averageTime) {
-            // Make sure that input size is correct.
-            size_t inSize = getInSize();
-            size_t outSize = getOutSize();
-            if (in.size() != inSize * n) {
-                std::cerr << "Wrong input size! " << std::endl;
-                exit(-2);
+        // Read every sampled input into the ring, waiting for the ones still running.
+        const sampling::RingBuffer &flushProfile() {
+            drainSamples(true);
+            return profileRing;
+        }
+
+        // The stages of the events of one input: the write, the kernels and the read.
+        std::vector<std::string> getStageNames(bool isRaw = false) const {
+            std::vector<std::string> names(1, "write");
+            if (isRaw) {
+                names.push_back(getKernelName(rawKernel));
+            }
+            for (size_t l = 0; l < layers.size(); ++l) {
+                names.push_back(getKernelName(layers[l]->kernel));
             }
+            names.push_back("read");
+            return names;
+        }
 
-            clock_t start = clock(), diff;
+        // Host clock around every clEnqueue of the last batch or pipelined forward,
+        // in the order of its events.
+        const std::vector<timeline::Enqueue> &getEnqueues() const {
+            return enqueues;
+        }
 
-            // Reserve the output buffer.
-            out.resize(outSize * n);
+        // Use numThreads workers for the CPU forward, pinned to the CPUs in affinity if not empty.
+        // One thread (the default) runs everything on the calling thread.
+        void setThreads(size_t numThreads, const std::vector<int> &affinity = std::vector<int>()) {
+            delete pool;
+            pool = numThreads > 1 ? new ThreadPool(numThreads, affinity) : NULL;
+        }
 
-            for (size_t i = 0; i < n; ++i) {
-                vec inThis(in.begin() + i * inSize, in.begin() + i * inSize + inSize);
-                forwardCPU(inThis);
-                std::copy(layers[layers.size() - 1]->out.begin(), layers[layers.size() - 1]->out.end(), out.begin() + i * outSize);
+        size_t getThreads() const {
+            return pool ? pool->size() : 1;
+        }
+
+        // Forward with CPU into the last layer's out.
+        // With more than one thread every layer is split across the workers for latency.
+        unsigned long long forwardCPU(const vec &in) {
+            return forwardCPU(&in[0], layers[layers.size() - 1]->out.data());
+        }
+
+        // Forward one input with CPU into out.
+        unsigned long long forwardCPU(const float *in, float *out) {
+            double start = wallTime();
+            preparePlans();
+            forwardCPU(in, out, latencyPlan, latencyContext->base, pool);
+            return (unsigned long long)((wallTime() - start) * 1000.0);
+        }
+
+        // Forward n inputs with CPU.
+        unsigned long long forwardCPUBatch(const vec &in, vec &out, size_t n, double *averageTime) {
+            checkInSize(in, n);
+            out.resize(getOutSize() * n);
+            return forwardCPUBatch(InSpan(&in[0], n, getInSize()), OutSpan(&out[0], n, getOutSize()), averageTime);
+        }
+
+        // Forward every input of the span with CPU into the caller's out.
+        // With more than one thread every worker takes whole images for throughput.
+        unsigned long long forwardCPUBatch(const InSpan &in, const OutSpan &out, double *averageTime) {
+            checkSpans(in, out);
+            size_t n = in.getN();
+
+            double start = wallTime();
+
+            // Every worker runs whole images in its own arena.
+            preparePlans();
+            auto task = [&](size_t begin, size_t end, size_t worker) {
+                float *base = batchContexts[worker]->base;
+                for (size_t i = begin; i < end; ++i) {
+                    forwardCPU(in[i], out[i], batchPlan, base, NULL);
+                }
+            };
+            if (pool) {
+                pool->parallelFor(0, n, 1, task);
+            }
+            else {
+                task(0, n, 0);
             }
 
-            diff = clock() - start;
-            *averageTime = (double)diff / (double)CLOCKS_PER_SEC / (double)n;
-            std::cout << "Average time (CPU): " << *averageTime << "s" << std::endl;
+            double diff = wallTime() - start;
+            *averageTime = diff / (double)n;
+            if (!isQuiet) {
+                std::cout << "Average time (CPU): " << *averageTime << "s" << std::endl;
+            }
 
-            return diff;
+            return (unsigned long long)(diff * CLOCKS_PER_SEC);
         }
 
         // Forward with OpenCL.
         unsigned long long forwardCL(const vec &in) {
+            return forwardCL(&in[0], layers[layers.size() - 1]->out.data());
+        }
+
+        // Forward one input with OpenCL and read the result into out.
+        // Passing getIn().data() as in and getOut().data() as out transfers through the
+        // host memory of clIn and clOut, which lets the runtime skip the copies.
+        unsigned long long forwardCL(const float *in, float *out) {
 
             // Prepare the input cl_mem.
+            cl_command_queue &queue = getProfiledQueue();
             cl_int err;
             err = clEnqueueWriteBuffer(queue,
                 clIn,
                 CL_TRUE,
                 0,
-                in.size() * sizeof(cl_float),
-                (void *)&in[0],
+                getInSize() * sizeof(cl_float),
+                (void *)in,
                 0,
                 NULL,
                 NULL);
@@ -126,13 +252,13 @@ namespace cnn {
                 totalTime += layers[i]->forwardCL(queue);
             }
 
-            // Get the result to the last layer's out vec.
+            // Get the result.
             err = clEnqueueReadBuffer(queue,
                 layers[layers.size() - 1]->clOut,
                 CL_TRUE,
                 0,
                 getOutSize() * sizeof(cl_float),
-                &(layers[layers.size() - 1]->out[0]),
+                out,
                 0,
                 NULL,
                 NULL);
@@ -142,85 +268,219 @@ namespace cnn {
 
         // Forward more than one input with in order command queue.
         std::vector<cl_event> forwardCLBatch(const vec &in, vec &out, size_t n, double *averageTime) {
+            checkInSize(in, n);
+            out.resize(getOutSize() * n);
+            return forwardCLBatch(InSpan(&in[0], n, getInSize()), OutSpan(&out[0], n, getOutSize()), averageTime);
+        }
+
+        // Forward every input of the span with in order command queue into the caller's out.
+        // Both spans must stay alive until the returned events complete.
+        std::vector<cl_event> forwardCLBatch(const InSpan &in, const OutSpan &out, double *averageTime) {
 
             // Make sure that input size is correct.
-            size_t inSize = getInSize();
+            checkSpans(in, out);
+            cl_mem clOut = layers[layers.size() - 1]->clOut;
+            return enqueueCLBatch(in, clOut, getOutSize() * sizeof(cl_float), [&](size_t i) {
+                return (void *)out[i];
+            }, averageTime);
+        }
+
+        // Classes ranked on the device per input, 0 if the last layer has no classification head.
+        size_t getTopK() const {
+            RBFLayer *rbf = dynamic_cast<RBFLayer *>(layers[layers.size() - 1]);
+            return rbf ? rbf->getTopK() : 0;
+        }
+
+        // Classify one input with OpenCL, reading back only the head of the last layer.
+        void classifyCL(const float *in, Classification &result) {
+            RBFLayer *rbf = getHead();
+            result.resize(1, rbf->getTopK());
+
+            cl_command_queue &queue = getProfiledQueue();
+            cl_int err;
+            err = clEnqueueWriteBuffer(queue,
+                clIn,
+                CL_TRUE,
+                0,
+                getInSize() * sizeof(cl_float),
+                (void *)in,
+                0,
+                NULL,
+                NULL);
+            handleError(err, "Failed copy input buffer. ");
+
+            for (size_t i = 0; i < layers.size(); ++i) {
+                layers[i]->forwardCL(queue);
+            }
+
+            err = clEnqueueReadBuffer(queue,
+                rbf->clHead,
+                CL_TRUE,
+                0,
+                result.getBytes(),
+                result[0],
+                0,
+                NULL,
+                NULL);
+            handleError(err, "Failed reading the head. ");
+        }
+
+        // Classify every input of the span with in order command queue, reading back the top k
+        // classes and their distances instead of the whole output.
+        // The span and result must stay alive until the returned events complete.
+        std::vector<cl_event> classifyCLBatch(const InSpan &in, Classification &result, double *averageTime) {
+            if (in.getSize() != getInSize()) {
+                std::cerr << "classifyCLBatch: Input size " << in.getSize() << " does not match " << getInSize() << std::endl;
+                exit(-1);
+            }
+            RBFLayer *rbf = getHead();
+            result.resize(in.getN(), rbf->getTopK());
+            return enqueueCLBatch(in, rbf->clHead, result.getBytes(), [&](size_t i) {
+                return (void *)result[i];
+            }, averageTime);
+        }
+
+        // Rank the k nearest classes of the CPU forward the way the device head does.
+        void classifyCPU(const InSpan &in, Classification &result, size_t k) {
             size_t outSize = getOutSize();
-            size_t eventSize = layers.size() + 2;
-            if (in.size() != inSize * n) {
-                std::cerr << "Wrong input size! " << std::endl;
-                exit(-2);
+            vec out(outSize * in.getN());
+            double averageTime;
+            forwardCPUBatch(in, OutSpan(&out[0], in.getN(), outSize), &averageTime);
+            result.resize(in.getN(), k);
+            for (size_t i = 0; i < in.getN(); ++i) {
+                rankClasses(&out[i * outSize], outSize, k, result[i]);
             }
+        }
 
-            clock_t start = clock(), diff;
+        // Whether every kernel can run on the device: its work group within the limits
+        // of the kernel and of the device and its local memory within the device's.
+        // Otherwise reason says which layer does not fit.
+        bool fitsDevice(std::string *reason) const {
+            size_t maxItems[3] = { 0, 0, 0 };
+            cl_ulong localBytes = 0;
+            clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(maxItems), maxItems, NULL);
+            clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(localBytes), &localBytes, NULL);
+            for (size_t l = 0; l < layers.size(); ++l) {
+                const Layer *layer = layers[l];
+                size_t maxGroup = 0;
+                cl_ulong kernelLocalBytes = 0;
+                clGetKernelWorkGroupInfo(layer->kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(maxGroup), &maxGroup, NULL);
+                clGetKernelWorkGroupInfo(layer->kernel, device, CL_KERNEL_LOCAL_MEM_SIZE, sizeof(kernelLocalBytes), &kernelLocalBytes, NULL);
+                size_t group = layer->workGroupSize[0] * layer->workGroupSize[1] * layer->workGroupSize[2];
+                std::ostringstream why;
+                if (group > maxGroup) {
+                    why << "work group of " << group << " items, the kernel allows " << maxGroup;
+                }
+                for (size_t d = 0; d < 3 && why.str().empty(); ++d) {
+                    if (layer->workGroupSize[d] > maxItems[d]) {
+                        why << "work group dimension " << d << " of " << layer->workGroupSize[d] << ", the device allows " << maxItems[d];
+                    }
+                }
+                if (why.str().empty() && kernelLocalBytes > localBytes) {
+                    why << kernelLocalBytes << " bytes of local memory, the device has " << localBytes;
+                }
+                if (!why.str().empty()) {
+                    if (reason) {
+                        std::ostringstream where;
+                        where << "layer " << l << ": " << why.str();
+                        *reason = where.str();
+                    }
+                    return false;
+                }
+            }
+            return true;
+        }
 
-            // Reserve the output buffer.
-            out.resize(outSize * n);
+        // Whether the model pads and normalizes raw uint8 images on the device.
+        bool hasRawInput() const {
+            return rawKernel != NULL;
+        }
 
-            // Reserve the event buffer.
-            // One event for each layer plus two events for IO.
-            std::vector<cl_event> events(n * eventSize);
+        const ingest::Format &getRawFormat() const {
+            return rawFormat;
+        }
 
-            // For OpenCL error.
-            cl_int err;
+        // Bytes of one raw image.
+        size_t getRawSize() const {
+            return rawFormat.size();
+        }
 
-            for (size_t i = 0; i < n; ++i) {
-                
-                // Prepare the input cl_mem.
-                err = clEnqueueWriteBuffer(queue,
-                    clIn,
-                    CL_FALSE,
-                    0,
-                    inSize * sizeof(cl_float),
-                    (void *)&in[i * inSize],
-                    i == 0 ? 0 : 1,
-                    i == 0 ? NULL : &events[(i - 1) * eventSize],
-                    &events[i * eventSize]);
-                handleError(err, "Failed copy input buffer. ");
+        // Pad and normalize one raw image on the CPU into the input of the first layer.
+        void normalizeCPU(const unsigned char *image, float *in) const {
+            checkRawInput("normalizeCPU");
+            ingest::normalize(image, rawFormat, layers[0]->iWidth, layers[0]->iHeight, in);
+        }
 
-                // For each layer.
-                for (size_t l = 0; l < layers.size(); ++l) {
-                    err = clEnqueueNDRangeKernel(queue,
-                        layers[l]->kernel,
-                        3,
-                        NULL,
-                        layers[l]->global,
-                        layers[l]->workGroupSize,
-                        1,
-                        &events[i * eventSize + l],
-                        &events[i * eventSize + l + 1]);
-                    handleError(err, "Failed enqueuing kernel. ");
-                }
+        // Forward one raw image with CPU into out.
+        unsigned long long forwardCPURaw(const unsigned char *image, float *out) {
+            normalizeCPU(image, input.data());
+            return forwardCPU(input.data(), out);
+        }
 
-                // Get the output.
-                err = clEnqueueReadBuffer(queue,
-                    layers[layers.size() - 1]->clOut,
-                    CL_FALSE,
-                    0,
-                    outSize * sizeof(cl_float),
-                    &out[i * outSize],
-                    1,
-                    &events[i * eventSize + layers.size()],
-                    &events[i * eventSize + layers.size() + 1]);
-                handleError(err, "Failed enqueuing reading buffer. ");
+        // Forward one raw image with OpenCL, sending its bytes and normalizing them on the device.
+        unsigned long long forwardCLRaw(const unsigned char *image, float *out) {
+            checkRawInput("forwardCLRaw");
+            cl_command_queue &queue = getProfiledQueue();
+            cl_int err;
+            err = clEnqueueWriteBuffer(queue,
+                clRaw,
+                CL_TRUE,
+                0,
+                getRawSize(),
+                (void *)image,
+                0,
+                NULL,
+                NULL);
+            handleError(err, "Failed copy raw input buffer. ");
 
-                // Wait for the command queue.
-                if (i % queueBarrier == queueBarrier - 1) {
-                    err = clFinish(queue);
-                    handleError(err, "Failed waiting for event. ");
-                }
+            // Pad and normalize into clIn.
+
+            unsigned long long totalTime = runAndTimeKernel(queue, rawKernel, 3, rawGlobal, rawWorkGroupSize);
 
+            for (size_t i = 0; i < layers.size(); ++i) {
+                totalTime += layers[i]->forwardCL(queue);
             }
 
-            diff = clock() - start;
-            *averageTime = (double)diff / (double)CLOCKS_PER_SEC / (double)n;
-            std::cout << "Average time: " << *averageTime << "s" << std::endl;
+            err = clEnqueueReadBuffer(queue,
+                layers[layers.size() - 1]->clOut,
+                CL_TRUE,
+                0,
+                getOutSize() * sizeof(cl_float),
+                out,
+                0,
+                NULL,
+                NULL);
+            handleError(err, "Failed reading the output. ");
 
-            return events;
+            return totalTime;
+        }
+
+        // Forward every raw image of the span with in order command queue into the caller's out.
+        // Each image costs getRawSize() bytes of host to device traffic instead of getInSize() floats.
+        // Both spans must stay alive until the returned events complete.
+        std::vector<cl_event> forwardCLBatchRaw(const RawSpan &in, const OutSpan &out, double *averageTime) {
+            checkRawInput("forwardCLBatchRaw");
+            if (in.getSize() != getRawSize() || in.getStride() < in.getSize() ||
+                out.getSize() != getOutSize() || out.getStride() < out.getSize() || out.getN() < in.getN()) {
+                std::cerr << "forwardCLBatchRaw: Spans do not match the raw input and the output" << std::endl;
+                exit(-1);
+            }
+            cl_mem clOut = layers[layers.size() - 1]->clOut;
+            return enqueueCLBatch(in, clOut, getOutSize() * sizeof(cl_float), [&](size_t i) {
+                return (void *)out[i];
+            }, averageTime);
         }
 
         // Forward with pipelined command queue.
         std::vector<cl_event> forwardCLPipeline(const vec &in, vec &out, size_t n, double *averageTime) {
+            checkInSize(in, n);
+            out.resize(getOutSize() * n);
+            return forwardCLPipeline(InSpan(&in[0], n, getInSize()), OutSpan(&out[0], n, getOutSize()), averageTime);
+        }
+
+        // Forward every input of the span with pipelined command queue into the caller's out.
+        // Both spans must stay alive until the returned events complete.
+        std::vector<cl_event> forwardCLPipeline(const InSpan &in, const OutSpan &out, double *averageTime) {
 
             // Check if the command queue supports out of order queue.
             if (isQueueInOrder) {
@@ -228,22 +488,19 @@ namespace cnn {
             }
 
             // Make sure that input size is correct.
+            checkSpans(in, out);
+            size_t n = in.getN();
             size_t inSize = getInSize();
             size_t outSize = getOutSize();
-            size_t eventSize = layers.size() + 2;
-            if (in.size() != inSize * n) {
-                std::cerr << "Wrong input size! " << std::endl;
-                exit(-2);
-            }
 
             // Initialize the event pool.
             EventPool events(layers.size() + 2, n);
+            size_t eventSize = layers.size() + 2;
+            enqueues.resize(n * eventSize);
+            startSampling();
 
             clock_t start = clock(), diff;
 
-            // Reserve the output buffer.
-            out.resize(outSize * n);
-
             // For OpenCL error.
             cl_int err;
 
@@ -254,23 +511,31 @@ namespace cnn {
 
             for (size_t i = 0; i < n; ++i) {
 
+                // Sampled inputs go to the profiled queue.
+                Sample sample;
+                cl_command_queue &queue = nextQueue(&sample);
+
                 // Prepare the input cl_mem.
                 eventList = events.getDependentEventList(0, i, &len);
+                enqueues[i * eventSize].begin = hostNanoseconds();
                 err = clEnqueueWriteBuffer(queue,
                     clIn,
                     CL_FALSE,
                     0,
                     inSize * sizeof(cl_float),
-                    (void *)&in[i * inSize],
+                    (void *)in[i],
                     len,
                     eventList,
                     &event);
+                enqueues[i * eventSize].end = hostNanoseconds();
                 handleError(err, "Failed copy input buffer. ");
                 events.pushEvent(0, i, event);
+                sample.events.push_back(event);
 
                 // For each layer.
                 for (size_t l = 0; l < layers.size(); ++l) {
                     eventList = events.getDependentEventList(l + 1, i, &len);
+                    enqueues[i * eventSize + l + 1].begin = hostNanoseconds();
                     err = clEnqueueNDRangeKernel(queue,
                         layers[l]->kernel,
                         3,
@@ -280,34 +545,41 @@ namespace cnn {
                         len,
                         eventList,
                         &event);
+                    enqueues[i * eventSize + l + 1].end = hostNanoseconds();
                     handleError(err, "Failed enqueuing kernel. ");
                     events.pushEvent(l + 1, i, event);
+                    sample.events.push_back(event);
                 }
 
                 // Get the output.
                 eventList = events.getDependentEventList(layers.size() + 1, i, &len);
+                enqueues[i * eventSize + layers.size() + 1].begin = hostNanoseconds();
                 err = clEnqueueReadBuffer(queue,
                     layers[layers.size() - 1]->clOut,
                     CL_FALSE,
                     0,
                     outSize * sizeof(cl_float),
-                    &out[i * outSize],
+                    out[i],
                     len,
                     eventList,
                     &event);
+                enqueues[i * eventSize + layers.size() + 1].end = hostNanoseconds();
                 handleError(err, "Failed enqueuing reading buffer. ");
                 events.pushEvent(layers.size() + 1, i, event);
+                sample.events.push_back(event);
+                keepSample(sample);
 
                 // Wait for the command queue.
                 if (i % queueBarrier == queueBarrier - 1) {
-                    err = clFinish(queue);
-                    handleError(err, "Failed waiting for event. ");
+                    finishQueues();
                 }
             }
 
             diff = clock() - start;
             *averageTime = (double)diff / (double)CLOCKS_PER_SEC / (double)n;
-            std::cout << "Pipelined average time: " << *averageTime << "s" << std::endl;
+            if (!isQuiet) {
+                std::cout << "Pipelined average time: " << *averageTime << "s" << std::endl;
+            }
 
             return events.sort();
         }
@@ -320,11 +592,40 @@ namespace cnn {
         std::map<std::string, cl_program> programs;
         cl_mem clIn;
 
+        // Kernel padding and normalizing the raw images in clRaw into clIn.
+        ingest::Format rawFormat;
+        cl_kernel rawKernel;
+        cl_mem clRaw;
+        unsigned char *raw;
+        size_t rawGlobal[3];
+        size_t rawWorkGroupSize[3];
+
+        // Inputs enqueued before the host waits for the queue.
         size_t queueBarrier;
         bool isQueueInOrder;
 
+        // Whether the batch and pipelined forwards keep their average time to themselves.
+        bool isQuiet;
+
+        // Host clock around the enqueues of the last batch.
+        std::vector<timeline::Enqueue> enqueues;
+
+        // Profiled queue of the sampled inputs, NULL unless sampling, see setProfileSampling.
+        cl_command_queue sampleQueue;
+        size_t sampleEvery;
+        uint64_t sampleSequence;
+        bool isLastSampled;
+        sampling::RingBuffer profileRing;
+
+        // Page aligned host memory of the input, every weight and every layer output.
+        Arena arena;
+        Tensor input;
+
         std::vector<Layer *> layers;
 
+        // For CPU.
+        ThreadPool *pool;
+
         size_t getInSize() const {
             return layers[0]->iWidth * layers[0]->iHeight * layers[0]->iDepth;
         }
@@ -334,24 +635,638 @@ namespace cnn {
             return layers[last]->out.size();
         }
 
-        const vec &getOut() const {
+        const Tensor &getOut() const {
             return layers[layers.size() - 1]->out;
         }
 
+        // Host memory behind clIn.
+        Tensor &getIn() {
+            return input;
+        }
+
+        // Use the compile time specialized CPU layers where the shape has one.
+        void setSpecialized(bool enable) {
+            for (size_t i = 0; i < layers.size(); ++i) {
+                layers[i]->setSpecialized(enable);
+            }
+        }
+
+        // Set the CPU activation of every layer, the RBF output has none.
+        void setActivation(Activation activation) {
+            for (size_t i = 0; i < layers.size(); ++i) {
+                layers[i]->setActivation(activation);
+            }
+        }
+
+        // Set the CPU algorithm of every convolutional layer.
+        void setConvAlgorithm(ConvAlgorithm algorithm) {
+            for (size_t i = 0; i < layers.size(); ++i) {
+                ConvolutionLayer *conv = dynamic_cast<ConvolutionLayer *>(layers[i]);
+                if (conv) {
+                    conv->setAlgorithm(algorithm);
+                }
+            }
+        }
+
+        // Set the CPU precision of every layer, INT8 only applies to the quantized conv and full layers.
+        void setPrecision(Precision precision) {
+            for (size_t i = 0; i < layers.size(); ++i) {
+                if (precision != INT8 || layers[i]->isQuantizable()) {
+                    layers[i]->setPrecision(precision);
+                }
+            }
+        }
+
+        // Run every layer of the CPU path in the precision of its device kernel.
+        void setDevicePrecision() {
+            for (size_t i = 0; i < layers.size(); ++i) {
+                layers[i]->setPrecision(layers[i]->getDevicePrecision());
+            }
+        }
+
+        // Calibrate INT8: run the fp32 CPU forward over the samples and take the input scale
+        // of every conv and full layer from the largest magnitude its input reached.
+        // Returns the input range of every layer.
+        std::vector<quant::Range> calibrate(const InSpan &samples) {
+            std::vector<Precision> saved(layers.size());
+            for (size_t l = 0; l < layers.size(); ++l) {
+                saved[l] = layers[l]->getPrecision();
+                layers[l]->setPrecision(FP32);
+            }
+
+            std::vector<quant::Range> ranges(layers.size());
+            preparePlans();
+            for (size_t i = 0; i < samples.getN(); ++i) {
+                forwardCPU(samples[i], layers[layers.size() - 1]->out.data(), latencyPlan, latencyContext->base, pool, &ranges);
+            }
+
+            for (size_t l = 0; l < layers.size(); ++l) {
+                if (layers[l]->isQuantizable()) {
+                    layers[l]->setQuantization(quant::getScale(ranges[l].getMaxAbs()));
+                }
+                layers[l]->setPrecision(saved[l]);
+            }
+            return ranges;
+        }
+
+        // Write the model with the quantized weights and scales of every quantized layer,
+        // loading it again restores them without calibration.
+        void writeQuantizedModel(const std::string &fileName) {
+            rewriteModel(fileName, "writeQuantizedModel", [&](std::ofstream &o, rapidxml::xml_node<> *node, size_t l) {
+                for (rapidxml::xml_node<> *child = node->first_node(); child; child = child->next_sibling()) {
+                    if (std::string(child->name()) != "quantization") {
+                        writeXMLNode(o, child);
+                    }
+                }
+                if (layers[l]->isQuantized()) {
+                    writeQuantization(o, layers[l]->getQuantization());
+                }
+            });
+        }
+
+        // Pruning tool: keep the round(density * n) weights of largest magnitude of every
+        // full layer and write the model, with <sparseWeight> at or below the density threshold.
+        // The quantized weights of the pruned layers are dropped, calibrate again.
+        void writePrunedModel(const std::string &fileName, float density) {
+            rewriteModel(fileName, "writePrunedModel", [&](std::ofstream &o, rapidxml::xml_node<> *node, size_t l) {
+                FullConnectLayer *full = dynamic_cast<FullConnectLayer *>(layers[l]);
+                for (rapidxml::xml_node<> *child = node->first_node(); child; child = child->next_sibling()) {
+                    std::string name(child->name());
+                    if (!full || (name != "weight" && name != "sparseWeight" && name != "quantization")) {
+                        writeXMLNode(o, child);
+                    }
+                }
+                if (!full) {
+                    return;
+                }
+                const sparse::Matrix &current = full->getSparseWeight();
+                vec weight(current.rows * current.cols);
+                sparse::toDense(current, &weight[0]);
+                sparse::prune(&weight[0], weight.size(), density);
+                sparse::Matrix pruned = sparse::fromDense(&weight[0], current.rows, current.cols);
+                if (pruned.density() <= sparse::DENSITY_THRESHOLD) {
+                    writeSparseWeight(o, pruned);
+                }
+                else {
+                    writeXMLOpenTag(o, "weight");
+                    o << std::endl;
+                    for (size_t i = 0; i < weight.size(); ++i) {
+                        writeXMLTag(o, "item", weight[i]);
+                    }
+                    writeXMLCloseTag(o, "weight");
+                    o << std::endl;
+                }
+            });
+        }
+
+        // Full layers with a density at or below the threshold run the CSR kernel on the CPU,
+        // 0 runs every one dense.
+        void setSparseThreshold(float threshold) {
+            for (size_t i = 0; i < layers.size(); ++i) {
+                FullConnectLayer *full = dynamic_cast<FullConnectLayer *>(layers[i]);
+                if (full) {
+                    full->setSparseThreshold(threshold);
+                }
+            }
+        }
+
     private:
 
-        void initOpenCL(bool isQueueInOrder, size_t inSize) {
+        // The events of one input of a batch, kept until they complete if it is sampled.
+        struct Sample {
+            bool isSampled;
+            // The input runs on another queue than the previous one.
+            bool isSwitch;
+            uint64_t sequence;
+            std::vector<cl_event> events;
+        };
+        std::vector<Sample> pendingSamples;
+
+        cl_command_queue createQueue(bool isProfiled) {
             cl_int err;
+            cl_command_queue created = clCreateCommandQueue(
+                context,
+                device,
+                (isProfiled ? CL_QUEUE_PROFILING_ENABLE : 0) | (isQueueInOrder ? 0 : CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE),
+                &err);
+            handleError(err, "Failed creating command queue. ");
+            return created;
+        }
 
-            // Choose the first platform.
-            err = clGetPlatformIDs(1, &platform, NULL);
+        // The queue of the single input forwards, which time their kernels.
+        cl_command_queue &getProfiledQueue() {
+            if (sampleQueue) {
+                cl_int err = clFinish(queue);
+                handleError(err, "Failed waiting for the queue. ");
+                return sampleQueue;
+            }
+            return queue;
+        }
 
-            // Choose the first device.
-            err = clGetDeviceIDs(platform,
-                CL_DEVICE_TYPE_ALL,
-                1,
-                &device,
-                NULL);
+        void finishQueues() {
+            cl_int err = clFinish(queue);
+            if (sampleQueue) {
+                err |= clFinish(sampleQueue);
+            }
+            handleError(err, "Failed waiting for event. ");
+        }
+
+        // The inputs of a sampling batch run on both queues, so it starts after the
+        // previous batch completes, whose samples are then read.
+        void startSampling() {
+            if (sampleQueue) {
+                finishQueues();
+                drainSamples(false);
+                isLastSampled = false;
+            }
+        }
+
+        // Pick the queue of the next input of a batch.
+        cl_command_queue &nextQueue(Sample *sample) {
+            sample->isSampled = sampleQueue && sampleEvery > 0 && sampleSequence % sampleEvery == 0;
+            sample->isSwitch = sample->isSampled != isLastSampled;
+            sample->sequence = sampleSequence;
+            if (sampleQueue) {
+                sampleSequence++;
+                isLastSampled = sample->isSampled;
+            }
+            return sample->isSampled ? sampleQueue : queue;
+        }
+
+        // Keep the events of a sampled input past the caller's release.
+        void keepSample(const Sample &sample) {
+            if (sample.isSampled) {
+                for (size_t e = 0; e < sample.events.size(); ++e) {
+                    clRetainEvent(sample.events[e]);
+                }
+                pendingSamples.push_back(sample);
+            }
+        }
+
+        // Profile the complete samples into the ring, all of them if wait.
+        void drainSamples(bool wait) {
+            size_t kept = 0;
+            for (size_t p = 0; p < pendingSamples.size(); ++p) {
+                Sample &sample = pendingSamples[p];
+                cl_int status = CL_COMPLETE;
+                if (wait) {
+                    clWaitForEvents((cl_uint)sample.events.size(), &sample.events[0]);
+                }
+                else {
+                    clGetEventInfo(sample.events.back(), CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, NULL);
+                }
+                if (status != CL_COMPLETE) {
+                    std::swap(pendingSamples[kept++], sample);
+                    continue;
+                }
+                for (size_t e = 0; e < sample.events.size(); ++e) {
+                    cl_ulong t[4];
+                    cl_int err = clGetEventProfilingInfo(sample.events[e], CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &t[0], NULL);
+                    err |= clGetEventProfilingInfo(sample.events[e], CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &t[1], NULL);
+                    err |= clGetEventProfilingInfo(sample.events[e], CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &t[2], NULL);
+                    err |= clGetEventProfilingInfo(sample.events[e], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &t[3], NULL);
+                    handleError(err, "Failed profiling the sample. ");
+                    sampling::Record record = { sample.sequence, (uint32_t)e, (uint32_t)sample.events.size(), t[0], t[1], t[2], t[3] };
+                    profileRing.push(record);
+                    clReleaseEvent(sample.events[e]);
+                }
+            }
+            pendingSamples.resize(kept);
+        }
+
+        // The model, read again to write the quantized one.
+        std::string xmlFileName;
+
+        // Activations and scratch of one worker, laid out by a plan.
+        struct CPUContext {
+            Arena arena;
+            float *base;
+        };
+
+        // Plan for one image split across all workers, run in latencyContext.
+        ExecutionPlan latencyPlan;
+        CPUContext *latencyContext;
+
+        // Plan for one image per worker, run in batchContexts[worker].
+        ExecutionPlan batchPlan;
+        std::vector<CPUContext *> batchContexts;
+
+        // Give the context a block of the plan's size.
+        void prepareContext(CPUContext *ctx, const ExecutionPlan &plan) {
+            ctx->arena.reset();
+            ctx->base = ctx->arena.allocate(plan.getSize());
+        }
+
+        // Plan again only if the thread count or a layer's scratch size changed.
+        void preparePlans() {
+            size_t numWorkers = getThreads();
+            if (!latencyPlan.matches(layers, numWorkers)) {
+                latencyPlan.build(layers, numWorkers);
+                prepareContext(latencyContext, latencyPlan);
+            }
+            if (!batchPlan.matches(layers, 1)) {
+                batchPlan.build(layers, 1);
+                for (size_t w = 0; w < batchContexts.size(); ++w) {
+                    prepareContext(batchContexts[w], batchPlan);
+                }
+            }
+            while (batchContexts.size() < numWorkers) {
+                batchContexts.push_back(new CPUContext);
+                prepareContext(batchContexts.back(), batchPlan);
+            }
+        }
+
+        // Make sure that input size is correct.
+        void checkInSize(const vec &in, size_t n) const {
+            if (in.size() != getInSize() * n) {
+                std::cerr << "Wrong input size! " << std::endl;
+                exit(-2);
+            }
+        }
+
+        // Make sure the spans match the network and each other.
+        void checkSpans(const InSpan &in, const OutSpan &out) const {
+            if (in.getSize() != getInSize() || in.getStride() < in.getSize()) {
+                std::cerr << "Wrong input size! " << std::endl;
+                exit(-2);
+            }
+            if (out.getSize() != getOutSize() || out.getStride() < out.getSize() || out.getN() < in.getN()) {
+                std::cerr << "Wrong output size! " << std::endl;
+                exit(-2);
+            }
+        }
+
+        // Forward one input through all layers with the plan's buffers at base.
+        // Records the input range of every layer into ranges if not NULL.
+        void forwardCPU(const float *in, float *out, const ExecutionPlan &plan, float *base, ThreadPool *pool,
+            std::vector<quant::Range> *ranges = NULL) {
+            for (size_t l = 0; l < layers.size(); ++l) {
+                const float *layerIn = l == 0 ? in : plan.getOut(l - 1, base);
+                if (ranges) {
+                    (*ranges)[l].update(layerIn, layers[l]->getInSize());
+                }
+                float *layerOut = l + 1 == layers.size() ? out : plan.getOut(l, base);
+                layers[l]->computeCPU(layerIn, layerOut, plan.getWorkspace(l, base, pool));
+
+                // An FP16 kernel stores its output to the next one as half.
+                if (layers[l]->getPrecision() == FP16 && l + 1 < layers.size()) {
+                    fp16::round(layerOut, layers[l]->getOutSize());
+                }
+            }
+        }
+
+        // Enqueue write, kernels and read of every input, the read copying resultBytes of result
+        // into resultPtr(i). Raw inputs go to clRaw and through the input kernel first.
+        // Every command waits for the previous one.
+        template<typename T, typename F>
+        std::vector<cl_event> enqueueCLBatch(const BatchSpan<const T> &in, cl_mem result, size_t resultBytes, F resultPtr, double *averageTime) {
+            bool isRaw = sizeof(T) == 1;
+            size_t n = in.getN();
+            size_t stages = layers.size() + (isRaw ? 1 : 0);
+            size_t eventSize = stages + 2;
+
+            clock_t start = clock(), diff;
+
+            // Reserve the event buffer.
+            // One event for each kernel plus two events for IO.
+            std::vector<cl_event> events(n * eventSize);
+            enqueues.resize(n * eventSize);
+            startSampling();
+
+            // For OpenCL error.
+            cl_int err;
+
+            for (size_t i = 0; i < n; ++i) {
+
+                // Sampled inputs go to the profiled queue. Switching queues, the write
+                // waits for the read of the previous input instead of its write.
+                Sample sample;
+                cl_command_queue &queue = nextQueue(&sample);
+                size_t previous = i == 0 ? 0 : (i - 1) * eventSize + (sample.isSwitch ? stages + 1 : 0);
+
+                // Prepare the input cl_mem.
+                enqueues[i * eventSize].begin = hostNanoseconds();
+                err = clEnqueueWriteBuffer(queue,
+                    isRaw ? clRaw : clIn,
+                    CL_FALSE,
+                    0,
+                    in.getSize() * sizeof(T),
+                    (void *)in[i],
+                    i == 0 ? 0 : 1,
+                    i == 0 ? NULL : &events[previous],
+                    &events[i * eventSize]);
+                enqueues[i * eventSize].end = hostNanoseconds();
+                handleError(err, "Failed copy input buffer. ");
+
+                // For the input kernel and each layer.
+                for (size_t s = 0; s < stages; ++s) {
+                    bool isInput = isRaw && s == 0;
+                    Layer *layer = isInput ? NULL : layers[s - (isRaw ? 1 : 0)];
+                    enqueues[i * eventSize + s + 1].begin = hostNanoseconds();
+                    err = clEnqueueNDRangeKernel(queue,
+                        isInput ? rawKernel : layer->kernel,
+                        3,
+                        NULL,
+                        isInput ? rawGlobal : layer->global,
+                        isInput ? rawWorkGroupSize : layer->workGroupSize,
+                        1,
+                        &events[i * eventSize + s],
+                        &events[i * eventSize + s + 1]);
+                    enqueues[i * eventSize + s + 1].end = hostNanoseconds();
+                    handleError(err, "Failed enqueuing kernel. ");
+                }
+
+                // Get the output.
+                enqueues[i * eventSize + stages + 1].begin = hostNanoseconds();
+                err = clEnqueueReadBuffer(queue,
+                    result,
+                    CL_FALSE,
+                    0,
+                    resultBytes,
+                    resultPtr(i),
+                    1,
+                    &events[i * eventSize + stages],
+                    &events[i * eventSize + stages + 1]);
+                enqueues[i * eventSize + stages + 1].end = hostNanoseconds();
+                handleError(err, "Failed enqueuing reading buffer. ");
+                sample.events.assign(&events[i * eventSize], &events[i * eventSize] + eventSize);
+                keepSample(sample);
+
+                // Wait for the command queue.
+                if (i % queueBarrier == queueBarrier - 1) {
+                    finishQueues();
+                }
+
+            }
+
+            diff = clock() - start;
+            *averageTime = (double)diff / (double)CLOCKS_PER_SEC / (double)n;
+            if (!isQuiet) {
+                std::cout << "Average time: " << *averageTime << "s" << std::endl;
+            }
+
+            return events;
+        }
+
+        void checkRawInput(const char *caller) const {
+            if (!hasRawInput()) {
+                std::cerr << caller << ": The model has no raw input" << std::endl;
+                exit(-1);
+            }
+        }
+
+        // Build the program of the node or take it from the ones already built.
+        // Models of a single kernel name its file once for every layer.
+        cl_program getProgram(rapidxml::xml_node<> *root, bool isBinary) {
+            const char *key = isBinary ? "xclbinFileName" : "kernelFileName";
+            rapidxml::xml_node<> *source = hasNode(root, key) || !root->parent() ? root : root->parent();
+            if (!hasNode(source, key)) {
+                std::cerr << "CNN: No " << key << " for the kernel " << getString(root, "kernelName") << std::endl;
+                exit(-1);
+            }
+            std::string fileName = resolveModelFile(xmlFileName, getString(source, key));
+            std::map<std::string, cl_program>::iterator iter = programs.find(fileName);
+            if (iter != programs.end()) {
+                return iter->second;
+            }
+            cl_program program = isBinary ?
+                buildProgramFromBinary(fileName.c_str(), context, device) :
+                buildProgramFromSource(fileName.c_str(), context, device);
+            cl_int err = clRetainProgram(program);
+            handleError(err, "Failed retaining program. ");
+            programs.insert(std::pair<std::string, cl_program>(fileName, program));
+            return program;
+        }
+
+        // Create the kernel padding and normalizing the raw images into clIn.
+        void initRawInput(rapidxml::xml_node<> *root, bool isBinary) {
+            rawFormat.width = getSizeT(root, "rawWidth");
+            rawFormat.height = getSizeT(root, "rawHeight");
+            rawFormat.depth = getSizeT(root, "rawDepth");
+            rawFormat.scale = (float)std::atof(getString(root, "scale").c_str());
+            rawFormat.bias = (float)std::atof(getString(root, "bias").c_str());
+            ingest::validate(rawFormat, layers[0]->iWidth, layers[0]->iHeight, layers[0]->iDepth, "input");
+
+            std::vector<size_t> workGroupSize;
+            getAllItem(root->first_node("workGroupSize"), workGroupSize);
+            for (size_t i = 0; i < 3; ++i) {
+                rawWorkGroupSize[i] = workGroupSize[i];
+            }
+            rawGlobal[0] = closestMultiple(rawWorkGroupSize[0], layers[0]->iWidth);
+            rawGlobal[1] = layers[0]->iHeight;
+            rawGlobal[2] = layers[0]->iDepth;
+
+            cl_int err;
+            std::string kernelName = getString(root, "kernelName");
+            rawKernel = clCreateKernel(getProgram(root, isBinary), kernelName.c_str(), &err);
+            handleError(err, "Failed creating kernel " + kernelName + ". ");
+
+            // The bytes live in the arena next to the input.
+            raw = reinterpret_cast<unsigned char *>(arena.allocate((rawFormat.size() + sizeof(float) - 1) / sizeof(float)));
+            clRaw = clCreateBuffer(
+                context,
+                CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                rawFormat.size(),
+                raw,
+                &err);
+            handleError(err, "Failed creating clRaw");
+
+            err = clSetKernelArg(rawKernel, 0, sizeof(cl_mem), &clRaw);
+            handleError(err, "Failed setting kernel arg: clRaw. ");
+            err = clSetKernelArg(rawKernel, 1, sizeof(cl_mem), &clIn);
+            handleError(err, "Failed setting kernel arg: clIn. ");
+        }
+
+        // The last layer, which must rank the classes on the device.
+        RBFLayer *getHead() {
+            RBFLayer *rbf = dynamic_cast<RBFLayer *>(layers[layers.size() - 1]);
+            if (!rbf || rbf->getTopK() == 0) {
+                std::cerr << "CNN: The last layer has no classification head" << std::endl;
+                exit(-1);
+            }
+            return rbf;
+        }
+
+        // Read the model again and write it with every layer node rewritten by writeLayer(o, node, index).
+        template<typename F>
+        void rewriteModel(const std::string &fileName, const std::string &caller, F writeLayer) {
+            char *buf = new char[BUFSIZE];
+            fileToChar(xmlFileName, buf, BUFSIZE);
+            rapidxml::xml_document<> doc;
+            doc.parse<0>(buf);
+            rapidxml::xml_node<> *root = doc.first_node();
+
+            std::ofstream o(fileName.c_str());
+            if (!o.is_open()) {
+                std::cerr << caller << ": Can't open file " << fileName << std::endl;
+                exit(-1);
+            }
+            o.precision(9);
+            o << "<?xml version=\"1.0\" encoding=\"utf-8\"?>" << std::endl;
+            writeXMLOpenTag(o, root->name());
+            o << std::endl;
+            size_t l = 0;
+            for (rapidxml::xml_node<> *node = root->first_node(); node; node = node->next_sibling()) {
+                if (std::string(node->name()) != "layer") {
+                    writeXMLNode(o, node);
+                    continue;
+                }
+                writeXMLOpenTag(o, "layer");
+                o << std::endl;
+                writeLayer(o, node, l);
+                writeXMLCloseTag(o, "layer");
+                o << std::endl;
+                ++l;
+            }
+            writeXMLCloseTag(o, root->name());
+            o.close();
+
+            delete[] buf;
+        }
+
+        void writeSparseWeight(std::ofstream &o, const sparse::Matrix &m) {
+            writeXMLOpenTag(o, "sparseWeight");
+            o << std::endl;
+            writeXMLOpenTag(o, "rowBegin");
+            o << std::endl;
+            for (size_t i = 0; i < m.rowBegin.size(); ++i) {
+                writeXMLTag(o, "item", m.rowBegin[i]);
+            }
+            writeXMLCloseTag(o, "rowBegin");
+            o << std::endl;
+            writeXMLOpenTag(o, "column");
+            o << std::endl;
+            for (size_t i = 0; i < m.column.size(); ++i) {
+                writeXMLTag(o, "item", m.column[i]);
+            }
+            writeXMLCloseTag(o, "column");
+            o << std::endl;
+            writeXMLOpenTag(o, "value");
+            o << std::endl;
+            for (size_t i = 0; i < m.value.size(); ++i) {
+                writeXMLTag(o, "item", m.value[i]);
+            }
+            writeXMLCloseTag(o, "value");
+            o << std::endl;
+            writeXMLCloseTag(o, "sparseWeight");
+            o << std::endl;
+        }
+
+        // The dense rows x cols weight of a <sparseWeight> node.
+        vec parseSparseWeight(rapidxml::xml_node<> *root, size_t rows, size_t cols, const std::string &kernelName) {
+            sparse::Matrix m;
+            m.rows = rows;
+            m.cols = cols;
+            m.rowBegin.clear();
+            getAllItem(root->first_node("rowBegin"), m.rowBegin);
+            getAllItem(root->first_node("column"), m.column);
+            vec value;
+            getAllItem(root->first_node("value"), value);
+            m.value.assign(value.begin(), value.end());
+            sparse::validate(m, kernelName);
+            vec weight(rows * cols);
+            sparse::toDense(m, &weight[0]);
+            return weight;
+        }
+
+        void writeQuantization(std::ofstream &o, const Quantization &q) {
+            writeXMLOpenTag(o, "quantization");
+            o << std::endl;
+            writeXMLTag(o, "inScale", q.inScale);
+            writeXMLOpenTag(o, "weightScale");
+            o << std::endl;
+            for (size_t i = 0; i < q.weightScale.size(); ++i) {
+                writeXMLTag(o, "item", q.weightScale[i]);
+            }
+            writeXMLCloseTag(o, "weightScale");
+            o << std::endl;
+            writeXMLOpenTag(o, "weight");
+            o << std::endl;
+            for (size_t i = 0; i < q.weight.size(); ++i) {
+                writeXMLTag(o, "item", (int)q.weight[i]);
+            }
+            writeXMLCloseTag(o, "weight");
+            o << std::endl;
+            writeXMLCloseTag(o, "quantization");
+            o << std::endl;
+        }
+
+        Quantization parseQuantization(rapidxml::xml_node<> *root) {
+            Quantization q;
+            q.inScale = (float)std::atof(getString(root, "inScale").c_str());
+            vec weightScale;
+            getAllItem(root->first_node("weightScale"), weightScale);
+            q.weightScale.assign(weightScale.begin(), weightScale.end());
+            vec weight;
+            getAllItem(root->first_node("weight"), weight);
+            q.weight.resize(weight.size());
+            for (size_t i = 0; i < weight.size(); ++i) {
+                q.weight[i] = (quant::int8)(int)weight[i];
+            }
+            return q;
+        }
+
+        // One oFeatureMap node listing its input maps per output map.
+        connection::Table parseConnection(rapidxml::xml_node<> *root) {
+            connection::Table table;
+            for (rapidxml::xml_node<> *node = root->first_node("oFeatureMap"); node; node = node->next_sibling("oFeatureMap")) {
+                table.push_back(std::vector<size_t>());
+                getAllItem(node, table.back());
+            }
+            return table;
+        }
+
+        void initOpenCL(size_t inSize, size_t deviceIndex) {
+            cl_int err;
+
+            // Choose the device, the first one of the first platform by default.
+            std::vector<std::pair<cl_platform_id, cl_device_id> > devices = getDevices();
+            if (deviceIndex >= devices.size()) {
+                std::cerr << "CNN: No OpenCL device " << deviceIndex << ", found " << devices.size() << std::endl;
+                exit(-1);
+            }
+            platform = devices[deviceIndex].first;
+            device = devices[deviceIndex].second;
 
             printDeviceInfo(std::cout, device);
 
@@ -369,19 +1284,16 @@ namespace cnn {
             handleError(err, "Failed creating context. ");
             clRetainContext(context);
 
-            queue = clCreateCommandQueue(
-                context,
-                device,
-                CL_QUEUE_PROFILING_ENABLE | (isQueueInOrder ? 0 : CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE),
-                &err);
-            handleError(err, "Failed creating command queue. ");
-            clRetainCommandQueue(queue);
+            // The only reference, setProfileSampling and the destructor release it.
+            queue = createQueue(true);
 
+            Tensor inputTensor(Shape(inSize), FLAT, &arena);
+            input.swap(inputTensor);
             clIn = clCreateBuffer(
                 context,
-                CL_MEM_READ_ONLY,
-                inSize * sizeof(cl_float),
-                NULL,
+                CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                input.bytes(),
+                input.data(),
                 &err);
             handleError(err, "Failed creating clIn");
             err = clRetainMemObject(clIn);
@@ -402,12 +1314,59 @@ namespace cnn {
             params.oWidth = getSizeT(root, "oWidth");
             params.oHeight = getSizeT(root, "oHeight");
             params.oDepth = getSizeT(root, "oDepth");
-            params.oWidthTile = getSizeT(root, "oWidthTile");
-            params.oHeightTile = getSizeT(root, "oHeightTile");
-            params.oDepthTile = getSizeT(root, "oDepthTile");
-            params.iDepthTile = getSizeT(root, "iDepthTile");
+            // Get the tiles, one output per work item by default.
+            params.oWidthTile = hasNode(root, "oWidthTile") ? getSizeT(root, "oWidthTile") : 1;
+            params.oHeightTile = hasNode(root, "oHeightTile") ? getSizeT(root, "oHeightTile") : 1;
+            params.oDepthTile = hasNode(root, "oDepthTile") ? getSizeT(root, "oDepthTile") : 1;
+            params.iDepthTile = hasNode(root, "iDepthTile") ? getSizeT(root, "iDepthTile") : 1;
             params.kernelSize = getSizeT(root, "kernelSize");
 
+            // Get the CPU algorithm, direct convolution by default.
+            params.algorithm = DIRECT;
+            if (hasNode(root, "algorithm")) {
+                params.algorithm = parseConvAlgorithm(getString(root, "algorithm"));
+            }
+
+            // Get the activation, sigmoid by default.
+            params.activation = SIGMOID;
+            if (hasNode(root, "activation")) {
+                params.activation = parseActivation(getString(root, "activation"));
+            }
+
+            // Get the precision, fp32 by default.
+            params.precision = FP32;
+            if (hasNode(root, "precision")) {
+                params.precision = parsePrecision(getString(root, "precision"));
+            }
+
+            // Get the weights quantized by calibration, if any.
+            if (hasNode(root, "quantization")) {
+                params.quantization = parseQuantization(root->first_node("quantization"));
+            }
+
+            // Get the connection table of a conv layer, every pair by default.
+            if (hasNode(root, "connection")) {
+                params.connection = parseConnection(root->first_node("connection"));
+            }
+
+            // Get the weight layout of the device kernel, dense by default.
+            params.weightFormat = DENSE;
+            if (hasNode(root, "weightFormat")) {
+                params.weightFormat = parseWeightFormat(getString(root, "weightFormat"));
+            }
+
+            // Get the classes an RBF kernel ranks on the device, none by default.
+            params.topK = 0;
+            if (hasNode(root, "topK")) {
+                params.topK = getSizeT(root, "topK");
+            }
+
+            // Get the Winograd output tile, F(2x2, r x r) by default.
+            params.winogradTile = 2;
+            if (hasNode(root, "winogradTile")) {
+                params.winogradTile = getSizeT(root, "winogradTile");
+            }
+
             // Get the kernel name.
             params.kernelName = getString(root, "kernelName");
 
@@ -418,75 +1377,72 @@ namespace cnn {
                 params.workGroupSize[i] = workGroupSize[i];
             }
 
-            // Create the weight vector.
+            // Create the weight vector, expanded from the nonzeros if the model stores them.
             cnn::vec weight;
-            getAllItem(root->first_node("weight"), weight);
+            if (hasNode(root, "sparseWeight")) {
+                weight = parseSparseWeight(root->first_node("sparseWeight"),
+                    params.oWidth * params.oHeight * params.oDepth,
+                    params.iWidth * params.iHeight * params.iDepth,
+                    params.kernelName);
+            }
+            else {
+                getAllItem(root->first_node("weight"), weight);
+            }
 
             // Create the offset vector.
             cnn::vec offset;
             getAllItem(root->first_node("offset"), offset);
 
-            // Get the program.
-            cl_program program;
-            if (isBinary) {
-                std::string xclbinFileName = getString(root, "xclbinFileName");
-                std::map<std::string, cl_program>::iterator iter = programs.find(xclbinFileName);
-                if (iter != programs.end()) {
-                    program = iter->second;
-                }
-                else {
-                    program = buildProgramFromBinary(xclbinFileName.c_str(), context, device);
-                    cl_int err = clRetainProgram(program);
-                    handleError(err, "Failed retaining program. ");
-                    programs.insert(std::pair<std::string, cl_program>(xclbinFileName, program));
-                }
-            }
-            else {
-                std::string kernelFileName = getString(root, "kernelFileName");
-                std::map<std::string, cl_program>::iterator iter = programs.find(kernelFileName);
-                if (iter != programs.end()) {
-                    program = iter->second;
-                }
-                else {
-                    program = buildProgramFromSource(kernelFileName.c_str(), context, device);
-                    cl_int err = clRetainProgram(program);
-                    handleError(err, "Failed retaining program. ");
-                    programs.insert(std::pair<std::string, cl_program>(kernelFileName, program));
-                }
+            // Get the weight transformed offline for the Winograd kernel, if any.
+            cnn::vec winogradWeight;
+            if (hasNode(root, "winogradWeight")) {
+                getAllItem(root->first_node("winogradWeight"), winogradWeight);
             }
 
+            // Get the program.
+            cl_program program = getProgram(root, isBinary);
+
             std::string type = getString(root, "type");
             if (type == "conv") {
+                params.type = CONV;
                 return new cnn::ConvolutionLayer(params,
                     weight,
                     offset,
+                    arena,
                     context,
                     program,
-                    clIn
+                    clIn,
+                    winogradWeight
                     );
             }
             else if (type == "pool") {
+                params.type = SUB;
                 return new cnn::MaxPoolLayer(params,
                     weight,
                     offset,
+                    arena,
                     context,
                     program,
                     clIn
                     );
             }
             else if (type == "full") {
+                params.type = FULL;
                 return new cnn::FullConnectLayer(params,
                     weight,
                     offset,
+                    arena,
                     context,
                     program,
                     clIn
                     );
             }
             else if (type == "rbf") {
+                params.type = RBF;
                 return new cnn::RBFLayer(params,
                     weight,
                     offset,
+                    arena,
                     context,
                     program,
                     clIn
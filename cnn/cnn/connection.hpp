@@ -0,0 +1,129 @@
+#ifndef CONNECTION_HEADER
+#define CONNECTION_HEADER
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+/******************************************************************************************
+
+    Connection table of a convolutional layer.
+
+    Output map o only sums the input maps listed in table[o], in increasing
+    order; an empty table connects every output map to every input map.
+    The weights of the unconnected pairs are zero, so the table does not
+    change the function of the layer, only which products are computed.
+
+    The model keeps the dense oDepth x iDepth x K x K weight. The device
+    kernel takes it packed: the K x K kernels of the connected pairs one
+    after another, output map by output map, located with
+        begin[o] .. begin[o + 1]    pairs of output map o,
+        input[p]                    input map of pair p.
+
+    LeNet-5 C3 (LeCun et al. 1998, table I) connects its 16 maps to 60
+    of the 96 pairs: the first 6 to 3 contiguous maps of S2, the next 6
+    to 4 contiguous ones, 3 to 4 non contiguous ones and the last to all.
+
+    This header only needs the standard library so the generator can share it.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace connection {
+
+        typedef std::vector<std::vector<size_t> > Table;
+
+        inline Table lenet5C3() {
+            static const char *ROWS[] = {
+                "111000", "011100", "001110", "000111", "100011", "110001",
+                "111100", "011110", "001111", "100111", "110011", "111001",
+                "110110", "011011", "101101", "111111"
+            };
+            Table table(sizeof(ROWS) / sizeof(ROWS[0]));
+            for (size_t o = 0; o < table.size(); ++o) {
+                for (size_t i = 0; ROWS[o][i]; ++i) {
+                    if (ROWS[o][i] == '1') {
+                        table[o].push_back(i);
+                    }
+                }
+            }
+            return table;
+        }
+
+        // Every output map connected to every input map.
+        inline Table full(size_t iDepth, size_t oDepth) {
+            Table table(oDepth);
+            for (size_t o = 0; o < oDepth; ++o) {
+                for (size_t i = 0; i < iDepth; ++i) {
+                    table[o].push_back(i);
+                }
+            }
+            return table;
+        }
+
+        // Exit unless the table has one sorted row of distinct input maps per output map.
+        inline void validate(const Table &table, size_t iDepth, size_t oDepth, const std::string &name) {
+            if (table.size() != oDepth) {
+                std::cerr << "connection: " << name << " has " << table.size()
+                    << " rows in the connection table, expected " << oDepth << std::endl;
+                exit(-1);
+            }
+            for (size_t o = 0; o < oDepth; ++o) {
+                for (size_t k = 0; k < table[o].size(); ++k) {
+                    if (table[o][k] >= iDepth || (k > 0 && table[o][k] <= table[o][k - 1])) {
+                        std::cerr << "connection: " << name << " has a bad connection table row " << o << std::endl;
+                        exit(-1);
+                    }
+                }
+            }
+        }
+
+        // Number of connected pairs, the empty table connects all of them.
+        inline size_t count(const Table &table, size_t iDepth, size_t oDepth) {
+            if (table.empty()) {
+                return iDepth * oDepth;
+            }
+            size_t n = 0;
+            for (size_t o = 0; o < table.size(); ++o) {
+                n += table[o].size();
+            }
+            return n;
+        }
+
+        // The begin and input arrays of the packed layout.
+        inline void flatten(const Table &table, std::vector<size_t> &begin, std::vector<size_t> &input) {
+            begin.assign(1, 0);
+            input.clear();
+            for (size_t o = 0; o < table.size(); ++o) {
+                input.insert(input.end(), table[o].begin(), table[o].end());
+                begin.push_back(input.size());
+            }
+        }
+
+        // Dense (o, i) mask, true for the connected pairs.
+        inline std::vector<bool> mask(const Table &table, size_t iDepth, size_t oDepth) {
+            std::vector<bool> connected(oDepth * iDepth, table.empty());
+            for (size_t o = 0; o < table.size(); ++o) {
+                for (size_t k = 0; k < table[o].size(); ++k) {
+                    connected[o * iDepth + table[o][k]] = true;
+                }
+            }
+            return connected;
+        }
+
+        // Copy the kernels of the connected pairs one after another.
+        template<typename T>
+        inline void pack(const Table &table, const T *weight, size_t iDepth, size_t kernelLen, T *packed) {
+            for (size_t o = 0; o < table.size(); ++o) {
+                for (size_t k = 0; k < table[o].size(); ++k) {
+                    const T *w = weight + (o * iDepth + table[o][k]) * kernelLen;
+                    packed = std::copy(w, w + kernelLen, packed);
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -2,6 +2,9 @@
 #define CONVOLUTION_HEADER
 
 #include "layer.hpp"
+#include "gemm.hpp"
+#include "winograd.hpp"
+#include "fft.hpp"
 
 #include <string>
 #include <cstring>
@@ -13,66 +16,572 @@ namespace cnn {
         ConvolutionLayer(const LayerParam &params,
             const vec &weight, 
             const vec &offset,
+            Arena &arena,
             const cl_context &context,
             const cl_program &program,
-            const cl_mem &clIn
-            ) : Layer(params, weight, offset, context, program, clIn),
-            kernelSize(params.kernelSize) {
+            const cl_mem &clIn,
+            const vec &winogradWeight = vec()
+            ) : Layer(params, maskWeight(params, weight), offset, arena, context, program, clIn),
+            kernelSize(params.kernelSize),
+            algorithm(DIRECT),
+            sparse(!params.connection.empty()),
+            winogradTile(params.winogradTile == 0 ? 2 : params.winogradTile) {
 
-            // Resize the input buffer.
-            inputBuffer.resize(kernelSize * kernelSize);
+            connectionTable = sparse ? params.connection : connection::full(iDepth, oDepth);
+            connection::flatten(connectionTable, connectionBegin, connectionInput);
+            if (sparse) {
+                initSparse(params, winogradWeight, arena);
+            }
+
+            // The device needs the Winograd weight up front only when the model supplies one.
+            if (!winogradWeight.empty()) {
+                initWinograd(winogradWeight, &arena);
+            }
+            setAlgorithm(params.algorithm);
 
             // Prepare the ND-Range.
-            global[0] = closestMultiple(workGroupSize[0], oWidth / params.oWidthTile);
-            global[1] = closestMultiple(workGroupSize[1], oHeight / params.oHeightTile);
-            global[2] = closestMultiple(workGroupSize[2], oDepth / params.oDepthTile);
+            if (winogradWeight.empty()) {
+                global[0] = closestMultiple(workGroupSize[0], oWidth / params.oWidthTile);
+                global[1] = closestMultiple(workGroupSize[1], oHeight / params.oHeightTile);
+                global[2] = closestMultiple(workGroupSize[2], oDepth / params.oDepthTile);
+            }
+            else {
+                // The generated Winograd kernel takes the transformed weight
+                // and one work item computes one m x m output tile.
+                setDeviceWeight(context, deviceWinogradWeight);
+                global[0] = closestMultiple(workGroupSize[0], winograd::numTiles(oWidth, transform.m));
+                global[1] = closestMultiple(workGroupSize[1], winograd::numTiles(oHeight, transform.m));
+                global[2] = closestMultiple(workGroupSize[2], oDepth);
+            }
+
+            specializedForward = specialized::findConv(kernelSize, iWidth, iHeight, iDepth, oDepth);
         }
 
         virtual ~ConvolutionLayer() {
         }
 
         // Forward with CPU.
-        virtual unsigned long long forwardCPU(const vec &in) {
-
-            clock_t start = clock(), diff;
-            
-            // Clear the output buffer.
-            std::fill(out.begin(), out.end(), 0.0f);
-
-            // For each output feature map.
-            for (size_t o = 0; o < oDepth; ++o) {
-                // For each input feature map.
-                for (size_t i = 0; i < iDepth; ++i) {
-                    // For each element in the output feature map.
-                    for (size_t r = 0; r < oHeight; ++r) {
+        virtual void computeCPU(const float *in, float *out, const Workspace &ws) {
+            // INT8 always runs the direct convolution.
+            if (precision == INT8) {
+                forwardCPUInt8(in, out, ws);
+                return;
+            }
+            switch (getCPUAlgorithm()) {
+            case IM2COL:
+                forwardCPUIm2col(in, out, ws);
+                break;
+            case WINOGRAD:
+                forwardCPUWinograd(in, out, ws);
+                break;
+            case FFT:
+                forwardCPUFFT(in, out, ws);
+                break;
+            default:
+                if (isSpecialized()) {
+                    specializedForward(in, weight.data(), offset.data(), out, activation, ws);
+                }
+                else {
+                    forwardCPUDirect(in, out, ws);
+                }
+                break;
+            }
+        }
+
+        // Only the direct convolution has a specialized path, which computes every pair.
+        virtual bool isSpecialized() const {
+            return getCPUAlgorithm() == DIRECT && !sparse && Layer::isSpecialized();
+        }
+
+        virtual size_t getSharedScratchSize() const {
+            if (precision == INT8) {
+                // The quantized input.
+                return getQuantizedInSize();
+            }
+            if (getCPUAlgorithm() == IM2COL) {
+                // The im2col matrix.
+                return iDepth * kernelSize * kernelSize * oWidth * oHeight;
+            }
+            if (getCPUAlgorithm() == WINOGRAD) {
+                // The transformed input and output tiles.
+                return transform.n * transform.n * (iDepth + oDepth) * getWinogradTiles();
+            }
+            if (getCPUAlgorithm() == FFT) {
+                // The spectrum of every input map.
+                return 2 * iDepth * getFFTSize();
+            }
+            return 0;
+        }
+
+        virtual size_t getLocalScratchSize() const {
+            if (precision == INT8) {
+                // The int32 accumulators of one output row.
+                return oWidth;
+            }
+            if (getCPUAlgorithm() == IM2COL) {
+                // The SGEMM packing buffers.
+                size_t N = iDepth * kernelSize * kernelSize;
+                return gemm::packASize(oDepth, N) + gemm::packBSize(N, oWidth * oHeight);
+            }
+            if (getCPUAlgorithm() == WINOGRAD) {
+                // The SGEMM packing buffers and two n x n tiles.
+                return gemm::packASize(oDepth, iDepth) + gemm::packBSize(iDepth, getWinogradTiles()) +
+                    2 * transform.n * transform.n;
+            }
+            if (getCPUAlgorithm() == FFT) {
+                // The spectrum of one output map.
+                return 2 * getFFTSize();
+            }
+            // The input buffer.
+            return isSpecialized() ? 0 : kernelSize * kernelSize;
+        }
+
+        // Switch the CPU algorithm, AUTO picks the cheapest one by the cost model.
+        void setAlgorithm(ConvAlgorithm algorithm) {
+            if (algorithm == AUTO) {
+                algorithm = pickAlgorithm();
+            }
+            if (algorithm == WINOGRAD) {
+                initWinograd(vec(), NULL);
+            }
+            if (algorithm == FFT) {
+                initFFT();
+            }
+            this->algorithm = algorithm;
+        }
+
+        ConvAlgorithm getAlgorithm() const {
+            return algorithm;
+        }
+
+        // Algorithm computeCPU runs: FP16 rounds the weight but not the
+        // Winograd and FFT ones, so it falls back to the direct convolution.
+        ConvAlgorithm getCPUAlgorithm() const {
+            if (precision == FP16 && (algorithm == WINOGRAD || algorithm == FFT)) {
+                return DIRECT;
+            }
+            return algorithm;
+        }
+
+        // Output tile m of the Winograd F(m x m, r x r) path.
+        size_t getWinogradTile() const {
+            return winogradTile;
+        }
+
+        size_t getKernelSize() const {
+            return kernelSize;
+        }
+
+        // Whether the model has a connection table.
+        bool isSparse() const {
+            return sparse;
+        }
+
+        // Connected (output, input) map pairs, iDepth * oDepth without a table.
+        size_t getConnections() const {
+            return connectionInput.size();
+        }
+
+        const connection::Table &getConnectionTable() const {
+            return connectionTable;
+        }
+
+        // Estimated cost of one forward, in multiplies weighted by how fast this CPU path runs them.
+        //     direct:  the kernel window multiplies, one dot product of K * K at a time,
+        //     im2col:  the same multiplies in a blocked SGEMM plus the im2col copy
+        //              and packing the weight, which dominates with few output pixels,
+        //     FFT:     iDepth forward and oDepth inverse transforms of P x Q
+        //              (5 / 2 * PQ * log2(PQ) complex butterflies as real multiplies)
+        //              and 4 real multiplies per frequency per map pair.
+        double getCost(ConvAlgorithm algorithm) const {
+            const double DIRECT_RATE = 1.0;
+            const double GEMM_RATE = 4.0;
+            const double FFT_RATE = 1.0;
+
+            double multiplies = (double)getMultiplies(IM2COL);
+            switch (algorithm) {
+            case IM2COL:
+                return multiplies / GEMM_RATE + (double)iDepth * kernelSize * kernelSize * (oWidth * oHeight + oDepth);
+            case FFT: {
+                double size = (double)getFFTSize();
+                double transforms = (double)(iDepth + oDepth) * 2.5 * size * (double)fft::log2(getFFTSize());
+                return (transforms + 4.0 * size * iDepth * oDepth) / FFT_RATE;
+            }
+            default:
+                return (double)getMultiplies(DIRECT) / DIRECT_RATE;
+            }
+        }
+
+        // The cheapest of direct, im2col and FFT for this shape.
+        ConvAlgorithm pickAlgorithm() const {
+            const ConvAlgorithm CANDIDATES[] = { DIRECT, IM2COL, FFT };
+            ConvAlgorithm best = DIRECT;
+            for (size_t i = 0; i < sizeof(CANDIDATES) / sizeof(CANDIDATES[0]); ++i) {
+                if (getCost(CANDIDATES[i]) < getCost(best)) {
+                    best = CANDIDATES[i];
+                }
+            }
+            return best;
+        }
+
+        // Multiplies of one forward with the algorithm. Only the direct convolution
+        // skips the unconnected pairs, im2col multiplies their zero weights.
+        size_t getMultiplies(ConvAlgorithm algorithm) const {
+            if (algorithm == WINOGRAD) {
+                return winograd::winogradMultiplies(winogradTile, kernelSize, oWidth, oHeight, iDepth, oDepth);
+            }
+            if (algorithm == DIRECT) {
+                return winograd::directMultiplies(kernelSize, oWidth, oHeight, 1, 1) * getConnections();
+            }
+            return winograd::directMultiplies(kernelSize, oWidth, oHeight, iDepth, oDepth);
+        }
+
+    private:
+        /*****************************************************************************************
+         For CPU forward.
+         *****************************************************************************************/
+        // Direct convolution, one kernel window at a time.
+        // Work is split across (output feature map, output row) pairs.
+        void forwardCPUDirect(const float *in, float *out, const Workspace &ws) {
+            parallelFor(ws, 0, oDepth * oHeight, 1, [&](size_t begin, size_t end, size_t worker) {
+                float *inputBuffer = ws.getLocal(worker);
+                for (size_t t = begin; t < end; ++t) {
+                    size_t o = t / oHeight;
+                    size_t r = t % oHeight;
+                    float *outRow = out + getOutputIdx(o, r, 0);
+
+                    // Clear the output row.
+                    std::fill(outRow, outRow + oWidth, 0.0f);
+
+                    // For each connected input feature map.
+                    for (size_t k = connectionBegin[o]; k < connectionBegin[o + 1]; ++k) {
+                        size_t i = connectionInput[k];
                         for (size_t c = 0; c < oWidth; ++c) {
-                            getInput(i, r, c, in);
-                            out[getOutputIdx(o, r, c)] += convolution(getWeightBase(i, o));
+                            getInput(i, r, c, in, inputBuffer);
+                            outRow[c] += convolution(getWeightBase(i, o), inputBuffer);
                         }
                     }
+
+                    // Activate function.
+                    simd::activate(activation, outRow, oWidth, 1.0f, offset[o]);
                 }
+            });
+        }
 
-                // Activate function.
-                for (size_t r = 0; r < oHeight; ++r) {
+        // Direct convolution on the quantized input and weights, accumulated in int32
+        // one output row at a time and dequantized with inScale * weightScale[o].
+        void forwardCPUInt8(const float *in, float *out, const Workspace &ws) {
+            const quant::int8 *q = quantizeInput(in, ws);
+            parallelFor(ws, 0, oDepth * oHeight, 1, [&](size_t begin, size_t end, size_t worker) {
+                int *acc = (int *)ws.getLocal(worker);
+                for (size_t t = begin; t < end; ++t) {
+                    size_t o = t / oHeight;
+                    size_t r = t % oHeight;
+                    std::fill(acc, acc + oWidth, 0);
+
+                    for (size_t k = connectionBegin[o]; k < connectionBegin[o + 1]; ++k) {
+                        size_t i = connectionInput[k];
+                        const quant::int8 *w = &qweight[(o * iDepth + i) * kernelSize * kernelSize];
+                        for (size_t x = 0; x < kernelSize; ++x) {
+                            const quant::int8 *inRow = q + (i * iHeight + r + x) * iWidth;
+                            for (size_t y = 0; y < kernelSize; ++y) {
+                                int wv = w[x * kernelSize + y];
+                                for (size_t c = 0; c < oWidth; ++c) {
+                                    acc[c] += wv * inRow[c + y];
+                                }
+                            }
+                        }
+                    }
+
+                    float *outRow = out + getOutputIdx(o, r, 0);
                     for (size_t c = 0; c < oWidth; ++c) {
-                        size_t idx = getOutputIdx(o, r, c);
-                        out[idx] = sigmod(out[idx] + offset[o]);
+                        outRow[c] = (float)acc[c];
+                    }
+                    simd::activate(activation, outRow, oWidth, inScale * weightScale[o], offset[o]);
+                }
+            });
+        }
+
+        // Im2col once for all output feature maps, then one SGEMM:
+        // out[oDepth x (oHeight * oWidth)] = weight[oDepth x (iDepth * kernelLen)] * col.
+        // Im2col is split across input feature maps and the SGEMM across column panels.
+        void forwardCPUIm2col(const float *in, float *out, const Workspace &ws) {
+
+            size_t M = oDepth;
+            size_t N = iDepth * kernelSize * kernelSize;
+            size_t P = oHeight * oWidth;
+            float *col = ws.shared;
+
+            parallelFor(ws, 0, iDepth, 1, [&](size_t begin, size_t end, size_t /*worker*/) {
+                im2col(in + begin * iWidth * iHeight,
+                    iWidth,
+                    iHeight,
+                    end - begin,
+                    kernelSize,
+                    oWidth,
+                    oHeight,
+                    col + begin * kernelSize * kernelSize * P);
+            });
+
+            size_t panels = (P + gemm::NR - 1) / gemm::NR;
+            parallelFor(ws, 0, panels, 1, [&](size_t begin, size_t end, size_t worker) {
+                size_t p0 = begin * gemm::NR;
+                size_t p1 = std::min(P, end * gemm::NR);
+                float *packedA = ws.getLocal(worker);
+                float *packedB = packedA + gemm::packASize(M, N);
+                sgemm(M, N, p1 - p0, &weight[0], N, col + p0, P, out + p0, P, packedA, packedB, simd::kernels().gemmMicroKernel);
+
+                // Activate function.
+                for (size_t o = 0; o < oDepth; ++o) {
+                    simd::activate(activation, out + o * P + p0, p1 - p0, 1.0f, offset[o]);
+                }
+            });
+        }
+
+        // Winograd F(m x m, r x r), the transformed domain has n x n points xi:
+        //     V[xi][i][t] = (BT d B)[xi]          for input map i and tile t,
+        //     M[xi] = U[xi](oDepth x iDepth) * V[xi](iDepth x tiles),
+        //     out tile = AT M A.
+        // The transforms are split across maps and the n * n SGEMMs across xi.
+        void forwardCPUWinograd(const float *in, float *out, const Workspace &ws) {
+
+            const size_t m = transform.m;
+            const size_t n = transform.n;
+            const size_t tilesW = winograd::numTiles(oWidth, m);
+            const size_t T = getWinogradTiles();
+            float *V = ws.shared;
+            float *M = V + n * n * iDepth * T;
+
+            // Input transform, tiles past the border read zeros.
+            parallelFor(ws, 0, iDepth, 1, [&](size_t begin, size_t end, size_t worker) {
+                float *d = ws.getLocal(worker) + gemm::packASize(oDepth, iDepth) + gemm::packBSize(iDepth, T);
+                float *tmp = d + n * n;
+                for (size_t i = begin; i < end; ++i) {
+                    const float *inMap = in + i * iWidth * iHeight;
+                    for (size_t t = 0; t < T; ++t) {
+                        size_t r0 = t / tilesW * m;
+                        size_t c0 = t % tilesW * m;
+                        for (size_t a = 0; a < n; ++a) {
+                            for (size_t b = 0; b < n; ++b) {
+                                bool inside = r0 + a < iHeight && c0 + b < iWidth;
+                                d[a * n + b] = inside ? inMap[(r0 + a) * iWidth + c0 + b] : 0.0f;
+                            }
+                        }
+                        multiplyTile(&transform.BT[0], n, d, n, tmp);
+                        for (size_t a = 0; a < n; ++a) {
+                            for (size_t b = 0; b < n; ++b) {
+                                float sum = 0.0f;
+                                for (size_t k = 0; k < n; ++k) {
+                                    sum += tmp[a * n + k] * transform.BT[b * n + k];
+                                }
+                                V[((a * n + b) * iDepth + i) * T + t] = sum;
+                            }
+                        }
                     }
                 }
+            });
+
+            // One SGEMM per point of the transformed domain.
+            parallelFor(ws, 0, n * n, 1, [&](size_t begin, size_t end, size_t worker) {
+                float *packedA = ws.getLocal(worker);
+                float *packedB = packedA + gemm::packASize(oDepth, iDepth);
+                for (size_t xi = begin; xi < end; ++xi) {
+                    sgemm(oDepth, iDepth, T,
+                        &cpuWinogradWeight[xi * oDepth * iDepth], iDepth,
+                        V + xi * iDepth * T, T,
+                        M + xi * oDepth * T, T,
+                        packedA, packedB, simd::kernels().gemmMicroKernel);
+                }
+            });
+
+            // Output transform, only the part of the tiles inside the map is written.
+            parallelFor(ws, 0, oDepth, 1, [&](size_t begin, size_t end, size_t worker) {
+                float *mt = ws.getLocal(worker) + gemm::packASize(oDepth, iDepth) + gemm::packBSize(iDepth, T);
+                float *tmp = mt + n * n;
+                for (size_t o = begin; o < end; ++o) {
+                    float *outMap = out + o * oWidth * oHeight;
+                    for (size_t t = 0; t < T; ++t) {
+                        size_t r0 = t / tilesW * m;
+                        size_t c0 = t % tilesW * m;
+                        for (size_t xi = 0; xi < n * n; ++xi) {
+                            mt[xi] = M[(xi * oDepth + o) * T + t];
+                        }
+                        multiplyTile(&transform.AT[0], m, mt, n, tmp);
+                        for (size_t a = 0; a < m && r0 + a < oHeight; ++a) {
+                            for (size_t b = 0; b < m && c0 + b < oWidth; ++b) {
+                                float sum = 0.0f;
+                                for (size_t k = 0; k < n; ++k) {
+                                    sum += tmp[a * n + k] * transform.AT[b * n + k];
+                                }
+                                outMap[(r0 + a) * oWidth + c0 + b] = sum;
+                            }
+                        }
+                    }
+
+                    // Activate function.
+                    simd::activate(activation, outMap, oWidth * oHeight, 1.0f, offset[o]);
+                }
+            });
+        }
+
+        // FFT convolution: transform every input map once, then for every output map
+        // accumulate the products with the kernel spectra and transform back.
+        // Split across input maps, then across output maps.
+        void forwardCPUFFT(const float *in, float *out, const Workspace &ws) {
+
+            const size_t size = getFFTSize();
+            fft::complex *spectra = reinterpret_cast<fft::complex *>(ws.shared);
+
+            parallelFor(ws, 0, iDepth, 1, [&](size_t begin, size_t end, size_t /*worker*/) {
+                for (size_t i = begin; i < end; ++i) {
+                    fft::forward2D(rowPlan, colPlan, in + i * iWidth * iHeight, iWidth, iHeight, spectra + i * size);
+                }
+            });
+
+            parallelFor(ws, 0, oDepth, 1, [&](size_t begin, size_t end, size_t worker) {
+                fft::complex *acc = reinterpret_cast<fft::complex *>(ws.getLocal(worker));
+                for (size_t o = begin; o < end; ++o) {
+                    std::fill(acc, acc + size, fft::complex(0.0f, 0.0f));
+                    for (size_t i = 0; i < iDepth; ++i) {
+                        const fft::complex *x = spectra + i * size;
+                        const fft::complex *w = &fftWeight[(o * iDepth + i) * size];
+                        for (size_t k = 0; k < size; ++k) {
+                            acc[k] += x[k] * w[k];
+                        }
+                    }
+                    float *outMap = out + o * oWidth * oHeight;
+                    fft::inverse2D(rowPlan, colPlan, acc, oWidth, oHeight, outMap);
+
+                    // Activate function.
+                    simd::activate(activation, outMap, oWidth * oHeight, 1.0f, offset[o]);
+                }
+            });
+        }
+
+        // Transform every kernel once, conjugated so the product correlates.
+        // Computed the first time FFT is chosen since the spectra are much larger than the weight.
+        void initFFT() {
+            if (!fftWeight.empty()) {
+                return;
+            }
+            rowPlan = fft::Plan(fft::nextPowerOfTwo(iWidth));
+            colPlan = fft::Plan(fft::nextPowerOfTwo(iHeight));
+            size_t size = getFFTSize();
+            fftWeight.resize(oDepth * iDepth * size);
+            for (size_t p = 0; p < oDepth * iDepth; ++p) {
+                fft::complex *w = &fftWeight[p * size];
+                fft::forward2D(rowPlan, colPlan, &weight[p * kernelSize * kernelSize], kernelSize, kernelSize, w);
+                for (size_t k = 0; k < size; ++k) {
+                    w[k] = std::conj(w[k]);
+                }
             }
+        }
 
-            diff = clock() - start;
-            int msec = diff * 1000 / CLOCKS_PER_SEC;
+        // Number of frequencies of one padded map.
+        size_t getFFTSize() const {
+            return fft::nextPowerOfTwo(iWidth) * fft::nextPowerOfTwo(iHeight);
+        }
 
-            return (unsigned long long)msec;
+        // c(rows x n) = a(rows x n) * b(n x n).
+        static void multiplyTile(const float *a, size_t rows, const float *b, size_t n, float *c) {
+            for (size_t i = 0; i < rows; ++i) {
+                for (size_t j = 0; j < n; ++j) {
+                    float sum = 0.0f;
+                    for (size_t k = 0; k < n; ++k) {
+                        sum += a[i * n + k] * b[k * n + j];
+                    }
+                    c[i * n + j] = sum;
+                }
+            }
+        }
+
+        // Build F(m x m, kernelSize x kernelSize) and the transformed weight,
+        // taken from the model if it has one and computed from the weight otherwise.
+        // Built once, with the model's weight or the first time Winograd is chosen,
+        // since it is several times the weight and F(m, r) only exists for small kernels.
+        void initWinograd(const vec &winogradWeight, Arena *arena) {
+            if (!cpuWinogradWeight.empty()) {
+                return;
+            }
+            const size_t m = winogradTile;
+            transform = winograd::makeTransform(m, kernelSize);
+            size_t n = transform.n;
+            size_t uSize = oDepth * iDepth * n * n;
+
+            Tensor device(Shape(oDepth, iDepth, n, n), OIHW, arena);
+            if (winogradWeight.empty()) {
+                winograd::transformWeight(transform, weight.data(), oDepth, iDepth, device.data());
+            }
+            else if (winogradWeight.size() == uSize) {
+                std::copy(winogradWeight.begin(), winogradWeight.end(), device.begin());
+            }
+            else {
+                std::cerr << "ConvolutionLayer: Winograd weight has " << winogradWeight.size()
+                    << " elements, F(" << m << ", " << kernelSize << ") needs " << uSize << std::endl;
+                exit(-1);
+            }
+
+            // Reorder (o, i, xi) to (xi, o, i) so every point is one row major matrix.
+            Tensor cpu(Shape(n * n, oDepth, iDepth), FLAT, arena);
+            for (size_t p = 0; p < oDepth * iDepth; ++p) {
+                for (size_t xi = 0; xi < n * n; ++xi) {
+                    cpu[xi * oDepth * iDepth + p] = device[p * n * n + xi];
+                }
+            }
+            deviceWinogradWeight.swap(device);
+            cpuWinogradWeight.swap(cpu);
+        }
+
+        // Zero the weight of the unconnected pairs, before the layer converts or quantizes it.
+        static vec maskWeight(const LayerParam &params, const vec &weight) {
+            if (params.connection.empty()) {
+                return weight;
+            }
+            connection::validate(params.connection, params.iDepth, params.oDepth, params.kernelName);
+            size_t kernelLen = params.kernelSize * params.kernelSize;
+            if (weight.size() != params.oDepth * params.iDepth * kernelLen) {
+                std::cerr << "ConvolutionLayer: " << params.kernelName << " has a connection table but "
+                    << weight.size() << " weights, expected " << params.oDepth * params.iDepth * kernelLen << std::endl;
+                exit(-1);
+            }
+            vec masked(weight);
+            std::vector<bool> connected = connection::mask(params.connection, params.iDepth, params.oDepth);
+            for (size_t p = 0; p < connected.size(); ++p) {
+                if (!connected[p]) {
+                    std::fill(masked.begin() + p * kernelLen, masked.begin() + (p + 1) * kernelLen, 0.0f);
+                }
+            }
+            return masked;
+        }
+
+        // The sparse kernel takes the kernels of the connected pairs packed one after another.
+        void initSparse(const LayerParam &params, const vec &winogradWeight, Arena &arena) {
+            if (!winogradWeight.empty() || devicePrecision == INT8) {
+                std::cerr << "ConvolutionLayer: No " << (winogradWeight.empty() ? "int8" : "Winograd")
+                    << " kernel with a connection table: " << params.kernelName << std::endl;
+                exit(-1);
+            }
+            size_t kernelLen = kernelSize * kernelSize;
+            if (devicePrecision == FP16) {
+                std::vector<fp16::half, AlignedAllocator<fp16::half> > packed(getConnections() * kernelLen);
+                connection::pack(connectionTable, &halfDeviceWeight[0], iDepth, kernelLen, &packed[0]);
+                halfDeviceWeight.swap(packed);
+                setDeviceWeight(context, &halfDeviceWeight[0], halfDeviceWeight.size() * sizeof(fp16::half));
+            }
+            else {
+                Tensor packed(Shape(getConnections() * kernelLen), FLAT, &arena);
+                connection::pack(connectionTable, weight.data(), iDepth, kernelLen, packed.data());
+                packedWeight.swap(packed);
+                setDeviceWeight(context, packedWeight);
+            }
+        }
+
+        size_t getWinogradTiles() const {
+            return winograd::numTiles(oWidth, winogradTile) * winograd::numTiles(oHeight, winogradTile);
         }
 
-    private:
-        /*****************************************************************************************
-         For CPU forward.
-         *****************************************************************************************/
         // Prepare the input buffer.
-        inline void getInput(size_t i, size_t r, size_t c, const vec &in) {
+        inline void getInput(size_t i, size_t r, size_t c, const float *in, float *inputBuffer) {
             size_t idx = 0;
             for (size_t x = 0; x < kernelSize; ++x) {
                 for (size_t y = 0; y < kernelSize; ++y) {
@@ -92,19 +601,35 @@ namespace cnn {
         }
 
         // Do the convolution with weight and the input buffer.
-        float convolution(size_t weightBase) {
-            float sum = 0.0f;
-            for (size_t i = 0; i < kernelSize * kernelSize; ++i) {
-                sum += weight[weightBase + i] * inputBuffer[i];
-            }
-            return sum;
+        float convolution(size_t weightBase, const float *inputBuffer) {
+            return simd::kernels().dot(&weight[weightBase], inputBuffer, kernelSize * kernelSize);
         }
 
         // Kernel size.
         size_t kernelSize;
 
-        // Buffer for convolution.
-        vec inputBuffer;
+        // CPU algorithm.
+        ConvAlgorithm algorithm;
+
+        // Connection table, flattened to the input maps connectionInput[connectionBegin[o]..connectionBegin[o + 1])
+        // of every output map o, and the weight of the connected pairs packed for the device.
+        bool sparse;
+        connection::Table connectionTable;
+        std::vector<size_t> connectionBegin;
+        std::vector<size_t> connectionInput;
+        Tensor packedWeight;
+
+        // Winograd output tile, transform and the weight in the transformed domain,
+        // laid out (o, i, xi) for the device and (xi, o, i) for the CPU SGEMMs.
+        size_t winogradTile;
+        winograd::Transform transform;
+        Tensor deviceWinogradWeight;
+        Tensor cpuWinogradWeight;
+
+        // FFT plans of the padded rows and columns and the conjugated kernel spectra, (o, i, P x Q).
+        fft::Plan rowPlan;
+        fft::Plan colPlan;
+        std::vector<fft::complex> fftWeight;
 
     };
 
@@ -0,0 +1,145 @@
+#ifndef FFT_HEADER
+#define FFT_HEADER
+
+#include <vector>
+#include <complex>
+#include <algorithm>
+#include <cmath>
+
+/******************************************************************************************
+
+    Radix-2 FFT for the CPU convolution.
+
+    The valid correlation of an input map of W x H with a K x K kernel is
+
+        out = IFFT( FFT(in) .* conj(FFT(kernel)) )    restricted to (W - K + 1) x (H - K + 1)
+
+    when both are zero padded to Q x P with Q >= W and P >= H: the circular
+    correlation never wraps inside the valid region. Per (input, output) map
+    pair the cost drops from oW * oH * K * K multiplies to one complex
+    multiply per frequency, the transforms are shared:
+        one forward transform per input map, reused by every output map,
+        one inverse transform per output map,
+        the kernel transforms are computed once when the algorithm is chosen.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace fft {
+
+        typedef std::complex<float> complex;
+
+        inline size_t nextPowerOfTwo(size_t n) {
+            size_t p = 1;
+            while (p < n) {
+                p <<= 1;
+            }
+            return p;
+        }
+
+        inline size_t log2(size_t n) {
+            size_t l = 0;
+            while (((size_t)1 << l) < n) {
+                ++l;
+            }
+            return l;
+        }
+
+        // Twiddles and bit reversal of one power of two size.
+        class Plan {
+        public:
+            Plan() : n(0) {
+            }
+
+            explicit Plan(size_t n) : n(n), twiddle(n / 2), reversed(n) {
+                const double PI = 3.14159265358979323846;
+                for (size_t k = 0; k < n / 2; ++k) {
+                    double angle = -2.0 * PI * (double)k / (double)n;
+                    twiddle[k] = complex((float)std::cos(angle), (float)std::sin(angle));
+                }
+                size_t bits = log2(n);
+                for (size_t i = 0; i < n; ++i) {
+                    size_t r = 0;
+                    for (size_t b = 0; b < bits; ++b) {
+                        r |= ((i >> b) & 1) << (bits - 1 - b);
+                    }
+                    reversed[i] = r;
+                }
+            }
+
+            size_t size() const {
+                return n;
+            }
+
+            // In place transform of n elements spaced by stride.
+            // The inverse is not scaled, divide by n afterwards.
+            void transform(complex *x, size_t stride, bool inverse) const {
+                for (size_t i = 0; i < n; ++i) {
+                    size_t r = reversed[i];
+                    if (i < r) {
+                        std::swap(x[i * stride], x[r * stride]);
+                    }
+                }
+                for (size_t len = 2; len <= n; len <<= 1) {
+                    size_t half = len / 2;
+                    size_t step = n / len;
+                    for (size_t i = 0; i < n; i += len) {
+                        for (size_t k = 0; k < half; ++k) {
+                            complex w = inverse ? std::conj(twiddle[k * step]) : twiddle[k * step];
+                            complex a = x[(i + k) * stride];
+                            complex b = x[(i + k + half) * stride] * w;
+                            x[(i + k) * stride] = a + b;
+                            x[(i + k + half) * stride] = a - b;
+                        }
+                    }
+                }
+            }
+
+        private:
+            size_t n;
+            std::vector<complex> twiddle;
+            std::vector<size_t> reversed;
+        };
+
+        // Forward transform of a rows x cols real map zero padded into a P x Q spectrum.
+        inline void forward2D(const Plan &rowPlan, const Plan &colPlan,
+            const float *in, size_t cols, size_t rows, complex *out) {
+            size_t Q = rowPlan.size();
+            size_t P = colPlan.size();
+            for (size_t r = 0; r < P; ++r) {
+                complex *row = out + r * Q;
+                for (size_t c = 0; c < Q; ++c) {
+                    row[c] = (r < rows && c < cols) ? complex(in[r * cols + c], 0.0f) : complex(0.0f, 0.0f);
+                }
+                // Rows past the map stay zero after the transform.
+                if (r < rows) {
+                    rowPlan.transform(row, 1, false);
+                }
+            }
+            for (size_t c = 0; c < Q; ++c) {
+                colPlan.transform(out + c, Q, false);
+            }
+        }
+
+        // Inverse transform of a P x Q spectrum, only the top left rows x cols of the real part is written.
+        // The spectrum is overwritten.
+        inline void inverse2D(const Plan &rowPlan, const Plan &colPlan,
+            complex *spectrum, size_t cols, size_t rows, float *out) {
+            size_t Q = rowPlan.size();
+            size_t P = colPlan.size();
+            for (size_t c = 0; c < Q; ++c) {
+                colPlan.transform(spectrum + c, Q, true);
+            }
+            float scale = 1.0f / (float)(P * Q);
+            for (size_t r = 0; r < rows; ++r) {
+                complex *row = spectrum + r * Q;
+                rowPlan.transform(row, 1, true);
+                for (size_t c = 0; c < cols; ++c) {
+                    out[r * cols + c] = row[c].real() * scale;
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -10,48 +10,215 @@ namespace cnn {
         FullConnectLayer(const LayerParam &params,
             const vec &weight,
             const vec &offset,
+            Arena &arena,
             const cl_context &context,
             const cl_program &program,
             const cl_mem &clIn
-            ) : Layer(params, weight, offset, context, program, clIn) {
+            ) : Layer(params, weight, offset, arena, context, program, clIn),
+            sparseThreshold(sparse::CPU_DENSITY_THRESHOLD),
+            clColumn(NULL),
+            clRowBegin(NULL) {
 
             assert(weight.size() == (iWidth * iHeight * iDepth * oWidth * oHeight * oDepth));
             assert(offset.size() == (oWidth * oHeight * oDepth));
 
+            // The nonzeros, only kept for the sparse kernels.
+            density = sparse::density(this->weight.data(), this->weight.size());
+            if (params.weightFormat == CSR) {
+                initSparse();
+                initSparseDevice(params, arena);
+            }
+            else if (isSparse()) {
+                initSparse();
+            }
+
             // Prepare the ND-Range.
             global[0] = closestMultiple(workGroupSize[0], oWidth * oDepth * oHeight);
             global[1] = workGroupSize[1];
             global[2] = workGroupSize[2];
+
+            specializedForward = specialized::findFull(getInSize(), getOutSize());
         }
 
         virtual ~FullConnectLayer() {
+            if (clColumn) {
+                clReleaseMemObject(clColumn);
+                clReleaseMemObject(clRowBegin);
+            }
+        }
+
+        // Forward with CPU, split across output neurons.
+        virtual void computeCPU(const float *in, float *out, const Workspace &ws) {
+            if (precision == INT8) {
+                forwardCPUInt8(in, out, ws);
+                return;
+            }
+            if (isSparse()) {
+                forwardCPUSparse(in, out, ws);
+                return;
+            }
+            if (isSpecialized()) {
+                specializedForward(in, weight.data(), offset.data(), out, activation, ws);
+                return;
+            }
+            size_t inSize = getInSize();
+            parallelFor(ws, 0, getOutSize(), 4, [&](size_t begin, size_t end, size_t /*worker*/) {
+                // For each output element.
+                for (size_t o = begin; o < end; ++o) {
+                    out[o] = simd::kernels().dot(&weight[o * inSize], in, inSize);
+                }
+
+                // Activate function.
+                simd::activateBias(activation, out + begin, &offset[begin], end - begin);
+            });
+        }
+
+        virtual size_t getSharedScratchSize() const {
+            return precision == INT8 ? getQuantizedInSize() : 0;
+        }
+
+        // The specialized path is dense.
+        virtual bool isSpecialized() const {
+            return !isSparse() && Layer::isSpecialized();
+        }
+
+        // Whether the CPU runs the CSR kernel: the weight is sparse enough and not rounded or quantized.
+        bool isSparse() const {
+            return precision == FP32 && density <= sparseThreshold;
+        }
+
+        // Densities at or below the threshold run the CSR kernel, 0 always runs the dense one.
+        void setSparseThreshold(float threshold) {
+            sparseThreshold = threshold;
+            if (density <= sparseThreshold) {
+                initSparse();
+            }
+        }
+
+        float getSparseThreshold() const {
+            return sparseThreshold;
+        }
+
+        // Fraction of the weight that is nonzero.
+        float getDensity() const {
+            return density;
         }
 
-        virtual unsigned long long forwardCPU(const vec &in) {
+        // The nonzeros of the fp32 weight, built on the first call if no sparse kernel needed them.
+        const sparse::Matrix &getSparseWeight() {
+            initSparse();
+            return csr;
+        }
 
-            clock_t start = clock(), diff;
+        // Multiplies of one forward on the CPU.
+        size_t getMultiplies() const {
+            return isSparse() ? csr.nonzeros() : getInSize() * getOutSize();
+        }
 
-            // Clear the output buffer.
-            std::fill(out.begin(), out.end(), 0.0f);
+    private:
 
-            // For each output element.
-            for (size_t o = 0; o < out.size(); ++o) {
-                size_t weightBase = o * iWidth * iHeight * iDepth;
-                // For each input element.
-                float sum = 0.0f;
-                for (size_t i = 0; i < in.size(); ++i) {
-                    sum += weight[weightBase + i] * in[i];
+        // Keep the nonzeros of the fp32 weight, which FP16 swaps into halfWeight.
+        void initSparse() {
+            if (csr.rows != 0) {
+                return;
+            }
+            const Tensor &fp32 = precision == FP16 ? halfWeight : weight;
+            csr = sparse::fromDense(fp32.data(), getOutSize(), getInSize());
+        }
+
+        // y[o] = sum of value[p] * in[column[p]] over the nonzeros p of row o.
+        void forwardCPUSparse(const float *in, float *out, const Workspace &ws) {
+            parallelFor(ws, 0, getOutSize(), 4, [&](size_t begin, size_t end, size_t /*worker*/) {
+                const float *value = csr.value.data();
+                const size_t *column = csr.column.data();
+                for (size_t o = begin; o < end; ++o) {
+                    // Four partial sums hide the latency of the gathered loads.
+                    float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                    size_t p = csr.rowBegin[o];
+                    size_t rowEnd = csr.rowBegin[o + 1];
+                    for (; p + 4 <= rowEnd; p += 4) {
+                        sum[0] += value[p] * in[column[p]];
+                        sum[1] += value[p + 1] * in[column[p + 1]];
+                        sum[2] += value[p + 2] * in[column[p + 2]];
+                        sum[3] += value[p + 3] * in[column[p + 3]];
+                    }
+                    for (; p < rowEnd; ++p) {
+                        sum[0] += value[p] * in[column[p]];
+                    }
+                    out[o] = (sum[0] + sum[1]) + (sum[2] + sum[3]);
                 }
-                out[o] = sigmod(sum + offset[o]);
+                simd::activateBias(activation, out + begin, &offset[begin], end - begin);
+            });
+        }
+
+        // The sparse kernel takes the nonzeros as its weight, then the column and row begin indices after clOffset.
+        void initSparseDevice(const LayerParam &params, Arena &arena) {
+            if (devicePrecision == INT8) {
+                std::cerr << "FullConnectLayer: No int8 CSR kernel: " << params.kernelName << std::endl;
+                exit(-1);
+            }
+            if (devicePrecision == FP16) {
+                halfDeviceWeight.resize(std::max(csr.nonzeros(), (size_t)1));
+                fp16::fromFloat(csr.value.data(), csr.nonzeros(), &halfDeviceWeight[0]);
+                setDeviceWeight(context, &halfDeviceWeight[0], halfDeviceWeight.size() * sizeof(fp16::half));
+            }
+            else {
+                Tensor value(Shape(std::max(csr.nonzeros(), (size_t)1)), FLAT, &arena);
+                std::copy(csr.value.begin(), csr.value.end(), value.begin());
+                sparseValue.swap(value);
+                setDeviceWeight(context, sparseValue);
             }
 
-            diff = clock() - start;
-            int msec = diff * 1000 / CLOCKS_PER_SEC;
+            deviceColumn.assign(csr.column.begin(), csr.column.end());
+            deviceColumn.resize(std::max(csr.nonzeros(), (size_t)1));
+            deviceRowBegin.assign(csr.rowBegin.begin(), csr.rowBegin.end());
+            clColumn = createIndexBuffer(deviceColumn, weightArg + 2, "clColumn");
+            clRowBegin = createIndexBuffer(deviceRowBegin, weightArg + 3, "clRowBegin");
+        }
+
+        cl_mem createIndexBuffer(std::vector<cl_int> &index, cl_uint arg, const std::string &name) {
+            cl_int err;
+            cl_mem buffer = clCreateBuffer(
+                context,
+                CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                index.size() * sizeof(cl_int),
+                &index[0],
+                &err);
+            handleError(err, "Failed creating " + name + ". ");
+            err = clSetKernelArg(kernel, arg, sizeof(cl_mem), &buffer);
+            handleError(err, "Failed setting kernel arg: " + name + ". ");
+            return buffer;
+        }
 
-            return (unsigned long long)msec;
+        // Quantize the input, accumulate the int8 products in int32 and dequantize each neuron.
+        void forwardCPUInt8(const float *in, float *out, const Workspace &ws) {
+            size_t inSize = getInSize();
+            const quant::int8 *q = quantizeInput(in, ws);
+            parallelFor(ws, 0, getOutSize(), 4, [&](size_t begin, size_t end, size_t /*worker*/) {
+                for (size_t o = begin; o < end; ++o) {
+                    const quant::int8 *w = &qweight[o * inSize];
+                    int sum = 0;
+                    for (size_t i = 0; i < inSize; ++i) {
+                        sum += (int)w[i] * (int)q[i];
+                    }
+                    out[o] = (float)sum * (inScale * weightScale[o]);
+                }
+                simd::activateBias(activation, out + begin, &offset[begin], end - begin);
+            });
         }
 
+        // The nonzeros of the weight, empty while no sparse kernel uses them,
+        // their density and the density below which the CPU uses them.
+        sparse::Matrix csr;
+        float density;
+        float sparseThreshold;
 
+        // CSR arrays of the sparse device kernel.
+        Tensor sparseValue;
+        std::vector<cl_int> deviceColumn;
+        std::vector<cl_int> deviceRowBegin;
+        cl_mem clColumn;
+        cl_mem clRowBegin;
     };
 }
 
@@ -0,0 +1,210 @@
+#ifndef GEMM_HEADER
+#define GEMM_HEADER
+
+#include <cstring>
+#include <algorithm>
+
+/******************************************************************************************
+
+    Im2col and a register- and cache-blocked SGEMM for the CPU convolution.
+
+    A convolution layer with M = oDepth, N = iDepth * kernelSize * kernelSize
+    and P = oWidth * oHeight is computed as
+
+        C[M x P] = A[M x N] * B[N x P]
+
+    where A is the weight (already stored as M rows of N elements), B is the
+    im2col expansion of the input and C is the output feature maps. This is the
+    same formulation the cnn-mat project uses on the device.
+
+    The SGEMM follows the usual three level blocking:
+        NC columns of B are packed into panels of NR columns  (L3)
+        KC rows of that block are packed                      (L2)
+        MC rows of A are packed into panels of MR rows        (L1)
+    and a MR x NR micro kernel keeps the accumulators in registers.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace gemm {
+
+        // Register block.
+        const size_t MR = 4;
+        const size_t NR = 16;
+
+        // Cache block.
+        const size_t MC = 64;
+        const size_t KC = 256;
+        const size_t NC = 1024;
+
+        inline size_t roundUp(size_t n, size_t base) {
+            return (n + base - 1) / base * base;
+        }
+
+        // Size of the packing buffer for A (in floats).
+        inline size_t packASize(size_t M, size_t N) {
+            return roundUp(std::min(MC, M), MR) * std::min(KC, N);
+        }
+
+        // Size of the packing buffer for B (in floats).
+        inline size_t packBSize(size_t N, size_t P) {
+            return std::min(KC, N) * roundUp(std::min(NC, P), NR);
+        }
+
+        // Pack a mc x kc block of A into panels of MR rows.
+        // Rows beyond mc are padded with zero so the micro kernel never checks bounds.
+        inline void packA(size_t mc, size_t kc, const float *A, size_t lda, float *packed) {
+            for (size_t i = 0; i < mc; i += MR) {
+                size_t mr = std::min(MR, mc - i);
+                for (size_t k = 0; k < kc; ++k) {
+                    for (size_t ii = 0; ii < mr; ++ii) {
+                        *packed++ = A[(i + ii) * lda + k];
+                    }
+                    for (size_t ii = mr; ii < MR; ++ii) {
+                        *packed++ = 0.0f;
+                    }
+                }
+            }
+        }
+
+        // Pack a kc x nc block of B into panels of NR columns.
+        inline void packB(size_t kc, size_t nc, const float *B, size_t ldb, float *packed) {
+            for (size_t j = 0; j < nc; j += NR) {
+                size_t nr = std::min(NR, nc - j);
+                for (size_t k = 0; k < kc; ++k) {
+                    const float *row = B + k * ldb + j;
+                    for (size_t jj = 0; jj < nr; ++jj) {
+                        *packed++ = row[jj];
+                    }
+                    for (size_t jj = nr; jj < NR; ++jj) {
+                        *packed++ = 0.0f;
+                    }
+                }
+            }
+        }
+
+        // Write the valid mr x nr part of a micro kernel result back to C.
+        inline void storeTile(const float tile[MR][NR], float *C, size_t ldc, size_t mr, size_t nr, bool accumulate) {
+            for (size_t i = 0; i < mr; ++i) {
+                float *c = C + i * ldc;
+                if (accumulate) {
+                    for (size_t j = 0; j < nr; ++j) {
+                        c[j] += tile[i][j];
+                    }
+                }
+                else {
+                    for (size_t j = 0; j < nr; ++j) {
+                        c[j] = tile[i][j];
+                    }
+                }
+            }
+        }
+
+        // C[mr x nr] (+)= packedA[MR x kc] * packedB[kc x NR].
+        typedef void (*MicroKernel)(size_t kc,
+            const float *a,
+            const float *b,
+            float *C,
+            size_t ldc,
+            size_t mr,
+            size_t nr,
+            bool accumulate);
+
+        // Portable micro kernel. The accumulator is small enough to live in
+        // registers and the inner loop has a fixed trip count so it is vectorized.
+        void microKernel(size_t kc,
+            const float *a,
+            const float *b,
+            float *C,
+            size_t ldc,
+            size_t mr,
+            size_t nr,
+            bool accumulate
+            ) {
+            float acc[MR][NR];
+            for (size_t i = 0; i < MR; ++i) {
+                for (size_t j = 0; j < NR; ++j) {
+                    acc[i][j] = 0.0f;
+                }
+            }
+
+            for (size_t k = 0; k < kc; ++k) {
+                for (size_t i = 0; i < MR; ++i) {
+                    float ai = a[i];
+                    for (size_t j = 0; j < NR; ++j) {
+                        acc[i][j] += ai * b[j];
+                    }
+                }
+                a += MR;
+                b += NR;
+            }
+
+            storeTile(acc, C, ldc, mr, nr, accumulate);
+        }
+    }
+
+    // C[M x P] = A[M x N] * B[N x P], all row major.
+    // packedA and packedB must hold gemm::packASize(M, N) and gemm::packBSize(N, P) floats.
+    void sgemm(size_t M, size_t N, size_t P,
+        const float *A, size_t lda,
+        const float *B, size_t ldb,
+        float *C, size_t ldc,
+        float *packedA,
+        float *packedB,
+        gemm::MicroKernel kernel = gemm::microKernel
+        ) {
+        using namespace gemm;
+
+        for (size_t jc = 0; jc < P; jc += NC) {
+            size_t nc = std::min(NC, P - jc);
+
+            for (size_t pc = 0; pc < N; pc += KC) {
+                size_t kc = std::min(KC, N - pc);
+                packB(kc, nc, B + pc * ldb + jc, ldb, packedB);
+
+                for (size_t ic = 0; ic < M; ic += MC) {
+                    size_t mc = std::min(MC, M - ic);
+                    packA(mc, kc, A + ic * lda + pc, lda, packedA);
+
+                    // Walk the packed panels with the micro kernel.
+                    for (size_t jr = 0; jr < nc; jr += NR) {
+                        size_t nr = std::min(NR, nc - jr);
+                        for (size_t ir = 0; ir < mc; ir += MR) {
+                            size_t mr = std::min(MR, mc - ir);
+                            kernel(kc,
+                                packedA + ir * kc,
+                                packedB + jr * kc,
+                                C + (ic + ir) * ldc + jc + jr,
+                                ldc,
+                                mr,
+                                nr,
+                                pc != 0);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Expand the input feature maps into a (iDepth * kernelSize * kernelSize) x (oHeight * oWidth) matrix.
+    // Row (i, x, y) holds the input pixel that is multiplied with weight[o][i][x][y] for every output position.
+    void im2col(const float *in,
+        size_t iWidth, size_t iHeight, size_t iDepth,
+        size_t kernelSize,
+        size_t oWidth, size_t oHeight,
+        float *col
+        ) {
+        for (size_t i = 0; i < iDepth; ++i) {
+            for (size_t x = 0; x < kernelSize; ++x) {
+                for (size_t y = 0; y < kernelSize; ++y) {
+                    for (size_t r = 0; r < oHeight; ++r) {
+                        memcpy(col, in + (i * iHeight + r + x) * iWidth + y, oWidth * sizeof(float));
+                        col += oWidth;
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef INGEST_HEADER
+#define INGEST_HEADER
+
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+/******************************************************************************************
+
+    Raw uint8 input of the network.
+
+    The source images are width x height x depth bytes, smaller than the
+    input of the first layer. They are centered in it and mapped to
+        out = raw * scale + bias,
+    the padding taking bias, the value of a 0 (background) pixel.
+
+    LeCun et al. 1998 pad the 28 x 28 MNIST digits to 32 x 32 and map the
+    background to -0.1 and the foreground to 1.175, which keeps the mean
+    input near 0 and its variance near 1.
+
+    Sending the bytes and normalizing on the device moves a quarter of the
+    bytes of the float input (less with the padding) and takes the
+    normalization off the host.
+
+    This header only needs the standard library so the generator can share it.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace ingest {
+
+        struct Format {
+            size_t width;
+            size_t height;
+            size_t depth;
+            float scale;
+            float bias;
+
+            size_t size() const {
+                return width * height * depth;
+            }
+        };
+
+        // 28 x 28 MNIST digits, background -0.1 and foreground 1.175.
+        inline Format lenet5() {
+            Format format = { 28, 28, 1, 1.275f / 255.0f, -0.1f };
+            return format;
+        }
+
+        // Map the pixel p / 255 to (p / 255 - mean) / std.
+        inline Format standardize(size_t width, size_t height, size_t depth, float mean, float std) {
+            Format format = { width, height, depth, 1.0f / (255.0f * std), -mean / std };
+            return format;
+        }
+
+        // Offset of the raw image in the padded input.
+        inline size_t padding(size_t raw, size_t padded) {
+            return (padded - raw) / 2;
+        }
+
+        // Exit unless the raw images fit in the width x height x depth input.
+        inline void validate(const Format &format, size_t width, size_t height, size_t depth, const std::string &name) {
+            if (format.depth != depth || format.width > width || format.height > height ||
+                format.size() == 0 || format.scale == 0.0f) {
+                std::cerr << "ingest: " << name << " can't pad " << format.width << "x" << format.height << "x" << format.depth
+                    << " raw images to " << width << "x" << height << "x" << depth << std::endl;
+                exit(-1);
+            }
+        }
+
+        // Pad and normalize one raw image into the width x height x depth input.
+        inline void normalize(const unsigned char *raw, const Format &format, size_t width, size_t height, float *out) {
+            size_t left = padding(format.width, width);
+            size_t top = padding(format.height, height);
+            for (size_t d = 0; d < format.depth; ++d) {
+                for (size_t r = 0; r < height; ++r) {
+                    float *row = out + (d * height + r) * width;
+                    if (r < top || r >= top + format.height) {
+                        std::fill(row, row + width, format.bias);
+                        continue;
+                    }
+                    const unsigned char *rawRow = raw + (d * format.height + r - top) * format.width;
+                    std::fill(row, row + left, format.bias);
+                    for (size_t c = 0; c < format.width; ++c) {
+                        row[left + c] = (float)rawRow[c] * format.scale + format.bias;
+                    }
+                    std::fill(row + left + format.width, row + width, format.bias);
+                }
+            }
+        }
+    }
+}
+
+#endif
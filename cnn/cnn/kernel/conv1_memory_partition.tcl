@@ -34,6 +34,84 @@ set_property file_type "c header files" [get_files "util.hpp"]
 add_files "test.hpp"
 set_property file_type "c header files" [get_files "test.hpp"]
 
+add_files "simd.hpp"
+set_property file_type "c header files" [get_files "simd.hpp"]
+
+add_files "gemm.hpp"
+set_property file_type "c header files" [get_files "gemm.hpp"]
+
+add_files "threadpool.hpp"
+set_property file_type "c header files" [get_files "threadpool.hpp"]
+
+add_files "span.hpp"
+set_property file_type "c header files" [get_files "span.hpp"]
+
+add_files "tensor.hpp"
+set_property file_type "c header files" [get_files "tensor.hpp"]
+
+add_files "plan.hpp"
+set_property file_type "c header files" [get_files "plan.hpp"]
+
+add_files "specialized.hpp"
+set_property file_type "c header files" [get_files "specialized.hpp"]
+
+add_files "winograd.hpp"
+set_property file_type "c header files" [get_files "winograd.hpp"]
+
+add_files "fft.hpp"
+set_property file_type "c header files" [get_files "fft.hpp"]
+
+add_files "activation.hpp"
+set_property file_type "c header files" [get_files "activation.hpp"]
+
+add_files "precision.hpp"
+set_property file_type "c header files" [get_files "precision.hpp"]
+
+add_files "connection.hpp"
+set_property file_type "c header files" [get_files "connection.hpp"]
+
+add_files "sparse.hpp"
+set_property file_type "c header files" [get_files "sparse.hpp"]
+
+add_files "ingest.hpp"
+set_property file_type "c header files" [get_files "ingest.hpp"]
+
+add_files "bench.hpp"
+set_property file_type "c header files" [get_files "bench.hpp"]
+
+add_files "stats.hpp"
+set_property file_type "c header files" [get_files "stats.hpp"]
+
+add_files "variants.hpp"
+set_property file_type "c header files" [get_files "variants.hpp"]
+
+add_files "timeline.hpp"
+set_property file_type "c header files" [get_files "timeline.hpp"]
+
+add_files "trace.hpp"
+set_property file_type "c header files" [get_files "trace.hpp"]
+
+add_files "analysis.hpp"
+set_property file_type "c header files" [get_files "analysis.hpp"]
+
+add_files "sampling.hpp"
+set_property file_type "c header files" [get_files "sampling.hpp"]
+
+add_files "sdaccel.hpp"
+set_property file_type "c header files" [get_files "sdaccel.hpp"]
+
+add_files "wallclock.hpp"
+set_property file_type "c header files" [get_files "wallclock.hpp"]
+
+add_files "regress.hpp"
+set_property file_type "c header files" [get_files "regress.hpp"]
+
+add_files "microbench.hpp"
+set_property file_type "c header files" [get_files "microbench.hpp"]
+
+add_files "loadgen.hpp"
+set_property file_type "c header files" [get_files "loadgen.hpp"]
+
 # Create the kernel.
 create_kernel conv1 -type clc
 add_files -kernel [get_kernels conv1] "kernel/conv1_memory_partition.cl"
@@ -0,0 +1,139 @@
+float sigmod(float in) {
+    return 1.0f / (1.0f + exp(-in)); 
+}
+#define KERNEL_SIZE 5
+#define KERNEL_LEN 25
+#define IWIDTH 14
+#define IHEIGHT 14
+#define IDEPTH 6
+#define IN_SIZE 1176
+#define OWIDTH 10
+#define OHEIGHT 10
+#define ODEPTH 16
+#define OWIDTH_TILE 5
+#define OHEIGHT_TILE 5
+#define ODEPTH_TILE 4
+#define IDEPTH_TILE 1
+#define OUT_SIZE 1600
+#define WORK_GROUP_DIM_0 2
+#define WORK_GROUP_DIM_1 2
+#define WORK_GROUP_DIM_2 4
+#define KERNEL_NAME conv3
+#define ACTIVATE sigmod
+#define CONNECTIONS 60
+#define CONNECTION_BEGIN {0, 3, 6, 9, 12, 15, 18, 22, 26, 30, 34, 38, 42, 46, 50, 54, 60}
+#define CONNECTION_INPUT {0, 1, 2, 1, 2, 3, 2, 3, 4, 3, 4, 5, 0, 4, 5, 0, 1, 5, 0, 1, 2, 3, 1, 2, 3, 4, 2, 3, 4, 5, 0, 3, 4, 5, 0, 1, 4, 5, 0, 1, 2, 5, 0, 1, 3, 4, 1, 2, 4, 5, 0, 2, 3, 5, 0, 1, 2, 3, 4, 5}
+#define WEIGHT_TYPE float
+#define WEIGHT_LOAD(i) weight[i]
+#define LOCAL_TYPE float
+#define LOCAL_LOAD(p, i) p[i]
+#define LOCAL_STORE(p, i, v) p[i] = (v)
+#define ACC_TYPE float
+#define IN_LOAD(i) in[i]
+#define OUT_STORE(i, v) out[i] = (v)
+#define KERNEL_PARAM __global float *in, __global float *out,
+__attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, WORK_GROUP_DIM_1, WORK_GROUP_DIM_2)))
+__kernel void KERNEL_NAME(
+    KERNEL_PARAM
+    __constant WEIGHT_TYPE *weight,
+    __constant float *offset
+    ) {
+
+    // Output map o sums the input maps connectionInput[connectionBegin[o]..connectionBegin[o + 1]),
+    // the weight holds the kernels of these pairs one after another.
+    const int connectionBegin[ODEPTH + 1] = CONNECTION_BEGIN;
+    const int connectionInput[CONNECTIONS] = CONNECTION_INPUT;
+
+    int cTile = get_global_id(0) * OWIDTH_TILE;
+    int rTile = get_global_id(1) * OHEIGHT_TILE;
+    int oTile = get_global_id(2) * ODEPTH_TILE;
+
+    int cLocal = get_local_id(0);
+    int rLocal = get_local_id(1);
+    int oLocal = get_local_id(2);
+
+    __local LOCAL_TYPE inLocal[IN_SIZE];
+    __local LOCAL_TYPE weightLocal[CONNECTIONS * KERNEL_LEN];
+    __local float offsetLocal[ODEPTH];
+
+    // This the the first work item in the group,
+    // Copy the input, output and weight into the local buffer.
+    if (cLocal == 0 && rLocal == 0 && oLocal == 0) {
+
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int i = 0; i < IN_SIZE; ++i) {
+            LOCAL_STORE(inLocal, i, IN_LOAD(i));
+        }
+
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int i = 0; i < CONNECTIONS * KERNEL_LEN; ++i) {
+            LOCAL_STORE(weightLocal, i, WEIGHT_LOAD(i));
+        }
+
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int i = 0; i < ODEPTH; ++i) {
+            offsetLocal[i] = offset[i];
+        }
+    }
+
+    // Set a barrier.
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Only the connected pairs are multiplied.
+    for (int r = 0; r < OHEIGHT_TILE; ++r) {
+        for (int c = 0; c < OWIDTH_TILE; ++c) {
+            for (int o = 0; o < ODEPTH_TILE; ++o) {
+                ACC_TYPE outPrivate = 0;
+                for (int p = connectionBegin[o + oTile]; p < connectionBegin[o + oTile + 1]; ++p) {
+                    int i = connectionInput[p];
+                    int weightIdx = 0;
+                    for (int x = 0; x < KERNEL_SIZE; ++x) {
+                        for (int y = 0; y < KERNEL_SIZE; ++y, ++weightIdx) {
+                            outPrivate += (ACC_TYPE)LOCAL_LOAD(inLocal, (i * IHEIGHT + r + rTile + x) * IWIDTH + c + cTile + y)
+                                * (ACC_TYPE)LOCAL_LOAD(weightLocal, p * KERNEL_LEN + weightIdx);
+                        }
+                    }
+                }
+                OUT_STORE(((o + oTile) * OHEIGHT + r + rTile) * OWIDTH + c + cTile, ACTIVATE(outPrivate + offsetLocal[o + oTile]));
+            }
+        }
+    }
+}
+
+#undef KERNEL_SIZE
+#undef KERNEL_LEN
+#undef IWIDTH
+#undef IHEIGHT
+#undef IDEPTH
+#undef IN_SIZE
+#undef OWIDTH
+#undef OHEIGHT
+#undef ODEPTH
+#undef OWIDTH_TILE
+#undef OHEIGHT_TILE
+#undef ODEPTH_TILE
+#undef IDEPTH_TILE
+#undef OUT_SIZE
+#undef WORK_GROUP_DIM_0
+#undef WORK_GROUP_DIM_1
+#undef WORK_GROUP_DIM_2
+#undef KERNEL_NAME
+#undef KERNEL_PARAM
+#undef ACTIVATE
+#undef WEIGHT_TYPE
+#undef WEIGHT_LOAD
+#undef LOCAL_TYPE
+#undef LOCAL_LOAD
+#undef LOCAL_STORE
+#undef ACC_TYPE
+#undef IN_LOAD
+#undef OUT_STORE
+#undef CONNECTIONS
+#undef CONNECTION_BEGIN
+#undef CONNECTION_INPUT
@@ -0,0 +1,167 @@
+float sigmod(float in) {
+    return 1.0f / (1.0f + exp(-in)); 
+}
+#define KERNEL_SIZE 5
+#define KERNEL_LEN 25
+#define IWIDTH 14
+#define IHEIGHT 14
+#define IDEPTH 6
+#define IN_SIZE 1176
+#define OWIDTH 10
+#define OHEIGHT 10
+#define ODEPTH 16
+#define OWIDTH_TILE 5
+#define OHEIGHT_TILE 5
+#define ODEPTH_TILE 4
+#define IDEPTH_TILE 1
+#define OUT_SIZE 1600
+#define WORK_GROUP_DIM_0 5
+#define WORK_GROUP_DIM_1 5
+#define WORK_GROUP_DIM_2 4
+#define KERNEL_NAME conv3
+#define ACTIVATE sigmod
+#define WINOGRAD_M 2
+#define WINOGRAD_N 6
+#define WINOGRAD_TILES_W 5
+#define WINOGRAD_TILES_H 5
+#define WINOGRAD_AT {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 2.0f, -2.0f, 1.0f}
+#define WINOGRAD_BT {1.0f, 0.0f, -1.25f, 0.0f, 0.25f, 0.0f, 0.0f, 0.666666687f, 0.666666687f, -0.166666672f, -0.166666672f, 0.0f, 0.0f, -0.666666687f, 0.666666687f, 0.166666672f, -0.166666672f, 0.0f, 0.0f, -0.0833333358f, -0.0416666679f, 0.0833333358f, 0.0416666679f, 0.0f, 0.0f, 0.0833333358f, -0.0416666679f, -0.0833333358f, 0.0416666679f, 0.0f, 0.0f, 4.0f, 0.0f, -5.0f, 0.0f, 1.0f}
+#define WEIGHT_TYPE float
+#define WEIGHT_LOAD(i) weight[i]
+#define LOCAL_TYPE float
+#define LOCAL_LOAD(p, i) p[i]
+#define LOCAL_STORE(p, i, v) p[i] = (v)
+#define ACC_TYPE float
+#define IN_LOAD(i) in[i]
+#define OUT_STORE(i, v) out[i] = (v)
+#define KERNEL_PARAM __global float *in, __global float *out,
+__attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, WORK_GROUP_DIM_1, WORK_GROUP_DIM_2)))
+__kernel void KERNEL_NAME(
+    KERNEL_PARAM
+    __constant float *weight,
+    __constant float *offset
+    ) {
+
+    // Winograd F(WINOGRAD_M x WINOGRAD_M, KERNEL_SIZE x KERNEL_SIZE).
+    // One work item computes one output tile of one output feature map,
+    // the weight is already transformed into WINOGRAD_N x WINOGRAD_N per (o, i) pair.
+    int cTile = get_global_id(0);
+    int rTile = get_global_id(1);
+    int o = get_global_id(2);
+
+    // The ND-Range is rounded up to the work group size.
+    if (cTile >= WINOGRAD_TILES_W || rTile >= WINOGRAD_TILES_H || o >= ODEPTH) {
+        return;
+    }
+
+    const float BT[WINOGRAD_N * WINOGRAD_N] = WINOGRAD_BT;
+    const float AT[WINOGRAD_M * WINOGRAD_N] = WINOGRAD_AT;
+
+    int r0 = rTile * WINOGRAD_M;
+    int c0 = cTile * WINOGRAD_M;
+
+    // Accumulate U .* (BT d B) over the input feature maps.
+    float acc[WINOGRAD_N * WINOGRAD_N];
+    for (int k = 0; k < WINOGRAD_N * WINOGRAD_N; ++k) {
+        acc[k] = 0.0f;
+    }
+
+    for (int i = 0; i < IDEPTH; ++i) {
+
+        // Load the input tile, zero past the border.
+        float d[WINOGRAD_N * WINOGRAD_N];
+        for (int a = 0; a < WINOGRAD_N; ++a) {
+            for (int b = 0; b < WINOGRAD_N; ++b) {
+                int r = r0 + a;
+                int c = c0 + b;
+                d[a * WINOGRAD_N + b] = (r < IHEIGHT && c < IWIDTH) ? IN_LOAD((i * IHEIGHT + r) * IWIDTH + c) : 0.0f;
+            }
+        }
+
+        // tmp = BT d.
+        float tmp[WINOGRAD_N * WINOGRAD_N];
+        for (int a = 0; a < WINOGRAD_N; ++a) {
+            for (int b = 0; b < WINOGRAD_N; ++b) {
+                float sum = 0.0f;
+                for (int k = 0; k < WINOGRAD_N; ++k) {
+                    sum += BT[a * WINOGRAD_N + k] * d[k * WINOGRAD_N + b];
+                }
+                tmp[a * WINOGRAD_N + b] = sum;
+            }
+        }
+
+        // V = tmp B, multiplied by the transformed weight.
+        __constant float *u = weight + (o * IDEPTH + i) * WINOGRAD_N * WINOGRAD_N;
+        for (int a = 0; a < WINOGRAD_N; ++a) {
+            for (int b = 0; b < WINOGRAD_N; ++b) {
+                float sum = 0.0f;
+                for (int k = 0; k < WINOGRAD_N; ++k) {
+                    sum += tmp[a * WINOGRAD_N + k] * BT[b * WINOGRAD_N + k];
+                }
+                acc[a * WINOGRAD_N + b] += u[a * WINOGRAD_N + b] * sum;
+            }
+        }
+    }
+
+    // tmp = AT acc.
+    float tmp[WINOGRAD_M * WINOGRAD_N];
+    for (int a = 0; a < WINOGRAD_M; ++a) {
+        for (int b = 0; b < WINOGRAD_N; ++b) {
+            float sum = 0.0f;
+            for (int k = 0; k < WINOGRAD_N; ++k) {
+                sum += AT[a * WINOGRAD_N + k] * acc[k * WINOGRAD_N + b];
+            }
+            tmp[a * WINOGRAD_N + b] = sum;
+        }
+    }
+
+    // Y = tmp A, only the part of the tile inside the output feature map.
+    for (int a = 0; a < WINOGRAD_M; ++a) {
+        for (int b = 0; b < WINOGRAD_M; ++b) {
+            int r = r0 + a;
+            int c = c0 + b;
+            if (r < OHEIGHT && c < OWIDTH) {
+                float sum = 0.0f;
+                for (int k = 0; k < WINOGRAD_N; ++k) {
+                    sum += tmp[a * WINOGRAD_N + k] * AT[b * WINOGRAD_N + k];
+                }
+                OUT_STORE((o * OHEIGHT + r) * OWIDTH + c, ACTIVATE(sum + offset[o]));
+            }
+        }
+    }
+}
+
+#undef KERNEL_SIZE
+#undef KERNEL_LEN
+#undef IWIDTH
+#undef IHEIGHT
+#undef IDEPTH
+#undef IN_SIZE
+#undef OWIDTH
+#undef OHEIGHT
+#undef ODEPTH
+#undef OWIDTH_TILE
+#undef OHEIGHT_TILE
+#undef ODEPTH_TILE
+#undef IDEPTH_TILE
+#undef OUT_SIZE
+#undef WORK_GROUP_DIM_0
+#undef WORK_GROUP_DIM_1
+#undef WORK_GROUP_DIM_2
+#undef KERNEL_NAME
+#undef KERNEL_PARAM
+#undef ACTIVATE
+#undef WEIGHT_TYPE
+#undef WEIGHT_LOAD
+#undef LOCAL_TYPE
+#undef LOCAL_LOAD
+#undef LOCAL_STORE
+#undef ACC_TYPE
+#undef IN_LOAD
+#undef OUT_STORE
+#undef WINOGRAD_M
+#undef WINOGRAD_N
+#undef WINOGRAD_TILES_W
+#undef WINOGRAD_TILES_H
+#undef WINOGRAD_AT
+#undef WINOGRAD_BT
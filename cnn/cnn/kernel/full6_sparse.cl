@@ -0,0 +1,101 @@
+float sigmod(float in) {
+    return 1.0f / (1.0f + exp(-in)); 
+}
+#define KERNEL_SIZE 10
+#define KERNEL_LEN 100
+#define IWIDTH 1
+#define IHEIGHT 1
+#define IDEPTH 120
+#define IN_SIZE 120
+#define OWIDTH 84
+#define OHEIGHT 1
+#define ODEPTH 1
+#define OWIDTH_TILE 1
+#define OHEIGHT_TILE 1
+#define ODEPTH_TILE 1
+#define IDEPTH_TILE 1
+#define OUT_SIZE 84
+#define WORK_GROUP_DIM_0 12
+#define WORK_GROUP_DIM_1 1
+#define WORK_GROUP_DIM_2 1
+#define KERNEL_NAME full6
+#define ACTIVATE sigmod
+#define WEIGHT_TYPE float
+#define WEIGHT_LOAD(i) weight[i]
+#define LOCAL_TYPE float
+#define LOCAL_LOAD(p, i) p[i]
+#define LOCAL_STORE(p, i, v) p[i] = (v)
+#define ACC_TYPE float
+#define IN_LOAD(i) in[i]
+#define OUT_STORE(i, v) out[i] = (v)
+#define KERNEL_PARAM __global float *in, __global float *out,
+__attribute__((reqd_work_group_size(WORK_GROUP_DIM_0, 1, 1)))
+__kernel void KERNEL_NAME(
+    KERNEL_PARAM
+    __global WEIGHT_TYPE *weight,
+    __constant float *offset,
+    __global int *column,
+    __global int *rowBegin
+    ) {
+
+    int o = get_global_id(0);
+    int oLocal = get_local_id(0);
+
+    // Only the input is shared, every work item streams the nonzeros of its own row.
+    __local LOCAL_TYPE inLocal[IN_SIZE];
+
+    if (oLocal == 0) {
+
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int i = 0; i < IN_SIZE; ++i) {
+            LOCAL_STORE(inLocal, i, IN_LOAD(i));
+        }
+    }
+
+    // Set a barrier.
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (o < OUT_SIZE) {
+
+        ACC_TYPE sum = 0;
+        int end = rowBegin[o + 1];
+        #ifdef __xilinx__
+        __attribute__((xcl_pipeline_loop))
+        #endif
+        for (int p = rowBegin[o]; p < end; ++p) {
+            sum += (ACC_TYPE)WEIGHT_LOAD(p) * (ACC_TYPE)LOCAL_LOAD(inLocal, column[p]);
+        }
+        OUT_STORE(o, ACTIVATE(sum + offset[o]));
+    }
+}
+
+#undef KERNEL_SIZE
+#undef KERNEL_LEN
+#undef IWIDTH
+#undef IHEIGHT
+#undef IDEPTH
+#undef IN_SIZE
+#undef OWIDTH
+#undef OHEIGHT
+#undef ODEPTH
+#undef OWIDTH_TILE
+#undef OHEIGHT_TILE
+#undef ODEPTH_TILE
+#undef IDEPTH_TILE
+#undef OUT_SIZE
+#undef WORK_GROUP_DIM_0
+#undef WORK_GROUP_DIM_1
+#undef WORK_GROUP_DIM_2
+#undef KERNEL_NAME
+#undef KERNEL_PARAM
+#undef ACTIVATE
+#undef WEIGHT_TYPE
+#undef WEIGHT_LOAD
+#undef LOCAL_TYPE
+#undef LOCAL_LOAD
+#undef LOCAL_STORE
+#undef ACC_TYPE
+#undef IN_LOAD
+#undef OUT_STORE
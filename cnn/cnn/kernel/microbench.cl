@@ -0,0 +1,44 @@
+// Kernels of the device microbenchmarks, see microbench.hpp.
+
+// Nothing: the launch overhead.
+__kernel void microbench_empty(__global float *out) {
+}
+
+// One float4 read and one written per work item: the global memory bandwidth.
+__kernel void microbench_copy(__global const float4 *in, __global float4 *out) {
+    size_t i = get_global_id(0);
+    out[i] = in[i];
+}
+
+// Independent float4 read and written per work item between two barriers, as LOCAL_ACCESSES of microbench.hpp.
+#define LOCAL_ACCESSES 8
+
+// reps rounds of LOCAL_ACCESSES reads and writes of the local memory per work item: the local memory bandwidth.
+// Every item reads the slots its neighbour wrote, so the loop can't stay in registers.
+// The slots are double buffered: round r reads buffer r & 1 and writes buffer (r + 1) & 1,
+// so one barrier per round orders both the writes before the next reads and the reads before the next writes.
+__kernel void microbench_local(__global float4 *out, __local float4 *scratch, uint reps) {
+    size_t lid = get_local_id(0);
+    size_t size = get_local_size(0);
+    size_t stride = LOCAL_ACCESSES * size;
+    for (uint a = 0; a < LOCAL_ACCESSES; ++a) {
+        scratch[a * size + lid] = (float4)((float)(lid + a));
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    float4 sum = (float4)(0.0f);
+    for (uint r = 0; r < reps; ++r) {
+        __local const float4 *from = scratch + (r & 1) * stride;
+        __local float4 *to = scratch + ((r + 1) & 1) * stride;
+        size_t neighbour = (lid + r + 1) % size;
+        float4 v[LOCAL_ACCESSES];
+        for (uint a = 0; a < LOCAL_ACCESSES; ++a) {
+            v[a] = from[a * size + neighbour];
+        }
+        for (uint a = 0; a < LOCAL_ACCESSES; ++a) {
+            sum += v[a];
+            to[a * size + lid] = v[a] + (float4)(1.0f);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    out[get_global_id(0)] = sum;
+}
@@ -2,6 +2,12 @@
 #define LAYER_HEADER
 
 #include "util.hpp"
+#include "simd.hpp"
+#include "threadpool.hpp"
+#include "specialized.hpp"
+#include "precision.hpp"
+#include "connection.hpp"
+#include "sparse.hpp"
 #include <cmath>
 
 namespace cnn {
@@ -13,11 +19,54 @@ namespace cnn {
         RBF
     };
 
+    // Algorithm used by the convolutional layer on CPU.
+    enum ConvAlgorithm {
+        DIRECT,
+        IM2COL,
+        WINOGRAD,
+        FFT,
+        // Let the layer's cost model pick one of the above.
+        AUTO
+    };
+
+    ConvAlgorithm parseConvAlgorithm(const std::string &name) {
+        if (name == "direct") {
+            return DIRECT;
+        }
+        else if (name == "im2col") {
+            return IM2COL;
+        }
+        else if (name == "winograd") {
+            return WINOGRAD;
+        }
+        else if (name == "fft") {
+            return FFT;
+        }
+        else if (name == "auto") {
+            return AUTO;
+        }
+        else {
+            std::cerr << "parseConvAlgorithm: Unsupported algorithm: " << name << std::endl;
+            exit(-1);
+        }
+    }
+
 #define INNER (0)
 #define FRONT (1)
 #define BACK  (1 << 1)
     typedef size_t Flag;
 
+    // INT8 parameters of a layer, see precision.hpp.
+    struct Quantization {
+        Quantization() : inScale(0.0f) {
+        }
+        // 0 until calibrated.
+        float inScale;
+        // One per output map.
+        std::vector<float> weightScale;
+        std::vector<quant::int8> weight;
+    };
+
     struct LayerParam {
         LayerType type;
         std::string kernelName;
@@ -33,15 +82,49 @@ namespace cnn {
         size_t oHeightTile;
         size_t oDepthTile;
         size_t iDepthTile;
+        ConvAlgorithm algorithm;
+        // Output tile m of Winograd F(m x m, r x r).
+        size_t winogradTile;
+        Activation activation;
+        // Precision of the device kernel, also the initial one of the CPU path.
+        Precision precision;
+        // Quantized weights stored in the model, if any.
+        Quantization quantization;
+        // Input maps summed by every output map of a conv layer, empty for all of them.
+        connection::Table connection;
+        // Weight layout of the device kernel, CSR for the sparse full kernel.
+        WeightFormat weightFormat;
+        // Classes the RBF kernel ranks on the device, 0 without a classification head.
+        size_t topK;
         Flag flag;
     };
 
+    // Shape and layout of the weight of a layer with n weights.
+    void getWeightShape(const LayerParam &params, size_t n, Shape &shape, Layout &layout) {
+        size_t inSize = params.iWidth * params.iHeight * params.iDepth;
+        size_t outSize = params.oWidth * params.oHeight * params.oDepth;
+        if (params.type == CONV && n == params.oDepth * params.iDepth * params.kernelSize * params.kernelSize) {
+            shape = Shape(params.oDepth, params.iDepth, params.kernelSize, params.kernelSize);
+            layout = OIHW;
+        }
+        else if ((params.type == FULL || params.type == RBF) && n == outSize * inSize) {
+            shape = Shape(outSize, inSize);
+            layout = OI;
+        }
+        else {
+            shape = Shape(n);
+            layout = FLAT;
+        }
+    }
+
     class Layer {
     public:
 
+        // The weight, offset and output are placed in arena.
         Layer(const LayerParam &params,
             const vec &weight,
             const vec &offset,
+            Arena &arena,
             const cl_context &context,
             const cl_program &program,
             const cl_mem &clIn
@@ -51,29 +134,192 @@ namespace cnn {
             oWidth(params.oWidth),
             oHeight(params.oHeight),
             oDepth(params.oDepth),
+            offset(Shape(offset.size()), FLAT, offset, &arena),
             flag(params.flag),
-            weight(weight),
-            offset(offset) {
+            activation(params.activation),
+            precision(FP32),
+            devicePrecision(params.precision),
+            quantizable(params.type == CONV || params.type == FULL),
+            inScale(0.0f),
+            clScale(NULL) {
+
+            Shape weightShape;
+            Layout weightLayout;
+            getWeightShape(params, weight.size(), weightShape, weightLayout);
+            Tensor weightTensor(weightShape, weightLayout, weight, &arena);
+            this->weight.swap(weightTensor);
 
-            out.resize(oWidth * oHeight * oDepth);
+            if (flag & BACK) {
+                Tensor outTensor(Shape(oDepth, oHeight, oWidth), CHW, &arena);
+                out.swap(outTensor);
+            }
+
+            // Subclasses look up their specialized path.
+            specializedForward = NULL;
+            useSpecialized = true;
 
             workGroupSize[0] = params.workGroupSize[0];
             workGroupSize[1] = params.workGroupSize[1];
             workGroupSize[2] = params.workGroupSize[2];
 
             initOpenCL(context, program, clIn, params.kernelName);
+
+            this->context = context;
+
+            // Convert the weight for an FP16 kernel.
+            if (devicePrecision == FP16) {
+                halfDeviceWeight.resize(weight.size());
+                fp16::fromFloat(weight.data(), weight.size(), &halfDeviceWeight[0]);
+                setDeviceWeight(context, &halfDeviceWeight[0], halfDeviceWeight.size() * sizeof(fp16::half));
+                setPrecision(FP16);
+            }
+
+            // Only the layers doing the multiplies are quantized.
+            if (quantizable) {
+                if (params.quantization.inScale > 0.0f) {
+                    setQuantization(params.quantization);
+                }
+                else if (params.precision == INT8) {
+                    // Not calibrated yet: assume inputs in [-1, 1] like the sigmoid outputs.
+                    setQuantization(1.0f / quant::QMAX);
+                }
+                if (params.precision == INT8) {
+                    setPrecision(INT8);
+                }
+            }
+            else if (params.precision == INT8) {
+                std::cerr << "Layer: Only conv and full layers can be INT8: " << params.kernelName << std::endl;
+                exit(-1);
+            }
         }
 
         virtual ~Layer() {
             if (flag & BACK) {
                 clReleaseMemObject(clOut);
             }
+            if (clScale) {
+                clReleaseMemObject(clScale);
+                clReleaseMemObject(clScale);
+            }
             clReleaseKernel(kernel);
             clReleaseMemObject(clWeight);
             clReleaseMemObject(clOffset);
         }
-        
-        virtual unsigned long long forwardCPU(const vec &in) = 0;
+
+        // Forward one input with CPU.
+        // ws must provide getSharedScratchSize() floats of shared scratch and
+        // getLocalScratchSize() floats of local scratch for every worker of ws.pool.
+        virtual void computeCPU(const float *in, float *out, const Workspace &ws) = 0;
+
+        // Scratch shared by all workers for one forward.
+        virtual size_t getSharedScratchSize() const {
+            return 0;
+        }
+
+        // Scratch private to each worker for one forward.
+        virtual size_t getLocalScratchSize() const {
+            return 0;
+        }
+
+        // Activation of the CPU path, the device kernel keeps the one it was generated with.
+        void setActivation(Activation activation) {
+            this->activation = activation;
+        }
+
+        Activation getActivation() const {
+            return activation;
+        }
+
+        // Precision of the CPU path, the device kernel keeps the one it was generated with.
+        // INT8 needs the layer to be quantized first.
+        // FP16 swaps in the weight rounded to half, the outputs are rounded by the caller.
+        void setPrecision(Precision precision) {
+            if (precision == INT8 && !isQuantized()) {
+                std::cerr << "Layer: INT8 needs calibration or quantized weights" << std::endl;
+                exit(-1);
+            }
+            if ((this->precision == FP16) != (precision == FP16)) {
+                if (halfWeight.empty()) {
+                    Tensor rounded(weight);
+                    fp16::round(rounded.data(), rounded.size());
+                    halfWeight.swap(rounded);
+                }
+                weight.swap(halfWeight);
+            }
+            this->precision = precision;
+        }
+
+        Precision getPrecision() const {
+            return precision;
+        }
+
+        // Precision the device kernel was generated with.
+        Precision getDevicePrecision() const {
+            return devicePrecision;
+        }
+
+        bool isQuantizable() const {
+            return quantizable;
+        }
+
+        bool isQuantized() const {
+            return inScale > 0.0f;
+        }
+
+        // Quantize the weights with one scale per output map and use inScale for the input.
+        void setQuantization(float inScale) {
+            // The fp32 weight is swapped out while the CPU runs in FP16.
+            const Tensor &master = precision == FP16 ? halfWeight : weight;
+            Quantization q;
+            size_t rows = master.getShape().dims[0];
+            size_t cols = master.size() / rows;
+            q.inScale = inScale;
+            q.weightScale.resize(rows);
+            q.weight.resize(master.size());
+            quant::quantizeRows(master.data(), rows, cols, &q.weight[0], &q.weightScale[0]);
+            setQuantization(q);
+        }
+
+        // Use weights quantized offline, the device buffers follow if the kernel is INT8.
+        void setQuantization(const Quantization &q) {
+            size_t rows = weight.getShape().dims[0];
+            if (q.inScale <= 0.0f || q.weightScale.size() != rows || q.weight.size() != weight.size()) {
+                std::cerr << "Layer: Wrong quantization for weight of " << weight.size() << std::endl;
+                exit(-1);
+            }
+            inScale = q.inScale;
+            weightScale = q.weightScale;
+            qweight.assign(q.weight.begin(), q.weight.end());
+            if (devicePrecision == INT8) {
+                uploadQuantization();
+            }
+        }
+
+        Quantization getQuantization() const {
+            Quantization q;
+            q.inScale = inScale;
+            q.weightScale = weightScale;
+            q.weight.assign(qweight.begin(), qweight.end());
+            return q;
+        }
+
+        // Use the compile time specialized CPU path if there is one for this shape.
+        void setSpecialized(bool enable) {
+            useSpecialized = enable;
+        }
+
+        // Whether computeCPU runs the specialized path.
+        virtual bool isSpecialized() const {
+            return precision == FP32 && useSpecialized && specializedForward != NULL;
+        }
+
+        size_t getInSize() const {
+            return iWidth * iHeight * iDepth;
+        }
+
+        size_t getOutSize() const {
+            return oWidth * oHeight * oDepth;
+        }
 
         // Forward with OpenCL.
         virtual unsigned long long forwardCL(cl_command_queue &queue) {
@@ -116,21 +362,26 @@ namespace cnn {
         size_t oHeight;
         size_t oDepth;
 
-        // For CPU.
-        vec out;
+        // Host memory of the network output, only in the last layer.
+        // Activations of the other layers live in the CNN's execution plan.
+        Tensor out;
 
         // For OpenCL.
         cl_kernel kernel;
         cl_mem clOut;
 
         // Buffer.
-        vec weight;
-        vec offset;
+        Tensor weight;
+        Tensor offset;
 
         // For OpenCL.
         cl_mem clWeight;
         cl_mem clOffset;
 
+        // Specialized CPU path for this shape, NULL if there is none.
+        specialized::Forward specializedForward;
+        bool useSpecialized;
+
         // For ND-Range.
         size_t workGroupSize[3];
         size_t global[3];
@@ -138,9 +389,108 @@ namespace cnn {
         // Whether this is the first layer or the last layer.
         const Flag flag;
 
-        // Sigmod function.
-        float sigmod(float i) {
-            return 1.0f / (1.0f + expf(-i));
+        // Applied to the outputs.
+        Activation activation;
+
+        // Index of clWeight in the kernel arguments.
+        unsigned int weightArg;
+
+        // Precision of computeCPU and of the device kernel.
+        Precision precision;
+        const Precision devicePrecision;
+        const bool quantizable;
+
+        // INT8: scale of the input, one scale per output map and the weights quantized with them.
+        float inScale;
+        std::vector<float> weightScale;
+        std::vector<quant::int8, AlignedAllocator<quant::int8> > qweight;
+
+        // INT8 kernel argument after clOffset: [1 / inScale, inScale * weightScale[o]...].
+        Tensor deviceScale;
+        cl_mem clScale;
+        cl_context context;
+
+        // FP16: the weight converted for the device, and the one of the CPU path
+        // rounded to half, swapped with weight while the CPU runs in FP16.
+        std::vector<fp16::half, AlignedAllocator<fp16::half> > halfDeviceWeight;
+        Tensor halfWeight;
+
+        // Point the kernel at another weight, e.g. one transformed for the device kernel.
+        void setDeviceWeight(const cl_context &context, Tensor &deviceWeight) {
+            setDeviceWeight(context, deviceWeight.data(), deviceWeight.bytes());
+        }
+
+        void setDeviceWeight(const cl_context &context, void *deviceWeight, size_t bytes) {
+            cl_int err;
+
+            // Created and retained in initOpenCL.
+            clReleaseMemObject(clWeight);
+            clReleaseMemObject(clWeight);
+
+            clWeight = clCreateBuffer(
+                context,
+                CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                bytes,
+                deviceWeight,
+                &err);
+            handleError(err, "Failed creating clWeight. ");
+            err = clRetainMemObject(clWeight);
+            handleError(err, "Failed retaining clWeight. ");
+
+            err = clSetKernelArg(kernel, weightArg, sizeof(cl_mem), &clWeight);
+            handleError(err, "Failed setting kernel arg: clWeight. ");
+        }
+
+        // Floats of shared scratch holding the quantized input.
+        size_t getQuantizedInSize() const {
+            return (getInSize() * sizeof(quant::int8) + sizeof(float) - 1) / sizeof(float);
+        }
+
+        // Quantize the input into the shared scratch, split across chunks of the input.
+        const quant::int8 *quantizeInput(const float *in, const Workspace &ws) {
+            const size_t CHUNK = 256;
+            size_t inSize = getInSize();
+            quant::int8 *q = (quant::int8 *)ws.shared;
+            parallelFor(ws, 0, (inSize + CHUNK - 1) / CHUNK, 1, [&](size_t begin, size_t end, size_t /*worker*/) {
+                size_t first = begin * CHUNK;
+                size_t last = std::min(inSize, end * CHUNK);
+                quant::quantize(in + first, last - first, inScale, q + first);
+            });
+            return q;
+        }
+
+        // Give the INT8 kernel the quantized weights and the scales.
+        // The buffers are created again since they use the host memory directly.
+        void uploadQuantization() {
+            cl_int err;
+
+            setDeviceWeight(context, &qweight[0], qweight.size() * sizeof(quant::int8));
+
+            if (deviceScale.empty()) {
+                Tensor scaleTensor(Shape(weightScale.size() + 1));
+                deviceScale.swap(scaleTensor);
+            }
+            deviceScale[0] = 1.0f / inScale;
+            for (size_t o = 0; o < weightScale.size(); ++o) {
+                deviceScale[o + 1] = inScale * weightScale[o];
+            }
+
+            if (clScale) {
+                clReleaseMemObject(clScale);
+                clReleaseMemObject(clScale);
+            }
+            clScale = clCreateBuffer(
+                context,
+                CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                deviceScale.bytes(),
+                deviceScale.data(),
+                &err);
+            handleError(err, "Failed creating clScale. ");
+            err = clRetainMemObject(clScale);
+            handleError(err, "Failed retaining clScale. ");
+
+            err = clSetKernelArg(kernel, weightArg + 2, sizeof(cl_mem), &clScale);
+            handleError(err, "Failed setting kernel arg: clScale. ");
         }
 
         void initOpenCL(const cl_context &context,
@@ -149,12 +499,14 @@ namespace cnn {
             const std::string &kernelName
             ) {
             cl_int err;
+
+            // The buffers use the page aligned host tensors directly.
             if (flag & BACK) {
                 clOut = clCreateBuffer(
                     context,
-                    CL_MEM_WRITE_ONLY,
-                    oDepth * oHeight * oWidth * sizeof(cl_float),
-                    NULL,
+                    CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR,
+                    out.bytes(),
+                    out.data(),
                     &err);
                 handleError(err, "Failed creating clOut");
                 err = clRetainMemObject(clOut);
@@ -163,9 +515,9 @@ namespace cnn {
 
             clWeight = clCreateBuffer(
                 context,
-                CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                weight.size() * sizeof(cl_float),
-                const_cast<void *>(static_cast<const void *>(&weight[0])),
+                CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                weight.bytes(),
+                weight.data(),
                 &err);
             handleError(err, "Failed creating clWeight. ");
             err = clRetainMemObject(clWeight);
@@ -173,9 +525,9 @@ namespace cnn {
 
             clOffset = clCreateBuffer(
                 context,
-                CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                offset.size() * sizeof(cl_float),
-                const_cast<void *>(static_cast<const void *>(&offset[0])),
+                CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                offset.bytes(),
+                offset.data(),
                 &err);
             handleError(err, "Failed creating clOffset");
             err = clRetainMemObject(clOffset);
@@ -198,6 +550,7 @@ namespace cnn {
                 handleError(err, "Failed setting kernel arg: clOut. ");
             }
 
+            weightArg = i;
             err = clSetKernelArg(kernel, i++, sizeof(cl_mem), &clWeight);
             handleError(err, "Failed setting kernel arg: clWeight. ");
 
@@ -0,0 +1,407 @@
+#ifndef LOADGEN_HEADER
+#define LOADGEN_HEADER
+
+#include <thread>
+
+#include "bench.hpp"
+
+/******************************************************************************************
+
+    Open loop load generator.
+
+        cnn --loadgen --model <xml> [--arrival poisson|bursty|trace] [--qps x]
+            [--requests n] [--burst n] [--arrival-trace file] [--mode single|batch|pipeline|cpu]
+            [--batch n] [--in-flight n] [--warmup n] [--seed n] [--device n]
+            [--xclbin file] [--threads n] [--json file]
+
+    The arrivals are drawn before the run, so they don't wait for the engine
+    the way the closed loop tests do:
+        poisson     exponential gaps of mean 1 / --qps
+        bursty      --burst requests at once, the bursts poisson at --qps / --burst
+        trace       the seconds of --arrival-trace, one arrival per line, scaled
+                    to --qps if given, as recorded otherwise
+    One server takes every request arrived so far, at most --batch of them
+    (1 in the single mode), and forwards them in the --mode; --in-flight
+    sets the queue barrier of the batch mode. The batches of the device
+    modes complete input by input: the END of the last command of every
+    input on the device clock, counted back from when the host saw the
+    batch done.
+
+    Every request gets, in seconds:
+        queueing    from its arrival to the dispatch of its batch
+        service     from the dispatch to its completion
+        latency     from its arrival to its completion, the sum
+    so a server too slow for the rate shows as a growing queueing delay, not
+    as a lower rate. The report has their mean and percentiles, the offered
+    and the achieved rate and the mean batch.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace loadgen {
+
+        enum Arrival {
+            ARRIVAL_POISSON,
+            ARRIVAL_BURSTY,
+            ARRIVAL_TRACE
+        };
+
+        const size_t NUM_ARRIVALS = 3;
+
+        inline const char *getArrivalName(Arrival arrival) {
+            static const char *NAMES[NUM_ARRIVALS] = { "poisson", "bursty", "trace" };
+            return NAMES[arrival];
+        }
+
+        inline Arrival parseArrival(const std::string &name) {
+            for (size_t i = 0; i < NUM_ARRIVALS; ++i) {
+                if (name == getArrivalName((Arrival)i)) {
+                    return (Arrival)i;
+                }
+            }
+            std::cerr << "parseArrival: Unsupported arrival: " << name << std::endl;
+            exit(-1);
+        }
+
+        // Seconds since the start of n arrivals at qps on average.
+        inline std::vector<double> getPoissonArrivals(size_t n, double qps, unsigned int seed) {
+            std::mt19937 generator(seed);
+            std::exponential_distribution<double> gap(qps);
+            std::vector<double> arrivals;
+            arrivals.reserve(n);
+            double t = 0.0;
+            for (size_t i = 0; i < n; ++i) {
+                t += gap(generator);
+                arrivals.push_back(t);
+            }
+            return arrivals;
+        }
+
+        inline std::vector<double> getBurstyArrivals(size_t n, double qps, size_t burst, unsigned int seed) {
+            burst = std::max<size_t>(burst, 1);
+            std::vector<double> bursts = getPoissonArrivals((n + burst - 1) / burst, qps / (double)burst, seed);
+            std::vector<double> arrivals;
+            arrivals.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                arrivals.push_back(bursts[i / burst]);
+            }
+            return arrivals;
+        }
+
+        // The arrivals of a trace, one time in seconds per line, '#' for comments.
+        inline std::vector<double> readTrace(const std::string &file) {
+            std::ifstream in(file.c_str());
+            if (!in.is_open()) {
+                std::cerr << "Can't open file " << file << std::endl;
+                exit(-1);
+            }
+            std::vector<double> arrivals;
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+                arrivals.push_back(std::atof(line.c_str()));
+            }
+            if (arrivals.empty()) {
+                std::cerr << "loadgen: No arrivals in " << file << std::endl;
+                exit(-1);
+            }
+            std::sort(arrivals.begin(), arrivals.end());
+            return arrivals;
+        }
+
+        // The arrivals from the first one on, stretched to qps on average if qps > 0.
+        inline std::vector<double> scaleArrivals(const std::vector<double> &arrivals, double qps) {
+            std::vector<double> scaled(arrivals.size());
+            double span = arrivals.back() - arrivals.front();
+            double scale = qps > 0.0 && span > 0.0 ? (double)(arrivals.size() - 1) / qps / span : 1.0;
+            for (size_t i = 0; i < arrivals.size(); ++i) {
+                scaled[i] = (arrivals[i] - arrivals.front()) * scale;
+            }
+            return scaled;
+        }
+
+        // Seconds since the start.
+        struct Request {
+            double arrival;
+            double dispatch;
+            double complete;
+            size_t batch;
+        };
+
+        // Wait on the wall clock until start + t, sleeping the most of it.
+        inline void waitUntil(double start, double t) {
+            double left = start + t - wallTime();
+            if (left > 200e-6) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(left - 100e-6));
+            }
+            while (wallTime() < start + t) {
+            }
+        }
+
+        // Serve the arrivals, sorted, in batches of at most maxBatch of the requests arrived.
+        // serve(first, count, completes) forwards the requests [first, first + count) and
+        // sets the wall time every one of them completed.
+        template <typename F>
+        std::vector<Request> drive(const std::vector<double> &arrivals, size_t maxBatch, F serve) {
+            std::vector<Request> requests(arrivals.size());
+            std::vector<double> completes(std::max<size_t>(maxBatch, 1));
+            double start = wallTime();
+            size_t next = 0;
+            while (next < arrivals.size()) {
+                waitUntil(start, arrivals[next]);
+                double now = wallTime() - start;
+                size_t count = 0;
+                while (next + count < arrivals.size() && count < maxBatch && arrivals[next + count] <= now) {
+                    count++;
+                }
+                serve(next, count, &completes[0]);
+                for (size_t i = 0; i < count; ++i) {
+                    Request &request = requests[next + i];
+                    request.arrival = arrivals[next + i];
+                    request.dispatch = now;
+                    request.complete = completes[i] - start;
+                    request.batch = count;
+                }
+                next += count;
+            }
+            return requests;
+        }
+
+        struct Distribution {
+            double mean;
+            double p50;
+            double p90;
+            double p99;
+            double p999;
+            double max;
+        };
+
+        inline Distribution getDistribution(std::vector<double> samples) {
+            std::sort(samples.begin(), samples.end());
+            Distribution d = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+            if (samples.empty()) {
+                return d;
+            }
+            for (size_t i = 0; i < samples.size(); ++i) {
+                d.mean += samples[i];
+            }
+            d.mean /= (double)samples.size();
+            d.p50 = stats::percentile(samples, 0.50);
+            d.p90 = stats::percentile(samples, 0.90);
+            d.p99 = stats::percentile(samples, 0.99);
+            d.p999 = stats::percentile(samples, 0.999);
+            d.max = samples.back();
+            return d;
+        }
+
+        struct Report {
+            size_t n;
+            // From the first arrival to the last completion.
+            double duration;
+            double offered;
+            double achieved;
+            double meanBatch;
+            Distribution queueing;
+            Distribution service;
+            Distribution latency;
+        };
+
+        inline Report analyze(const std::vector<Request> &requests) {
+            Report report;
+            report.n = requests.size();
+            std::vector<double> queueing;
+            std::vector<double> service;
+            std::vector<double> latency;
+            double first = requests.empty() ? 0.0 : requests.front().arrival;
+            double lastArrival = first;
+            double lastComplete = first;
+            double batches = 0.0;
+            for (size_t i = 0; i < requests.size(); ++i) {
+                const Request &r = requests[i];
+                queueing.push_back(r.dispatch - r.arrival);
+                service.push_back(r.complete - r.dispatch);
+                latency.push_back(r.complete - r.arrival);
+                lastArrival = std::max(lastArrival, r.arrival);
+                lastComplete = std::max(lastComplete, r.complete);
+                batches += 1.0 / (double)r.batch;
+            }
+            report.duration = lastComplete - first;
+            report.offered = lastArrival > first ? (double)(report.n - 1) / (lastArrival - first) : 0.0;
+            report.achieved = report.duration > 0.0 ? (double)report.n / report.duration : 0.0;
+            report.meanBatch = batches > 0.0 ? (double)report.n / batches : 0.0;
+            report.queueing = getDistribution(queueing);
+            report.service = getDistribution(service);
+            report.latency = getDistribution(latency);
+            return report;
+        }
+
+        inline void writeDistribution(std::ostream &o, const char *name, const Distribution &d) {
+            o << "  " << std::left << std::setw(12) << name << std::right << std::setw(12) << d.mean * 1e3
+                << std::setw(12) << d.p50 * 1e3 << std::setw(12) << d.p90 * 1e3 << std::setw(12) << d.p99 * 1e3
+                << std::setw(12) << d.p999 * 1e3 << std::setw(12) << d.max * 1e3 << std::endl;
+        }
+
+        inline void writeSummary(std::ostream &o, const Report &report) {
+            o << std::fixed << std::setprecision(3);
+            o << report.n << " requests in " << report.duration << " s: offered " << report.offered << " qps, achieved "
+                << report.achieved << " qps, mean batch " << report.meanBatch << std::endl;
+            o << "  " << std::left << std::setw(12) << "ms" << std::right << std::setw(12) << "mean" << std::setw(12) << "p50"
+                << std::setw(12) << "p90" << std::setw(12) << "p99" << std::setw(12) << "p99.9" << std::setw(12) << "max" << std::endl;
+            writeDistribution(o, "queueing", report.queueing);
+            writeDistribution(o, "service", report.service);
+            writeDistribution(o, "latency", report.latency);
+            o.unsetf(std::ios::floatfield);
+        }
+
+        inline void writeJSONDistribution(std::ostream &o, const char *name, const Distribution &d) {
+            o << "  \"" << name << "\": {\"mean\": " << d.mean << ", \"p50\": " << d.p50 << ", \"p90\": " << d.p90
+                << ", \"p99\": " << d.p99 << ", \"p999\": " << d.p999 << ", \"max\": " << d.max << "}";
+        }
+
+        inline void writeJSON(std::ostream &o, const bench::Options &options, const std::string &device, const Report &report) {
+            o << std::setprecision(9);
+            o << "{" << std::endl;
+            o << "  \"model\": " << jsonString(options.model) << "," << std::endl;
+            o << "  \"device\": " << jsonString(device) << "," << std::endl;
+            o << "  \"mode\": " << jsonString(getBenchModeName(options.mode)) << "," << std::endl;
+            o << "  \"arrival\": " << jsonString(options.arrival) << "," << std::endl;
+            o << "  \"qps\": " << options.qps << "," << std::endl;
+            o << "  \"maxBatch\": " << (options.mode == BENCH_SINGLE ? 1 : options.batch) << "," << std::endl;
+            o << "  \"inFlight\": " << options.inFlight << "," << std::endl;
+            o << "  \"seed\": " << options.seed << "," << std::endl;
+            o << "  \"unit\": \"s\"," << std::endl;
+            o << "  \"requests\": " << report.n << "," << std::endl;
+            o << "  \"duration\": " << report.duration << "," << std::endl;
+            o << "  \"offered\": " << report.offered << "," << std::endl;
+            o << "  \"achieved\": " << report.achieved << "," << std::endl;
+            o << "  \"meanBatch\": " << report.meanBatch << "," << std::endl;
+            writeJSONDistribution(o, "queueing", report.queueing);
+            o << "," << std::endl;
+            writeJSONDistribution(o, "service", report.service);
+            o << "," << std::endl;
+            writeJSONDistribution(o, "latency", report.latency);
+            o << std::endl;
+            o << "}" << std::endl;
+        }
+
+        // The requests forwarded by a CNN in a mode of the benchmark.
+        class Server {
+        public:
+            Server(CNN &cnn, BenchMode mode, const vec &in, vec &out)
+                : cnn(cnn), mode(mode),
+                inSpan(&in[0], in.size() / cnn.getInSize(), cnn.getInSize()),
+                outSpan(&out[0], out.size() / cnn.getOutSize(), cnn.getOutSize()) {
+            }
+
+            void operator()(size_t first, size_t count, double *completes) {
+                InSpan in = inSpan.slice(first, first + count);
+                OutSpan out = outSpan.slice(first, first + count);
+                std::vector<cl_event> events;
+                double averageTime;
+                switch (mode) {
+                case BENCH_SINGLE:
+                    for (size_t i = 0; i < count; ++i) {
+                        cnn.forwardCL(in[i], out[i]);
+                        completes[i] = wallTime();
+                    }
+                    return;
+                case BENCH_CPU:
+                    cnn.forwardCPUBatch(in, out, &averageTime);
+                    std::fill(completes, completes + count, wallTime());
+                    return;
+                case BENCH_PIPELINE:
+                    events = cnn.forwardCLPipeline(in, out, &averageTime);
+                    break;
+                default:
+                    events = cnn.forwardCLBatch(in, out, &averageTime);
+                    break;
+                }
+                clWaitForEvents((cl_uint)events.size(), &events[0]);
+                double done = wallTime();
+
+                // Count every input back from the last END.
+                size_t eventSize = events.size() / count;
+                cl_ulong last = 0;
+                std::vector<cl_ulong> ends(count);
+                for (size_t i = 0; i < count; ++i) {
+                    cl_int err = clGetEventProfilingInfo(events[(i + 1) * eventSize - 1], CL_PROFILING_COMMAND_END,
+                        sizeof(cl_ulong), &ends[i], NULL);
+                    handleError(err, "Failed profiling the load. ");
+                    last = std::max(last, ends[i]);
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    completes[i] = done - (double)(last - ends[i]) * 1e-9;
+                }
+                bench::releaseEvents(events);
+            }
+
+        private:
+            CNN &cnn;
+            BenchMode mode;
+            InSpan inSpan;
+            OutSpan outSpan;
+        };
+
+        inline std::vector<double> getArrivals(const bench::Options &options) {
+            switch (parseArrival(options.arrival)) {
+            case ARRIVAL_POISSON:
+                return getPoissonArrivals(options.requests, options.qps, options.seed);
+            case ARRIVAL_BURSTY:
+                return getBurstyArrivals(options.requests, options.qps, options.burst, options.seed);
+            default:
+                if (options.arrivalTrace.empty()) {
+                    std::cerr << "loadgen: The trace arrival needs --arrival-trace" << std::endl;
+                    exit(-1);
+                }
+                return scaleArrivals(readTrace(options.arrivalTrace), options.isQPS ? options.qps : 0.0);
+            }
+        }
+
+        inline int mainLoadgen(const bench::Options &options) {
+            if (options.mode == BENCH_STREAM) {
+                std::cerr << "loadgen: Needs the single, batch, pipeline or cpu mode" << std::endl;
+                exit(-1);
+            }
+            std::vector<double> arrivals = getArrivals(options);
+
+            CNN cnn(options.model, options.mode != BENCH_PIPELINE, options.xclbin, options.device);
+            if (options.inFlight > 0) {
+                cnn.setQueueBarrier(options.inFlight);
+            }
+            cnn.setThreads(options.threads);
+            // Printing after every batch would add to the service time.
+            cnn.setQuiet(true);
+            vec in;
+            bench::fillInputs(in, arrivals.size(), cnn.getInSize(), options.seed);
+            vec out(arrivals.size() * cnn.getOutSize());
+            Server server(cnn, options.mode, in, out);
+
+            // Warm up on the first inputs, the load starts on an idle engine.
+            std::vector<double> completes(options.batch);
+            for (size_t r = 0; r < options.warmup; ++r) {
+                server(0, std::min(options.batch, arrivals.size()), &completes[0]);
+            }
+
+            // The single mode forwards one request at a time, the rest wait in the queue.
+            size_t maxBatch = options.mode == BENCH_SINGLE ? 1 : options.batch;
+            Report report = analyze(drive(arrivals, maxBatch, server));
+            std::string device = getDeviceName(cnn.device);
+            std::cout << options.model << " " << getBenchModeName(options.mode) << " on " << device << ", "
+                << options.arrival << " arrivals" << std::endl;
+            writeSummary(std::cout, report);
+            if (!options.json.empty()) {
+                std::ofstream o(options.json.c_str());
+                if (!o.is_open()) {
+                    std::cerr << "Can't open file " << options.json << std::endl;
+                    exit(-1);
+                }
+                writeJSON(o, options, device, report);
+            }
+            return 0;
+        }
+    }
+}
+
+#endif
@@ -1,16 +1,63 @@
 #include "convolution.hpp"
 #include "test.hpp"
+#include "variants.hpp"
+#include "wallclock.hpp"
+#include "regress.hpp"
+#include "microbench.hpp"
+#include "loadgen.hpp"
 #include <iostream>
 
 #define TEST_BATCH_SIZE 100
 
 int main(int argc, char *argv[]) {
 
+    // Flags run the benchmark driver instead of the tests.
+    if (argc > 1 && std::string(argv[1]).compare(0, 2, "--") == 0) {
+        bench::Options options = bench::parseOptions(argc, argv);
+        if (options.isConv1Variants) {
+            return bench::mainVariants(options);
+        }
+        if (options.isProfileReport) {
+            return wallclock::mainProfileReport(options);
+        }
+        if (options.isRegress) {
+            return regress::mainRegress(options);
+        }
+        if (options.isMicrobench) {
+            return microbench::mainMicrobench(options);
+        }
+        if (options.isLoadgen) {
+            return loadgen::mainLoadgen(options);
+        }
+        return bench::main(options);
+    }
+
     // Test our event pool.
     test::runEventPoolTest();
 
+    // Test the SIMD kernels.
+    test::runSIMDTest();
+
+    // Test the thread pool.
+    test::runThreadPoolTest();
+
+    // Test the timeline analysis.
+    test::runAnalysisTest();
+
+    // Test the SDAccel summary reader.
+    test::runSDAccelTest("sdaccel_profile_summary.csv");
+
+    // Test the regression gate.
+    test::runRegressTest("kernel/result_lenet5.xml", "kernel/result_lenet5_final.xml");
+
+    // Test the device profile.
+    test::runDeviceProfileTest();
+
+    // Test the load generator.
+    test::runLoadgenTest();
+
     if (argc != 3 && argc != 4) {
-        std::cout << "Usage: cnn <xml> <result> [xclbin]" << std::endl;
+        bench::printUsage(std::cout);
         exit(-1);
     }
 
@@ -41,13 +88,31 @@ int main(int argc, char *argv[]) {
     writeXMLOpenTag(o, "results");
 
     cnn::vec inBatch(cnn->getInSize() * TEST_BATCH_SIZE);
-    for (int i = 0; i < in.size(); ++i) {
-        in[i] = (float)rand() / (float)RAND_MAX - 0.5f;
+    for (int i = 0; i < inBatch.size(); ++i) {
+        inBatch[i] = (float)rand() / (float)RAND_MAX - 0.5f;
     }
 
     test::runFuncTest(cnn, in);
+    test::runConvAlgorithmTest(cnn, in);
+    test::runWinogradTest(o, cnn, in);
+    test::runFFTTest(o, cnn, in);
+    test::runConnectionTest(o, cnn, in);
+    test::runActivationTest(o, cnn, in);
+    test::runQuantizationTest(o, cnn, in, TEST_BATCH_SIZE, testFile + ".int8.xml");
+    test::runHalfTest(o, cnn, in);
+    test::runSparseTest(o, cnn, in, testFile + ".pruned.xml");
+    test::runHeadTest(o, cnn, TEST_BATCH_SIZE);
+    test::runIngestTest(o, cnn, TEST_BATCH_SIZE);
+    test::runSpecializedTest(cnn, in);
+    test::runTensorTest(cnn);
+    test::runPlanTest(cnn, inBatch, TEST_BATCH_SIZE);
+    test::runSpanTest(cnn, inBatch, TEST_BATCH_SIZE);
+    test::runSIMDForwardTest(cnn, in);
     test::runTimeTest(o, cnn, in);
     test::runTimeTestBatch(o, cnn, inBatch, TEST_BATCH_SIZE);
+    test::runTraceTest(cnn, inBatch, TEST_BATCH_SIZE, false, testFile + ".batch.trace.json");
+    test::runScalingTest(o, cnn, inBatch, TEST_BATCH_SIZE, std::thread::hardware_concurrency());
+    test::runSamplingTest(cnn, inBatch, TEST_BATCH_SIZE, false, testFile + ".batch.prof");
     delete cnn;
 
     // Do the same test for pipelined cnn;
@@ -62,6 +127,8 @@ int main(int argc, char *argv[]) {
 
     test::runFuncTest(cnnPipelined, in);
     test::runTimeTestPipeline(o, cnnPipelined, inBatch, TEST_BATCH_SIZE);
+    test::runTraceTest(cnnPipelined, inBatch, TEST_BATCH_SIZE, true, testFile + ".pipeline.trace.json");
+    test::runSamplingTest(cnnPipelined, inBatch, TEST_BATCH_SIZE, true, testFile + ".pipeline.prof");
 
     delete cnnPipelined;
 
@@ -10,10 +10,11 @@ namespace cnn {
         MaxPoolLayer(const LayerParam &params,
             const vec &weight,
             const vec &offset,
+            Arena &arena,
             const cl_context &context,
             const cl_program &program,
             const cl_mem &clIn
-            ) : Layer(params, weight, offset, context, program, clIn),
+            ) : Layer(params, weight, offset, arena, context, program, clIn),
             poolSize(params.kernelSize) {
 
             assert(params.iDepth == params.oDepth);
@@ -28,35 +29,39 @@ namespace cnn {
             global[0] = closestMultiple(workGroupSize[0], oWidth);
             global[1] = closestMultiple(workGroupSize[1], oHeight);
             global[2] = closestMultiple(workGroupSize[2], oDepth);
+
+            specializedForward = specialized::findPool(poolSize, iWidth, iHeight, iDepth);
         }
 
         virtual ~MaxPoolLayer() {
         }
 
-        virtual unsigned long long forwardCPU(const vec &in) {
-
-            clock_t start = clock(), diff;
-
-            // For each output feature map.
-            for (size_t o = 0; o < oDepth; ++o) {
-                // For each element in the output feature map.
-                for (size_t r = 0; r < oHeight; ++r) {
-                    for (size_t c = 0; c < oWidth; ++c) {
-                        float sum = 0.0f;
-                        for (size_t x = 0; x < poolSize; ++x) {
-                            for (size_t y = 0; y < poolSize; ++y) {
-                                sum += in[(o * iHeight + r * poolSize + x) * iWidth + c * poolSize + y];
+        // Forward with CPU, split across output feature maps.
+        virtual void computeCPU(const float *in, float *out, const Workspace &ws) {
+            if (isSpecialized()) {
+                specializedForward(in, weight.data(), offset.data(), out, activation, ws);
+                return;
+            }
+            parallelFor(ws, 0, oDepth, 1, [&](size_t begin, size_t end, size_t /*worker*/) {
+                // For each output feature map.
+                for (size_t o = begin; o < end; ++o) {
+                    // For each element in the output feature map.
+                    for (size_t r = 0; r < oHeight; ++r) {
+                        for (size_t c = 0; c < oWidth; ++c) {
+                            float sum = 0.0f;
+                            for (size_t x = 0; x < poolSize; ++x) {
+                                for (size_t y = 0; y < poolSize; ++y) {
+                                    sum += in[(o * iHeight + r * poolSize + x) * iWidth + c * poolSize + y];
+                                }
                             }
+                            out[(o * oHeight + r) * oWidth + c] = sum;
                         }
-                        out[(o * oHeight + r) * oWidth + c] = sigmod(sum * weight[o] + offset[o]);
                     }
-                }
-            }
 
-            diff = clock() - start;
-            int msec = diff * 1000 / CLOCKS_PER_SEC;
-
-            return (unsigned long long)msec;
+                    // Activate function.
+                    simd::activate(activation, out + o * oHeight * oWidth, oHeight * oWidth, weight[o], offset[o]);
+                }
+            });
         }
 
     private:
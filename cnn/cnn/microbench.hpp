@@ -0,0 +1,596 @@
+#ifndef MICROBENCH_HEADER
+#define MICROBENCH_HEADER
+
+#include "bench.hpp"
+
+/******************************************************************************************
+
+    Device microbenchmarks and the device profile.
+
+        cnn --microbench [--device n] [--kernel-dir kernel] [--xclbin file]
+            [--warmup n] [--reps n] [--confidence c] [--json file]
+
+    What printDeviceInfo can't tell, measured on the device:
+        transfers       blocking clEnqueueWrite/ReadBuffer of 4 KB up to 64 MB
+                        on the host clock, from pageable memory (the heap) and
+                        from pinned memory (a mapped CL_MEM_ALLOC_HOST_PTR
+                        buffer); every direction and memory is fitted to
+                        time = latency + bytes / bandwidth by least squares of
+                        the relative error
+        enqueue         the host time of clEnqueueNDRangeKernel of an empty
+                        kernel
+        queued->start   its QUEUED to START on the device clock
+        round trip      its enqueue to clWaitForEvents returning
+        wait complete   clWaitForEvents on an event already complete
+        wait wakeup     the round trip beyond END - QUEUED: how late the host
+                        learns that the device is done
+        global          a float4 copy kernel, the bytes read and written over
+                        END - START
+        local           every work item reading the __local slots of its
+                        neighbour and writing its own, LOCAL_ACCESSES of
+                        each per barrier, the bytes over END - START
+
+    The kernels are kernel/microbench.cl, built from source, or the --xclbin
+    built from it for SDAccel. --json stores the device profile, the input of
+    the tiling and placement decisions: readDeviceProfile loads it and
+    predictTransfer prices a transfer from its fit.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace microbench {
+
+        enum Direction {
+            HOST_TO_DEVICE,
+            DEVICE_TO_HOST
+        };
+
+        const size_t NUM_DIRECTIONS = 2;
+
+        inline const char *getDirectionName(Direction direction) {
+            static const char *NAMES[NUM_DIRECTIONS] = { "h2d", "d2h" };
+            return NAMES[direction];
+        }
+
+        enum HostMemory {
+            HOST_PAGEABLE,
+            HOST_PINNED
+        };
+
+        const size_t NUM_HOST_MEMORIES = 2;
+
+        inline const char *getHostMemoryName(HostMemory memory) {
+            static const char *NAMES[NUM_HOST_MEMORIES] = { "pageable", "pinned" };
+            return NAMES[memory];
+        }
+
+        // Seconds of the transfers of one size.
+        struct Transfer {
+            Direction direction;
+            HostMemory memory;
+            size_t bytes;
+            stats::Summary time;
+        };
+
+        // time = latency + bytes / bandwidth, seconds and bytes per second.
+        struct TransferModel {
+            double latency;
+            double bandwidth;
+        };
+
+        // Seconds, but the bandwidths in bytes per second.
+        struct DeviceProfile {
+            std::string device;
+            std::vector<Transfer> transfers;
+            TransferModel models[NUM_DIRECTIONS][NUM_HOST_MEMORIES];
+            stats::Summary enqueue;
+            stats::Summary queuedToStart;
+            stats::Summary roundTrip;
+            stats::Summary waitComplete;
+            stats::Summary waitWakeup;
+            // END - START of the kernels and the bytes they move.
+            stats::Summary globalTime;
+            size_t globalBytes;
+            stats::Summary localTime;
+            size_t localBytes;
+            size_t localWorkGroup;
+            double globalBandwidth;
+            double localBandwidth;
+        };
+
+        inline double getBandwidth(size_t bytes, const stats::Summary &time) {
+            return time.mean > 0.0 ? (double)bytes / time.mean : 0.0;
+        }
+
+        // Fit the transfers of a direction and memory, a bandwidth of 0 without two sizes.
+        inline TransferModel fitTransfers(const std::vector<Transfer> &transfers, Direction direction, HostMemory memory) {
+            // Weighted by 1 / time^2, so the small transfers set the latency and the large ones the bandwidth.
+            double sw = 0.0;
+            double sx = 0.0;
+            double sy = 0.0;
+            double sxx = 0.0;
+            double sxy = 0.0;
+            size_t n = 0;
+            for (size_t t = 0; t < transfers.size(); ++t) {
+                const Transfer &transfer = transfers[t];
+                if (transfer.direction != direction || transfer.memory != memory || transfer.time.mean <= 0.0) {
+                    continue;
+                }
+                double x = (double)transfer.bytes;
+                double y = transfer.time.mean;
+                double w = 1.0 / (y * y);
+                sw += w;
+                sx += w * x;
+                sy += w * y;
+                sxx += w * x * x;
+                sxy += w * x * y;
+                n++;
+            }
+            TransferModel model = { 0.0, 0.0 };
+            double det = sw * sxx - sx * sx;
+            if (n < 2 || det <= 0.0) {
+                return model;
+            }
+            double slope = (sw * sxy - sx * sy) / det;
+            double intercept = (sy - slope * sx) / sw;
+            model.latency = std::max(0.0, intercept);
+            model.bandwidth = slope > 0.0 ? 1.0 / slope : 0.0;
+            return model;
+        }
+
+        // Seconds of a transfer of bytes from the fit, 0 if the profile has none.
+        inline double predictTransfer(const DeviceProfile &profile, Direction direction, HostMemory memory, size_t bytes) {
+            const TransferModel &model = profile.models[direction][memory];
+            return model.bandwidth > 0.0 ? model.latency + (double)bytes / model.bandwidth : 0.0;
+        }
+
+        // The context, the profiled in order queue and the kernels of one device.
+        struct Device {
+            cl_platform_id platform;
+            cl_device_id device;
+            cl_context context;
+            cl_command_queue queue;
+            cl_program program;
+            cl_kernel empty;
+            cl_kernel copy;
+            cl_kernel local;
+
+            Device(const bench::Options &options) {
+                std::vector<std::pair<cl_platform_id, cl_device_id> > devices = getDevices();
+                if (options.device >= devices.size()) {
+                    std::cerr << "microbench: No OpenCL device " << options.device << ", found " << devices.size() << std::endl;
+                    exit(-1);
+                }
+                platform = devices[options.device].first;
+                device = devices[options.device].second;
+
+                cl_int err;
+                cl_context_properties properties[] = {
+                    CL_CONTEXT_PLATFORM, (cl_context_properties)platform, 0
+                };
+                context = clCreateContext(properties, 1, &device, NULL, NULL, &err);
+                handleError(err, "Failed creating context. ");
+                queue = clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, &err);
+                handleError(err, "Failed creating command queue. ");
+
+                program = options.xclbin != "NONE" ?
+                    buildProgramFromBinary(options.xclbin, context, device) :
+                    buildProgramFromSource(options.kernelDir + "/microbench.cl", context, device);
+                empty = clCreateKernel(program, "microbench_empty", &err);
+                handleError(err, "Failed creating kernel microbench_empty. ");
+                copy = clCreateKernel(program, "microbench_copy", &err);
+                handleError(err, "Failed creating kernel microbench_copy. ");
+                local = clCreateKernel(program, "microbench_local", &err);
+                handleError(err, "Failed creating kernel microbench_local. ");
+            }
+
+            ~Device() {
+                clReleaseKernel(empty);
+                clReleaseKernel(copy);
+                clReleaseKernel(local);
+                clReleaseProgram(program);
+                clReleaseCommandQueue(queue);
+                clReleaseContext(context);
+            }
+
+            cl_ulong getInfo(cl_device_info info) const {
+                cl_ulong value = 0;
+                clGetDeviceInfo(device, info, sizeof(value), &value, NULL);
+                return value;
+            }
+
+            cl_mem createBuffer(cl_mem_flags flags, size_t bytes) const {
+                cl_int err;
+                cl_mem buffer = clCreateBuffer(context, flags, bytes, NULL, &err);
+                handleError(err, "Failed creating buffer. ");
+                return buffer;
+            }
+        };
+
+        // Seconds from QUEUED or START to END of a complete event, released.
+        inline double getEventTime(cl_event event, cl_profiling_info from) {
+            cl_ulong begin;
+            cl_ulong end;
+            cl_int err = clGetEventProfilingInfo(event, from, sizeof(cl_ulong), &begin, NULL);
+            err |= clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+            handleError(err, "Failed profiling the microbenchmark. ");
+            clReleaseEvent(event);
+            return (double)(end - begin) * 1e-9;
+        }
+
+        inline void measureTransfers(const Device &d, const bench::Options &options, DeviceProfile &profile) {
+            size_t maxBytes = (size_t)std::min<cl_ulong>(64 << 20, d.getInfo(CL_DEVICE_MAX_MEM_ALLOC_SIZE));
+            cl_int err;
+            for (size_t bytes = 4 << 10; bytes <= maxBytes; bytes *= 4) {
+                cl_mem buffer = d.createBuffer(CL_MEM_READ_WRITE, bytes);
+                std::vector<char> pageable(bytes, 1);
+                cl_mem pinnedBuffer = d.createBuffer(CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, bytes);
+                void *pinned = clEnqueueMapBuffer(d.queue, pinnedBuffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, bytes, 0, NULL, NULL, &err);
+                handleError(err, "Failed mapping the pinned buffer. ");
+
+                for (size_t direction = 0; direction < NUM_DIRECTIONS; ++direction) {
+                    for (size_t memory = 0; memory < NUM_HOST_MEMORIES; ++memory) {
+                        void *host = memory == HOST_PINNED ? pinned : (void *)&pageable[0];
+                        std::vector<double> samples;
+                        for (size_t r = 0; r < options.warmup + options.reps; ++r) {
+                            double start = wallTime();
+                            err = direction == HOST_TO_DEVICE ?
+                                clEnqueueWriteBuffer(d.queue, buffer, CL_TRUE, 0, bytes, host, 0, NULL, NULL) :
+                                clEnqueueReadBuffer(d.queue, buffer, CL_TRUE, 0, bytes, host, 0, NULL, NULL);
+                            double seconds = wallTime() - start;
+                            handleError(err, "Failed transferring the buffer. ");
+                            if (r >= options.warmup) {
+                                samples.push_back(seconds);
+                            }
+                        }
+                        Transfer transfer = { (Direction)direction, (HostMemory)memory, bytes, stats::summarize(samples, options.confidence) };
+                        profile.transfers.push_back(transfer);
+                    }
+                }
+
+                err = clEnqueueUnmapMemObject(d.queue, pinnedBuffer, pinned, 0, NULL, NULL);
+                handleError(err, "Failed unmapping the pinned buffer. ");
+                clFinish(d.queue);
+                clReleaseMemObject(pinnedBuffer);
+                clReleaseMemObject(buffer);
+            }
+            for (size_t direction = 0; direction < NUM_DIRECTIONS; ++direction) {
+                for (size_t memory = 0; memory < NUM_HOST_MEMORIES; ++memory) {
+                    profile.models[direction][memory] = fitTransfers(profile.transfers, (Direction)direction, (HostMemory)memory);
+                }
+            }
+        }
+
+        inline void measureLaunch(const Device &d, const bench::Options &options, DeviceProfile &profile) {
+            cl_mem out = d.createBuffer(CL_MEM_WRITE_ONLY, sizeof(cl_float));
+            cl_int err = clSetKernelArg(d.empty, 0, sizeof(cl_mem), &out);
+            handleError(err, "Failed setting the kernel argument. ");
+            size_t global = 1;
+            std::vector<double> enqueue;
+            std::vector<double> queuedToStart;
+            std::vector<double> roundTrip;
+            std::vector<double> waitComplete;
+            std::vector<double> waitWakeup;
+            for (size_t r = 0; r < options.warmup + options.reps; ++r) {
+                cl_event event;
+                double start = wallTime();
+                err = clEnqueueNDRangeKernel(d.queue, d.empty, 1, NULL, &global, NULL, 0, NULL, &event);
+                double enqueued = wallTime();
+                handleError(err, "Failed enqueuing kernel. ");
+                clWaitForEvents(1, &event);
+                double done = wallTime();
+                clWaitForEvents(1, &event);
+                double waited = wallTime();
+
+                cl_ulong queued;
+                cl_ulong started;
+                cl_ulong end;
+                err = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &queued, NULL);
+                err |= clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &started, NULL);
+                err |= clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+                handleError(err, "Failed profiling the microbenchmark. ");
+                clReleaseEvent(event);
+                if (r < options.warmup) {
+                    continue;
+                }
+                enqueue.push_back(enqueued - start);
+                queuedToStart.push_back((double)(started - queued) * 1e-9);
+                roundTrip.push_back(done - start);
+                waitComplete.push_back(waited - done);
+                waitWakeup.push_back(std::max(0.0, (done - start) - (double)(end - queued) * 1e-9));
+            }
+            clReleaseMemObject(out);
+            profile.enqueue = stats::summarize(enqueue, options.confidence);
+            profile.queuedToStart = stats::summarize(queuedToStart, options.confidence);
+            profile.roundTrip = stats::summarize(roundTrip, options.confidence);
+            profile.waitComplete = stats::summarize(waitComplete, options.confidence);
+            profile.waitWakeup = stats::summarize(waitWakeup, options.confidence);
+        }
+
+        inline void measureGlobal(const Device &d, const bench::Options &options, DeviceProfile &profile) {
+            size_t bytes = (size_t)std::min<cl_ulong>(16 << 20, d.getInfo(CL_DEVICE_MAX_MEM_ALLOC_SIZE));
+            size_t global = bytes / sizeof(cl_float4);
+            profile.globalBytes = 2 * global * sizeof(cl_float4);
+            profile.globalTime = stats::summarize(std::vector<double>(), options.confidence);
+            if (global == 0) {
+                return;
+            }
+            cl_mem in = d.createBuffer(CL_MEM_READ_ONLY, global * sizeof(cl_float4));
+            cl_mem out = d.createBuffer(CL_MEM_WRITE_ONLY, global * sizeof(cl_float4));
+            cl_int err = clSetKernelArg(d.copy, 0, sizeof(cl_mem), &in);
+            err |= clSetKernelArg(d.copy, 1, sizeof(cl_mem), &out);
+            handleError(err, "Failed setting the kernel arguments. ");
+            std::vector<double> samples;
+            for (size_t r = 0; r < options.warmup + options.reps; ++r) {
+                cl_event event;
+                err = clEnqueueNDRangeKernel(d.queue, d.copy, 1, NULL, &global, NULL, 0, NULL, &event);
+                handleError(err, "Failed enqueuing kernel. ");
+                clWaitForEvents(1, &event);
+                double seconds = getEventTime(event, CL_PROFILING_COMMAND_START);
+                if (r >= options.warmup) {
+                    samples.push_back(seconds);
+                }
+            }
+            clReleaseMemObject(in);
+            clReleaseMemObject(out);
+            profile.globalTime = stats::summarize(samples, options.confidence);
+        }
+
+        // The float4 read and written per work item between two barriers of microbench_local, as in microbench.cl.
+        const size_t LOCAL_ACCESSES = 8;
+
+        inline void measureLocal(const Device &d, const bench::Options &options, DeviceProfile &profile) {
+            const cl_uint reps = 256;
+            size_t group = 256;
+            size_t kernelGroup = 0;
+            clGetKernelWorkGroupInfo(d.local, d.device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &kernelGroup, NULL);
+            size_t deviceGroup = 0;
+            clGetDeviceInfo(d.device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &deviceGroup, NULL);
+            group = std::min(group, std::min(kernelGroup, deviceGroup));
+            // Two buffers of LOCAL_ACCESSES slots per work item.
+            size_t slots = 2 * LOCAL_ACCESSES;
+            group = std::min<size_t>(group, (size_t)d.getInfo(CL_DEVICE_LOCAL_MEM_SIZE) / (slots * sizeof(cl_float4)));
+            size_t units = std::max<size_t>(1, (size_t)d.getInfo(CL_DEVICE_MAX_COMPUTE_UNITS));
+            size_t global = group * units * 4;
+            profile.localWorkGroup = group;
+            profile.localBytes = global * reps * 2 * LOCAL_ACCESSES * sizeof(cl_float4);
+            profile.localTime = stats::summarize(std::vector<double>(), options.confidence);
+            if (group == 0) {
+                return;
+            }
+            cl_mem out = d.createBuffer(CL_MEM_WRITE_ONLY, global * sizeof(cl_float4));
+            cl_int err = clSetKernelArg(d.local, 0, sizeof(cl_mem), &out);
+            err |= clSetKernelArg(d.local, 1, slots * group * sizeof(cl_float4), NULL);
+            err |= clSetKernelArg(d.local, 2, sizeof(cl_uint), &reps);
+            handleError(err, "Failed setting the kernel arguments. ");
+            std::vector<double> samples;
+            for (size_t r = 0; r < options.warmup + options.reps; ++r) {
+                cl_event event;
+                err = clEnqueueNDRangeKernel(d.queue, d.local, 1, NULL, &global, &group, 0, NULL, &event);
+                handleError(err, "Failed enqueuing kernel. ");
+                clWaitForEvents(1, &event);
+                double seconds = getEventTime(event, CL_PROFILING_COMMAND_START);
+                if (r >= options.warmup) {
+                    samples.push_back(seconds);
+                }
+            }
+            clReleaseMemObject(out);
+            profile.localTime = stats::summarize(samples, options.confidence);
+        }
+
+        inline DeviceProfile measure(const bench::Options &options) {
+            Device d(options);
+            DeviceProfile profile;
+            profile.device = getDeviceName(d.device);
+            measureTransfers(d, options, profile);
+            measureLaunch(d, options, profile);
+            measureGlobal(d, options, profile);
+            measureLocal(d, options, profile);
+            profile.globalBandwidth = getBandwidth(profile.globalBytes, profile.globalTime);
+            profile.localBandwidth = getBandwidth(profile.localBytes, profile.localTime);
+            return profile;
+        }
+
+        inline void writeSummary(std::ostream &o, const DeviceProfile &profile) {
+            o << std::fixed << std::setprecision(2);
+            o << "Device profile of " << profile.device << std::endl;
+            o << "  " << std::left << std::setw(10) << "transfer" << std::setw(10) << "memory" << std::right
+                << std::setw(12) << "bytes" << std::setw(12) << "mean us" << std::setw(12) << "GB/s" << std::endl;
+            for (size_t t = 0; t < profile.transfers.size(); ++t) {
+                const Transfer &transfer = profile.transfers[t];
+                o << "  " << std::left << std::setw(10) << getDirectionName(transfer.direction)
+                    << std::setw(10) << getHostMemoryName(transfer.memory) << std::right << std::setw(12) << transfer.bytes
+                    << std::setw(12) << transfer.time.mean * 1e6 << std::setw(12) << getBandwidth(transfer.bytes, transfer.time) * 1e-9 << std::endl;
+            }
+            for (size_t direction = 0; direction < NUM_DIRECTIONS; ++direction) {
+                for (size_t memory = 0; memory < NUM_HOST_MEMORIES; ++memory) {
+                    const TransferModel &model = profile.models[direction][memory];
+                    o << "  fit " << getDirectionName((Direction)direction) << " " << getHostMemoryName((HostMemory)memory)
+                        << ": " << model.latency * 1e6 << " us + bytes / " << model.bandwidth * 1e-9 << " GB/s" << std::endl;
+                }
+            }
+            o << "  enqueue " << profile.enqueue.mean * 1e6 << " us, queued->start " << profile.queuedToStart.mean * 1e6
+                << " us, round trip " << profile.roundTrip.mean * 1e6 << " us" << std::endl;
+            o << "  wait complete " << profile.waitComplete.mean * 1e6 << " us, wait wakeup " << profile.waitWakeup.mean * 1e6
+                << " us" << std::endl;
+            o << "  global " << profile.globalBandwidth * 1e-9 << " GB/s, local " << profile.localBandwidth * 1e-9
+                << " GB/s with work groups of " << profile.localWorkGroup << std::endl;
+            o.unsetf(std::ios::floatfield);
+        }
+
+        inline void writeJSON(std::ostream &o, const DeviceProfile &profile) {
+            o << std::setprecision(9);
+            o << "{" << std::endl;
+            o << "  \"device\": " << jsonString(profile.device) << "," << std::endl;
+            o << "  \"unit\": \"s\"," << std::endl;
+            bench::writeJSONSummary(o, "enqueue", profile.enqueue);
+            o << "," << std::endl;
+            bench::writeJSONSummary(o, "queuedToStart", profile.queuedToStart);
+            o << "," << std::endl;
+            bench::writeJSONSummary(o, "roundTrip", profile.roundTrip);
+            o << "," << std::endl;
+            bench::writeJSONSummary(o, "waitComplete", profile.waitComplete);
+            o << "," << std::endl;
+            bench::writeJSONSummary(o, "waitWakeup", profile.waitWakeup);
+            o << "," << std::endl;
+            bench::writeJSONSummary(o, "globalTime", profile.globalTime);
+            o << "," << std::endl;
+            bench::writeJSONSummary(o, "localTime", profile.localTime);
+            o << "," << std::endl;
+            o << "  \"globalBytes\": " << profile.globalBytes << "," << std::endl;
+            o << "  \"localBytes\": " << profile.localBytes << "," << std::endl;
+            o << "  \"localWorkGroup\": " << profile.localWorkGroup << "," << std::endl;
+            o << "  \"globalBandwidth\": " << profile.globalBandwidth << "," << std::endl;
+            o << "  \"localBandwidth\": " << profile.localBandwidth << "," << std::endl;
+            o << "  \"transferModels\": [" << std::endl;
+            for (size_t direction = 0; direction < NUM_DIRECTIONS; ++direction) {
+                for (size_t memory = 0; memory < NUM_HOST_MEMORIES; ++memory) {
+                    const TransferModel &model = profile.models[direction][memory];
+                    o << "    {\"direction\": \"" << getDirectionName((Direction)direction) << "\", \"memory\": \""
+                        << getHostMemoryName((HostMemory)memory) << "\", \"latency\": " << model.latency
+                        << ", \"bandwidth\": " << model.bandwidth << "}"
+                        << (direction + 1 < NUM_DIRECTIONS || memory + 1 < NUM_HOST_MEMORIES ? "," : "") << std::endl;
+                }
+            }
+            o << "  ]," << std::endl;
+            o << "  \"transfers\": [" << std::endl;
+            for (size_t t = 0; t < profile.transfers.size(); ++t) {
+                const Transfer &transfer = profile.transfers[t];
+                const stats::Summary &s = transfer.time;
+                o << "    {\"direction\": \"" << getDirectionName(transfer.direction) << "\", \"memory\": \""
+                    << getHostMemoryName(transfer.memory) << "\", \"bytes\": " << transfer.bytes
+                    << ", \"time\": {\"n\": " << s.n << ", \"mean\": " << s.mean << ", \"stddev\": " << s.stddev
+                    << ", \"min\": " << s.min << ", \"median\": " << s.median << ", \"max\": " << s.max
+                    << ", \"confidence\": " << s.confidence << ", \"ciLow\": " << s.ciLow << ", \"ciHigh\": " << s.ciHigh << "}}"
+                    << (t + 1 < profile.transfers.size() ? "," : "") << std::endl;
+            }
+            o << "  ]" << std::endl;
+            o << "}" << std::endl;
+        }
+
+        inline double getJSONNumber(const std::string &line, const std::string &key) {
+            std::string value;
+            return findJSONValue(line, key, &value) ? std::atof(value.c_str()) : 0.0;
+        }
+
+        // A summary written by bench::writeJSONSummary on the line.
+        inline stats::Summary readJSONSummary(const std::string &line) {
+            stats::Summary s;
+            s.n = (size_t)getJSONNumber(line, "n");
+            s.mean = getJSONNumber(line, "mean");
+            s.stddev = getJSONNumber(line, "stddev");
+            s.min = getJSONNumber(line, "min");
+            s.median = getJSONNumber(line, "median");
+            s.max = getJSONNumber(line, "max");
+            s.confidence = getJSONNumber(line, "confidence");
+            s.ciLow = getJSONNumber(line, "ciLow");
+            s.ciHigh = getJSONNumber(line, "ciHigh");
+            return s;
+        }
+
+        inline Direction parseDirection(const std::string &name) {
+            for (size_t i = 0; i < NUM_DIRECTIONS; ++i) {
+                if (name == getDirectionName((Direction)i)) {
+                    return (Direction)i;
+                }
+            }
+            std::cerr << "microbench: Unsupported direction: " << name << std::endl;
+            exit(-1);
+        }
+
+        inline HostMemory parseHostMemory(const std::string &name) {
+            for (size_t i = 0; i < NUM_HOST_MEMORIES; ++i) {
+                if (name == getHostMemoryName((HostMemory)i)) {
+                    return (HostMemory)i;
+                }
+            }
+            std::cerr << "microbench: Unsupported host memory: " << name << std::endl;
+            exit(-1);
+        }
+
+        // The profile written by writeJSON.
+        inline DeviceProfile readDeviceProfile(std::istream &in) {
+            DeviceProfile profile;
+            TransferModel none = { 0.0, 0.0 };
+            for (size_t direction = 0; direction < NUM_DIRECTIONS; ++direction) {
+                for (size_t memory = 0; memory < NUM_HOST_MEMORIES; ++memory) {
+                    profile.models[direction][memory] = none;
+                }
+            }
+            stats::Summary *summaries[7] = {
+                &profile.enqueue, &profile.queuedToStart, &profile.roundTrip, &profile.waitComplete,
+                &profile.waitWakeup, &profile.globalTime, &profile.localTime
+            };
+            const char *names[7] = {
+                "enqueue", "queuedToStart", "roundTrip", "waitComplete", "waitWakeup", "globalTime", "localTime"
+            };
+            std::string line;
+            std::string value;
+            while (std::getline(in, line)) {
+                std::string direction;
+                std::string memory;
+                if (findJSONValue(line, "direction", &direction) && findJSONValue(line, "memory", &memory)) {
+                    if (findJSONValue(line, "bytes", &value)) {
+                        Transfer transfer = { parseDirection(direction), parseHostMemory(memory),
+                            (size_t)std::atol(value.c_str()), readJSONSummary(line) };
+                        profile.transfers.push_back(transfer);
+                    }
+                    else {
+                        TransferModel model = { getJSONNumber(line, "latency"), getJSONNumber(line, "bandwidth") };
+                        profile.models[parseDirection(direction)][parseHostMemory(memory)] = model;
+                    }
+                    continue;
+                }
+                if (findJSONValue(line, "device", &value)) {
+                    profile.device = value;
+                }
+                for (size_t s = 0; s < 7; ++s) {
+                    if (line.find(jsonString(names[s]) + ": {") != std::string::npos) {
+                        *summaries[s] = readJSONSummary(line);
+                    }
+                }
+                if (findJSONValue(line, "globalBytes", &value)) {
+                    profile.globalBytes = (size_t)std::atol(value.c_str());
+                }
+                if (findJSONValue(line, "localBytes", &value)) {
+                    profile.localBytes = (size_t)std::atol(value.c_str());
+                }
+                if (findJSONValue(line, "localWorkGroup", &value)) {
+                    profile.localWorkGroup = (size_t)std::atol(value.c_str());
+                }
+                if (findJSONValue(line, "globalBandwidth", &value)) {
+                    profile.globalBandwidth = std::atof(value.c_str());
+                }
+                if (findJSONValue(line, "localBandwidth", &value)) {
+                    profile.localBandwidth = std::atof(value.c_str());
+                }
+            }
+            return profile;
+        }
+
+        inline DeviceProfile readDeviceProfile(const std::string &file) {
+            std::ifstream in(file.c_str());
+            if (!in.is_open()) {
+                std::cerr << "Can't open file " << file << std::endl;
+                exit(-1);
+            }
+            return readDeviceProfile(in);
+        }
+
+        inline int mainMicrobench(const bench::Options &options) {
+            DeviceProfile profile = measure(options);
+            writeSummary(std::cout, profile);
+            if (!options.json.empty()) {
+                std::ofstream o(options.json.c_str());
+                if (!o.is_open()) {
+                    std::cerr << "Can't open file " << options.json << std::endl;
+                    exit(-1);
+                }
+                writeJSON(o, profile);
+            }
+            return 0;
+        }
+    }
+}
+
+#endif
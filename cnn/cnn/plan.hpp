@@ -0,0 +1,176 @@
+#ifndef PLAN_HEADER
+#define PLAN_HEADER
+
+#include "layer.hpp"
+
+#include <vector>
+#include <algorithm>
+
+/******************************************************************************************
+
+    Static memory plan for the CPU forward.
+
+    One forward through the layers needs, at step l,
+        the output of layer l - 1  (the input of layer l),
+        the output of layer l,
+        the shared and per worker scratch of layer l.
+    Everything else is dead, so the plan gives every buffer a lifetime in
+    steps and packs all of them into one block: the largest buffers are
+    placed first at the lowest offset that does not overlap a buffer alive
+    at the same time. The input of the first layer and the output of the
+    last one belong to the caller and are not part of the plan.
+
+    The block is allocated once per worker from its arena. Planning only
+    happens again when the layers' scratch sizes or the worker count change,
+    so after the first forward the CPU path never touches the heap.
+
+*******************************************************************************************/
+
+namespace cnn {
+
+    class ExecutionPlan {
+    public:
+
+        ExecutionPlan() : size(0), numWorkers(0) {
+        }
+
+        // Plan a forward with every layer split across numWorkers.
+        void build(const std::vector<Layer *> &layers, size_t numWorkers) {
+
+            this->numWorkers = numWorkers;
+            steps.resize(layers.size());
+
+            // Collect every buffer with its lifetime.
+            std::vector<Buffer> buffers;
+            for (size_t l = 0; l < layers.size(); ++l) {
+                Step &step = steps[l];
+                step.outSize = l + 1 < layers.size() ? layers[l]->getOutSize() : 0;
+                step.sharedSize = layers[l]->getSharedScratchSize();
+                step.localSize = layers[l]->getLocalScratchSize();
+
+                // Keep every worker's scratch on its own cache lines.
+                step.localStride = roundUp(step.localSize);
+
+                step.outOffset = 0;
+                if (step.outSize != 0) {
+                    buffers.push_back(Buffer(&step.outOffset, step.outSize, l, l + 1));
+                }
+                buffers.push_back(Buffer(&step.sharedOffset, step.sharedSize, l, l));
+                buffers.push_back(Buffer(&step.localOffset, step.localStride * numWorkers, l, l));
+            }
+
+            // Largest first, each at the lowest offset free during its lifetime.
+            std::stable_sort(buffers.begin(), buffers.end(), Buffer::larger);
+            size = 0;
+            for (size_t i = 0; i < buffers.size(); ++i) {
+                Buffer &buffer = buffers[i];
+                size_t offset = 0;
+                bool moved = true;
+                while (moved) {
+                    moved = false;
+                    for (size_t j = 0; j < i; ++j) {
+                        const Buffer &other = buffers[j];
+                        if (buffer.isAliveWith(other) &&
+                            offset < other.offset + other.size &&
+                            other.offset < offset + buffer.size) {
+                            offset = roundUp(other.offset + other.size);
+                            moved = true;
+                        }
+                    }
+                }
+                buffer.offset = offset;
+                *buffer.target = offset;
+                size = std::max(size, offset + buffer.size);
+            }
+        }
+
+        // Whether the plan still fits the layers and the worker count.
+        bool matches(const std::vector<Layer *> &layers, size_t numWorkers) const {
+            if (numWorkers != this->numWorkers || layers.size() != steps.size()) {
+                return false;
+            }
+            for (size_t l = 0; l < layers.size(); ++l) {
+                if (layers[l]->getSharedScratchSize() != steps[l].sharedSize ||
+                    layers[l]->getLocalScratchSize() != steps[l].localSize) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Floats needed by one forward.
+        size_t getSize() const {
+            return size;
+        }
+
+        // Floats the same buffers would need without sharing any memory.
+        size_t getUnsharedSize() const {
+            size_t total = 0;
+            for (size_t l = 0; l < steps.size(); ++l) {
+                total += steps[l].outSize + steps[l].sharedSize + steps[l].localStride * numWorkers;
+            }
+            return total;
+        }
+
+        // Output of layer l, for every layer but the last.
+        float *getOut(size_t l, float *base) const {
+            return base + steps[l].outOffset;
+        }
+
+        // Scratch of layer l.
+        Workspace getWorkspace(size_t l, float *base, ThreadPool *pool) const {
+            Workspace ws;
+            ws.pool = pool;
+            ws.shared = base + steps[l].sharedOffset;
+            ws.local = base + steps[l].localOffset;
+            ws.localStride = steps[l].localStride;
+            return ws;
+        }
+
+    private:
+
+        // Offsets of the buffers used at one step.
+        struct Step {
+            size_t outOffset;
+            size_t outSize;
+            size_t sharedOffset;
+            size_t localOffset;
+            size_t sharedSize;
+            size_t localSize;
+            size_t localStride;
+        };
+
+        // A buffer to place, alive from step first to step last.
+        struct Buffer {
+            Buffer(size_t *target, size_t size, size_t first, size_t last)
+                : target(target), size(size), first(first), last(last), offset(0) {
+            }
+
+            bool isAliveWith(const Buffer &other) const {
+                return first <= other.last && other.first <= last;
+            }
+
+            static bool larger(const Buffer &a, const Buffer &b) {
+                return a.size > b.size;
+            }
+
+            size_t *target;
+            size_t size;
+            size_t first;
+            size_t last;
+            size_t offset;
+        };
+
+        std::vector<Step> steps;
+        size_t size;
+        size_t numWorkers;
+
+        // Round up to whole cache lines.
+        static size_t roundUp(size_t n) {
+            size_t line = CACHE_LINE_ALIGNMENT / sizeof(float);
+            return (n + line - 1) / line * line;
+        }
+    };
+}
+
+#endif
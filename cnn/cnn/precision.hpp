@@ -0,0 +1,205 @@
+#ifndef PRECISION_HEADER
+#define PRECISION_HEADER
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+/******************************************************************************************
+
+    Numeric precision of a layer.
+
+    INT8 is symmetric post-training quantization:
+        the input of a layer is q = round(x / inScale), clamped to [-127, 127],
+        with inScale = max|x| / 127 over a calibration set,
+        every output map o has its own weight scale max|w_o| / 127,
+        products are accumulated in int32 and the sum is dequantized with
+        inScale * weightScale[o] before the offset and the activation.
+    Only the convolutional and fully connected layers, which do all the
+    multiplies, are quantized; pooling and the RBF output stay in fp32.
+
+    FP16 stores the weights and the activations as IEEE half, which halves
+    their bandwidth and local memory. The device kernels accumulate in fp32
+    or, with cl_khr_fp16, in fp16. The CPU path emulates the storage: it
+    rounds the weights and the outputs to half and computes in fp32.
+
+    This header only needs the standard library so the generator can share it.
+
+*******************************************************************************************/
+
+namespace cnn {
+
+    enum Precision {
+        FP32,
+        INT8,
+        FP16
+    };
+
+    const size_t NUM_PRECISIONS = 3;
+
+    inline const char *getPrecisionName(Precision precision) {
+        static const char *NAMES[NUM_PRECISIONS] = { "fp32", "int8", "fp16" };
+        return NAMES[precision];
+    }
+
+    inline Precision parsePrecision(const std::string &name) {
+        for (size_t i = 0; i < NUM_PRECISIONS; ++i) {
+            if (name == getPrecisionName((Precision)i)) {
+                return (Precision)i;
+            }
+        }
+        std::cerr << "parsePrecision: Unsupported precision: " << name << std::endl;
+        exit(-1);
+    }
+
+    namespace fp16 {
+
+        // Bits of an IEEE half.
+        typedef unsigned short half;
+
+        // Round to the nearest half, ties to even, like vstore_half.
+        inline half fromFloat(float f) {
+            unsigned int x;
+            memcpy(&x, &f, sizeof(x));
+            unsigned int sign = (x >> 16) & 0x8000;
+            unsigned int exponent = (x >> 23) & 0xff;
+            unsigned int mantissa = x & 0x7fffff;
+
+            // Infinity and NaN.
+            if (exponent == 0xff) {
+                return (half)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+            }
+            int e = (int)exponent - 127 + 15;
+            if (e >= 31) {
+                return (half)(sign | 0x7c00);
+            }
+            unsigned int shift;
+            unsigned int h;
+            if (e <= 0) {
+                // Subnormal half, counted in units of 2^-24.
+                if (e < -10) {
+                    return (half)sign;
+                }
+                mantissa |= 0x800000;
+                shift = 14 - e;
+                h = mantissa >> shift;
+            }
+            else {
+                shift = 13;
+                h = ((unsigned int)e << 10) | (mantissa >> shift);
+            }
+            unsigned int rest = mantissa & ((1u << shift) - 1);
+            unsigned int halfway = 1u << (shift - 1);
+            // A carry into the exponent is still the right encoding.
+            if (rest > halfway || (rest == halfway && (h & 1))) {
+                ++h;
+            }
+            return (half)(sign | h);
+        }
+
+        inline float toFloat(half h) {
+            unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+            unsigned int exponent = (h >> 10) & 0x1f;
+            unsigned int mantissa = h & 0x3ff;
+            unsigned int x;
+            if (exponent == 0) {
+                float f = (float)mantissa * 5.9604644775390625e-8f;
+                return sign ? -f : f;
+            }
+            if (exponent == 31) {
+                x = sign | 0x7f800000 | (mantissa << 13);
+            }
+            else {
+                x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+            }
+            float f;
+            memcpy(&f, &x, sizeof(f));
+            return f;
+        }
+
+        inline void fromFloat(const float *x, size_t n, half *h) {
+            for (size_t i = 0; i < n; ++i) {
+                h[i] = fromFloat(x[i]);
+            }
+        }
+
+        // Round in place to the nearest value a half can hold.
+        inline void round(float *x, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                x[i] = toFloat(fromFloat(x[i]));
+            }
+        }
+    }
+
+    namespace quant {
+
+        typedef signed char int8;
+
+        const int QMAX = 127;
+
+        // Scale mapping [-maxAbs, maxAbs] to [-QMAX, QMAX].
+        inline float getScale(float maxAbs) {
+            return maxAbs > 0.0f ? maxAbs / QMAX : 1.0f;
+        }
+
+        inline int8 quantize(float x, float invScale) {
+            float q = std::floor(x * invScale + 0.5f);
+            q = q < -QMAX ? -QMAX : (q > QMAX ? QMAX : q);
+            return (int8)q;
+        }
+
+        inline void quantize(const float *x, size_t n, float scale, int8 *q) {
+            float invScale = 1.0f / scale;
+            for (size_t i = 0; i < n; ++i) {
+                q[i] = quantize(x[i], invScale);
+            }
+        }
+
+        inline float maxAbs(const float *x, size_t n) {
+            float m = 0.0f;
+            for (size_t i = 0; i < n; ++i) {
+                m = std::max(m, std::fabs(x[i]));
+            }
+            return m;
+        }
+
+        // Quantize rows x cols weights with one scale per row.
+        inline void quantizeRows(const float *weight, size_t rows, size_t cols, int8 *q, float *scales) {
+            for (size_t r = 0; r < rows; ++r) {
+                scales[r] = getScale(maxAbs(weight + r * cols, cols));
+                quantize(weight + r * cols, cols, scales[r], q + r * cols);
+            }
+        }
+
+        // Range of the values seen by a layer during calibration.
+        struct Range {
+            Range() : min(0.0f), max(0.0f), count(0) {
+            }
+
+            void update(const float *x, size_t n) {
+                for (size_t i = 0; i < n; ++i) {
+                    if (count == 0 && i == 0) {
+                        min = max = x[0];
+                    }
+                    min = std::min(min, x[i]);
+                    max = std::max(max, x[i]);
+                }
+                count += n;
+            }
+
+            float getMaxAbs() const {
+                return std::max(std::fabs(min), std::fabs(max));
+            }
+
+            float min;
+            float max;
+            size_t count;
+        };
+    }
+}
+
+#endif
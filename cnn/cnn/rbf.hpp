@@ -1,18 +1,106 @@
 #include "layer.hpp"
 
+#include <cstring>
+
 namespace cnn {
+
+    // Rank the k nearest of n classes the way the device head does:
+    // head[j] is the j-th nearest class and head[k + j] the bits of its distance.
+    // Ties go to the lower class.
+    inline void rankClasses(const float *distance, size_t n, size_t k, cl_int *head) {
+        std::vector<bool> taken(n, false);
+        for (size_t j = 0; j < k; ++j) {
+            size_t best = n;
+            for (size_t o = 0; o < n; ++o) {
+                if (!taken[o] && (best == n || distance[o] < distance[best])) {
+                    best = o;
+                }
+            }
+            taken[best] = true;
+            head[j] = (cl_int)best;
+            memcpy(&head[k + j], &distance[best], sizeof(cl_int));
+        }
+    }
+
+    // The k nearest classes of every input, 2 * k words per input as the head writes them.
+    class Classification {
+    public:
+        Classification() : n(0), k(0) {
+        }
+
+        void resize(size_t n, size_t k) {
+            this->n = n;
+            this->k = k;
+            words.resize(n * 2 * k);
+        }
+
+        size_t getN() const {
+            return n;
+        }
+
+        size_t getK() const {
+            return k;
+        }
+
+        // Bytes read back per input.
+        size_t getBytes() const {
+            return 2 * k * sizeof(cl_int);
+        }
+
+        // The j-th nearest class of input i.
+        size_t getClass(size_t i, size_t j = 0) const {
+            return (size_t)words[i * 2 * k + j];
+        }
+
+        // The distance to the j-th nearest class of input i.
+        float getScore(size_t i, size_t j = 0) const {
+            float score;
+            memcpy(&score, &words[i * 2 * k + k + j], sizeof(float));
+            return score;
+        }
+
+        cl_int *operator[](size_t i) {
+            return &words[i * 2 * k];
+        }
+
+    private:
+        size_t n;
+        size_t k;
+        std::vector<cl_int> words;
+    };
+
     class RBFLayer : public Layer {
     public:
         RBFLayer(const LayerParam &params,
             const vec &weight,
             const vec &offset,
+            Arena &arena,
             const cl_context &context,
             const cl_program &program,
             const cl_mem &clIn
-            ) : Layer(params, weight, offset, context, program, clIn) {
+            ) : Layer(params, weight, offset, arena, context, program, clIn), topK(params.topK), clHead(NULL) {
 
             assert(weight.size() == (iWidth * iHeight * iDepth * oWidth * oHeight * oDepth));
 
+            // The kernel ranks the classes and writes the head after the offset.
+            if (topK > 0) {
+                if (topK > getOutSize()) {
+                    std::cerr << "RBFLayer: topK " << topK << " exceeds " << getOutSize() << " classes" << std::endl;
+                    exit(-1);
+                }
+                head.resize(2 * topK);
+                cl_int err;
+                clHead = clCreateBuffer(
+                    context,
+                    CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR,
+                    head.size() * sizeof(cl_int),
+                    &head[0],
+                    &err);
+                handleError(err, "Failed creating clHead. ");
+                err = clSetKernelArg(kernel, weightArg + 2, sizeof(cl_mem), &clHead);
+                handleError(err, "Failed setting kernel arg: clHead. ");
+            }
+
             // Prepare the ND-Range.
             global[0] = closestMultiple(workGroupSize[0], oWidth * oDepth * oHeight);
             global[1] = workGroupSize[1];
@@ -20,28 +108,31 @@ namespace cnn {
         }
 
         virtual ~RBFLayer() {
-
+            if (clHead) {
+                clReleaseMemObject(clHead);
+            }
         }
 
-        // Forward with CPU.
-        virtual unsigned long long forwardCPU(const vec &in) {
-
-            clock_t start = clock(), diff;
-
-            // Clear the output buffer.
-            std::fill(out.begin(), out.end(), 0.0f);
+        // Classes ranked on the device, 0 without a head.
+        size_t getTopK() const {
+            return topK;
+        }
 
-            for (size_t o = 0; o < out.size(); ++o) {
-                for (size_t i = 0; i < in.size(); ++i) {
-                    float diff = in[i] - weight[o * in.size() + i];
-                    out[o] += diff * diff;
+        // Forward with CPU, split across output neurons.
+        virtual void computeCPU(const float *in, float *out, const Workspace &ws) {
+            size_t inSize = getInSize();
+            parallelFor(ws, 0, getOutSize(), 1, [&](size_t begin, size_t end, size_t /*worker*/) {
+                for (size_t o = begin; o < end; ++o) {
+                    out[o] = simd::kernels().sqrDist(in, &weight[o * inSize], inSize);
                 }
-            }
+            });
+        }
 
-            diff = clock() - start;
-            int msec = diff * 1000 / CLOCKS_PER_SEC;
+    protected:
+        friend class CNN;
 
-            return (unsigned long long)msec;
-        }
+        size_t topK;
+        std::vector<cl_int> head;
+        cl_mem clHead;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,395 @@
+#ifndef REGRESS_HEADER
+#define REGRESS_HEADER
+
+#include "bench.hpp"
+
+/******************************************************************************************
+
+    Performance regression gate against a stored result file.
+
+        cnn --regress --baseline <kernel/result_*.xml> --model <xml> [--xclbin file]
+            [--device n] [--batch n] [--warmup n] [--reps n] [--seed n]
+            [--result file] [--tolerance 0.10] [--confidence 0.95]
+        cnn --regress --baseline <xml> --current <xml> ...
+
+    The first form runs the current build through the modes of the baseline,
+    single, batch and pipeline if it has one, and writes their results in
+    the same format as the tests to --result, result_current.xml by default.
+    The second compares two stored files.
+
+    From the profile of every event of a mode the gate takes:
+        stage       END - START of every command of an input: the write,
+                    the kernel of every layer and the read
+        latency     the START of the first command of an input to the END
+                    of its last one
+        interval    the END of the last command of an input to that of the
+                    next one, the inverse of the throughput
+    and the averageTime of the mode. The single mode keeps the average of
+    its repetitions only, the current run every repetition.
+
+    A metric regresses when its mean is more than --tolerance above the
+    baseline and the difference is significant at --confidence: Welch's t
+    test of both sets of samples, the one sample t test of the current
+    samples against a stored average, the tolerance alone between two
+    averages. The latency, the interval and the single average gate the
+    exit code; a slower stage is only flagged, the report per layer tells
+    where the time went.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace regress {
+
+        // The samples of one metric in nanoseconds.
+        struct Metric {
+            std::string name;
+            std::vector<double> samples;
+            bool isGating;
+        };
+
+        // One mode of a result file.
+        struct Mode {
+            std::string name;
+            size_t n;
+            size_t stageSize;
+            std::vector<Metric> metrics;
+
+            const Metric *find(const std::string &metric) const {
+                for (size_t m = 0; m < metrics.size(); ++m) {
+                    if (metrics[m].name == metric) {
+                        return &metrics[m];
+                    }
+                }
+                return NULL;
+            }
+        };
+
+        struct Result {
+            std::string file;
+            std::vector<Mode> modes;
+
+            const Mode *find(const std::string &mode) const {
+                for (size_t m = 0; m < modes.size(); ++m) {
+                    if (modes[m].name == mode) {
+                        return &modes[m];
+                    }
+                }
+                return NULL;
+            }
+        };
+
+        inline double getValue(rapidxml::xml_node<> *node, const char *name, const std::string &file) {
+            rapidxml::xml_node<> *child = node->first_node(name);
+            if (!child) {
+                std::cerr << "regress: No " << name << " in " << node->name() << " of " << file << std::endl;
+                exit(-1);
+            }
+            return std::atof(child->value());
+        }
+
+        // The stage s of stageSize, named after the layers when the names are given.
+        inline std::string getStageName(size_t s, size_t stageSize, const std::vector<std::string> &names) {
+            if (names.size() == stageSize) {
+                std::ostringstream name;
+                name << "stage" << s << "." << names[s];
+                return name.str();
+            }
+            std::ostringstream name;
+            if (s == 0) {
+                name << "stage0.write";
+            }
+            else if (s + 1 == stageSize) {
+                name << "stage" << s << ".read";
+            }
+            else {
+                name << "stage" << s << ".layer" << s - 1;
+            }
+            return name.str();
+        }
+
+        inline Mode parseEvents(rapidxml::xml_node<> *node, const std::string &file, const std::vector<std::string> &names) {
+            Mode mode;
+            mode.name = node->name();
+            mode.n = 0;
+            mode.stageSize = 0;
+
+            // START and END of every command of every input.
+            std::vector<std::vector<std::pair<double, double> > > inputs;
+            for (rapidxml::xml_node<> *input = node->first_node("input"); input; input = input->next_sibling("input")) {
+                std::vector<std::pair<double, double> > commands;
+                for (rapidxml::xml_node<> *event = input->first_node("event"); event; event = event->next_sibling("event")) {
+                    commands.push_back(std::make_pair(getValue(event, "sta", file), getValue(event, "end", file)));
+                }
+                if (!inputs.empty() && commands.size() != inputs[0].size()) {
+                    std::cerr << "regress: The inputs of " << mode.name << " in " << file << " have different events" << std::endl;
+                    exit(-1);
+                }
+                inputs.push_back(commands);
+            }
+            if (inputs.empty() || inputs[0].empty()) {
+                std::cerr << "regress: No events in " << mode.name << " of " << file << std::endl;
+                exit(-1);
+            }
+            mode.n = inputs.size();
+            mode.stageSize = inputs[0].size();
+
+            // The averageTime of batch and pipeline is seconds per input.
+            Metric average = { "averageTime", std::vector<double>(1, getValue(node, "averageTime", file) * 1e9), true };
+            Metric latency = { "latency", std::vector<double>(), true };
+            Metric interval = { "interval", std::vector<double>(), true };
+            std::vector<Metric> stages(mode.stageSize);
+            for (size_t s = 0; s < mode.stageSize; ++s) {
+                stages[s].name = getStageName(s, mode.stageSize, names);
+                stages[s].isGating = false;
+            }
+            for (size_t i = 0; i < mode.n; ++i) {
+                const std::vector<std::pair<double, double> > &commands = inputs[i];
+                for (size_t s = 0; s < mode.stageSize; ++s) {
+                    stages[s].samples.push_back(commands[s].second - commands[s].first);
+                }
+                latency.samples.push_back(commands.back().second - commands.front().first);
+                if (i > 0) {
+                    interval.samples.push_back(commands.back().second - inputs[i - 1].back().second);
+                }
+            }
+            mode.metrics.push_back(average);
+            mode.metrics.push_back(latency);
+            mode.metrics.push_back(interval);
+            mode.metrics.insert(mode.metrics.end(), stages.begin(), stages.end());
+            return mode;
+        }
+
+        // Parse a result file written by the tests or by record, stages named after names if given.
+        inline Result parse(const std::string &file, const std::vector<std::string> &names = std::vector<std::string>()) {
+            if (!std::ifstream(file.c_str()).good()) {
+                std::cerr << "Can't open file " << file << std::endl;
+                exit(-1);
+            }
+            std::string text = fileToString(file);
+            std::vector<char> buf(text.begin(), text.end());
+            buf.push_back('\0');
+            rapidxml::xml_document<> doc;
+            doc.parse<0>(&buf[0]);
+            rapidxml::xml_node<> *root = doc.first_node("results");
+            if (!root) {
+                std::cerr << "regress: " << file << " is not a result file" << std::endl;
+                exit(-1);
+            }
+
+            Result result;
+            result.file = file;
+            if (rapidxml::xml_node<> *single = root->first_node("single")) {
+                Mode mode;
+                mode.name = "single";
+                mode.n = 1;
+                mode.stageSize = 0;
+                Metric average = { "averageTime", std::vector<double>(1, getValue(single, "averageTime", file)), true };
+                mode.metrics.push_back(average);
+                result.modes.push_back(mode);
+            }
+            const char *modes[2] = { "batch", "pipeline" };
+            for (size_t m = 0; m < 2; ++m) {
+                if (rapidxml::xml_node<> *node = root->first_node(modes[m])) {
+                    result.modes.push_back(parseEvents(node, file, names));
+                }
+            }
+            return result;
+        }
+
+        // Run the modes of the baseline on the model of the options into options.result.
+        inline Result record(const bench::Options &options, const Result &baseline) {
+            std::ofstream o(options.result.c_str());
+            if (!o.is_open()) {
+                std::cerr << "Can't open file " << options.result << std::endl;
+                exit(-1);
+            }
+            o << "<?xml version=\"1.0\" encoding=\"utf-8\"?>" << std::endl;
+            writeXMLOpenTag(o, "results");
+
+            std::vector<std::string> names;
+            std::vector<double> singles;
+            size_t n = options.batch;
+            double averageTime;
+            {
+                CNN cnn(options.model, true, options.xclbin, options.device);
+                names = cnn.getStageNames();
+                vec in;
+                bench::fillInputs(in, n, cnn.getInSize(), options.seed);
+                vec out(n * cnn.getOutSize());
+
+                if (baseline.find("single")) {
+                    vec one(in.begin(), in.begin() + cnn.getInSize());
+                    unsigned long long totalTime = 0;
+                    for (size_t r = 0; r < options.warmup + options.reps; ++r) {
+                        unsigned long long time = cnn.forwardCL(one);
+                        if (r >= options.warmup) {
+                            singles.push_back((double)time);
+                            totalTime += time;
+                        }
+                    }
+                    writeXMLOpenTag(o, "single");
+                    writeXMLTag(o, "averageTime", (size_t)(totalTime / options.reps));
+                    writeXMLCloseTag(o, "single");
+                }
+                if (baseline.find("batch")) {
+                    for (size_t r = 0; r < options.warmup; ++r) {
+                        std::vector<cl_event> events = cnn.forwardCLBatch(in, out, n, &averageTime);
+                        bench::releaseEvents(events);
+                    }
+                    std::vector<cl_event> events = cnn.forwardCLBatch(in, out, n, &averageTime);
+                    clWaitForEvents((cl_uint)events.size(), &events[0]);
+                    writeXMLOpenTag(o, "batch");
+                    writeXMLTag(o, "averageTime", (float)averageTime);
+                    dumpEventsProfile(o, events, n);
+                    writeXMLCloseTag(o, "batch");
+                    bench::releaseEvents(events);
+                }
+            }
+            if (baseline.find("pipeline")) {
+                CNN cnn(options.model, false, options.xclbin, options.device);
+                vec in;
+                bench::fillInputs(in, n, cnn.getInSize(), options.seed);
+                vec out(n * cnn.getOutSize());
+                for (size_t r = 0; r < options.warmup; ++r) {
+                    std::vector<cl_event> events = cnn.forwardCLPipeline(in, out, n, &averageTime);
+                    bench::releaseEvents(events);
+                }
+                std::vector<cl_event> events = cnn.forwardCLPipeline(in, out, n, &averageTime);
+                clWaitForEvents((cl_uint)events.size(), &events[0]);
+                writeXMLOpenTag(o, "pipeline");
+                writeXMLTag(o, "averageTime", (float)averageTime);
+                dumpEventsProfile(o, events, n);
+                writeXMLCloseTag(o, "pipeline");
+                bench::releaseEvents(events);
+            }
+            writeXMLCloseTag(o, "results");
+            o.close();
+
+            // The stored single keeps the average, the gate every repetition.
+            Result result = parse(options.result, names);
+            for (size_t m = 0; m < result.modes.size(); ++m) {
+                if (result.modes[m].name == "single") {
+                    result.modes[m].metrics[0].samples = singles;
+                }
+            }
+            return result;
+        }
+
+        struct Diff {
+            std::string mode;
+            std::string metric;
+            bool isGating;
+            stats::Summary before;
+            stats::Summary now;
+            double change;
+            // t of the test, 0 without one.
+            double t;
+            bool isSignificant;
+            bool isRegression;
+        };
+
+        // Is now different from before: Welch's t test of two sets of samples,
+        // the one sample t test of a set against an average, true for two averages.
+        inline bool isSignificant(const stats::Summary &before, const stats::Summary &now, double *t) {
+            *t = 0.0;
+            if (before.n >= 2 && now.n >= 2) {
+                stats::Welch w = stats::welch(before, now);
+                *t = w.t;
+                return w.isSignificant;
+            }
+            if (before.n < 2 && now.n < 2) {
+                return true;
+            }
+            const stats::Summary &samples = now.n >= 2 ? now : before;
+            double average = now.n >= 2 ? before.mean : now.mean;
+            if (samples.stddev == 0.0) {
+                *t = samples.mean == average ? 0.0 : (now.mean > before.mean ? INFINITY : -INFINITY);
+                return samples.mean != average;
+            }
+            *t = (now.mean - before.mean) / (samples.stddev / std::sqrt((double)samples.n));
+            return std::fabs(*t) > stats::tQuantile(samples.confidence, samples.n - 1);
+        }
+
+        // The metrics of every mode of both, the stages only if both have the same.
+        inline std::vector<Diff> compare(const Result &baseline, const Result &current, double tolerance, double confidence) {
+            std::vector<Diff> diffs;
+            for (size_t m = 0; m < current.modes.size(); ++m) {
+                const Mode &now = current.modes[m];
+                const Mode *before = baseline.find(now.name);
+                if (!before) {
+                    continue;
+                }
+                bool isSameStages = before->stageSize == now.stageSize;
+                for (size_t k = 0; k < now.metrics.size(); ++k) {
+                    const Metric &metric = now.metrics[k];
+                    const Metric *old = isSameStages ? &before->metrics[k] : metric.isGating ? before->find(metric.name) : NULL;
+                    if (!old) {
+                        continue;
+                    }
+                    Diff diff;
+                    diff.mode = now.name;
+                    diff.metric = metric.name;
+                    diff.isGating = metric.isGating;
+                    diff.before = stats::summarize(old->samples, confidence);
+                    diff.now = stats::summarize(metric.samples, confidence);
+                    diff.change = diff.before.mean > 0.0 ? diff.now.mean / diff.before.mean - 1.0 : 0.0;
+                    diff.isSignificant = isSignificant(diff.before, diff.now, &diff.t);
+                    diff.isRegression = diff.change > tolerance && diff.isSignificant;
+                    diffs.push_back(diff);
+                }
+            }
+            return diffs;
+        }
+
+        // Print the diff of every metric, the number of gating regressions.
+        inline size_t writeReport(std::ostream &o, const Result &baseline, const Result &current,
+            const std::vector<Diff> &diffs, double tolerance, double confidence) {
+            size_t regressions = 0;
+            o << "Regression gate of " << current.file << " against " << baseline.file << ", tolerance "
+                << tolerance * 100.0 << "%, confidence " << confidence * 100.0 << "%" << std::endl;
+            for (size_t m = 0; m < current.modes.size(); ++m) {
+                const Mode *before = baseline.find(current.modes[m].name);
+                if (before && before->stageSize != current.modes[m].stageSize) {
+                    o << "  " << current.modes[m].name << ": " << before->stageSize << " stages in the baseline, "
+                        << current.modes[m].stageSize << " now, no diff per layer" << std::endl;
+                }
+            }
+            o << std::fixed << std::setprecision(2);
+            o << "  " << std::left << std::setw(10) << "mode" << std::setw(28) << "metric" << std::right
+                << std::setw(14) << "baseline us" << std::setw(14) << "now us" << std::setw(9) << "change"
+                << std::setw(9) << "t" << std::endl;
+            for (size_t d = 0; d < diffs.size(); ++d) {
+                const Diff &diff = diffs[d];
+                regressions += diff.isGating && diff.isRegression;
+                o << "  " << std::left << std::setw(10) << diff.mode << std::setw(28) << diff.metric << std::right
+                    << std::setw(14) << diff.before.mean * 1e-3 << std::setw(14) << diff.now.mean * 1e-3
+                    << std::setw(8) << std::setprecision(1) << diff.change * 100.0 << "%" << std::setw(9) << diff.t
+                    << std::setprecision(2);
+                if (diff.isRegression) {
+                    o << (diff.isGating ? "  REGRESSION" : "  slower");
+                }
+                else if (diff.change < -tolerance && diff.isSignificant) {
+                    o << "  faster";
+                }
+                o << std::endl;
+            }
+            o.unsetf(std::ios::floatfield);
+            return regressions;
+        }
+
+        inline int mainRegress(const bench::Options &options) {
+            if (options.baseline.empty()) {
+                std::cerr << "regress: Needs a --baseline result file" << std::endl;
+                exit(-1);
+            }
+            Result baseline = parse(options.baseline);
+            Result current = options.current.empty() ? record(options, baseline) : parse(options.current);
+            std::vector<Diff> diffs = compare(baseline, current, options.tolerance, options.confidence);
+            size_t regressions = writeReport(std::cout, baseline, current, diffs, options.tolerance, options.confidence);
+            std::cout << regressions << " regressions of the latency or the throughput" << std::endl;
+            return regressions > 0 ? 1 : 0;
+        }
+    }
+}
+
+#endif
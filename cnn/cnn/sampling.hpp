@@ -0,0 +1,128 @@
+#ifndef SAMPLING_HEADER
+#define SAMPLING_HEADER
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+/******************************************************************************************
+
+    Ring buffer of sampled profiles.
+
+    With CNN::setProfileSampling(every) the hot queue runs without
+    CL_QUEUE_PROFILING_ENABLE and 1 in every inputs of the batch and
+    pipelined forwards goes to a second, profiled queue. The events of the
+    sampled inputs are kept and, once complete, read in bulk at the start
+    of the next forward (or by flushProfile) into this buffer: one Record
+    per command, the oldest overwritten when it is full. A buffer of no
+    capacity only counts them.
+
+    The binary file is the 8 bytes magic "CNNPROF1", the number of records
+    and the number overwritten as uint64, then the records, all in the byte
+    order of the host.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace sampling {
+
+        // One command of a sampled input, the times on the device clock in nanoseconds.
+        struct Record {
+            // The input counted since setProfileSampling.
+            uint64_t sequence;
+            uint32_t stage;
+            uint32_t stages;
+            uint64_t queued;
+            uint64_t submit;
+            uint64_t start;
+            uint64_t end;
+        };
+
+        static const char MAGIC[8] = { 'C', 'N', 'N', 'P', 'R', 'O', 'F', '1' };
+
+        class RingBuffer {
+        public:
+            RingBuffer(size_t capacity = 0) : records(capacity), head(0), count(0), overwritten(0) {}
+
+            void push(const Record &record) {
+                if (records.empty()) {
+                    overwritten++;
+                    return;
+                }
+                records[head] = record;
+                head = (head + 1) % records.size();
+                if (count < records.size()) {
+                    count++;
+                }
+                else {
+                    overwritten++;
+                }
+            }
+
+            size_t size() const {
+                return count;
+            }
+
+            size_t getCapacity() const {
+                return records.size();
+            }
+
+            uint64_t getOverwritten() const {
+                return overwritten;
+            }
+
+            // The records from the oldest to the newest.
+            std::vector<Record> snapshot() const {
+                std::vector<Record> ordered;
+                ordered.reserve(count);
+                size_t first = (head + records.size() - count) % std::max<size_t>(records.size(), 1);
+                for (size_t i = 0; i < count; ++i) {
+                    ordered.push_back(records[(first + i) % records.size()]);
+                }
+                return ordered;
+            }
+
+            void clear() {
+                head = 0;
+                count = 0;
+                overwritten = 0;
+            }
+
+            void write(std::ostream &o) const {
+                std::vector<Record> ordered = snapshot();
+                uint64_t header[2] = { (uint64_t)ordered.size(), overwritten };
+                o.write(MAGIC, sizeof(MAGIC));
+                o.write((const char *)header, sizeof(header));
+                if (!ordered.empty()) {
+                    o.write((const char *)&ordered[0], ordered.size() * sizeof(Record));
+                }
+            }
+
+            // Read the records of a file written by write, false if it is not one.
+            static bool read(std::istream &in, std::vector<Record> &records, uint64_t *overwritten) {
+                char magic[sizeof(MAGIC)];
+                uint64_t header[2];
+                if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+                    !in.read((char *)header, sizeof(header))) {
+                    return false;
+                }
+                records.resize((size_t)header[0]);
+                if (!records.empty() && !in.read((char *)&records[0], records.size() * sizeof(Record))) {
+                    return false;
+                }
+                *overwritten = header[1];
+                return true;
+            }
+
+        private:
+            std::vector<Record> records;
+            size_t head;
+            size_t count;
+            uint64_t overwritten;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef SDACCEL_HEADER
+#define SDACCEL_HEADER
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <iostream>
+
+/******************************************************************************************
+
+    Reader of sdaccel_profile_summary.csv.
+
+    The summary is a title line and blocks separated by blank lines: a
+    block is the title of a table, its header and its rows, every line
+    ending with a comma. Cells are looked up by the name of their column,
+    which survives a reorder of the columns between SDAccel versions.
+
+    The OpenCL API calls are split by what the host spends their time on:
+        setup       context, program, kernel and buffer creation, once
+        enqueue     clEnqueue*, the launch overhead
+        profiling   clGetEventProfilingInfo
+        wait        clFinish and clWaitForEvents, the host blocked on the device
+        other       the rest
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace sdaccel {
+
+        struct Table {
+            std::string title;
+            std::vector<std::string> header;
+            std::vector<std::vector<std::string> > rows;
+
+            // The column named name, -1 if none.
+            int column(const std::string &name) const {
+                for (size_t c = 0; c < header.size(); ++c) {
+                    if (header[c] == name) {
+                        return (int)c;
+                    }
+                }
+                return -1;
+            }
+
+            double getNumber(size_t row, const std::string &name) const {
+                int c = column(name);
+                if (c < 0 || (size_t)c >= rows[row].size()) {
+                    std::cerr << "sdaccel: No column " << name << " in " << title << std::endl;
+                    exit(-1);
+                }
+                return std::atof(rows[row][c].c_str());
+            }
+        };
+
+        struct Summary {
+            std::vector<Table> tables;
+
+            // The table titled title, NULL if none.
+            const Table *find(const std::string &title) const {
+                for (size_t t = 0; t < tables.size(); ++t) {
+                    if (tables[t].title == title) {
+                        return &tables[t];
+                    }
+                }
+                return NULL;
+            }
+        };
+
+        inline std::vector<std::string> splitLine(const std::string &line) {
+            std::vector<std::string> cells;
+            std::string cell;
+            std::istringstream in(line);
+            while (std::getline(in, cell, ',')) {
+                cells.push_back(cell);
+            }
+            return cells;
+        }
+
+        inline Summary parse(std::istream &in) {
+            Summary summary;
+            std::vector<std::string> block;
+            std::string line;
+            bool isEnd = false;
+            while (!isEnd) {
+                isEnd = !std::getline(in, line);
+                if (!line.empty() && line[line.size() - 1] == '\r') {
+                    line.erase(line.size() - 1);
+                }
+                if (!isEnd && !line.empty()) {
+                    block.push_back(line);
+                    continue;
+                }
+                // A block of a single line is the title of the summary.
+                if (block.size() >= 2) {
+                    Table table;
+                    table.title = block[0];
+                    table.header = splitLine(block[1]);
+                    for (size_t r = 2; r < block.size(); ++r) {
+                        table.rows.push_back(splitLine(block[r]));
+                    }
+                    summary.tables.push_back(table);
+                }
+                block.clear();
+                line.clear();
+            }
+            return summary;
+        }
+
+        inline Summary parseFile(const std::string &file) {
+            std::ifstream in(file.c_str());
+            if (!in.is_open()) {
+                std::cerr << "Can't open file " << file << std::endl;
+                exit(-1);
+            }
+            Summary summary = parse(in);
+            if (!summary.find("OpenCL API Calls")) {
+                std::cerr << "sdaccel: " << file << " has no OpenCL API Calls table" << std::endl;
+                exit(-1);
+            }
+            return summary;
+        }
+
+        enum ApiCategory {
+            API_SETUP,
+            API_ENQUEUE,
+            API_PROFILING,
+            API_WAIT,
+            API_OTHER
+        };
+
+        const size_t NUM_API_CATEGORIES = 5;
+
+        inline const char *getApiCategoryName(ApiCategory category) {
+            static const char *NAMES[NUM_API_CATEGORIES] = { "setup", "enqueue", "profiling", "wait", "other" };
+            return NAMES[category];
+        }
+
+        inline ApiCategory getApiCategory(const std::string &api) {
+            if (api.compare(0, 9, "clEnqueue") == 0) {
+                return API_ENQUEUE;
+            }
+            if (api == "clGetEventProfilingInfo") {
+                return API_PROFILING;
+            }
+            if (api == "clFinish" || api == "clWaitForEvents") {
+                return API_WAIT;
+            }
+            if (api.compare(0, 8, "clCreate") == 0 || api == "clBuildProgram" || api.compare(0, 5, "clGet") == 0) {
+                return API_SETUP;
+            }
+            return API_OTHER;
+        }
+
+        // Milliseconds of the API calls per category.
+        inline std::vector<double> getApiTimes(const Summary &summary) {
+            std::vector<double> times(NUM_API_CATEGORIES, 0.0);
+            const Table *api = summary.find("OpenCL API Calls");
+            for (size_t r = 0; api && r < api->rows.size(); ++r) {
+                times[getApiCategory(api->rows[r][0])] += api->getNumber(r, "Total Time (ms)");
+            }
+            return times;
+        }
+
+        // Milliseconds and count of a row of a table, 0 if absent.
+        inline double getTotal(const Summary &summary, const std::string &title, const std::string &row, size_t *count) {
+            const Table *table = summary.find(title);
+            for (size_t r = 0; table && r < table->rows.size(); ++r) {
+                if (table->rows[r][0] == row) {
+                    *count = (size_t)table->getNumber(r, table->header[1]);
+                    return table->getNumber(r, "Total Time (ms)");
+                }
+            }
+            *count = 0;
+            return 0.0;
+        }
+
+        // Milliseconds summed over the rows of a table.
+        inline double getTotal(const Summary &summary, const std::string &title) {
+            const Table *table = summary.find(title);
+            double total = 0.0;
+            for (size_t r = 0; table && r < table->rows.size(); ++r) {
+                total += table->getNumber(r, "Total Time (ms)");
+            }
+            return total;
+        }
+    }
+}
+
+#endif
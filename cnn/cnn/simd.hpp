@@ -0,0 +1,705 @@
+#ifndef SIMD_HEADER
+#define SIMD_HEADER
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <iostream>
+
+#include "gemm.hpp"
+#include "activation.hpp"
+
+/******************************************************************************************
+
+    SIMD kernels for the CPU forward path with runtime ISA dispatch.
+
+    Every kernel has a scalar reference implementation plus SSE, AVX2 and AVX-512
+    versions. The best ISA supported by the CPU (and the OS, for the wide register
+    state) is picked once via CPUID, and can be forced with the CNN_ISA environment
+    variable (scalar, sse, avx2, avx512) or setISA().
+
+    The scalar kernels compute exactly what the original layers did, including
+    expf() for the sigmoid, so they serve as the reference the vector kernels are
+    checked against. The vector sigmoid uses a Cephes style exp approximation
+    (range reduction to [-ln2/2, ln2/2] and a degree 5 polynomial), which is
+    accurate to a few ulp over the whole float range.
+
+*******************************************************************************************/
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CNN_SIMD_X86
+#endif
+
+#ifdef CNN_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CNN_TARGET(isa)
+#else
+#include <cpuid.h>
+#define CNN_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace cnn {
+    namespace simd {
+
+        enum ISA {
+            SCALAR,
+            SSE,
+            AVX2,
+            AVX512
+        };
+
+        const char *isaName(ISA isa) {
+            switch (isa) {
+            case SSE:
+                return "sse";
+            case AVX2:
+                return "avx2";
+            case AVX512:
+                return "avx512";
+            default:
+                return "scalar";
+            }
+        }
+
+        struct Kernels {
+            ISA isa;
+
+            // sum(a[i] * b[i]).
+            float (*dot)(const float *a, const float *b, size_t n);
+
+            // sum((a[i] - b[i])^2).
+            float (*sqrDist)(const float *a, const float *b, size_t n);
+
+            // x[i] = sigmoid(x[i] * scale + bias).
+            void (*sigmoid)(float *x, size_t n, float scale, float bias);
+
+            // x[i] = sigmoid(x[i] + bias[i]).
+            void (*sigmoidBias)(float *x, const float *bias, size_t n);
+
+            // MR x NR SGEMM micro kernel.
+            gemm::MicroKernel gemmMicroKernel;
+        };
+
+        /*****************************************************************************************
+         Scalar reference.
+         *****************************************************************************************/
+        float dotScalar(const float *a, const float *b, size_t n) {
+            float sum = 0.0f;
+            for (size_t i = 0; i < n; ++i) {
+                sum += a[i] * b[i];
+            }
+            return sum;
+        }
+
+        float sqrDistScalar(const float *a, const float *b, size_t n) {
+            float sum = 0.0f;
+            for (size_t i = 0; i < n; ++i) {
+                float diff = a[i] - b[i];
+                sum += diff * diff;
+            }
+            return sum;
+        }
+
+        void sigmoidScalar(float *x, size_t n, float scale, float bias) {
+            for (size_t i = 0; i < n; ++i) {
+                x[i] = 1.0f / (1.0f + expf(-(x[i] * scale + bias)));
+            }
+        }
+
+        void sigmoidBiasScalar(float *x, const float *bias, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                x[i] = 1.0f / (1.0f + expf(-(x[i] + bias[i])));
+            }
+        }
+
+#ifdef CNN_SIMD_X86
+        /*****************************************************************************************
+         Constants of the exp approximation.
+         *****************************************************************************************/
+        const float EXP_HI = 88.3762626647949f;
+        const float EXP_LO = -88.3762626647949f;
+        const float LOG2E = 1.44269504088896341f;
+        const float LN2_HI = 0.693359375f;
+        const float LN2_LO = -2.12194440e-4f;
+        const float EXP_P0 = 1.9875691500E-4f;
+        const float EXP_P1 = 1.3981999507E-3f;
+        const float EXP_P2 = 8.3334519073E-3f;
+        const float EXP_P3 = 4.1665795894E-2f;
+        const float EXP_P4 = 1.6666665459E-1f;
+        const float EXP_P5 = 5.0000001201E-1f;
+
+        /*****************************************************************************************
+         SSE.
+         *****************************************************************************************/
+        CNN_TARGET("sse2")
+        inline float hsum128(__m128 v) {
+            __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+            __m128 sums = _mm_add_ps(v, shuf);
+            shuf = _mm_movehl_ps(shuf, sums);
+            sums = _mm_add_ss(sums, shuf);
+            return _mm_cvtss_f32(sums);
+        }
+
+        CNN_TARGET("sse2")
+        inline __m128 exp128(__m128 x) {
+            x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_LO)), _mm_set1_ps(EXP_HI));
+
+            // n = round(x / ln2), r = x - n * ln2.
+            __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(LOG2E)));
+            __m128 fn = _mm_cvtepi32_ps(n);
+            x = _mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(LN2_HI)));
+            x = _mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(LN2_LO)));
+
+            __m128 y = _mm_set1_ps(EXP_P0);
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+            y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+            y = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(y, x), x), _mm_add_ps(x, _mm_set1_ps(1.0f)));
+
+            // Multiply by 2^n.
+            __m128i e = _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23);
+            return _mm_mul_ps(y, _mm_castsi128_ps(e));
+        }
+
+        CNN_TARGET("sse2")
+        inline __m128 sigmoid128(__m128 x) {
+            __m128 one = _mm_set1_ps(1.0f);
+            return _mm_div_ps(one, _mm_add_ps(one, exp128(_mm_sub_ps(_mm_setzero_ps(), x))));
+        }
+
+        CNN_TARGET("sse2")
+        float dotSSE(const float *a, const float *b, size_t n) {
+            __m128 acc0 = _mm_setzero_ps();
+            __m128 acc1 = _mm_setzero_ps();
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+                acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+            }
+            for (; i + 4 <= n; i += 4) {
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            }
+            float sum = hsum128(_mm_add_ps(acc0, acc1));
+            for (; i < n; ++i) {
+                sum += a[i] * b[i];
+            }
+            return sum;
+        }
+
+        CNN_TARGET("sse2")
+        float sqrDistSSE(const float *a, const float *b, size_t n) {
+            __m128 acc = _mm_setzero_ps();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m128 diff = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+                acc = _mm_add_ps(acc, _mm_mul_ps(diff, diff));
+            }
+            float sum = hsum128(acc);
+            for (; i < n; ++i) {
+                float diff = a[i] - b[i];
+                sum += diff * diff;
+            }
+            return sum;
+        }
+
+        CNN_TARGET("sse2")
+        void sigmoidSSE(float *x, size_t n, float scale, float bias) {
+            __m128 s = _mm_set1_ps(scale);
+            __m128 b = _mm_set1_ps(bias);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                _mm_storeu_ps(x + i, sigmoid128(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), s), b)));
+            }
+            sigmoidScalar(x + i, n - i, scale, bias);
+        }
+
+        CNN_TARGET("sse2")
+        void sigmoidBiasSSE(float *x, const float *bias, size_t n) {
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                _mm_storeu_ps(x + i, sigmoid128(_mm_add_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(bias + i))));
+            }
+            sigmoidBiasScalar(x + i, bias + i, n - i);
+        }
+
+        CNN_TARGET("sse2")
+        void gemmMicroKernelSSE(size_t kc, const float *a, const float *b, float *C, size_t ldc, size_t mr, size_t nr, bool accumulate) {
+            __m128 acc[gemm::MR][gemm::NR / 4];
+            for (size_t i = 0; i < gemm::MR; ++i) {
+                for (size_t j = 0; j < gemm::NR / 4; ++j) {
+                    acc[i][j] = _mm_setzero_ps();
+                }
+            }
+            for (size_t k = 0; k < kc; ++k) {
+                __m128 b0 = _mm_loadu_ps(b);
+                __m128 b1 = _mm_loadu_ps(b + 4);
+                __m128 b2 = _mm_loadu_ps(b + 8);
+                __m128 b3 = _mm_loadu_ps(b + 12);
+                for (size_t i = 0; i < gemm::MR; ++i) {
+                    __m128 ai = _mm_set1_ps(a[i]);
+                    acc[i][0] = _mm_add_ps(acc[i][0], _mm_mul_ps(ai, b0));
+                    acc[i][1] = _mm_add_ps(acc[i][1], _mm_mul_ps(ai, b1));
+                    acc[i][2] = _mm_add_ps(acc[i][2], _mm_mul_ps(ai, b2));
+                    acc[i][3] = _mm_add_ps(acc[i][3], _mm_mul_ps(ai, b3));
+                }
+                a += gemm::MR;
+                b += gemm::NR;
+            }
+            float tile[gemm::MR][gemm::NR];
+            for (size_t i = 0; i < gemm::MR; ++i) {
+                for (size_t j = 0; j < gemm::NR / 4; ++j) {
+                    _mm_storeu_ps(&tile[i][j * 4], acc[i][j]);
+                }
+            }
+            gemm::storeTile(tile, C, ldc, mr, nr, accumulate);
+        }
+
+        /*****************************************************************************************
+         AVX2 + FMA.
+         *****************************************************************************************/
+        CNN_TARGET("avx2,fma")
+        inline float hsum256(__m256 v) {
+            __m128 lo = _mm256_castps256_ps128(v);
+            __m128 hi = _mm256_extractf128_ps(v, 1);
+            return hsum128(_mm_add_ps(lo, hi));
+        }
+
+        CNN_TARGET("avx2,fma")
+        inline __m256 exp256(__m256 x) {
+            x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+
+            __m256 fn = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            x = _mm256_fnmadd_ps(fn, _mm256_set1_ps(LN2_HI), x);
+            x = _mm256_fnmadd_ps(fn, _mm256_set1_ps(LN2_LO), x);
+
+            __m256 y = _mm256_set1_ps(EXP_P0);
+            y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P1));
+            y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P2));
+            y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P3));
+            y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P4));
+            y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P5));
+            y = _mm256_fmadd_ps(_mm256_mul_ps(y, x), x, _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+            __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(fn), _mm256_set1_epi32(127)), 23);
+            return _mm256_mul_ps(y, _mm256_castsi256_ps(e));
+        }
+
+        CNN_TARGET("avx2,fma")
+        inline __m256 sigmoid256(__m256 x) {
+            __m256 one = _mm256_set1_ps(1.0f);
+            return _mm256_div_ps(one, _mm256_add_ps(one, exp256(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+        }
+
+        CNN_TARGET("avx2,fma")
+        float dotAVX2(const float *a, const float *b, size_t n) {
+            __m256 acc0 = _mm256_setzero_ps();
+            __m256 acc1 = _mm256_setzero_ps();
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+                acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+            }
+            for (; i + 8 <= n; i += 8) {
+                acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+            }
+            float sum = hsum256(_mm256_add_ps(acc0, acc1));
+            for (; i < n; ++i) {
+                sum += a[i] * b[i];
+            }
+            return sum;
+        }
+
+        CNN_TARGET("avx2,fma")
+        float sqrDistAVX2(const float *a, const float *b, size_t n) {
+            __m256 acc = _mm256_setzero_ps();
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+                acc = _mm256_fmadd_ps(diff, diff, acc);
+            }
+            float sum = hsum256(acc);
+            for (; i < n; ++i) {
+                float diff = a[i] - b[i];
+                sum += diff * diff;
+            }
+            return sum;
+        }
+
+        CNN_TARGET("avx2,fma")
+        void sigmoidAVX2(float *x, size_t n, float scale, float bias) {
+            __m256 s = _mm256_set1_ps(scale);
+            __m256 b = _mm256_set1_ps(bias);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                _mm256_storeu_ps(x + i, sigmoid256(_mm256_fmadd_ps(_mm256_loadu_ps(x + i), s, b)));
+            }
+            sigmoidSSE(x + i, n - i, scale, bias);
+        }
+
+        CNN_TARGET("avx2,fma")
+        void sigmoidBiasAVX2(float *x, const float *bias, size_t n) {
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                _mm256_storeu_ps(x + i, sigmoid256(_mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(bias + i))));
+            }
+            sigmoidBiasSSE(x + i, bias + i, n - i);
+        }
+
+        CNN_TARGET("avx2,fma")
+        void gemmMicroKernelAVX2(size_t kc, const float *a, const float *b, float *C, size_t ldc, size_t mr, size_t nr, bool accumulate) {
+            __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+            __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+            __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+            __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+            for (size_t k = 0; k < kc; ++k) {
+                __m256 b0 = _mm256_loadu_ps(b);
+                __m256 b1 = _mm256_loadu_ps(b + 8);
+                __m256 ai = _mm256_broadcast_ss(a);
+                c00 = _mm256_fmadd_ps(ai, b0, c00);
+                c01 = _mm256_fmadd_ps(ai, b1, c01);
+                ai = _mm256_broadcast_ss(a + 1);
+                c10 = _mm256_fmadd_ps(ai, b0, c10);
+                c11 = _mm256_fmadd_ps(ai, b1, c11);
+                ai = _mm256_broadcast_ss(a + 2);
+                c20 = _mm256_fmadd_ps(ai, b0, c20);
+                c21 = _mm256_fmadd_ps(ai, b1, c21);
+                ai = _mm256_broadcast_ss(a + 3);
+                c30 = _mm256_fmadd_ps(ai, b0, c30);
+                c31 = _mm256_fmadd_ps(ai, b1, c31);
+                a += gemm::MR;
+                b += gemm::NR;
+            }
+            float tile[gemm::MR][gemm::NR];
+            _mm256_storeu_ps(&tile[0][0], c00);
+            _mm256_storeu_ps(&tile[0][8], c01);
+            _mm256_storeu_ps(&tile[1][0], c10);
+            _mm256_storeu_ps(&tile[1][8], c11);
+            _mm256_storeu_ps(&tile[2][0], c20);
+            _mm256_storeu_ps(&tile[2][8], c21);
+            _mm256_storeu_ps(&tile[3][0], c30);
+            _mm256_storeu_ps(&tile[3][8], c31);
+            gemm::storeTile(tile, C, ldc, mr, nr, accumulate);
+        }
+
+        /*****************************************************************************************
+         AVX-512.
+         The unmasked min, max, roundscale, scalef and 512 to 256 bit extracts of GCC 12 pass
+         _mm512_undefined_* as the merge source, which -Wall reports as uninitialized (GCC bug
+         105593). Their zero masked forms with every lane set are the same instructions.
+         *****************************************************************************************/
+        const __mmask16 ALL16 = 0xFFFF;
+        const __mmask8 ALL8 = 0xFF;
+
+        CNN_TARGET("avx512f")
+        inline float hsum512(__m512 v) {
+            __m512d d = _mm512_castps_pd(v);
+            __m256 h = _mm256_add_ps(_mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(ALL8, d, 0)),
+                _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(ALL8, d, 1)));
+            return hsum128(_mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1)));
+        }
+
+        CNN_TARGET("avx512f")
+        inline __m512 exp512(__m512 x) {
+            x = _mm512_maskz_min_ps(ALL16, _mm512_maskz_max_ps(ALL16, x, _mm512_set1_ps(EXP_LO)), _mm512_set1_ps(EXP_HI));
+
+            __m512 fn = _mm512_maskz_roundscale_ps(ALL16, _mm512_mul_ps(x, _mm512_set1_ps(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            x = _mm512_fnmadd_ps(fn, _mm512_set1_ps(LN2_HI), x);
+            x = _mm512_fnmadd_ps(fn, _mm512_set1_ps(LN2_LO), x);
+
+            __m512 y = _mm512_set1_ps(EXP_P0);
+            y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P1));
+            y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P2));
+            y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P3));
+            y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P4));
+            y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P5));
+            y = _mm512_fmadd_ps(_mm512_mul_ps(y, x), x, _mm512_add_ps(x, _mm512_set1_ps(1.0f)));
+
+            // Multiply by 2^n.
+            return _mm512_maskz_scalef_ps(ALL16, y, fn);
+        }
+
+        CNN_TARGET("avx512f")
+        inline __m512 sigmoid512(__m512 x) {
+            __m512 one = _mm512_set1_ps(1.0f);
+            return _mm512_div_ps(one, _mm512_add_ps(one, exp512(_mm512_sub_ps(_mm512_setzero_ps(), x))));
+        }
+
+        CNN_TARGET("avx512f")
+        float dotAVX512(const float *a, const float *b, size_t n) {
+            __m512 acc0 = _mm512_setzero_ps();
+            __m512 acc1 = _mm512_setzero_ps();
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32) {
+                acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+                acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+            }
+            if (i + 16 <= n) {
+                acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+                i += 16;
+            }
+            // Masked tail.
+            if (i < n) {
+                __mmask16 mask = (__mmask16)((1u << (n - i)) - 1);
+                acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), acc1);
+            }
+            return hsum512(_mm512_add_ps(acc0, acc1));
+        }
+
+        CNN_TARGET("avx512f")
+        float sqrDistAVX512(const float *a, const float *b, size_t n) {
+            __m512 acc = _mm512_setzero_ps();
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+                acc = _mm512_fmadd_ps(diff, diff, acc);
+            }
+            if (i < n) {
+                __mmask16 mask = (__mmask16)((1u << (n - i)) - 1);
+                __m512 diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+                acc = _mm512_fmadd_ps(diff, diff, acc);
+            }
+            return hsum512(acc);
+        }
+
+        CNN_TARGET("avx512f")
+        void sigmoidAVX512(float *x, size_t n, float scale, float bias) {
+            __m512 s = _mm512_set1_ps(scale);
+            __m512 b = _mm512_set1_ps(bias);
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                _mm512_storeu_ps(x + i, sigmoid512(_mm512_fmadd_ps(_mm512_loadu_ps(x + i), s, b)));
+            }
+            if (i < n) {
+                __mmask16 mask = (__mmask16)((1u << (n - i)) - 1);
+                _mm512_mask_storeu_ps(x + i, mask, sigmoid512(_mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x + i), s, b)));
+            }
+        }
+
+        CNN_TARGET("avx512f")
+        void sigmoidBiasAVX512(float *x, const float *bias, size_t n) {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                _mm512_storeu_ps(x + i, sigmoid512(_mm512_add_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(bias + i))));
+            }
+            if (i < n) {
+                __mmask16 mask = (__mmask16)((1u << (n - i)) - 1);
+                _mm512_mask_storeu_ps(x + i, mask, sigmoid512(_mm512_add_ps(_mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, bias + i))));
+            }
+        }
+
+        CNN_TARGET("avx512f")
+        void gemmMicroKernelAVX512(size_t kc, const float *a, const float *b, float *C, size_t ldc, size_t mr, size_t nr, bool accumulate) {
+            __m512 c0 = _mm512_setzero_ps();
+            __m512 c1 = _mm512_setzero_ps();
+            __m512 c2 = _mm512_setzero_ps();
+            __m512 c3 = _mm512_setzero_ps();
+            for (size_t k = 0; k < kc; ++k) {
+                __m512 b0 = _mm512_loadu_ps(b);
+                c0 = _mm512_fmadd_ps(_mm512_set1_ps(a[0]), b0, c0);
+                c1 = _mm512_fmadd_ps(_mm512_set1_ps(a[1]), b0, c1);
+                c2 = _mm512_fmadd_ps(_mm512_set1_ps(a[2]), b0, c2);
+                c3 = _mm512_fmadd_ps(_mm512_set1_ps(a[3]), b0, c3);
+                a += gemm::MR;
+                b += gemm::NR;
+            }
+            float tile[gemm::MR][gemm::NR];
+            _mm512_storeu_ps(tile[0], c0);
+            _mm512_storeu_ps(tile[1], c1);
+            _mm512_storeu_ps(tile[2], c2);
+            _mm512_storeu_ps(tile[3], c3);
+            gemm::storeTile(tile, C, ldc, mr, nr, accumulate);
+        }
+
+        /*****************************************************************************************
+         CPUID.
+         *****************************************************************************************/
+        inline void cpuid(unsigned int info[4], unsigned int leaf, unsigned int subleaf) {
+#if defined(_MSC_VER)
+            __cpuidex((int *)info, (int)leaf, (int)subleaf);
+#else
+            __cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+        }
+
+        // Read XCR0 to check which register states the OS saves.
+        inline unsigned long long xgetbv0() {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#else
+            unsigned int eax, edx;
+            __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return ((unsigned long long)edx << 32) | eax;
+#endif
+        }
+#endif
+
+        // Detect the best ISA supported by both the CPU and the OS.
+        ISA detectISA() {
+#ifdef CNN_SIMD_X86
+            unsigned int info[4];
+            cpuid(info, 0, 0);
+            unsigned int maxLeaf = info[0];
+
+            cpuid(info, 1, 0);
+            bool sse2 = (info[3] & (1u << 26)) != 0;
+            bool osxsave = (info[2] & (1u << 27)) != 0;
+            bool fma = (info[2] & (1u << 12)) != 0;
+            if (!sse2) {
+                return SCALAR;
+            }
+            if (!osxsave || maxLeaf < 7) {
+                return SSE;
+            }
+
+            unsigned long long xcr0 = xgetbv0();
+            cpuid(info, 7, 0);
+            bool avx2 = (info[1] & (1u << 5)) != 0;
+            bool avx512f = (info[1] & (1u << 16)) != 0;
+
+            // XMM, YMM and the three AVX-512 states.
+            if (avx512f && (xcr0 & 0xE6) == 0xE6) {
+                return AVX512;
+            }
+            if (avx2 && fma && (xcr0 & 0x6) == 0x6) {
+                return AVX2;
+            }
+            return SSE;
+#else
+            return SCALAR;
+#endif
+        }
+
+        Kernels makeKernels(ISA isa) {
+            Kernels k;
+            k.isa = SCALAR;
+            k.dot = dotScalar;
+            k.sqrDist = sqrDistScalar;
+            k.sigmoid = sigmoidScalar;
+            k.sigmoidBias = sigmoidBiasScalar;
+            k.gemmMicroKernel = gemm::microKernel;
+#ifdef CNN_SIMD_X86
+            switch (isa) {
+            case SSE:
+                k.isa = SSE;
+                k.dot = dotSSE;
+                k.sqrDist = sqrDistSSE;
+                k.sigmoid = sigmoidSSE;
+                k.sigmoidBias = sigmoidBiasSSE;
+                k.gemmMicroKernel = gemmMicroKernelSSE;
+                break;
+            case AVX2:
+                k.isa = AVX2;
+                k.dot = dotAVX2;
+                k.sqrDist = sqrDistAVX2;
+                k.sigmoid = sigmoidAVX2;
+                k.sigmoidBias = sigmoidBiasAVX2;
+                k.gemmMicroKernel = gemmMicroKernelAVX2;
+                break;
+            case AVX512:
+                k.isa = AVX512;
+                k.dot = dotAVX512;
+                k.sqrDist = sqrDistAVX512;
+                k.sigmoid = sigmoidAVX512;
+                k.sigmoidBias = sigmoidBiasAVX512;
+                k.gemmMicroKernel = gemmMicroKernelAVX512;
+                break;
+            default:
+                break;
+            }
+#endif
+            return k;
+        }
+
+        // Pick the kernels on first use: CNN_ISA if set and supported, otherwise the best one.
+        Kernels &activeKernels() {
+            static Kernels kernels = makeKernels(detectISA());
+            static bool initialized = false;
+            if (!initialized) {
+                initialized = true;
+                const char *env = getenv("CNN_ISA");
+                if (env) {
+                    std::string name(env);
+                    for (int isa = SCALAR; isa <= AVX512; ++isa) {
+                        if (name == isaName((ISA)isa)) {
+                            if (isa <= detectISA()) {
+                                kernels = makeKernels((ISA)isa);
+                            }
+                            else {
+                                std::cerr << "CNN_ISA: " << name << " is not supported, using " << isaName(kernels.isa) << std::endl;
+                            }
+                        }
+                    }
+                }
+            }
+            return kernels;
+        }
+
+        inline const Kernels &kernels() {
+            return activeKernels();
+        }
+
+        // Force an ISA. Returns false if the CPU does not support it.
+        bool setISA(ISA isa) {
+            if (isa > detectISA()) {
+                return false;
+            }
+            activeKernels() = makeKernels(isa);
+            return true;
+        }
+
+        ISA getISA() {
+            return kernels().isa;
+        }
+
+        // x[i] = activation(x[i] * scale + bias), the sigmoid through the dispatched kernel.
+        inline void activate(Activation activation, float *x, size_t n, float scale, float bias) {
+            switch (activation) {
+            case SIGMOID:
+                kernels().sigmoid(x, n, scale, bias);
+                break;
+            case RELU:
+                for (size_t i = 0; i < n; ++i) {
+                    float y = x[i] * scale + bias;
+                    x[i] = y > 0.0f ? y : 0.0f;
+                }
+                break;
+            case HARD_SIGMOID:
+                for (size_t i = 0; i < n; ++i) {
+                    float y = 0.2f * (x[i] * scale + bias) + 0.5f;
+                    x[i] = y < 0.0f ? 0.0f : (y > 1.0f ? 1.0f : y);
+                }
+                break;
+            case LUT_SIGMOID: {
+                const lut::Table &table = lut::table();
+                for (size_t i = 0; i < n; ++i) {
+                    x[i] = lut::sigmoid(x[i] * scale + bias, table);
+                }
+                break;
+            }
+            default:
+                for (size_t i = 0; i < n; ++i) {
+                    x[i] = cnn::activate(activation, x[i] * scale + bias);
+                }
+                break;
+            }
+        }
+
+        // x[i] = activation(x[i] + bias[i]).
+        inline void activateBias(Activation activation, float *x, const float *bias, size_t n) {
+            if (activation == SIGMOID) {
+                kernels().sigmoidBias(x, bias, n);
+                return;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                x[i] = cnn::activate(activation, x[i] + bias[i]);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef SPAN_HEADER
+#define SPAN_HEADER
+
+#include <cstddef>
+
+/******************************************************************************************
+
+    Non-owning views over a batch of inputs or outputs.
+
+    A span is n samples of size floats each, the first float of sample i at
+    data + i * stride. With stride == size the batch is one contiguous block,
+    a larger stride lets the caller pass samples that live inside bigger
+    records (e.g. a padded image or an interleaved dataset) without packing
+    them into a temporary vec first.
+
+*******************************************************************************************/
+
+namespace cnn {
+
+    template <typename T>
+    class BatchSpan {
+    public:
+
+        BatchSpan() : data(NULL), n(0), size(0), stride(0) {
+        }
+
+        // stride = 0 means the samples are packed back to back.
+        BatchSpan(T *data, size_t n, size_t size, size_t stride = 0)
+            : data(data), n(n), size(size), stride(stride == 0 ? size : stride) {
+        }
+
+        // A span of float converts to a span of const float.
+        template <typename U>
+        BatchSpan(const BatchSpan<U> &other)
+            : data(other.getData()), n(other.getN()), size(other.getSize()), stride(other.getStride()) {
+        }
+
+        // First float of sample i.
+        T *operator[](size_t i) const {
+            return data + i * stride;
+        }
+
+        // Samples [begin, end) of this span.
+        BatchSpan slice(size_t begin, size_t end) const {
+            return BatchSpan(data + begin * stride, end - begin, size, stride);
+        }
+
+        T *getData() const {
+            return data;
+        }
+
+        size_t getN() const {
+            return n;
+        }
+
+        size_t getSize() const {
+            return size;
+        }
+
+        size_t getStride() const {
+            return stride;
+        }
+
+        bool isContiguous() const {
+            return stride == size;
+        }
+
+    private:
+        T *data;
+        size_t n;
+        size_t size;
+        size_t stride;
+    };
+
+    typedef BatchSpan<const float> InSpan;
+    typedef BatchSpan<float> OutSpan;
+
+    // Raw uint8 images, size bytes each.
+    typedef BatchSpan<const unsigned char> RawSpan;
+}
+
+#endif
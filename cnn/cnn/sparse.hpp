@@ -0,0 +1,168 @@
+#ifndef SPARSE_HEADER
+#define SPARSE_HEADER
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+/******************************************************************************************
+
+    Unstructured sparsity of the fully connected weight.
+
+    Magnitude pruning keeps the largest |w| of the whole layer and zeroes
+    the others. The nonzeros are stored in CSR, row o holding
+        value[rowBegin[o] .. rowBegin[o + 1]]    its weights,
+        column[rowBegin[o] .. rowBegin[o + 1]]   their inputs.
+
+    Every nonzero costs a value and a column index, so CSR streams fewer
+    bytes than the dense weight below a density of one half: the model
+    stores it and the device kernel, bound by the weight bandwidth, uses it
+    from there. The input vector is small enough to stay in cache or local
+    memory, so the gather through column is cheap. On the CPU the dense
+    layer runs a vectorized dot product, a gathered product costs about as
+    much as four of its multiplies, so CSR only pays off below a quarter.
+
+    The model stores a sparse layer as <sparseWeight>; the device kernel
+    takes the CSR arrays when the layer has <weightFormat>csr</weightFormat>.
+
+    This header only needs the standard library so the generator can share it.
+
+*******************************************************************************************/
+
+namespace cnn {
+
+    // Weight layout of the device kernel.
+    enum WeightFormat {
+        DENSE,
+        CSR
+    };
+
+    const size_t NUM_WEIGHT_FORMATS = 2;
+
+    inline const char *getWeightFormatName(WeightFormat format) {
+        static const char *NAMES[NUM_WEIGHT_FORMATS] = { "dense", "csr" };
+        return NAMES[format];
+    }
+
+    inline WeightFormat parseWeightFormat(const std::string &name) {
+        for (size_t i = 0; i < NUM_WEIGHT_FORMATS; ++i) {
+            if (name == getWeightFormatName((WeightFormat)i)) {
+                return (WeightFormat)i;
+            }
+        }
+        std::cerr << "parseWeightFormat: Unsupported weight format: " << name << std::endl;
+        exit(-1);
+    }
+
+    namespace sparse {
+
+        // Densities at or below this are stored and run on the device in CSR.
+        const float DENSITY_THRESHOLD = 0.5f;
+
+        // Densities at or below this run the CSR kernel on the CPU.
+        const float CPU_DENSITY_THRESHOLD = 0.25f;
+
+        struct Matrix {
+            Matrix() : rows(0), cols(0), rowBegin(1, 0) {
+            }
+
+            size_t nonzeros() const {
+                return value.size();
+            }
+
+            float density() const {
+                return rows * cols == 0 ? 0.0f : (float)nonzeros() / (float)(rows * cols);
+            }
+
+            // Bytes of the CSR arrays with 4 byte indices and values of the given size.
+            size_t bytes(size_t element) const {
+                return nonzeros() * (element + 4) + (rows + 1) * 4;
+            }
+
+            size_t rows;
+            size_t cols;
+            std::vector<float> value;
+            std::vector<size_t> column;
+            std::vector<size_t> rowBegin;
+        };
+
+        // Fraction of the n weights that are nonzero.
+        inline float density(const float *weight, size_t n) {
+            size_t nonzeros = 0;
+            for (size_t i = 0; i < n; ++i) {
+                nonzeros += weight[i] != 0.0f;
+            }
+            return n == 0 ? 0.0f : (float)nonzeros / (float)n;
+        }
+
+        // Keep the nonzeros of a rows x cols row major weight.
+        inline Matrix fromDense(const float *weight, size_t rows, size_t cols) {
+            Matrix m;
+            m.rows = rows;
+            m.cols = cols;
+            for (size_t r = 0; r < rows; ++r) {
+                for (size_t c = 0; c < cols; ++c) {
+                    if (weight[r * cols + c] != 0.0f) {
+                        m.value.push_back(weight[r * cols + c]);
+                        m.column.push_back(c);
+                    }
+                }
+                m.rowBegin.push_back(m.value.size());
+            }
+            return m;
+        }
+
+        inline void toDense(const Matrix &m, float *weight) {
+            std::fill(weight, weight + m.rows * m.cols, 0.0f);
+            for (size_t r = 0; r < m.rows; ++r) {
+                for (size_t p = m.rowBegin[r]; p < m.rowBegin[r + 1]; ++p) {
+                    weight[r * m.cols + m.column[p]] = m.value[p];
+                }
+            }
+        }
+
+        // Exit unless the arrays describe a rows x cols CSR matrix.
+        inline void validate(const Matrix &m, const std::string &name) {
+            bool isValid = m.rowBegin.size() == m.rows + 1 && m.rowBegin[0] == 0 &&
+                m.rowBegin[m.rows] == m.value.size() && m.column.size() == m.value.size();
+            for (size_t r = 0; isValid && r < m.rows; ++r) {
+                isValid = m.rowBegin[r] <= m.rowBegin[r + 1];
+                for (size_t p = m.rowBegin[r]; isValid && p < m.rowBegin[r + 1]; ++p) {
+                    isValid = m.column[p] < m.cols && (p == m.rowBegin[r] || m.column[p] > m.column[p - 1]);
+                }
+            }
+            if (!isValid) {
+                std::cerr << "sparse: " << name << " has a bad sparse weight" << std::endl;
+                exit(-1);
+            }
+        }
+
+        // Zero all but the round(density * n) weights of largest magnitude.
+        // Returns the number of weights kept.
+        inline size_t prune(float *weight, size_t n, float density) {
+            size_t keep = (size_t)std::floor(std::max(0.0f, std::min(density, 1.0f)) * n + 0.5f);
+            if (keep >= n) {
+                return n;
+            }
+            std::vector<size_t> order(n);
+            for (size_t i = 0; i < n; ++i) {
+                order[i] = i;
+            }
+            // Ties go to the lower index so the result does not depend on the sort.
+            std::nth_element(order.begin(), order.begin() + keep, order.end(), [weight](size_t a, size_t b) {
+                float x = std::fabs(weight[a]);
+                float y = std::fabs(weight[b]);
+                return x > y || (x == y && a < b);
+            });
+            for (size_t i = keep; i < n; ++i) {
+                weight[order[i]] = 0.0f;
+            }
+            return keep;
+        }
+    }
+}
+
+#endif
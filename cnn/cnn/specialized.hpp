@@ -0,0 +1,189 @@
+#ifndef SPECIALIZED_HEADER
+#define SPECIALIZED_HEADER
+
+#include "threadpool.hpp"
+#include "simd.hpp"
+
+/******************************************************************************************
+
+    CPU layers specialized on their shape at compile time.
+
+    The generated OpenCL kernels get every dimension as a #define. These
+    templates do the same for the host: with the kernel size, the feature
+    map sizes and the depths as template arguments every stride is a
+    constant, the kernel window loops are fully unrolled and the loop over
+    an output row has a fixed trip count the compiler vectorizes.
+
+    Only the shapes listed in the find* functions below are instantiated,
+    every other shape returns NULL and the layer keeps its generic path. To
+    specialize a new model, add its shapes with the CNN_SPECIALIZE_* macros.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace specialized {
+
+        // Same arguments for every specialized layer.
+        typedef void (*Forward)(const float *in,
+            const float *weight,
+            const float *offset,
+            float *out,
+            Activation activation,
+            const Workspace &ws);
+
+        // Dot product of two N floats with independent accumulators.
+        template <size_t N>
+        inline float dot(const float *a, const float *b) {
+            const size_t LANES = 8;
+            float acc[LANES] = { 0.0f };
+            for (size_t i = 0; i + LANES <= N; i += LANES) {
+                for (size_t j = 0; j < LANES; ++j) {
+                    acc[j] += a[i + j] * b[i + j];
+                }
+            }
+            for (size_t i = N / LANES * LANES; i < N; ++i) {
+                acc[0] += a[i] * b[i];
+            }
+            float sum = 0.0f;
+            for (size_t j = 0; j < LANES; ++j) {
+                sum += acc[j];
+            }
+            return sum;
+        }
+
+        // Convolution of ID input maps of IW x IH with OD kernels of K x K.
+        template <size_t K, size_t IW, size_t IH, size_t ID, size_t OD>
+        struct Conv {
+            static const size_t OW = IW - K + 1;
+            static const size_t OH = IH - K + 1;
+
+            // Split across (output map, output row) pairs like the generic direct path.
+            static void forward(const float *in, const float *weight, const float *offset, float *out, Activation activation, const Workspace &ws) {
+                parallelFor(ws, 0, OD * OH, 1, [&](size_t begin, size_t end, size_t /*worker*/) {
+                    for (size_t t = begin; t < end; ++t) {
+                        size_t o = t / OH;
+                        size_t r = t % OH;
+                        float *outRow = out + (o * OH + r) * OW;
+
+                        if (OW == 1 && OH == 1) {
+                            // The kernel covers the whole input: one dot product.
+                            outRow[0] = dot<ID * K * K>(weight + o * ID * K * K, in);
+                        }
+                        else {
+                            // Accumulate the whole output row, one weight at a time.
+                            float acc[OW] = { 0.0f };
+                            for (size_t i = 0; i < ID; ++i) {
+                                const float *w = weight + (o * ID + i) * K * K;
+                                for (size_t x = 0; x < K; ++x) {
+                                    const float *inRow = in + (i * IH + r + x) * IW;
+                                    for (size_t y = 0; y < K; ++y) {
+                                        float wxy = w[x * K + y];
+                                        for (size_t c = 0; c < OW; ++c) {
+                                            acc[c] += wxy * inRow[c + y];
+                                        }
+                                    }
+                                }
+                            }
+                            for (size_t c = 0; c < OW; ++c) {
+                                outRow[c] = acc[c];
+                            }
+                        }
+
+                        // Activate function.
+                        simd::activate(activation, outRow, OW, 1.0f, offset[o]);
+                    }
+                });
+            }
+        };
+
+        // Sum pooling of D maps of IW x IH with a K x K window, scaled by weight.
+        template <size_t K, size_t IW, size_t IH, size_t D>
+        struct Pool {
+            static const size_t OW = IW / K;
+            static const size_t OH = IH / K;
+
+            static void forward(const float *in, const float *weight, const float *offset, float *out, Activation activation, const Workspace &ws) {
+                parallelFor(ws, 0, D, 1, [&](size_t begin, size_t end, size_t /*worker*/) {
+                    for (size_t o = begin; o < end; ++o) {
+                        const float *inMap = in + o * IW * IH;
+                        float *outMap = out + o * OW * OH;
+                        for (size_t r = 0; r < OH; ++r) {
+                            for (size_t c = 0; c < OW; ++c) {
+                                float sum = 0.0f;
+                                for (size_t x = 0; x < K; ++x) {
+                                    for (size_t y = 0; y < K; ++y) {
+                                        sum += inMap[(r * K + x) * IW + c * K + y];
+                                    }
+                                }
+                                outMap[r * OW + c] = sum;
+                            }
+                        }
+
+                        // Activate function.
+                        simd::activate(activation, outMap, OW * OH, weight[o], offset[o]);
+                    }
+                });
+            }
+        };
+
+        // Fully connected layer of IN inputs and OUT outputs.
+        template <size_t IN, size_t OUT>
+        struct Full {
+            static void forward(const float *in, const float *weight, const float *offset, float *out, Activation activation, const Workspace &ws) {
+                parallelFor(ws, 0, OUT, 4, [&](size_t begin, size_t end, size_t /*worker*/) {
+                    for (size_t o = begin; o < end; ++o) {
+                        out[o] = dot<IN>(weight + o * IN, in);
+                    }
+
+                    // Activate function.
+                    simd::activateBias(activation, out + begin, offset + begin, end - begin);
+                });
+            }
+        };
+
+#define CNN_SPECIALIZE_CONV(K, IW, IH, ID, OD) \
+    if (kernelSize == K && iWidth == IW && iHeight == IH && iDepth == ID && oDepth == OD) { \
+        return &Conv<K, IW, IH, ID, OD>::forward; \
+    }
+
+#define CNN_SPECIALIZE_POOL(K, IW, IH, D) \
+    if (kernelSize == K && iWidth == IW && iHeight == IH && depth == D) { \
+        return &Pool<K, IW, IH, D>::forward; \
+    }
+
+#define CNN_SPECIALIZE_FULL(IN, OUT) \
+    if (inSize == IN && outSize == OUT) { \
+        return &Full<IN, OUT>::forward; \
+    }
+
+        // Specialized convolution for this shape, NULL if there is none.
+        Forward findConv(size_t kernelSize, size_t iWidth, size_t iHeight, size_t iDepth, size_t oDepth) {
+            // LeNet-5.
+            CNN_SPECIALIZE_CONV(5, 32, 32, 1, 6)
+            CNN_SPECIALIZE_CONV(5, 14, 14, 6, 16)
+            CNN_SPECIALIZE_CONV(5, 5, 5, 16, 120)
+            return NULL;
+        }
+
+        // Specialized pooling for this shape, NULL if there is none.
+        Forward findPool(size_t kernelSize, size_t iWidth, size_t iHeight, size_t depth) {
+            // LeNet-5.
+            CNN_SPECIALIZE_POOL(2, 28, 28, 6)
+            CNN_SPECIALIZE_POOL(2, 10, 10, 16)
+            return NULL;
+        }
+
+        // Specialized fully connected layer for this shape, NULL if there is none.
+        Forward findFull(size_t inSize, size_t outSize) {
+            // LeNet-5.
+            CNN_SPECIALIZE_FULL(120, 84)
+            return NULL;
+        }
+
+#undef CNN_SPECIALIZE_CONV
+#undef CNN_SPECIALIZE_POOL
+#undef CNN_SPECIALIZE_FULL
+    }
+}
+
+#endif
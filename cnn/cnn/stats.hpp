@@ -0,0 +1,155 @@
+#ifndef STATS_HEADER
+#define STATS_HEADER
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+/******************************************************************************************
+
+    Summary statistics of repeated measurements.
+
+    The confidence interval of the mean is mean +- t * s / sqrt(n) with the
+    two sided Student t quantile of n - 1 degrees of freedom: exact to three
+    digits from the table up to 30, Cornish-Fisher expansion of the normal
+    quantile above. Repetitions of a benchmark are few, so the t quantile
+    matters: with 10 of them it is 2.26 instead of 1.96 at 95%.
+
+    Welch's t test compares the means of two sets of measurements without
+    assuming equal variances: t = (mean b - mean a) / sqrt(sa^2/na + sb^2/nb)
+    with the Welch-Satterthwaite degrees of freedom, the difference being
+    significant when |t| exceeds the two sided t quantile.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace stats {
+
+        struct Summary {
+            size_t n;
+            double mean;
+            double stddev;
+            double min;
+            double median;
+            double max;
+            double confidence;
+            double ciLow;
+            double ciHigh;
+        };
+
+        // Two sided Student t quantile, confidence 0.90, 0.95 or 0.99.
+        inline double tQuantile(double confidence, size_t df) {
+            static const double T90[30] = {
+                6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860, 1.833, 1.812,
+                1.796, 1.782, 1.771, 1.761, 1.753, 1.746, 1.740, 1.734, 1.729, 1.725,
+                1.721, 1.717, 1.714, 1.711, 1.708, 1.706, 1.703, 1.701, 1.699, 1.697
+            };
+            static const double T95[30] = {
+                12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+            };
+            static const double T99[30] = {
+                63.657, 9.925, 5.841, 4.604, 4.032, 3.707, 3.499, 3.355, 3.250, 3.169,
+                3.106, 3.055, 3.012, 2.977, 2.947, 2.921, 2.898, 2.878, 2.861, 2.845,
+                2.831, 2.819, 2.807, 2.797, 2.787, 2.779, 2.771, 2.763, 2.756, 2.750
+            };
+            const double *table;
+            double z;
+            if (std::fabs(confidence - 0.90) < 1e-9) {
+                table = T90;
+                z = 1.6449;
+            }
+            else if (std::fabs(confidence - 0.95) < 1e-9) {
+                table = T95;
+                z = 1.9600;
+            }
+            else if (std::fabs(confidence - 0.99) < 1e-9) {
+                table = T99;
+                z = 2.5758;
+            }
+            else {
+                std::cerr << "stats: Unsupported confidence " << confidence << ", use 0.90, 0.95 or 0.99" << std::endl;
+                exit(-1);
+            }
+            if (df == 0) {
+                return INFINITY;
+            }
+            if (df <= 30) {
+                return table[df - 1];
+            }
+            double d = (double)df;
+            double z3 = z * z * z;
+            double z5 = z3 * z * z;
+            return z + (z3 + z) / (4.0 * d) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * d * d);
+        }
+
+        inline Summary summarize(const std::vector<double> &samples, double confidence) {
+            Summary s = { samples.size(), 0.0, 0.0, 0.0, 0.0, 0.0, confidence, 0.0, 0.0 };
+            if (samples.empty()) {
+                return s;
+            }
+            std::vector<double> sorted(samples);
+            std::sort(sorted.begin(), sorted.end());
+            s.min = sorted.front();
+            s.max = sorted.back();
+            size_t half = sorted.size() / 2;
+            s.median = sorted.size() % 2 ? sorted[half] : 0.5 * (sorted[half - 1] + sorted[half]);
+            for (size_t i = 0; i < samples.size(); ++i) {
+                s.mean += samples[i];
+            }
+            s.mean /= (double)s.n;
+            for (size_t i = 0; s.n > 1 && i < samples.size(); ++i) {
+                s.stddev += (samples[i] - s.mean) * (samples[i] - s.mean);
+            }
+            s.stddev = s.n > 1 ? std::sqrt(s.stddev / (double)(s.n - 1)) : 0.0;
+            double halfWidth = s.n > 1 ? tQuantile(confidence, s.n - 1) * s.stddev / std::sqrt((double)s.n) : 0.0;
+            s.ciLow = s.mean - halfWidth;
+            s.ciHigh = s.mean + halfWidth;
+            return s;
+        }
+
+        // The p quantile of sorted samples, 0 <= p <= 1, interpolated between the closest ranks.
+        inline double percentile(const std::vector<double> &sorted, double p) {
+            if (sorted.empty()) {
+                return 0.0;
+            }
+            double rank = p * (double)(sorted.size() - 1);
+            size_t below = (size_t)std::floor(rank);
+            size_t above = std::min(below + 1, sorted.size() - 1);
+            return sorted[below] + (rank - (double)below) * (sorted[above] - sorted[below]);
+        }
+
+        struct Welch {
+            double t;
+            double df;
+            bool isSignificant;
+        };
+
+        // Welch's t test of b against a at the confidence of b.
+        inline Welch welch(const Summary &a, const Summary &b) {
+            Welch w = { 0.0, 0.0, false };
+            if (a.n < 2 || b.n < 2) {
+                return w;
+            }
+            double va = a.stddev * a.stddev / (double)a.n;
+            double vb = b.stddev * b.stddev / (double)b.n;
+            if (va + vb == 0.0) {
+                // No spread at all: any difference is significant.
+                w.isSignificant = a.mean != b.mean;
+                w.t = a.mean == b.mean ? 0.0 : (b.mean > a.mean ? INFINITY : -INFINITY);
+                w.df = (double)(a.n + b.n - 2);
+                return w;
+            }
+            w.t = (b.mean - a.mean) / std::sqrt(va + vb);
+            w.df = (va + vb) * (va + vb) / (va * va / (double)(a.n - 1) + vb * vb / (double)(b.n - 1));
+            size_t df = std::max<size_t>(1, (size_t)std::floor(w.df));
+            w.isSignificant = std::fabs(w.t) > tQuantile(b.confidence, df);
+            return w;
+        }
+    }
+}
+
+#endif
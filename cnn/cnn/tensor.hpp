@@ -0,0 +1,365 @@
+#ifndef TENSOR_HEADER
+#define TENSOR_HEADER
+
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+/******************************************************************************************
+
+    Aligned memory for weights and activations.
+
+    AlignedAllocator makes cnn::vec start on a cache line so the SIMD kernels
+    never split a load across two lines.
+
+    Arena hands out page aligned chunks of a few large blocks. A page (4 KB)
+    is what DMA engines need to use host memory directly, so every layer's
+    weight, offset and output can back its cl_mem with CL_MEM_USE_HOST_PTR
+    and the CPU and OpenCL paths share one copy of it.
+
+    Tensor is a float buffer with a shape and a layout. It either owns its
+    memory or lives in an arena, which then outlives it.
+
+*******************************************************************************************/
+
+namespace cnn {
+
+    const size_t CACHE_LINE_ALIGNMENT = 64;
+    const size_t PAGE_ALIGNMENT = 4096;
+
+    // Allocate bytes aligned to alignment, a power of two.
+    void *alignedAlloc(size_t bytes, size_t alignment) {
+        void *ptr = NULL;
+        if (bytes == 0) {
+            bytes = alignment;
+        }
+#if defined(_WIN32)
+        ptr = _aligned_malloc(bytes, alignment);
+#else
+        if (posix_memalign(&ptr, alignment, bytes) != 0) {
+            ptr = NULL;
+        }
+#endif
+        if (ptr == NULL) {
+            std::cerr << "alignedAlloc: Out of memory: " << bytes << " bytes" << std::endl;
+            exit(-1);
+        }
+        return ptr;
+    }
+
+    void alignedFree(void *ptr) {
+#if defined(_WIN32)
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+
+    // Standard allocator returning memory aligned to Alignment bytes.
+    template <typename T, size_t Alignment = CACHE_LINE_ALIGNMENT>
+    class AlignedAllocator {
+    public:
+        typedef T value_type;
+        typedef T *pointer;
+        typedef const T *const_pointer;
+        typedef T &reference;
+        typedef const T &const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+
+        template <typename U>
+        struct rebind {
+            typedef AlignedAllocator<U, Alignment> other;
+        };
+
+        AlignedAllocator() {
+        }
+
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment> &) {
+        }
+
+        T *allocate(size_t n) {
+            return static_cast<T *>(alignedAlloc(n * sizeof(T), Alignment));
+        }
+
+        void deallocate(T *ptr, size_t) {
+            alignedFree(ptr);
+        }
+
+        template <typename U>
+        bool operator==(const AlignedAllocator<U, Alignment> &) const {
+            return true;
+        }
+
+        template <typename U>
+        bool operator!=(const AlignedAllocator<U, Alignment> &) const {
+            return false;
+        }
+    };
+
+    // Bump allocator over a list of page aligned blocks.
+    // Nothing is freed until the arena is reset or destroyed, and existing chunks never move.
+    class Arena {
+    public:
+
+        Arena(size_t blockSize = 1024 * 1024) : blockSize(blockSize), current(0), used(0) {
+        }
+
+        ~Arena() {
+            for (size_t i = 0; i < blocks.size(); ++i) {
+                alignedFree(blocks[i].base);
+            }
+        }
+
+        // Get n floats aligned to alignment bytes (at most a page).
+        float *allocate(size_t n, size_t alignment = PAGE_ALIGNMENT) {
+            size_t bytes = std::max(n * sizeof(float), (size_t)1);
+
+            // Find the first block from the current one with enough room.
+            for (; current < blocks.size(); ++current) {
+                Block &block = blocks[current];
+                size_t offset = (block.used + alignment - 1) / alignment * alignment;
+                if (offset + bytes <= block.size) {
+                    used += offset + bytes - block.used;
+                    block.used = offset + bytes;
+                    return reinterpret_cast<float *>(block.base + offset);
+                }
+            }
+
+            Block block;
+            block.size = (std::max(blockSize, bytes) + PAGE_ALIGNMENT - 1) / PAGE_ALIGNMENT * PAGE_ALIGNMENT;
+            block.base = static_cast<char *>(alignedAlloc(block.size, PAGE_ALIGNMENT));
+            block.used = bytes;
+            blocks.push_back(block);
+            used += bytes;
+            return reinterpret_cast<float *>(block.base);
+        }
+
+        // Forget every chunk but keep the blocks for reuse.
+        void reset() {
+            for (size_t i = 0; i < blocks.size(); ++i) {
+                blocks[i].used = 0;
+            }
+            current = 0;
+            used = 0;
+        }
+
+        // Bytes handed out, including alignment padding.
+        size_t getUsed() const {
+            return used;
+        }
+
+        // Bytes reserved from the system.
+        size_t getCapacity() const {
+            size_t capacity = 0;
+            for (size_t i = 0; i < blocks.size(); ++i) {
+                capacity += blocks[i].size;
+            }
+            return capacity;
+        }
+
+    private:
+        struct Block {
+            char *base;
+            size_t size;
+            size_t used;
+        };
+
+        std::vector<Block> blocks;
+        size_t blockSize;
+        size_t current;
+        size_t used;
+
+        Arena(const Arena &);
+        Arena &operator=(const Arena &);
+    };
+
+    // How the elements of a tensor are ordered, outermost dimension first.
+    enum Layout {
+        // A plain vector.
+        FLAT,
+        // Feature maps: depth, height, width.
+        CHW,
+        // Convolution weight: output map, input map, kernel row, kernel column.
+        OIHW,
+        // Matrix weight: output, input.
+        OI
+    };
+
+    // Up to four dimensions, outermost first.
+    struct Shape {
+        size_t rank;
+        size_t dims[4];
+
+        Shape() : rank(0) {
+        }
+
+        Shape(size_t d0) : rank(1) {
+            dims[0] = d0;
+        }
+
+        Shape(size_t d0, size_t d1) : rank(2) {
+            dims[0] = d0;
+            dims[1] = d1;
+        }
+
+        Shape(size_t d0, size_t d1, size_t d2) : rank(3) {
+            dims[0] = d0;
+            dims[1] = d1;
+            dims[2] = d2;
+        }
+
+        Shape(size_t d0, size_t d1, size_t d2, size_t d3) : rank(4) {
+            dims[0] = d0;
+            dims[1] = d1;
+            dims[2] = d2;
+            dims[3] = d3;
+        }
+
+        // Number of elements.
+        size_t count() const {
+            size_t n = rank == 0 ? 0 : 1;
+            for (size_t i = 0; i < rank; ++i) {
+                n *= dims[i];
+            }
+            return n;
+        }
+
+        bool operator==(const Shape &other) const {
+            if (rank != other.rank) {
+                return false;
+            }
+            for (size_t i = 0; i < rank; ++i) {
+                if (dims[i] != other.dims[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    class Tensor {
+    public:
+
+        Tensor() : ptr(NULL), count(0), layout(FLAT), owned(false) {
+        }
+
+        // Zero filled tensor, page aligned, in arena if not NULL.
+        Tensor(const Shape &shape, Layout layout = FLAT, Arena *arena = NULL)
+            : shape(shape), layout(layout) {
+            allocate(arena);
+            std::fill(ptr, ptr + count, 0.0f);
+        }
+
+        // Tensor holding a copy of values.
+        template <typename Alloc>
+        Tensor(const Shape &shape, Layout layout, const std::vector<float, Alloc> &values, Arena *arena = NULL)
+            : shape(shape), layout(layout) {
+            if (values.size() != shape.count()) {
+                std::cerr << "Tensor: Wrong number of values: " << values.size() << " for " << shape.count() << std::endl;
+                exit(-1);
+            }
+            allocate(arena);
+            std::copy(values.begin(), values.end(), ptr);
+        }
+
+        // A copy always owns its memory.
+        Tensor(const Tensor &other) : shape(other.shape), layout(other.layout) {
+            allocate(NULL);
+            std::copy(other.begin(), other.end(), ptr);
+        }
+
+        Tensor &operator=(const Tensor &other) {
+            if (this != &other) {
+                Tensor copy(other);
+                swap(copy);
+            }
+            return *this;
+        }
+
+        ~Tensor() {
+            if (owned) {
+                alignedFree(ptr);
+            }
+        }
+
+        void swap(Tensor &other) {
+            std::swap(ptr, other.ptr);
+            std::swap(count, other.count);
+            std::swap(shape, other.shape);
+            std::swap(layout, other.layout);
+            std::swap(owned, other.owned);
+        }
+
+        float &operator[](size_t i) {
+            return ptr[i];
+        }
+
+        const float &operator[](size_t i) const {
+            return ptr[i];
+        }
+
+        float *data() {
+            return ptr;
+        }
+
+        const float *data() const {
+            return ptr;
+        }
+
+        float *begin() {
+            return ptr;
+        }
+
+        float *end() {
+            return ptr + count;
+        }
+
+        const float *begin() const {
+            return ptr;
+        }
+
+        const float *end() const {
+            return ptr + count;
+        }
+
+        size_t size() const {
+            return count;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        size_t bytes() const {
+            return count * sizeof(float);
+        }
+
+        const Shape &getShape() const {
+            return shape;
+        }
+
+        Layout getLayout() const {
+            return layout;
+        }
+
+    private:
+        float *ptr;
+        size_t count;
+        Shape shape;
+        Layout layout;
+        bool owned;
+
+        void allocate(Arena *arena) {
+            count = shape.count();
+            owned = arena == NULL;
+            ptr = owned ? static_cast<float *>(alignedAlloc(count * sizeof(float), PAGE_ALIGNMENT)) : arena->allocate(count);
+        }
+    };
+}
+
+#endif
@@ -1,4 +1,14 @@
 #include "cnn.hpp"
+#include "trace.hpp"
+#include "analysis.hpp"
+#include "wallclock.hpp"
+#include "regress.hpp"
+#include "microbench.hpp"
+#include "loadgen.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
 
 using namespace cnn;
 
@@ -7,8 +17,32 @@ using namespace cnn;
 #define ASSERT(expression) if (!(expression)) {std::cerr << "Failed test: CL kernel works incorrect. " << std::endl; exit(-2);}
 
 namespace test {
+    // Heap allocations made while isCountingAllocations, see runPlanTest.
+    std::atomic<size_t> allocations(0);
+    std::atomic<bool> isCountingAllocations(false);
+}
 
-    void dumpEventsProfile(std::ofstream &o, std::vector<cl_event> &events, size_t n);
+// Count the allocations of the whole program, new[] and nothrow new come here too.
+void *operator new(size_t size) {
+    if (test::isCountingAllocations) {
+        test::allocations++;
+    }
+    void *ptr = std::malloc(size == 0 ? 1 : size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+// Inlined, GCC pairs the free with the caller's new and warns -Wmismatched-new-delete.
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+namespace test {
 
     // Run time test with single input.
     void runTimeTest(std::ofstream &o, CNN *cnn, const vec &in) {
@@ -52,16 +86,1216 @@ namespace test {
     }
 
     void runFuncTest(CNN *cnn, const vec &in) {
-        cnn->forwardCL(in);
-        cnn::vec outCL(cnn->getOut());
+        cnn::vec outCL(cnn->getOutSize());
+        cnn->forwardCL(&in[0], &outCL[0]);
         cnn->forwardCPU(in);
-        cnn::vec outCPU(cnn->getOut());
+        const Tensor &outCPU = cnn->getOut();
         for (int i = 0; i < outCL.size(); ++i) {
             ASSERT(abs(outCL[i] - outCPU[i]) < 0.0001f)
         }
         std::cout << "CL Kernel works perfect!. " << std::endl;
     }
 
+    // Check the im2col convolution against the direct one.
+    void runConvAlgorithmTest(CNN *cnn, const vec &in) {
+        cnn->setConvAlgorithm(DIRECT);
+        cnn->forwardCPU(in);
+        cnn::vec outDirect(cnn->getOut().begin(), cnn->getOut().end());
+        cnn->setConvAlgorithm(IM2COL);
+        cnn->forwardCPU(in);
+        cnn::vec outIm2col(cnn->getOut().begin(), cnn->getOut().end());
+        for (size_t i = 0; i < outDirect.size(); ++i) {
+            ASSERT(fabs(outDirect[i] - outIm2col[i]) < 0.0001f)
+        }
+        cnn->setConvAlgorithm(DIRECT);
+        std::cout << "Im2col convolution works perfect!" << std::endl;
+    }
+
+    // Forward one layer alone with its own scratch on one thread,
+    // the input is the test input repeated to the layer's input size.
+    void computeLayerCPU(Layer *layer, const vec &in, vec &layerIn, vec &out) {
+        layerIn.resize(layer->getInSize());
+        for (size_t i = 0; i < layerIn.size(); ++i) {
+            layerIn[i] = in[i % in.size()];
+        }
+        out.resize(layer->getOutSize());
+        vec shared(layer->getSharedScratchSize() + 1);
+        vec local(layer->getLocalScratchSize() + 1);
+        Workspace ws = { NULL, &shared[0], &local[0], local.size() };
+        layer->computeCPU(&layerIn[0], &out[0], ws);
+    }
+
+    // Forward every layer on one thread like CNN::forwardCPU, keeping the output of each.
+    void forwardLayersCPU(CNN *cnn, const float *in, std::vector<vec> &outs) {
+        outs.resize(cnn->layers.size());
+        for (size_t l = 0; l < cnn->layers.size(); ++l) {
+            Layer *layer = cnn->layers[l];
+            outs[l].resize(layer->getOutSize());
+            vec shared(layer->getSharedScratchSize() + 1);
+            vec local(layer->getLocalScratchSize() + 1);
+            Workspace ws = { NULL, &shared[0], &local[0], local.size() };
+            layer->computeCPU(l == 0 ? in : &outs[l - 1][0], &outs[l][0], ws);
+            if (layer->getPrecision() == FP16 && l + 1 < cnn->layers.size()) {
+                fp16::round(&outs[l][0], outs[l].size());
+            }
+        }
+    }
+
+    // Deepest layer whose output still changes with the input, outs[i][l] being the output of
+    // layer l for input i, or the number of layers if none does. The random weights of the test
+    // models are all positive, so the sigmoids saturate a few layers in and every output after,
+    // the network's too, is the same for any input and can't show a precision error.
+    size_t getLastUnsaturated(const std::vector<std::vector<vec> > &outs) {
+        const float MIN_SPREAD = 0.001f;
+        size_t last = outs[0].size();
+        for (size_t l = 0; l < outs[0].size(); ++l) {
+            for (size_t j = 0; j < outs[0][l].size(); ++j) {
+                float lo = outs[0][l][j];
+                float hi = lo;
+                for (size_t i = 1; i < outs.size(); ++i) {
+                    lo = std::min(lo, outs[i][l][j]);
+                    hi = std::max(hi, outs[i][l][j]);
+                }
+                if (hi - lo > MIN_SPREAD) {
+                    last = l;
+                    break;
+                }
+            }
+        }
+        return last;
+    }
+
+    // Max error over the inputs of layer l's output in outs against reference.
+    float getLayerError(const std::vector<std::vector<vec> > &reference, const std::vector<std::vector<vec> > &outs, size_t l) {
+        float maxError = 0.0f;
+        for (size_t i = 0; i < outs.size(); ++i) {
+            for (size_t j = 0; j < outs[i][l].size(); ++j) {
+                maxError = std::max(maxError, std::fabs(reference[i][l][j] - outs[i][l][j]));
+            }
+        }
+        return maxError;
+    }
+
+    // Check the Winograd convolution against the direct one and report,
+    // for every convolutional layer, the error and the multiplies saved.
+    void runWinogradTest(std::ofstream &o, CNN *cnn, const vec &in) {
+        writeXMLOpenTag(o, "winograd");
+        for (size_t l = 0; l < cnn->layers.size(); ++l) {
+            ConvolutionLayer *conv = dynamic_cast<ConvolutionLayer *>(cnn->layers[l]);
+            if (!conv) {
+                continue;
+            }
+            ConvAlgorithm algorithm = conv->getAlgorithm();
+
+            // Run the layer alone on the test input.
+            vec layerIn;
+            vec outDirect;
+            vec outWinograd;
+            conv->setAlgorithm(DIRECT);
+            computeLayerCPU(conv, in, layerIn, outDirect);
+            conv->setAlgorithm(WINOGRAD);
+            computeLayerCPU(conv, in, layerIn, outWinograd);
+            conv->setAlgorithm(algorithm);
+
+            float maxError = 0.0f;
+            float maxRelError = 0.0f;
+            for (size_t i = 0; i < outDirect.size(); ++i) {
+                float error = std::fabs(outDirect[i] - outWinograd[i]);
+                maxError = std::max(maxError, error);
+                maxRelError = std::max(maxRelError, error / std::max(std::fabs(outDirect[i]), 1e-6f));
+            }
+            ASSERT(maxError < 0.001f)
+
+            size_t m = conv->getWinogradTile();
+            size_t r = conv->getKernelSize();
+            size_t direct = conv->getMultiplies(DIRECT);
+            size_t wino = conv->getMultiplies(WINOGRAD);
+            std::cout << "Layer " << l << " F(" << m << "x" << m << ", " << r << "x" << r << ")"
+                << " max error: " << maxError << " max relative error: " << maxRelError
+                << " multiplies: " << direct << " -> " << wino << " (x" << (float)direct / wino << ")" << std::endl;
+
+            writeXMLOpenTag(o, "layer");
+            writeXMLTag(o, "index", l);
+            writeXMLTag(o, "tile", m);
+            writeXMLTag(o, "maxError", maxError);
+            writeXMLTag(o, "maxRelError", maxRelError);
+            writeXMLTag(o, "directMultiplies", direct);
+            writeXMLTag(o, "winogradMultiplies", wino);
+            writeXMLCloseTag(o, "layer");
+        }
+        writeXMLCloseTag(o, "winograd");
+        std::cout << "Winograd convolution works perfect!" << std::endl;
+    }
+
+    // Check the layers with a connection table: the direct convolution skipping the
+    // unconnected pairs matches im2col multiplying every pair, their weights being zero.
+    void runConnectionTest(std::ofstream &o, CNN *cnn, const vec &in) {
+        writeXMLOpenTag(o, "connection");
+        for (size_t l = 0; l < cnn->layers.size(); ++l) {
+            ConvolutionLayer *conv = dynamic_cast<ConvolutionLayer *>(cnn->layers[l]);
+            if (!conv || !conv->isSparse()) {
+                continue;
+            }
+            ConvAlgorithm algorithm = conv->getAlgorithm();
+
+            vec layerIn;
+            vec outDense;
+            vec outSparse;
+            double times[2];
+            const ConvAlgorithm ALGORITHMS[] = { IM2COL, DIRECT };
+            for (size_t a = 0; a < 2; ++a) {
+                conv->setAlgorithm(ALGORITHMS[a]);
+                vec &out = a == 0 ? outDense : outSparse;
+                computeLayerCPU(conv, in, layerIn, out);
+
+                vec shared(conv->getSharedScratchSize() + 1);
+                vec local(conv->getLocalScratchSize() + 1);
+                Workspace ws = { NULL, &shared[0], &local[0], local.size() };
+                double start = wallTime();
+                for (size_t i = 0; i < NUM_TEST; ++i) {
+                    conv->computeCPU(&layerIn[0], &out[0], ws);
+                }
+                times[a] = (wallTime() - start) / NUM_TEST;
+            }
+            conv->setAlgorithm(algorithm);
+
+            float maxError = 0.0f;
+            for (size_t i = 0; i < outDense.size(); ++i) {
+                maxError = std::max(maxError, std::fabs(outDense[i] - outSparse[i]));
+            }
+            ASSERT(maxError < 0.001f)
+
+            size_t dense = conv->getMultiplies(IM2COL);
+            size_t sparse = conv->getMultiplies(DIRECT);
+            std::cout << "Layer " << l << " connections: " << conv->getConnections()
+                << " max error: " << maxError << " multiplies: " << dense << " -> " << sparse
+                << " (-" << 100.0f * (1.0f - (float)sparse / dense) << "%)"
+                << " direct: " << times[1] * 1000.0 << "ms im2col: " << times[0] * 1000.0 << "ms" << std::endl;
+
+            writeXMLOpenTag(o, "layer");
+            writeXMLTag(o, "index", l);
+            writeXMLTag(o, "connections", conv->getConnections());
+            writeXMLTag(o, "maxError", maxError);
+            writeXMLTag(o, "denseMultiplies", dense);
+            writeXMLTag(o, "sparseMultiplies", sparse);
+            writeXMLTag(o, "directTime", (float)times[1]);
+            writeXMLTag(o, "im2colTime", (float)times[0]);
+            writeXMLCloseTag(o, "layer");
+        }
+        writeXMLCloseTag(o, "connection");
+        std::cout << "Connection table works perfect!" << std::endl;
+    }
+
+    // Check the FFT convolution against the direct one and compare,
+    // for every convolutional layer, the cost model with the measured time.
+    void runFFTTest(std::ofstream &o, CNN *cnn, const vec &in) {
+        const ConvAlgorithm ALGORITHMS[] = { DIRECT, IM2COL, FFT };
+        const char *NAMES[] = { "direct", "im2col", "fft" };
+        const size_t NUM_ALGORITHMS = sizeof(ALGORITHMS) / sizeof(ALGORITHMS[0]);
+
+        writeXMLOpenTag(o, "fft");
+        for (size_t l = 0; l < cnn->layers.size(); ++l) {
+            ConvolutionLayer *conv = dynamic_cast<ConvolutionLayer *>(cnn->layers[l]);
+            if (!conv) {
+                continue;
+            }
+            ConvAlgorithm algorithm = conv->getAlgorithm();
+
+            vec layerIn;
+            vec outDirect;
+            vec out;
+            double times[NUM_ALGORITHMS];
+            size_t fastest = 0;
+            float maxError = 0.0f;
+            for (size_t a = 0; a < NUM_ALGORITHMS; ++a) {
+                conv->setAlgorithm(ALGORITHMS[a]);
+                computeLayerCPU(conv, in, layerIn, out);
+
+                vec shared(conv->getSharedScratchSize() + 1);
+                vec local(conv->getLocalScratchSize() + 1);
+                Workspace ws = { NULL, &shared[0], &local[0], local.size() };
+                double start = wallTime();
+                for (size_t i = 0; i < NUM_TEST; ++i) {
+                    conv->computeCPU(&layerIn[0], &out[0], ws);
+                }
+                times[a] = (wallTime() - start) / NUM_TEST;
+                if (times[a] < times[fastest]) {
+                    fastest = a;
+                }
+                if (ALGORITHMS[a] == DIRECT) {
+                    outDirect = out;
+                }
+                for (size_t i = 0; i < out.size(); ++i) {
+                    maxError = std::max(maxError, std::fabs(outDirect[i] - out[i]));
+                }
+            }
+            ASSERT(maxError < 0.001f)
+
+            ConvAlgorithm picked = conv->pickAlgorithm();
+            conv->setAlgorithm(algorithm);
+
+            std::cout << "Layer " << l << " max error: " << maxError;
+            writeXMLOpenTag(o, "layer");
+            writeXMLTag(o, "index", l);
+            writeXMLTag(o, "maxError", maxError);
+            for (size_t a = 0; a < NUM_ALGORITHMS; ++a) {
+                std::cout << " " << NAMES[a] << ": " << times[a] * 1000.0 << "ms (cost " << conv->getCost(ALGORITHMS[a]) << ")";
+                writeXMLOpenTag(o, NAMES[a]);
+                writeXMLTag(o, "time", (float)times[a]);
+                writeXMLTag(o, "cost", (float)conv->getCost(ALGORITHMS[a]));
+                writeXMLCloseTag(o, NAMES[a]);
+            }
+            for (size_t a = 0; a < NUM_ALGORITHMS; ++a) {
+                if (ALGORITHMS[a] == picked) {
+                    std::cout << " picked: " << NAMES[a] << " fastest: " << NAMES[fastest] << std::endl;
+                    writeXMLTag(o, "picked", std::string(NAMES[a]));
+                    writeXMLTag(o, "fastest", std::string(NAMES[fastest]));
+                }
+            }
+            writeXMLCloseTag(o, "layer");
+        }
+        writeXMLCloseTag(o, "fft");
+        std::cout << "FFT convolution works perfect!" << std::endl;
+    }
+
+    // Check every activation against its scalar reference and report its CPU cost,
+    // the distance to the exact sigmoid and the forward time with it in every layer.
+    void runActivationTest(std::ofstream &o, CNN *cnn, const vec &in) {
+        const size_t N = 1 << 16;
+        vec x(N);
+        for (size_t i = 0; i < N; ++i) {
+            x[i] = -10.0f + 20.0f * (float)i / (float)N;
+        }
+
+        std::vector<Activation> saved;
+        for (size_t l = 0; l < cnn->layers.size(); ++l) {
+            saved.push_back(cnn->layers[l]->getActivation());
+        }
+
+        writeXMLOpenTag(o, "activation");
+        for (size_t a = 0; a < NUM_ACTIVATIONS; ++a) {
+            Activation activation = (Activation)a;
+
+            vec y(x);
+            simd::activate(activation, &y[0], N, 1.0f, 0.0f);
+            float maxError = 0.0f;
+            float maxSigmoidError = 0.0f;
+            for (size_t i = 0; i < N; ++i) {
+                maxError = std::max(maxError, std::fabs(y[i] - activate(activation, x[i])));
+                maxSigmoidError = std::max(maxSigmoidError, std::fabs(y[i] - activate(SIGMOID, x[i])));
+            }
+            ASSERT(maxError < 0.0001f)
+            if (activation == LUT_SIGMOID) {
+                ASSERT(maxSigmoidError < 0.001f)
+            }
+
+            double start = wallTime();
+            for (size_t i = 0; i < NUM_TEST; ++i) {
+                simd::activate(activation, &y[0], N, 1.0f, 0.0f);
+            }
+            double perElement = (wallTime() - start) / NUM_TEST / N;
+
+            cnn->setActivation(activation);
+            cnn->forwardCPU(in);
+            start = wallTime();
+            for (size_t i = 0; i < NUM_TEST; ++i) {
+                cnn->forwardCPU(in);
+            }
+            double forward = (wallTime() - start) / NUM_TEST;
+
+            std::cout << "Activation " << getActivationName(activation)
+                << ": " << perElement * 1e9 << "ns per element"
+                << " forward: " << forward * 1000.0 << "ms"
+                << " max error to sigmoid: " << maxSigmoidError << std::endl;
+
+            writeXMLOpenTag(o, getActivationName(activation));
+            writeXMLTag(o, "timePerElement", (float)perElement);
+            writeXMLTag(o, "forwardTime", (float)forward);
+            writeXMLTag(o, "maxSigmoidError", maxSigmoidError);
+            writeXMLCloseTag(o, getActivationName(activation));
+        }
+        writeXMLCloseTag(o, "activation");
+
+        for (size_t l = 0; l < cnn->layers.size(); ++l) {
+            cnn->layers[l]->setActivation(saved[l]);
+        }
+        std::cout << "Activations work perfect!" << std::endl;
+    }
+
+    // Index of the closest RBF center, the predicted class.
+    size_t argmin(const float *out, size_t n) {
+        return std::min_element(out, out + n) - out;
+    }
+
+    // Calibrate INT8 on half of n random inputs, then report per layer the input range and
+    // the INT8 error on the test input, and over the other half the output error and how
+    // often INT8 predicts the same class as fp32. The network is checked at its deepest layer
+    // not saturated, where an INT8 error still shows. The quantized model is written to
+    // quantizedFile and loaded again to check it restores the same network.
+    void runQuantizationTest(std::ofstream &o, CNN *cnn, const vec &in, size_t n, const std::string &quantizedFile) {
+        size_t inSize = cnn->getInSize();
+        size_t outSize = cnn->getOutSize();
+        vec samples(inSize * n);
+        for (size_t i = 0; i < samples.size(); ++i) {
+            samples[i] = (float)rand() / (float)RAND_MAX - 0.5f;
+        }
+        size_t calibration = n / 2;
+        std::vector<quant::Range> ranges = cnn->calibrate(InSpan(&samples[0], calibration, inSize));
+
+        writeXMLOpenTag(o, "quantization");
+        for (size_t l = 0; l < cnn->layers.size(); ++l) {
+            Layer *layer = cnn->layers[l];
+            if (!layer->isQuantizable()) {
+                continue;
+            }
+            vec layerIn;
+            vec outFP32;
+            vec outInt8;
+            layer->setPrecision(FP32);
+            computeLayerCPU(layer, in, layerIn, outFP32);
+            layer->setPrecision(INT8);
+            computeLayerCPU(layer, in, layerIn, outInt8);
+            layer->setPrecision(FP32);
+
+            float maxError = 0.0f;
+            for (size_t i = 0; i < outFP32.size(); ++i) {
+                maxError = std::max(maxError, std::fabs(outFP32[i] - outInt8[i]));
+            }
+            ASSERT(maxError < 0.05f)
+
+            std::cout << "Layer " << l << " input range: [" << ranges[l].min << ", " << ranges[l].max << "]"
+                << " inScale: " << layer->getQuantization().inScale
+                << " INT8 max error: " << maxError << std::endl;
+
+            writeXMLOpenTag(o, "layer");
+            writeXMLTag(o, "index", l);
+            writeXMLTag(o, "min", ranges[l].min);
+            writeXMLTag(o, "max", ranges[l].max);
+            writeXMLTag(o, "inScale", layer->getQuantization().inScale);
+            writeXMLTag(o, "maxError", maxError);
+            writeXMLCloseTag(o, "layer");
+        }
+
+        // Accuracy delta on the inputs not used for calibration.
+        size_t evaluated = n - calibration;
+        std::vector<std::vector<vec> > layersFP32(evaluated);
+        std::vector<std::vector<vec> > layersInt8(evaluated);
+        float maxError = 0.0f;
+        double sumError = 0.0;
+        size_t agree = 0;
+        for (size_t i = 0; i < evaluated; ++i) {
+            cnn->setPrecision(FP32);
+            forwardLayersCPU(cnn, &samples[(calibration + i) * inSize], layersFP32[i]);
+            cnn->setPrecision(INT8);
+            forwardLayersCPU(cnn, &samples[(calibration + i) * inSize], layersInt8[i]);
+            const vec &outFP32 = layersFP32[i].back();
+            const vec &outInt8 = layersInt8[i].back();
+            for (size_t j = 0; j < outSize; ++j) {
+                float error = std::fabs(outFP32[j] - outInt8[j]);
+                maxError = std::max(maxError, error);
+                sumError += error;
+            }
+            agree += argmin(&outFP32[0], outSize) == argmin(&outInt8[0], outSize);
+        }
+        float meanError = (float)(sumError / (evaluated * outSize));
+        float agreement = (float)agree / evaluated;
+
+        size_t probe = getLastUnsaturated(layersFP32);
+        ASSERT(probe < cnn->layers.size())
+        float probeError = getLayerError(layersFP32, layersInt8, probe);
+        ASSERT(probeError < 0.01f)
+
+        // The written model restores the same INT8 network.
+        cnn->writeQuantizedModel(quantizedFile);
+        CNN *quantized = new CNN(quantizedFile, true);
+        quantized->setPrecision(INT8);
+        quantized->forwardCPU(in);
+        cnn->forwardCPU(in);
+        for (size_t j = 0; j < outSize; ++j) {
+            ASSERT(quantized->getOut()[j] == cnn->getOut()[j])
+        }
+        delete quantized;
+        cnn->setPrecision(FP32);
+
+        std::cout << "INT8 vs fp32 over " << evaluated << " inputs: max error: " << maxError
+            << " mean error: " << meanError << " top-1 agreement: " << agreement * 100.0f << "%"
+            << " layer " << probe << " (last not saturated) max error: " << probeError << std::endl;
+
+        writeXMLTag(o, "calibrationInputs", calibration);
+        writeXMLTag(o, "evaluatedInputs", evaluated);
+        writeXMLTag(o, "maxError", maxError);
+        writeXMLTag(o, "meanError", meanError);
+        writeXMLTag(o, "top1Agreement", agreement);
+        writeXMLTag(o, "unsaturatedLayer", probe);
+        writeXMLTag(o, "unsaturatedMaxError", probeError);
+        writeXMLCloseTag(o, "quantization");
+        std::cout << "Quantization works perfect!" << std::endl;
+    }
+
+    // Check the half conversion, then report for every layer the error of half storage on the
+    // CPU path, and for the network with every layer but the RBF output in half, checked at
+    // its deepest layer not saturated over NUM_TEST random inputs.
+    void runHalfTest(std::ofstream &o, CNN *cnn, const vec &in) {
+        // Every half goes through float and back, ties round to even.
+        for (unsigned int h = 0; h < 0x10000; ++h) {
+            float f = fp16::toFloat((fp16::half)h);
+            if (f == f) {
+                ASSERT(fp16::fromFloat(f) == h)
+            }
+        }
+        ASSERT(fp16::fromFloat(1.0f + 1.0f / 2048.0f) == fp16::fromFloat(1.0f))
+        ASSERT(fp16::fromFloat(1.0f + 3.0f / 2048.0f) == fp16::fromFloat(1.0f + 2.0f / 1024.0f))
+        ASSERT(fp16::toFloat(fp16::fromFloat(4e-8f)) == 5.9604644775390625e-8f)
+        ASSERT(fp16::fromFloat(65520.0f) == 0x7c00)
+
+        std::vector<Precision> saved;
+        for (size_t l = 0; l < cnn->layers.size(); ++l) {
+            saved.push_back(cnn->layers[l]->getPrecision());
+        }
+
+        writeXMLOpenTag(o, "fp16");
+        for (size_t l = 0; l < cnn->layers.size(); ++l) {
+            Layer *layer = cnn->layers[l];
+            vec layerIn;
+            vec outFP32;
+            vec outFP16;
+            layer->setPrecision(FP32);
+            computeLayerCPU(layer, in, layerIn, outFP32);
+            layer->setPrecision(FP16);
+            computeLayerCPU(layer, in, layerIn, outFP16);
+            fp16::round(&outFP16[0], outFP16.size());
+            layer->setPrecision(FP32);
+
+            float maxError = 0.0f;
+            float maxOut = 0.0f;
+            for (size_t i = 0; i < outFP32.size(); ++i) {
+                maxError = std::max(maxError, std::fabs(outFP32[i] - outFP16[i]));
+                maxOut = std::max(maxOut, std::fabs(outFP32[i]));
+            }
+            ASSERT(maxError <= 0.01f * std::max(maxOut, 1.0f))
+
+            std::cout << "Layer " << l << " FP16 max error: " << maxError << std::endl;
+            writeXMLOpenTag(o, "layer");
+            writeXMLTag(o, "index", l);
+            writeXMLTag(o, "maxError", maxError);
+            writeXMLCloseTag(o, "layer");
+        }
+
+        // The RBF output keeps fp32 like the generated mixed model.
+        size_t last = cnn->layers.size() - 1;
+        std::vector<std::vector<vec> > layersFP32(NUM_TEST);
+        std::vector<std::vector<vec> > layersFP16(NUM_TEST);
+        vec sample(cnn->getInSize());
+        for (size_t i = 0; i < NUM_TEST; ++i) {
+            for (size_t j = 0; j < sample.size(); ++j) {
+                sample[j] = (float)rand() / (float)RAND_MAX - 0.5f;
+            }
+            cnn->setPrecision(FP32);
+            forwardLayersCPU(cnn, &sample[0], layersFP32[i]);
+            cnn->setPrecision(FP16);
+            cnn->layers[last]->setPrecision(FP32);
+            forwardLayersCPU(cnn, &sample[0], layersFP16[i]);
+        }
+        float maxError = getLayerError(layersFP32, layersFP16, last);
+
+        size_t probe = getLastUnsaturated(layersFP32);
+        ASSERT(probe < cnn->layers.size())
+        float probeError = getLayerError(layersFP32, layersFP16, probe);
+        float probeMax = 0.0f;
+        for (size_t i = 0; i < NUM_TEST; ++i) {
+            for (size_t j = 0; j < layersFP32[i][probe].size(); ++j) {
+                probeMax = std::max(probeMax, std::fabs(layersFP32[i][probe][j]));
+            }
+        }
+        ASSERT(probeError <= 0.01f * std::max(probeMax, 1.0f))
+
+        std::cout << "FP16 network max error: " << maxError
+            << " layer " << probe << " (last not saturated) max error: " << probeError << std::endl;
+        writeXMLTag(o, "networkMaxError", maxError);
+        writeXMLTag(o, "unsaturatedLayer", probe);
+        writeXMLTag(o, "unsaturatedMaxError", probeError);
+        writeXMLCloseTag(o, "fp16");
+
+        for (size_t l = 0; l < cnn->layers.size(); ++l) {
+            cnn->layers[l]->setPrecision(saved[l]);
+        }
+        std::cout << "FP16 works perfect!" << std::endl;
+    }
+
+    // Prune every full layer to a quarter of its weights and check the pruned model:
+    // the largest weights are kept, the CSR kernel matches the dense one on the same weights,
+    // and the device matches the CPU. Reports the footprint and the time of both kernels.
+    void runSparseTest(std::ofstream &o, CNN *cnn, const vec &in, const std::string &prunedFile) {
+        const float DENSITY = 0.25f;
+
+        writeXMLOpenTag(o, "sparse");
+        cnn->writePrunedModel(prunedFile, DENSITY);
+        CNN *pruned = new CNN(prunedFile, true);
+        for (size_t l = 0; l < pruned->layers.size(); ++l) {
+            FullConnectLayer *full = dynamic_cast<FullConnectLayer *>(pruned->layers[l]);
+            if (!full) {
+                continue;
+            }
+            const sparse::Matrix &csr = full->getSparseWeight();
+            const sparse::Matrix &original = dynamic_cast<FullConnectLayer *>(cnn->layers[l])->getSparseWeight();
+            ASSERT(csr.nonzeros() <= (size_t)(DENSITY * original.rows * original.cols + 0.5f))
+            ASSERT(full->isSparse())
+
+            // Every kept weight is unchanged and at least as large as every dropped one.
+            vec dense(original.rows * original.cols);
+            sparse::toDense(csr, &dense[0]);
+            float minKept = INFINITY;
+            float maxDropped = 0.0f;
+            for (size_t r = 0; r < original.rows; ++r) {
+                for (size_t p = original.rowBegin[r]; p < original.rowBegin[r + 1]; ++p) {
+                    float w = dense[r * original.cols + original.column[p]];
+                    if (w != 0.0f) {
+                        ASSERT(w == original.value[p])
+                        minKept = std::min(minKept, std::fabs(w));
+                    }
+                    else {
+                        maxDropped = std::max(maxDropped, std::fabs(original.value[p]));
+                    }
+                }
+            }
+            ASSERT(maxDropped <= minKept)
+
+            vec layerIn;
+            vec outDense;
+            vec outSparse;
+            double times[2];
+            for (size_t k = 0; k < 2; ++k) {
+                full->setSparseThreshold(k == 0 ? 0.0f : sparse::CPU_DENSITY_THRESHOLD);
+                vec &out = k == 0 ? outDense : outSparse;
+                computeLayerCPU(full, in, layerIn, out);
+
+                vec shared(full->getSharedScratchSize() + 1);
+                vec local(full->getLocalScratchSize() + 1);
+                Workspace ws = { NULL, &shared[0], &local[0], local.size() };
+                double start = wallTime();
+                for (size_t i = 0; i < NUM_TEST; ++i) {
+                    full->computeCPU(&layerIn[0], &out[0], ws);
+                }
+                times[k] = (wallTime() - start) / NUM_TEST;
+            }
+
+            float maxError = 0.0f;
+            for (size_t i = 0; i < outDense.size(); ++i) {
+                maxError = std::max(maxError, std::fabs(outDense[i] - outSparse[i]));
+            }
+            ASSERT(maxError < 0.0001f)
+
+            size_t denseBytes = csr.rows * csr.cols * sizeof(float);
+            std::cout << "Layer " << l << " density: " << csr.density() << " max error: " << maxError
+                << " weight: " << denseBytes << " -> " << csr.bytes(sizeof(float)) << " bytes"
+                << " dense: " << times[0] * 1000.0 << "ms csr: " << times[1] * 1000.0 << "ms" << std::endl;
+
+            writeXMLOpenTag(o, "layer");
+            writeXMLTag(o, "index", l);
+            writeXMLTag(o, "density", csr.density());
+            writeXMLTag(o, "maxError", maxError);
+            writeXMLTag(o, "denseBytes", denseBytes);
+            writeXMLTag(o, "sparseBytes", csr.bytes(sizeof(float)));
+            writeXMLTag(o, "denseTime", (float)times[0]);
+            writeXMLTag(o, "sparseTime", (float)times[1]);
+            writeXMLCloseTag(o, "layer");
+        }
+        runFuncTest(pruned, in);
+        delete pruned;
+        writeXMLCloseTag(o, "sparse");
+        std::cout << "Sparse full layers work perfect!" << std::endl;
+    }
+
+    // Rank the classes of n random inputs on the CPU and check the ranking against a sort.
+    // With a classification head also check the device ranking and report the bytes read
+    // back per input and the time of both batches.
+    void runHeadTest(std::ofstream &o, CNN *cnn, size_t n) {
+        size_t inSize = cnn->getInSize();
+        size_t outSize = cnn->getOutSize();
+        size_t k = cnn->getTopK() > 0 ? cnn->getTopK() : std::min<size_t>(3, outSize);
+
+        vec batch(inSize * n);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            batch[i] = (float)rand() / (float)RAND_MAX - 0.5f;
+        }
+        InSpan in(&batch[0], n, inSize);
+
+        Classification cpu;
+        double start = wallTime();
+        cnn->classifyCPU(in, cpu, k);
+        double cpuTime = (wallTime() - start) / n;
+
+        vec out(outSize);
+        for (size_t i = 0; i < n; ++i) {
+            cnn->forwardCPU(in[i], &out[0]);
+            std::vector<size_t> order(outSize);
+            for (size_t c = 0; c < outSize; ++c) {
+                order[c] = c;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return out[a] < out[b];
+            });
+            for (size_t j = 0; j < k; ++j) {
+                ASSERT(cpu.getClass(i, j) == order[j])
+                ASSERT(cpu.getScore(i, j) == out[order[j]])
+            }
+        }
+
+        writeXMLOpenTag(o, "head");
+        writeXMLTag(o, "topK", k);
+        writeXMLTag(o, "cpuTime", (float)cpuTime);
+        if (cnn->getTopK() > 0) {
+            Classification device;
+            double deviceTime;
+            std::vector<cl_event> events = cnn->classifyCLBatch(in, device, &deviceTime);
+            clWaitForEvents((cl_uint)events.size(), &events[0]);
+            for (size_t i = 0; i < events.size(); ++i) {
+                clReleaseEvent(events[i]);
+            }
+
+            // The device sums in its own order, so only a near tie may swap two classes.
+            size_t mismatches = 0;
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t j = 0; j < k; ++j) {
+                    float error = std::fabs(device.getScore(i, j) - cpu.getScore(i, j));
+                    ASSERT(error <= 0.0001f * std::max(1.0f, std::fabs(cpu.getScore(i, j))))
+                    mismatches += device.getClass(i, j) != cpu.getClass(i, j);
+                }
+            }
+            ASSERT(mismatches <= n * k / 100)
+
+            size_t fullBytes = outSize * sizeof(cl_float);
+            std::cout << "Head top " << k << " readback: " << fullBytes << " -> " << device.getBytes()
+                << " bytes per input, device: " << deviceTime * 1000.0 << "ms cpu: " << cpuTime * 1000.0
+                << "ms mismatches: " << mismatches << std::endl;
+            writeXMLTag(o, "fullBytes", fullBytes);
+            writeXMLTag(o, "headBytes", device.getBytes());
+            writeXMLTag(o, "deviceTime", (float)deviceTime);
+            writeXMLTag(o, "mismatches", mismatches);
+        }
+        writeXMLCloseTag(o, "head");
+        std::cout << "Classification head works perfect!" << std::endl;
+    }
+
+    // Check the timeline of n inputs forwarded by the batch or the pipeline and
+    // export it as a Chrome trace: every command must run after the ones it waits for.
+    void runTraceTest(CNN *cnn, const vec &in, size_t n, bool isPipelined, const std::string &traceFile) {
+        vec out;
+        double averageTime;
+        std::vector<cl_event> events = isPipelined ?
+            cnn->forwardCLPipeline(in, out, n, &averageTime) :
+            cnn->forwardCLBatch(in, out, n, &averageTime);
+        clWaitForEvents((cl_uint)events.size(), &events[0]);
+
+        timeline::Timeline t = timeline::collect(events, cnn->getEnqueues(), n, cnn->getStageNames(),
+            isPipelined ? timeline::SCHEDULE_PIPELINE : timeline::SCHEDULE_BATCH);
+        for (size_t i = 0; i < events.size(); ++i) {
+            clReleaseEvent(events[i]);
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t s = 0; s < t.stages.size(); ++s) {
+                const timeline::Command &c = t.at(i, s);
+                ASSERT(c.enqueueBegin <= c.enqueueEnd)
+                ASSERT(c.queued <= c.submit && c.submit <= c.start && c.start <= c.end)
+                std::vector<std::pair<size_t, size_t> > dependencies = timeline::getDependencies(t, i, s);
+                for (size_t d = 0; d < dependencies.size(); ++d) {
+                    ASSERT(t.at(dependencies[d].first, dependencies[d].second).end <= c.start)
+                }
+            }
+        }
+
+        trace::writeChromeTrace(traceFile, t, getDeviceName(cnn->device), isPipelined ? "pipeline" : "batch");
+        std::cout << "Trace written to " << traceFile << ", clock offset " << t.offset
+            << "ns +- " << t.offsetError << "ns" << std::endl;
+        std::cout << "Timeline works perfect!" << std::endl;
+    }
+
+    // Profile 1 in 4 inputs of two batches with profiling off on the hot queue: the ring keeps
+    // the samples of the second batch in order, survives its file, and the results stay right
+    // although the inputs switch queues. Leaves the cnn sampling.
+    void runSamplingTest(CNN *cnn, const vec &in, size_t n, bool isPipelined, const std::string &ringFile) {
+        const size_t every = 4;
+        size_t stages = cnn->getStageNames().size();
+        std::vector<uint64_t> expected;
+        for (uint64_t sequence = n; sequence < 2 * n; ++sequence) {
+            if (sequence % every == 0) {
+                expected.push_back(sequence);
+            }
+        }
+        cnn->setProfileSampling(every, expected.size() * stages);
+
+        vec out;
+        for (size_t b = 0; b < 2; ++b) {
+            double averageTime;
+            std::vector<cl_event> events = isPipelined ?
+                cnn->forwardCLPipeline(in, out, n, &averageTime) :
+                cnn->forwardCLBatch(in, out, n, &averageTime);
+            clWaitForEvents((cl_uint)events.size(), &events[0]);
+            for (size_t i = 0; i < events.size(); ++i) {
+                clReleaseEvent(events[i]);
+            }
+        }
+
+        const sampling::RingBuffer &ring = cnn->flushProfile();
+        std::vector<sampling::Record> records = ring.snapshot();
+        ASSERT(records.size() == expected.size() * stages)
+        ASSERT(ring.getOverwritten() == (n + every - 1) / every * stages)
+        for (size_t r = 0; r < records.size(); ++r) {
+            const sampling::Record &record = records[r];
+            ASSERT(record.sequence == expected[r / stages] && record.stage == r % stages && record.stages == stages)
+            ASSERT(record.queued <= record.start && record.start <= record.end)
+        }
+
+        {
+            std::ofstream file(ringFile.c_str(), std::ios::binary);
+            ring.write(file);
+        }
+        std::ifstream file(ringFile.c_str(), std::ios::binary);
+        std::vector<sampling::Record> read;
+        uint64_t overwritten;
+        ASSERT(sampling::RingBuffer::read(file, read, &overwritten))
+        ASSERT(read.size() == records.size() && overwritten == ring.getOverwritten())
+        ASSERT(read.empty() || std::memcmp(&read[0], &records[0], read.size() * sizeof(sampling::Record)) == 0)
+
+        vec reference;
+        double averageTime;
+        cnn->forwardCPUBatch(in, reference, n, &averageTime);
+        for (size_t i = 0; i < reference.size(); ++i) {
+            ASSERT(std::fabs(out[i] - reference[i]) < 0.0001f)
+        }
+        std::cout << "Sampled " << records.size() / stages << " of " << n << " inputs, "
+            << ring.getOverwritten() << " records overwritten" << std::endl;
+        std::cout << "Sampled profiling works perfect!" << std::endl;
+    }
+
+    // Parse the checked in SDAccel summary and flag a metric over its baseline.
+    void runSDAccelTest(const std::string &csvFile) {
+        sdaccel::Summary summary = sdaccel::parseFile(csvFile);
+        const sdaccel::Table *api = summary.find("OpenCL API Calls");
+        ASSERT(api && api->rows.size() == 26 && api->rows[0][0] == "clFinish")
+        ASSERT(api->getNumber(0, "Number Of Calls") == 20.0 && api->getNumber(0, "Total Time (ms)") == 2539.5)
+
+        size_t count;
+        ASSERT(sdaccel::getTotal(summary, "Kernel Execution", "conv1", &count) == 968.685 && count == 212)
+        const sdaccel::Table *units = summary.find("Compute Unit Utilization");
+        ASSERT(units && units->rows.size() == 10 && units->rows[0][units->column("Global Work Size")] == "7:7:2")
+
+        std::vector<double> times = sdaccel::getApiTimes(summary);
+        double total = 0.0;
+        double categories = 0.0;
+        for (size_t r = 0; r < api->rows.size(); ++r) {
+            total += api->getNumber(r, "Total Time (ms)");
+        }
+        for (size_t c = 0; c < times.size(); ++c) {
+            categories += times[c];
+        }
+        ASSERT(std::fabs(categories - total) < 1e-9)
+        ASSERT(std::fabs(times[sdaccel::API_WAIT] - (2539.5 + 211.741)) < 1e-9)
+        ASSERT(times[sdaccel::API_PROFILING] == 7.5626)
+
+        wallclock::Metrics baseline;
+        baseline.push_back(std::make_pair("batch.api.enqueue", 10.0));
+        baseline.push_back(std::make_pair("batch.device.kernels", 10.0));
+        wallclock::Metrics now;
+        now.push_back(std::make_pair("batch.api.enqueue", 12.0));
+        now.push_back(std::make_pair("batch.device.kernels", 8.0));
+        std::ostringstream diff;
+        ASSERT(wallclock::compare(diff, now, baseline, 0.10) == 1)
+        ASSERT(wallclock::compare(diff, now, baseline, 0.25) == 0)
+        std::cout << "SDAccel summary works perfect!" << std::endl;
+    }
+
+    // Gate a stored result against itself and against a faster one.
+    void runRegressTest(const std::string &slowFile, const std::string &fastFile) {
+        double a[5] = { 1.0, 2.0, 3.0, 4.0, 5.0 };
+        double b[5] = { 6.0, 7.0, 8.0, 9.0, 10.0 };
+        stats::Welch w = stats::welch(stats::summarize(std::vector<double>(a, a + 5), 0.95),
+            stats::summarize(std::vector<double>(b, b + 5), 0.95));
+        ASSERT(std::fabs(w.t - 5.0) < 1e-9 && std::fabs(w.df - 8.0) < 1e-9 && w.isSignificant)
+
+        regress::Result slow = regress::parse(slowFile);
+        regress::Result fast = regress::parse(fastFile);
+        const regress::Mode *batch = slow.find("batch");
+        ASSERT(slow.find("single") && batch && slow.find("pipeline"))
+        ASSERT(batch->n == 100 && batch->stageSize == 9 && batch->find("interval")->samples.size() == 99)
+        ASSERT(batch->find("stage0.write") && batch->find("stage8.read"))
+
+        std::ostringstream report;
+        std::vector<regress::Diff> diffs = regress::compare(slow, slow, 0.05, 0.95);
+        ASSERT(regress::writeReport(report, slow, slow, diffs, 0.05, 0.95) == 0)
+        diffs = regress::compare(fast, slow, 0.05, 0.95);
+        ASSERT(regress::writeReport(report, fast, slow, diffs, 0.05, 0.95) > 0)
+        diffs = regress::compare(slow, fast, 0.05, 0.95);
+        ASSERT(regress::writeReport(report, slow, fast, diffs, 0.05, 0.95) == 0)
+        std::cout << "Regression gate works perfect!" << std::endl;
+    }
+
+    // Fit synthetic transfers and read the profile back.
+    void runDeviceProfileTest() {
+        microbench::DeviceProfile profile;
+        profile.device = "synthetic";
+        for (size_t bytes = 4 << 10; bytes <= (64 << 20); bytes *= 4) {
+            for (size_t memory = 0; memory < microbench::NUM_HOST_MEMORIES; ++memory) {
+                // 20 us + 1 GB/s pageable, 5 us + 4 GB/s pinned, both ways.
+                double seconds = memory == microbench::HOST_PINNED ? 5e-6 + bytes / 4e9 : 2e-5 + bytes / 1e9;
+                stats::Summary time = stats::summarize(std::vector<double>(3, seconds), 0.95);
+                microbench::Transfer h2d = { microbench::HOST_TO_DEVICE, (microbench::HostMemory)memory, bytes, time };
+                microbench::Transfer d2h = { microbench::DEVICE_TO_HOST, (microbench::HostMemory)memory, bytes, time };
+                profile.transfers.push_back(h2d);
+                profile.transfers.push_back(d2h);
+            }
+        }
+        for (size_t direction = 0; direction < microbench::NUM_DIRECTIONS; ++direction) {
+            for (size_t memory = 0; memory < microbench::NUM_HOST_MEMORIES; ++memory) {
+                profile.models[direction][memory] = microbench::fitTransfers(profile.transfers,
+                    (microbench::Direction)direction, (microbench::HostMemory)memory);
+            }
+        }
+        const microbench::TransferModel &pageable = profile.models[microbench::HOST_TO_DEVICE][microbench::HOST_PAGEABLE];
+        const microbench::TransferModel &pinned = profile.models[microbench::DEVICE_TO_HOST][microbench::HOST_PINNED];
+        ASSERT(std::fabs(pageable.latency - 2e-5) < 1e-9 && std::fabs(pageable.bandwidth / 1e9 - 1.0) < 1e-6)
+        ASSERT(std::fabs(pinned.latency - 5e-6) < 1e-9 && std::fabs(pinned.bandwidth / 4e9 - 1.0) < 1e-6)
+
+        double launch[4] = { 1e-5, 1.2e-5, 0.9e-5, 1.1e-5 };
+        profile.enqueue = stats::summarize(std::vector<double>(launch, launch + 4), 0.95);
+        profile.queuedToStart = profile.enqueue;
+        profile.roundTrip = profile.enqueue;
+        profile.waitComplete = profile.enqueue;
+        profile.waitWakeup = profile.enqueue;
+        profile.globalTime = profile.enqueue;
+        profile.localTime = profile.enqueue;
+        profile.globalBytes = 32 << 20;
+        profile.localBytes = 64 << 20;
+        profile.localWorkGroup = 256;
+        profile.globalBandwidth = microbench::getBandwidth(profile.globalBytes, profile.globalTime);
+        profile.localBandwidth = microbench::getBandwidth(profile.localBytes, profile.localTime);
+
+        std::stringstream json;
+        microbench::writeJSON(json, profile);
+        microbench::DeviceProfile read = microbench::readDeviceProfile(json);
+        ASSERT(read.device == "synthetic" && read.transfers.size() == profile.transfers.size())
+        ASSERT(read.transfers[5].bytes == profile.transfers[5].bytes && read.transfers[5].memory == profile.transfers[5].memory)
+        ASSERT(std::fabs(read.roundTrip.mean - profile.roundTrip.mean) < 1e-12 && read.roundTrip.n == 4)
+        ASSERT(std::fabs(read.localBandwidth / profile.localBandwidth - 1.0) < 1e-6 && read.localWorkGroup == 256)
+        double predicted = microbench::predictTransfer(read, microbench::DEVICE_TO_HOST, microbench::HOST_PINNED, 1 << 20);
+        ASSERT(std::fabs(predicted - (5e-6 + (1 << 20) / 4e9)) < 1e-9)
+        std::cout << "Device profile works perfect!" << std::endl;
+    }
+
+    // Draw the arrivals and drive a server of 1 ms per batch with them.
+    void runLoadgenTest() {
+        std::vector<double> poisson = loadgen::getPoissonArrivals(20000, 500.0, 1);
+        ASSERT(std::fabs(poisson.back() / 20000.0 - 1.0 / 500.0) < 0.05 / 500.0)
+        ASSERT(poisson == loadgen::getPoissonArrivals(20000, 500.0, 1))
+        std::vector<double> bursty = loadgen::getBurstyArrivals(20, 500.0, 8, 1);
+        ASSERT(bursty[0] == bursty[7] && bursty[7] < bursty[8] && bursty[16] == bursty[19])
+        double recorded[4] = { 10.0, 10.5, 11.0, 12.0 };
+        std::vector<double> scaled = loadgen::scaleArrivals(std::vector<double>(recorded, recorded + 4), 300.0);
+        ASSERT(scaled[0] == 0.0 && std::fabs(scaled[3] - 0.01) < 1e-12 && std::fabs(scaled[1] - 0.0025) < 1e-12)
+
+        double sorted[5] = { 1.0, 2.0, 3.0, 4.0, 5.0 };
+        ASSERT(stats::percentile(std::vector<double>(sorted, sorted + 5), 0.5) == 3.0)
+        ASSERT(std::fabs(stats::percentile(std::vector<double>(sorted, sorted + 5), 0.9) - 4.6) < 1e-12)
+
+        // 8 requests at once: the first batch takes 4 of them, the others wait for it.
+        std::vector<double> atOnce(8, 0.0);
+        std::vector<loadgen::Request> requests = loadgen::drive(atOnce, 4, [](size_t /*first*/, size_t count, double *completes) {
+            double done = wallTime() + 1e-3;
+            while (wallTime() < done) {
+            }
+            for (size_t i = 0; i < count; ++i) {
+                completes[i] = done;
+            }
+        });
+        loadgen::Report report = loadgen::analyze(requests);
+        ASSERT(report.n == 8 && report.meanBatch == 4.0)
+        ASSERT(requests[0].batch == 4 && requests[4].dispatch >= requests[3].complete)
+        ASSERT(requests[4].dispatch - requests[4].arrival >= 1e-3 && report.service.p50 >= 1e-3)
+        ASSERT(std::fabs(report.latency.mean - report.queueing.mean - report.service.mean) < 1e-9)
+        std::ostringstream summary;
+        loadgen::writeSummary(summary, report);
+        std::cout << "Load generator works perfect!" << std::endl;
+    }
+
+    // Check the analysis of a hand made pipeline of 3 stages of 10, 30 and 10ns
+    // over 5 inputs: the middle stage is the bottleneck and sets the II.
+    void runAnalysisTest() {
+        timeline::Timeline t;
+        t.schedule = timeline::SCHEDULE_PIPELINE;
+        t.n = 5;
+        t.stages.push_back("write");
+        t.stages.push_back("kernel");
+        t.stages.push_back("read");
+        t.offset = 0;
+        t.offsetError = 0;
+        long long durations[3] = { 10, 30, 10 };
+        for (long long i = 0; i < 5; ++i) {
+            // The kernel of input i runs from 10 + 30i to 40 + 30i.
+            long long starts[3] = { 30 * i, 10 + 30 * i, 40 + 30 * i };
+            for (size_t s = 0; s < 3; ++s) {
+                timeline::Command c = { 0, 1, 0, 0, starts[s], starts[s] + durations[s] };
+                t.commands.push_back(c);
+            }
+        }
+
+        analysis::Report report = analysis::analyze(t);
+        ASSERT(report.makespan == 170)
+        ASSERT(report.busy == 170 && report.idle == 0 && report.gaps == 0)
+        ASSERT(report.criticalStage == 1)
+        ASSERT(report.stages[1].busy == 150 && report.stages[1].meanDuration == 30.0)
+        ASSERT(report.stages[2].maxQueuedToStart == 160)
+        ASSERT(report.ii == 30.0 && report.iiBound == 30.0 && report.efficiency == 1.0)
+        // Every write and read but the first write and the last read overlap a kernel for 10ns.
+        ASSERT(std::fabs(report.concurrency - 250.0 / 170.0) < 1e-9)
+        ASSERT(std::fabs(report.overlap - 80.0 / 170.0) < 1e-9)
+
+        // Stall the kernel of the last input for a 20ns gap.
+        for (size_t s = 1; s < 3; ++s) {
+            t.commands[4 * 3 + s].start += 30;
+            t.commands[4 * 3 + s].end += 30;
+        }
+        report = analysis::analyze(t);
+        ASSERT(report.gaps == 1 && report.maxGap == 20 && report.idle == 20)
+        std::cout << "Timeline analysis works perfect!" << std::endl;
+    }
+
+    // Check the CPU padding and normalization of raw images on the LeNet-5 format.
+    // With a raw input kernel also check the device forward of n random images against
+    // the CPU one and report the bytes sent per image and the time of both batches.
+    void runIngestTest(std::ofstream &o, CNN *cnn, size_t n) {
+        ingest::Format format = ingest::lenet5();
+        std::vector<unsigned char> image(format.size());
+        for (size_t i = 0; i < image.size(); ++i) {
+            image[i] = (unsigned char)(rand() % 256);
+        }
+        vec padded(32 * 32);
+        ingest::normalize(&image[0], format, 32, 32, &padded[0]);
+        for (size_t r = 0; r < 32; ++r) {
+            for (size_t c = 0; c < 32; ++c) {
+                bool isInside = r >= 2 && r < 30 && c >= 2 && c < 30;
+                float expected = isInside ? image[(r - 2) * 28 + c - 2] * 1.275f / 255.0f - 0.1f : -0.1f;
+                ASSERT(std::fabs(padded[r * 32 + c] - expected) < 0.00001f)
+            }
+        }
+
+        writeXMLOpenTag(o, "ingest");
+        if (cnn->hasRawInput()) {
+            size_t rawSize = cnn->getRawSize();
+            size_t outSize = cnn->getOutSize();
+            std::vector<unsigned char> raw(rawSize * n);
+            for (size_t i = 0; i < raw.size(); ++i) {
+                raw[i] = (unsigned char)(rand() % 256);
+            }
+
+            // The CPU reference normalizes on the host.
+            vec cpu(outSize * n);
+            double start = wallTime();
+            for (size_t i = 0; i < n; ++i) {
+                cnn->forwardCPURaw(&raw[i * rawSize], &cpu[i * outSize]);
+            }
+            double cpuTime = (wallTime() - start) / n;
+
+            vec device(outSize * n);
+            double deviceTime;
+            std::vector<cl_event> events = cnn->forwardCLBatchRaw(RawSpan(&raw[0], n, rawSize),
+                OutSpan(&device[0], n, outSize), &deviceTime);
+            clWaitForEvents((cl_uint)events.size(), &events[0]);
+            for (size_t i = 0; i < events.size(); ++i) {
+                clReleaseEvent(events[i]);
+            }
+            float maxError = 0.0f;
+            for (size_t i = 0; i < device.size(); ++i) {
+                maxError = std::max(maxError, std::fabs(device[i] - cpu[i]));
+            }
+            ASSERT(maxError < 0.001f)
+
+            vec single(outSize);
+            cnn->forwardCLRaw(&raw[0], &single[0]);
+            for (size_t i = 0; i < outSize; ++i) {
+                ASSERT(std::fabs(single[i] - cpu[i]) < 0.001f)
+            }
+
+            size_t floatBytes = cnn->getInSize() * sizeof(cl_float);
+            std::cout << "Raw input: " << floatBytes << " -> " << rawSize << " bytes per image, device: "
+                << deviceTime * 1000.0 << "ms cpu: " << cpuTime * 1000.0 << "ms max error: " << maxError << std::endl;
+            writeXMLTag(o, "floatBytes", floatBytes);
+            writeXMLTag(o, "rawBytes", rawSize);
+            writeXMLTag(o, "deviceTime", (float)deviceTime);
+            writeXMLTag(o, "cpuTime", (float)cpuTime);
+            writeXMLTag(o, "maxError", maxError);
+        }
+        writeXMLCloseTag(o, "ingest");
+        std::cout << "Raw input works perfect!" << std::endl;
+    }
+
+    // Check the specialized CPU layers against the generic ones.
+    void runSpecializedTest(CNN *cnn, const vec &in) {
+        cnn->setSpecialized(false);
+        cnn->forwardCPU(in);
+        cnn::vec outGeneric(cnn->getOut().begin(), cnn->getOut().end());
+        cnn->setSpecialized(true);
+        cnn->forwardCPU(in);
+        const Tensor &outSpecialized = cnn->getOut();
+        for (size_t i = 0; i < outGeneric.size(); ++i) {
+            ASSERT(fabs(outGeneric[i] - outSpecialized[i]) < 0.0001f)
+        }
+        for (size_t i = 0; i < cnn->layers.size(); ++i) {
+            std::cout << "Layer " << i << (cnn->layers[i]->isSpecialized() ? ": specialized" : ": generic") << std::endl;
+        }
+        std::cout << "Specialized layers work perfect!" << std::endl;
+    }
+
+    // Check every SIMD kernel supported by this CPU against the scalar reference.
+    void runSIMDTest() {
+        simd::Kernels ref = simd::makeKernels(simd::SCALAR);
+        for (int isa = simd::SSE; isa <= simd::detectISA(); ++isa) {
+            simd::Kernels k = simd::makeKernels((simd::ISA)isa);
+            for (size_t n = 1; n < 200; n += 7) {
+                vec a(n), b(n), x(n), y(n);
+                for (size_t i = 0; i < n; ++i) {
+                    a[i] = (float)rand() / (float)RAND_MAX - 0.5f;
+                    b[i] = (float)rand() / (float)RAND_MAX - 0.5f;
+                    x[i] = ((float)rand() / (float)RAND_MAX - 0.5f) * 200.0f;
+                }
+                ASSERT(fabs(k.dot(&a[0], &b[0], n) - ref.dot(&a[0], &b[0], n)) < 0.0001f)
+                ASSERT(fabs(k.sqrDist(&a[0], &b[0], n) - ref.sqrDist(&a[0], &b[0], n)) < 0.0001f)
+
+                y = x;
+                vec z(x);
+                k.sigmoid(&y[0], n, 0.5f, 0.25f);
+                ref.sigmoid(&z[0], n, 0.5f, 0.25f);
+                for (size_t i = 0; i < n; ++i) {
+                    ASSERT(fabs(y[i] - z[i]) < 0.000001f)
+                }
+
+                y = x;
+                z = x;
+                k.sigmoidBias(&y[0], &a[0], n);
+                ref.sigmoidBias(&z[0], &a[0], n);
+                for (size_t i = 0; i < n; ++i) {
+                    ASSERT(fabs(y[i] - z[i]) < 0.000001f)
+                }
+            }
+
+            // One full and one partial micro kernel tile.
+            size_t kc = 37;
+            vec a(gemm::MR * kc), b(gemm::NR * kc);
+            for (size_t i = 0; i < a.size(); ++i) {
+                a[i] = (float)rand() / (float)RAND_MAX - 0.5f;
+            }
+            for (size_t i = 0; i < b.size(); ++i) {
+                b[i] = (float)rand() / (float)RAND_MAX - 0.5f;
+            }
+            for (size_t nr = gemm::NR; nr >= gemm::NR - 3; nr -= 3) {
+                vec c(gemm::MR * gemm::NR, 1.0f), cRef(gemm::MR * gemm::NR, 1.0f);
+                k.gemmMicroKernel(kc, &a[0], &b[0], &c[0], gemm::NR, gemm::MR - 1, nr, true);
+                ref.gemmMicroKernel(kc, &a[0], &b[0], &cRef[0], gemm::NR, gemm::MR - 1, nr, true);
+                for (size_t i = 0; i < c.size(); ++i) {
+                    ASSERT(fabs(c[i] - cRef[i]) < 0.0001f)
+                }
+            }
+            std::cout << "SIMD kernels (" << simd::isaName((simd::ISA)isa) << ") work perfect!" << std::endl;
+        }
+    }
+
+    // Check the whole CPU forward with the active ISA against the scalar reference.
+    void runSIMDForwardTest(CNN *cnn, const vec &in) {
+        simd::ISA isa = simd::getISA();
+        simd::setISA(simd::SCALAR);
+        cnn->forwardCPU(in);
+        cnn::vec outScalar(cnn->getOut().begin(), cnn->getOut().end());
+        simd::setISA(isa);
+        cnn->forwardCPU(in);
+        cnn::vec outSIMD(cnn->getOut().begin(), cnn->getOut().end());
+        for (size_t i = 0; i < outScalar.size(); ++i) {
+            ASSERT(fabs(outScalar[i] - outSIMD[i]) < 0.0001f)
+        }
+        std::cout << "CPU forward with " << simd::isaName(isa) << " works perfect!" << std::endl;
+    }
+
+    // Measure the CPU forward from 1 to maxThreads workers.
+    // Latency is one image split across the workers, throughput is a batch with one image per worker.
+    void runScalingTest(std::ofstream &o, CNN *cnn, const vec &in, size_t n, size_t maxThreads) {
+        size_t inSize = cnn->getInSize();
+        vec single(in.begin(), in.begin() + inSize);
+        vec outRef;
+        vec out;
+        double averageTime;
+        double baseLatency = 0.0;
+        double baseThroughput = 0.0;
+
+        writeXMLOpenTag(o, "scaling");
+        for (size_t t = 1; t <= maxThreads; ++t) {
+            cnn->setThreads(t);
+
+            double start = wallTime();
+            for (size_t i = 0; i < NUM_TEST; ++i) {
+                cnn->forwardCPU(single);
+            }
+            double latency = (wallTime() - start) / NUM_TEST;
+
+            cnn->forwardCPUBatch(in, out, n, &averageTime);
+            double throughput = 1.0 / averageTime;
+
+            // Every thread count must give the same result.
+            if (t == 1) {
+                outRef = out;
+                baseLatency = latency;
+                baseThroughput = throughput;
+            }
+            for (size_t i = 0; i < out.size(); ++i) {
+                ASSERT(fabs(out[i] - outRef[i]) < 0.0001f)
+            }
+
+            std::cout << "Threads: " << t
+                << " latency: " << latency * 1000.0 << "ms (x" << baseLatency / latency << ")"
+                << " throughput: " << throughput << "/s (x" << throughput / baseThroughput << ")" << std::endl;
+
+            writeXMLOpenTag(o, "point");
+            writeXMLTag(o, "threads", t);
+            writeXMLTag(o, "latency", (float)latency);
+            writeXMLTag(o, "throughput", (float)throughput);
+            writeXMLCloseTag(o, "point");
+        }
+        writeXMLCloseTag(o, "scaling");
+        cnn->setThreads(1);
+        std::cout << "Finish testing!" << std::endl;
+    }
+
+    // Forward a batch whose samples are padded apart through the span API.
+    // The result must match the packed batch.
+    void runSpanTest(CNN *cnn, const vec &in, size_t n) {
+        size_t inSize = cnn->getInSize();
+        size_t outSize = cnn->getOutSize();
+        size_t inStride = inSize + 7;
+        size_t outStride = outSize + 3;
+        double averageTime;
+
+        vec padded(inStride * n, -1.0f);
+        for (size_t i = 0; i < n; ++i) {
+            std::copy(&in[i * inSize], &in[i * inSize] + inSize, &padded[i * inStride]);
+        }
+
+        vec outPacked;
+        cnn->forwardCPUBatch(in, outPacked, n, &averageTime);
+
+        vec outCPU(outStride * n);
+        vec outCL(outStride * n);
+        InSpan inSpan(&padded[0], n, inSize, inStride);
+        cnn->forwardCPUBatch(inSpan, OutSpan(&outCPU[0], n, outSize, outStride), &averageTime);
+        std::vector<cl_event> events = cnn->forwardCLBatch(inSpan, OutSpan(&outCL[0], n, outSize, outStride), &averageTime);
+        clWaitForEvents((cl_uint)events.size(), &events[0]);
+
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < outSize; ++j) {
+                ASSERT(fabs(outPacked[i * outSize + j] - outCPU[i * outStride + j]) < 0.0001f)
+                ASSERT(fabs(outCPU[i * outStride + j] - outCL[i * outStride + j]) < 0.0001f)
+            }
+        }
+        std::cout << "Strided batch works perfect!" << std::endl;
+    }
+
     void runFuncTestPipelined(CNN *inOrder, CNN *pipelined, const vec &in, const size_t n) {
         vec outInOrder;
         vec outPipelined;
@@ -74,35 +1308,76 @@ namespace test {
         std::cout << "CL pipelined works perfect!" << std::endl;
     }
 
-    void dumpEventsProfile(std::ofstream &o, std::vector<cl_event> &events, size_t n) {
-        cl_int err;
-        cl_ulong t;
-        size_t eventForOneInput = events.size() / n;
-        for (size_t i = 0; i < n; ++i) {
-            writeXMLOpenTag(o, "input");
-            for (size_t e = 0; e < eventForOneInput; ++e) {
-                writeXMLOpenTag(o, "event");
-
-                err = clGetEventProfilingInfo(events[i * eventForOneInput + e], CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &t, NULL);
-                handleError(err, "Failed get profile. ");
-                writeXMLTag(o, "que", t);
+    // Every host buffer shared with OpenCL must be page aligned.
+    void runTensorTest(CNN *cnn) {
+        ASSERT((size_t)cnn->getIn().data() % PAGE_ALIGNMENT == 0)
+        ASSERT((size_t)cnn->getOut().data() % PAGE_ALIGNMENT == 0)
 
-                err = clGetEventProfilingInfo(events[i * eventForOneInput + e], CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &t, NULL);
-                handleError(err, "Failed get profile. ");
-                writeXMLTag(o, "sub", t);
+        Arena arena(PAGE_ALIGNMENT);
+        float *small = arena.allocate(3);
+        float *line = arena.allocate(5, CACHE_LINE_ALIGNMENT);
+        float *large = arena.allocate(2 * PAGE_ALIGNMENT);
+        ASSERT((size_t)small % PAGE_ALIGNMENT == 0)
+        ASSERT((size_t)large % PAGE_ALIGNMENT == 0)
+        ASSERT((size_t)line % CACHE_LINE_ALIGNMENT == 0)
+        ASSERT(line == small + CACHE_LINE_ALIGNMENT / sizeof(float))
 
-                err = clGetEventProfilingInfo(events[i * eventForOneInput + e], CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &t, NULL);
-                handleError(err, "Failed get profile. ");
-                writeXMLTag(o, "sta", t);
+        vec v(13);
+        ASSERT((size_t)&v[0] % CACHE_LINE_ALIGNMENT == 0)
+        std::cout << "Tensor alignment works perfect!" << std::endl;
+    }
 
-                err = clGetEventProfilingInfo(events[i * eventForOneInput + e], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &t, NULL);
-                handleError(err, "Failed get profile. ");
-                writeXMLTag(o, "end", t);
+    // After the warm up forward the CPU forwards only use the planned memory,
+    // for every thread count and conv algorithm they never touch the heap.
+    void runPlanTest(CNN *cnn, const vec &in, size_t n) {
+        const ConvAlgorithm ALGORITHMS[] = { DIRECT, IM2COL };
+        const char *NAMES[] = { "direct", "im2col" };
+        const size_t THREADS[] = { 1, 2, 4 };
+        size_t numThreads = cnn->getThreads();
+        cnn->setQuiet(true);
+        vec out(n * cnn->getOutSize());
+        double averageTime;
+        for (size_t a = 0; a < sizeof(ALGORITHMS) / sizeof(ALGORITHMS[0]); ++a) {
+            for (size_t t = 0; t < sizeof(THREADS) / sizeof(THREADS[0]); ++t) {
+                cnn->setConvAlgorithm(ALGORITHMS[a]);
+                cnn->setThreads(THREADS[t]);
+                cnn->forwardCPU(in);
+                cnn->forwardCPUBatch(in, out, n, &averageTime);
 
-                writeXMLCloseTag(o, "event");
+                allocations = 0;
+                isCountingAllocations = true;
+                cnn->forwardCPU(in);
+                cnn->forwardCPUBatch(in, out, n, &averageTime);
+                isCountingAllocations = false;
+                std::cout << NAMES[a] << " on " << THREADS[t]
+                    << " threads: " << allocations << " allocations" << std::endl;
+                ASSERT(allocations == 0)
             }
-            writeXMLCloseTag(o, "input");
         }
+        cnn->setQuiet(false);
+        cnn->setThreads(numThreads);
+        cnn->setConvAlgorithm(DIRECT);
+        std::cout << "Execution plan works perfect!" << std::endl;
+    }
+
+    void runThreadPoolTest() {
+        ThreadPool pool(4);
+        ASSERT(pool.size() == 4);
+        std::vector<int> hits(1000, 0);
+        pool.parallelFor(0, hits.size(), 3, [&](size_t begin, size_t end, size_t worker) {
+            ASSERT(worker < pool.size());
+            // Nested calls run inline.
+            pool.parallelFor(begin, end, 1, [&](size_t b, size_t e, size_t w) {
+                ASSERT(w == worker);
+                for (size_t i = b; i < e; ++i) {
+                    hits[i]++;
+                }
+            });
+        });
+        for (size_t i = 0; i < hits.size(); ++i) {
+            ASSERT(hits[i] == 1);
+        }
+        std::cout << "Thread pool works perfect!" << std::endl;
     }
 
     void runEventPoolTest() {
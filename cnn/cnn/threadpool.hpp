@@ -0,0 +1,313 @@
+#ifndef THREAD_POOL_HEADER
+#define THREAD_POOL_HEADER
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/******************************************************************************************
+
+    A work stealing thread pool for the CPU forward path.
+
+    parallelFor splits [begin, end) into chunks and gives every worker a
+    contiguous run of them in its own deque. A worker takes chunks from the
+    front of its own deque and, once it runs dry, steals from the back of the
+    others, so uneven chunk costs (e.g. one slow layer in a batch) balance out.
+
+    The calling thread takes part as worker 0, so a pool of size N spawns N - 1
+    threads. Every chunk is run with the id of the worker running it, which the
+    layers use to pick their per worker scratch memory.
+
+    A parallelFor issued from inside a chunk runs inline on that worker.
+
+    Nothing is allocated per call: tasks are passed by reference and the
+    deques are fixed size rings, so a warmed up forward never hits the heap.
+
+*******************************************************************************************/
+
+namespace cnn {
+
+    // Non-owning reference to a callable fn(begin, end, worker).
+    // The callable must outlive the parallelFor it is passed to.
+    class Task {
+    public:
+        template <typename F>
+        Task(const F &fn) : object(&fn), call(&invoke<F>) {
+        }
+
+        void operator()(size_t begin, size_t end, size_t worker) const {
+            call(object, begin, end, worker);
+        }
+
+    private:
+        const void *object;
+        void (*call)(const void *, size_t, size_t, size_t);
+
+        template <typename F>
+        static void invoke(const void *object, size_t begin, size_t end, size_t worker) {
+            (*static_cast<const F *>(object))(begin, end, worker);
+        }
+    };
+
+    class ThreadPool {
+    public:
+
+        // At most this many chunks per worker and call.
+        static const size_t CHUNKS_PER_WORKER = 8;
+
+        // numThreads = 0 uses one worker per hardware thread.
+        // affinity[i] is the CPU spawned thread i (worker i + 1) is pinned to, empty for no pinning.
+        ThreadPool(size_t numThreads = 0, const std::vector<int> &affinity = std::vector<int>())
+            : queued(0), stop(false) {
+
+            if (numThreads == 0) {
+                numThreads = std::thread::hardware_concurrency();
+                if (numThreads == 0) {
+                    numThreads = 1;
+                }
+            }
+
+            for (size_t i = 0; i < numThreads; ++i) {
+                queues.push_back(new Queue);
+                queues.back()->chunks.resize(CHUNKS_PER_WORKER);
+            }
+
+            for (size_t i = 1; i < numThreads; ++i) {
+                threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+                if (!affinity.empty()) {
+                    pinThread(threads.back(), affinity[(i - 1) % affinity.size()]);
+                }
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(wakeMutex);
+                stop = true;
+            }
+            wake.notify_all();
+            for (size_t i = 0; i < threads.size(); ++i) {
+                threads[i].join();
+            }
+            for (size_t i = 0; i < queues.size(); ++i) {
+                delete queues[i];
+            }
+        }
+
+        // Number of workers, including the calling thread.
+        size_t size() const {
+            return queues.size();
+        }
+
+        // Run task over [begin, end) in chunks of at least grain indices and wait for all of them.
+        void parallelFor(size_t begin, size_t end, size_t grain, const Task &task) {
+
+            if (begin >= end) {
+                return;
+            }
+
+            // Nested call from one of our workers: run inline.
+            if (current() == this) {
+                task(begin, end, currentWorker());
+                return;
+            }
+
+            std::lock_guard<std::mutex> callLock(callMutex);
+
+            // Cap the number of chunks to keep the queue overhead small.
+            size_t n = end - begin;
+            size_t maxChunks = size() * CHUNKS_PER_WORKER;
+            if (grain == 0) {
+                grain = 1;
+            }
+            if ((n + grain - 1) / grain > maxChunks) {
+                grain = (n + maxChunks - 1) / maxChunks;
+            }
+            size_t numChunks = (n + grain - 1) / grain;
+
+            std::atomic<size_t> pending(numChunks);
+
+            // Give each worker a contiguous run of chunks.
+            // The queues are empty here since the previous call waited for all of its chunks.
+            for (size_t w = 0; w < size(); ++w) {
+                size_t first = numChunks * w / size();
+                size_t last = numChunks * (w + 1) / size();
+                Queue *queue = queues[w];
+                std::lock_guard<std::mutex> lock(queue->mutex);
+                queue->head = 0;
+                queue->tail = 0;
+                for (size_t c = first; c < last; ++c) {
+                    Chunk &chunk = queue->chunks[queue->tail++];
+                    chunk.task = &task;
+                    chunk.begin = begin + c * grain;
+                    chunk.end = std::min(end, chunk.begin + grain);
+                    chunk.pending = &pending;
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(wakeMutex);
+                queued += numChunks;
+            }
+            wake.notify_all();
+
+            // Work as worker 0 until every chunk is done.
+            current() = this;
+            currentWorker() = 0;
+            while (pending.load() != 0) {
+                Chunk chunk;
+                if (take(0, chunk)) {
+                    run(chunk);
+                }
+                else {
+                    std::this_thread::yield();
+                }
+            }
+            current() = NULL;
+        }
+
+    private:
+
+        struct Chunk {
+            const Task *task;
+            size_t begin;
+            size_t end;
+            std::atomic<size_t> *pending;
+        };
+
+        // Chunks [head, tail) are waiting.
+        struct Queue {
+            Queue() : head(0), tail(0) {
+            }
+            std::mutex mutex;
+            std::vector<Chunk> chunks;
+            size_t head;
+            size_t tail;
+        };
+
+        std::vector<Queue *> queues;
+        std::vector<std::thread> threads;
+
+        // Serializes callers from outside the pool.
+        std::mutex callMutex;
+
+        // Chunks not yet taken, guarded by wakeMutex so idle workers can sleep.
+        std::mutex wakeMutex;
+        std::condition_variable wake;
+        size_t queued;
+        bool stop;
+
+        static ThreadPool *&current() {
+            static thread_local ThreadPool *pool = NULL;
+            return pool;
+        }
+
+        static size_t &currentWorker() {
+            static thread_local size_t worker = 0;
+            return worker;
+        }
+
+        // Pop from the front of our own deque, otherwise steal from the back of another one.
+        bool take(size_t worker, Chunk &chunk) {
+            {
+                Queue *own = queues[worker];
+                std::lock_guard<std::mutex> lock(own->mutex);
+                if (own->head != own->tail) {
+                    chunk = own->chunks[own->head++];
+                    taken();
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < size(); ++i) {
+                Queue *victim = queues[(worker + i) % size()];
+                std::lock_guard<std::mutex> lock(victim->mutex);
+                if (victim->head != victim->tail) {
+                    chunk = victim->chunks[--victim->tail];
+                    taken();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void taken() {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            --queued;
+        }
+
+        void run(const Chunk &chunk) {
+            (*chunk.task)(chunk.begin, chunk.end, currentWorker());
+            chunk.pending->fetch_sub(1);
+        }
+
+        void workerLoop(size_t worker) {
+            current() = this;
+            currentWorker() = worker;
+            while (true) {
+                Chunk chunk;
+                if (take(worker, chunk)) {
+                    run(chunk);
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wake.wait(lock, [this] { return stop || queued > 0; });
+                if (stop) {
+                    return;
+                }
+            }
+        }
+
+        static void pinThread(std::thread &thread, int cpu) {
+#if defined(_WIN32)
+            SetThreadAffinityMask(thread.native_handle(), (DWORD_PTR)1 << cpu);
+#elif defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#endif
+        }
+    };
+
+    // Scratch memory and threads for one CPU forward of a layer.
+    struct Workspace {
+        // Pool to split the layer across, NULL to run on the calling thread.
+        ThreadPool *pool;
+
+        // Scratch shared by all workers.
+        float *shared;
+
+        // Scratch private to each worker, localStride floats apart.
+        float *local;
+        size_t localStride;
+
+        float *getLocal(size_t worker) const {
+            return local + worker * localStride;
+        }
+    };
+
+    // Run task over [begin, end) on the workspace's pool, or inline as worker 0 without one.
+    void parallelFor(const Workspace &ws, size_t begin, size_t end, size_t grain, const Task &task) {
+        if (ws.pool) {
+            ws.pool->parallelFor(begin, end, grain, task);
+        }
+        else if (begin < end) {
+            task(begin, end, 0);
+        }
+    }
+}
+
+#endif
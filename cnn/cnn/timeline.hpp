@@ -0,0 +1,153 @@
+#ifndef TIMELINE_HEADER
+#define TIMELINE_HEADER
+
+#include <algorithm>
+#include <climits>
+
+#include "util.hpp"
+
+/******************************************************************************************
+
+    Timeline of the commands of a batch forward.
+
+    The commands of one input are the write of the input, the kernels
+    (the input kernel of the raw models first, then every layer) and the
+    read of the output: the stages. forwardCLBatch chains them on the in
+    order queue, every write also waiting for the previous write;
+    forwardCLPipeline lets the out of order queue overlap them following the
+    event pool:
+        (s, i) waits for (s - 1, i) and (s + 1, i - 1).
+
+    The device stamps QUEUED, SUBMIT, START and END on its own clock. The
+    host stamps its steady clock before and after every clEnqueue call, and
+    QUEUED falls between the two, so every command bounds the offset of the
+    device clock:
+        queued - after <= offset <= queued - before.
+    The offset is the middle of the intersection of these bounds, its error
+    half their width. A negative error means the bounds don't intersect, the
+    clocks drifted apart or the runtime stamps QUEUED late.
+
+    All the times of the timeline are nanoseconds on the host clock since the
+    first enqueue.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace timeline {
+
+        // Host steady clock around the clEnqueue call of one command.
+        struct Enqueue {
+            cl_ulong begin;
+            cl_ulong end;
+        };
+
+        enum Schedule {
+            SCHEDULE_BATCH,
+            SCHEDULE_PIPELINE
+        };
+
+        struct Command {
+            long long enqueueBegin;
+            long long enqueueEnd;
+            long long queued;
+            long long submit;
+            long long start;
+            long long end;
+        };
+
+        struct Timeline {
+            Schedule schedule;
+            size_t n;
+            std::vector<std::string> stages;
+            // Input major, the stages of every input.
+            std::vector<Command> commands;
+            // Device minus host clock and its error, nanoseconds.
+            long long offset;
+            long long offsetError;
+
+            const Command &at(size_t i, size_t s) const {
+                return commands[i * stages.size() + s];
+            }
+        };
+
+        // The (input, stage) the command waits for.
+        inline std::vector<std::pair<size_t, size_t> > getDependencies(const Timeline &timeline, size_t i, size_t s) {
+            std::vector<std::pair<size_t, size_t> > dependencies;
+            size_t stages = timeline.stages.size();
+            if (s > 0) {
+                dependencies.push_back(std::make_pair(i, s - 1));
+            }
+            if (i > 0 && timeline.schedule == SCHEDULE_BATCH && s == 0) {
+                dependencies.push_back(std::make_pair(i - 1, s));
+            }
+            if (i > 0 && timeline.schedule == SCHEDULE_PIPELINE && s + 1 < stages) {
+                dependencies.push_back(std::make_pair(i - 1, s + 1));
+            }
+            return dependencies;
+        }
+
+        // Profile the events of n inputs returned by forwardCLBatch or forwardCLPipeline.
+        // enqueues are CNN::getEnqueues() of the same call, without them the host
+        // clock is taken as the device one.
+        inline Timeline collect(const std::vector<cl_event> &events,
+            const std::vector<Enqueue> &enqueues,
+            size_t n,
+            const std::vector<std::string> &stages,
+            Schedule schedule) {
+
+            if (n == 0 || events.size() != n * stages.size()) {
+                std::cerr << "timeline: " << events.size() << " events for " << n << " inputs of "
+                    << stages.size() << " stages" << std::endl;
+                exit(-1);
+            }
+            bool hasHost = enqueues.size() == events.size();
+
+            Timeline timeline;
+            timeline.schedule = schedule;
+            timeline.n = n;
+            timeline.stages = stages;
+            timeline.commands.resize(events.size());
+
+            std::vector<cl_ulong> device(events.size() * 4);
+            long long low = LLONG_MIN;
+            long long high = LLONG_MAX;
+            for (size_t e = 0; e < events.size(); ++e) {
+                cl_int err = clGetEventProfilingInfo(events[e], CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &device[e * 4], NULL);
+                err |= clGetEventProfilingInfo(events[e], CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &device[e * 4 + 1], NULL);
+                err |= clGetEventProfilingInfo(events[e], CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &device[e * 4 + 2], NULL);
+                err |= clGetEventProfilingInfo(events[e], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &device[e * 4 + 3], NULL);
+                handleError(err, "Failed get profile. ");
+                if (hasHost) {
+                    low = std::max(low, (long long)(device[e * 4] - enqueues[e].end));
+                    high = std::min(high, (long long)(device[e * 4] - enqueues[e].begin));
+                }
+            }
+
+            // Correlate the clocks, the origin is the first enqueue.
+            long long origin;
+            if (hasHost) {
+                timeline.offset = low + (high - low) / 2;
+                timeline.offsetError = (high - low) / 2;
+                origin = (long long)enqueues[0].begin;
+            }
+            else {
+                timeline.offset = 0;
+                timeline.offsetError = 0;
+                origin = (long long)device[0];
+            }
+            for (size_t e = 0; e < events.size(); ++e) {
+                Command &c = timeline.commands[e];
+                long long shift = origin + timeline.offset;
+                c.queued = (long long)device[e * 4] - shift;
+                c.submit = (long long)device[e * 4 + 1] - shift;
+                c.start = (long long)device[e * 4 + 2] - shift;
+                c.end = (long long)device[e * 4 + 3] - shift;
+                c.enqueueBegin = hasHost ? (long long)enqueues[e].begin - origin : c.queued;
+                c.enqueueEnd = hasHost ? (long long)enqueues[e].end - origin : c.queued;
+            }
+            return timeline;
+        }
+    }
+}
+
+#endif
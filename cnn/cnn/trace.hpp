@@ -0,0 +1,117 @@
+#ifndef TRACE_HEADER
+#define TRACE_HEADER
+
+#include <iomanip>
+
+#include "timeline.hpp"
+
+/******************************************************************************************
+
+    Chrome trace event export of a timeline.
+
+    Open the file in chrome://tracing or https://ui.perfetto.dev:
+        host        one track of the clEnqueue calls
+        device      one track per stage, a slice from START to END of every
+                    command, named after the stage with the input in args
+    Flow arrows link every enqueue to its command, and the END of every
+    command to the START of the ones waiting for it, so the bubbles of the
+    pipeline show as the length of the dependency arrows.
+
+    otherData names the mode that ran, e.g. the bench --mode, which may
+    differ from the schedule: stream runs the batch schedule.
+
+    Times are microseconds on the host clock since the first enqueue, see
+    timeline.hpp for the correlation of the device clock.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace trace {
+
+        const int HOST_PID = 0;
+        const int DEVICE_PID = 1;
+
+        inline double toMicroseconds(long long nanoseconds) {
+            return (double)nanoseconds * 1e-3;
+        }
+
+        inline void writeMetadata(std::ostream &o, const char *name, int pid, int tid, const std::string &value) {
+            o << "    {\"name\": \"" << name << "\", \"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " << tid
+                << ", \"args\": {\"name\": " << jsonString(value) << "}}," << std::endl;
+        }
+
+        inline void writeFlow(std::ostream &o, const char *cat, size_t id,
+            int fromPid, size_t fromTid, long long from,
+            int toPid, size_t toTid, long long to) {
+            o << "    {\"name\": \"" << cat << "\", \"cat\": \"" << cat << "\", \"ph\": \"s\", \"id\": " << id
+                << ", \"pid\": " << fromPid << ", \"tid\": " << fromTid << ", \"ts\": " << toMicroseconds(from) << "}," << std::endl;
+            o << "    {\"name\": \"" << cat << "\", \"cat\": \"" << cat << "\", \"ph\": \"f\", \"bp\": \"e\", \"id\": " << id
+                << ", \"pid\": " << toPid << ", \"tid\": " << toTid << ", \"ts\": " << toMicroseconds(to) << "}," << std::endl;
+        }
+
+        inline void writeChromeTrace(std::ostream &o, const timeline::Timeline &timeline, const std::string &device,
+            const std::string &mode) {
+            const std::vector<std::string> &stages = timeline.stages;
+            o << std::fixed << std::setprecision(3);
+            o << "{" << std::endl;
+            o << "  \"displayTimeUnit\": \"ns\"," << std::endl;
+            o << "  \"otherData\": {\"device\": " << jsonString(device) << ", \"mode\": " << jsonString(mode)
+                << ", \"schedule\": \"" << (timeline.schedule == timeline::SCHEDULE_BATCH ? "batch" : "pipeline")
+                << "\", \"inputs\": " << timeline.n << ", \"clockOffsetNs\": " << timeline.offset
+                << ", \"clockOffsetErrorNs\": " << timeline.offsetError << "}," << std::endl;
+            o << "  \"traceEvents\": [" << std::endl;
+
+            writeMetadata(o, "process_name", HOST_PID, 0, "host");
+            writeMetadata(o, "thread_name", HOST_PID, 0, "enqueue");
+            writeMetadata(o, "process_name", DEVICE_PID, 0, device);
+            for (size_t s = 0; s < stages.size(); ++s) {
+                std::ostringstream name;
+                name << s << " " << stages[s];
+                writeMetadata(o, "thread_name", DEVICE_PID, (int)s, name.str());
+            }
+
+            size_t flow = 0;
+            for (size_t i = 0; i < timeline.n; ++i) {
+                for (size_t s = 0; s < stages.size(); ++s) {
+                    const timeline::Command &c = timeline.at(i, s);
+                    o << "    {\"name\": " << jsonString(stages[s]) << ", \"cat\": \"enqueue\", \"ph\": \"X\", \"pid\": " << HOST_PID
+                        << ", \"tid\": 0, \"ts\": " << toMicroseconds(c.enqueueBegin)
+                        << ", \"dur\": " << toMicroseconds(c.enqueueEnd - c.enqueueBegin)
+                        << ", \"args\": {\"input\": " << i << "}}," << std::endl;
+                    o << "    {\"name\": " << jsonString(stages[s]) << ", \"cat\": \"device\", \"ph\": \"X\", \"pid\": " << DEVICE_PID
+                        << ", \"tid\": " << s << ", \"ts\": " << toMicroseconds(c.start)
+                        << ", \"dur\": " << toMicroseconds(c.end - c.start)
+                        << ", \"args\": {\"input\": " << i << ", \"queuedToStartUs\": " << toMicroseconds(c.start - c.queued)
+                        << ", \"submitToStartUs\": " << toMicroseconds(c.start - c.submit) << "}}," << std::endl;
+
+                    writeFlow(o, "enqueue", flow++, HOST_PID, 0, c.enqueueBegin, DEVICE_PID, s, c.start);
+                    std::vector<std::pair<size_t, size_t> > dependencies = timeline::getDependencies(timeline, i, s);
+                    for (size_t d = 0; d < dependencies.size(); ++d) {
+                        // The start binds to the slice enclosing it, so it stays 1 ns inside the producer.
+                        const timeline::Command &from = timeline.at(dependencies[d].first, dependencies[d].second);
+                        long long fromEnd = from.end > from.start ? from.end - 1 : from.start;
+                        writeFlow(o, "dependency", flow++, DEVICE_PID, dependencies[d].second, fromEnd, DEVICE_PID, s, c.start);
+                    }
+                }
+            }
+
+            // Mark the end of the last read, which also closes the list without a trailing comma.
+            o << "    {\"name\": \"end\", \"ph\": \"i\", \"s\": \"g\", \"pid\": " << DEVICE_PID
+                << ", \"tid\": 0, \"ts\": " << toMicroseconds(timeline.at(timeline.n - 1, stages.size() - 1).end) << "}" << std::endl;
+            o << "  ]" << std::endl;
+            o << "}" << std::endl;
+        }
+
+        inline void writeChromeTrace(const std::string &file, const timeline::Timeline &timeline, const std::string &device,
+            const std::string &mode) {
+            std::ofstream o(file.c_str());
+            if (!o.is_open()) {
+                std::cerr << "Can't open file " << file << std::endl;
+                exit(-1);
+            }
+            writeChromeTrace(o, timeline, device, mode);
+        }
+    }
+}
+
+#endif
@@ -11,7 +11,9 @@
 #define __CL_ENABLE_EXCEPTIONS
 #include <CL/cl.h>
 #include <ctime>
+#include <chrono>
 #include "include/RapidXML/rapidxml.hpp"
+#include "tensor.hpp"
 
 namespace cnn {
 
@@ -134,6 +136,45 @@ namespace cnn {
         }
     }
 
+    // Every device of every platform, platform by platform.
+    std::vector<std::pair<cl_platform_id, cl_device_id> > getDevices() {
+        std::vector<std::pair<cl_platform_id, cl_device_id> > devices;
+        cl_uint numPlatforms = 0;
+        if (clGetPlatformIDs(0, NULL, &numPlatforms) != CL_SUCCESS || numPlatforms == 0) {
+            return devices;
+        }
+        std::vector<cl_platform_id> platforms(numPlatforms);
+        clGetPlatformIDs(numPlatforms, &platforms[0], NULL);
+        for (cl_uint p = 0; p < numPlatforms; ++p) {
+            cl_uint numDevices = 0;
+            if (clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, 0, NULL, &numDevices) != CL_SUCCESS || numDevices == 0) {
+                continue;
+            }
+            std::vector<cl_device_id> ids(numDevices);
+            clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, numDevices, &ids[0], NULL);
+            for (cl_uint d = 0; d < numDevices; ++d) {
+                devices.push_back(std::make_pair(platforms[p], ids[d]));
+            }
+        }
+        return devices;
+    }
+
+    std::string getDeviceName(cl_device_id device) {
+        size_t size = 0;
+        clGetDeviceInfo(device, CL_DEVICE_NAME, 0, NULL, &size);
+        std::vector<char> name(size + 1, '\0');
+        clGetDeviceInfo(device, CL_DEVICE_NAME, size, &name[0], NULL);
+        return std::string(&name[0]);
+    }
+
+    std::string getKernelName(cl_kernel kernel) {
+        size_t size = 0;
+        clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, 0, NULL, &size);
+        std::vector<char> name(size + 1, '\0');
+        clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, size, &name[0], NULL);
+        return std::string(&name[0]);
+    }
+
     void printDeviceInfo(std::ostream &o, cl_device_id device) {
 
         cl_device_type type;
@@ -220,7 +261,18 @@ namespace cnn {
         buf[str.size()] = '\0';
     }
 
-    cl_program buildProgramFromSource(const std::string &fileName, const cl_context &context, const cl_device_id &device) {
+    // A file a model names: the file of that name next to the model if there is one,
+    // so a model moved with its kernels finds them, otherwise the path as written.
+    std::string resolveModelFile(const std::string &model, const std::string &fileName) {
+        size_t slash = model.find_last_of("/\\");
+        size_t nameSlash = fileName.find_last_of("/\\");
+        std::string beside = (slash == std::string::npos ? "." : model.substr(0, slash)) + "/" +
+            fileName.substr(nameSlash == std::string::npos ? 0 : nameSlash + 1);
+        return std::ifstream(beside.c_str()).good() ? beside : fileName;
+    }
+
+    // Build the program from source, NULL with the build log in log if it fails.
+    cl_program tryBuildProgramFromSource(const std::string &fileName, const cl_context &context, const cl_device_id &device, std::string *log) {
         std::string text = fileToString(fileName);
         const char *source = text.c_str();
         cl_int err;
@@ -229,17 +281,27 @@ namespace cnn {
         
         err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
         if (err != CL_SUCCESS) {
-            char buildLog[16384];
-            clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, sizeof(buildLog), buildLog, NULL);
-            std::cerr << "Error in kernel: " << std::endl;
-            std::cerr << buildLog;
+            char buildLog[16384] = { 0 };
+            clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, sizeof(buildLog) - 1, buildLog, NULL);
+            *log = buildLog;
             clReleaseProgram(program);
-            exit(-1);
+            return NULL;
         }
 
         return program;
     }
 
+    cl_program buildProgramFromSource(const std::string &fileName, const cl_context &context, const cl_device_id &device) {
+        std::string log;
+        cl_program program = tryBuildProgramFromSource(fileName, context, device, &log);
+        if (!program) {
+            std::cerr << "Error in kernel: " << std::endl;
+            std::cerr << log;
+            exit(-1);
+        }
+        return program;
+    }
+
     cl_program buildProgramFromBinary(const std::string &fileName, const cl_context &context, const cl_device_id &device) {
         std::string text = fileToString(fileName);
         size_t len = text.size();
@@ -298,6 +360,17 @@ namespace cnn {
         return t2 - t1;
     }
 
+    // Wall clock time in seconds.
+    double wallTime() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Steady clock time in nanoseconds, the host clock of the traces.
+    cl_ulong hostNanoseconds() {
+        return (cl_ulong)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     unsigned int closestMultiple(unsigned int size, unsigned int divisor) {
         unsigned int remainder = size % divisor;
         return remainder == 0 ? size : size - remainder + divisor;
@@ -314,9 +387,13 @@ namespace cnn {
         return;
     }
 
-    typedef std::vector<float> vec;
+    typedef std::vector<float, AlignedAllocator<float> > vec;
     typedef std::vector<vec> vec2d;
 
+    bool hasNode(rapidxml::xml_node<> *root, const char *name) {
+        return root->first_node(name) != NULL;
+    }
+
     size_t getSizeT(rapidxml::xml_node<> *root, const char *name) {
         rapidxml::xml_node<> *node = root->first_node(name);
         return std::atoi(node->value());
@@ -371,6 +448,39 @@ namespace cnn {
         return remainder == 0 ? n : n - remainder + base;
     }
 
+    std::string jsonString(const std::string &s) {
+        std::string quoted("\"");
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (s[i] == '"' || s[i] == '\\') {
+                quoted += '\\';
+            }
+            quoted += s[i];
+        }
+        return quoted + "\"";
+    }
+
+    // The value of "key": in a line of the JSON files written here, one object per line,
+    // without the quotes of a string. False if the line has no key.
+    bool findJSONValue(const std::string &line, const std::string &key, std::string *value) {
+        size_t at = line.find(jsonString(key) + ":");
+        if (at == std::string::npos) {
+            return false;
+        }
+        at = line.find_first_not_of(' ', at + key.size() + 3);
+        if (at == std::string::npos) {
+            return false;
+        }
+        if (line[at] == '"') {
+            size_t end = line.find('"', at + 1);
+            *value = line.substr(at + 1, end == std::string::npos ? std::string::npos : end - at - 1);
+        }
+        else {
+            size_t end = line.find_first_of(",}]", at);
+            *value = line.substr(at, end == std::string::npos ? std::string::npos : end - at);
+        }
+        return true;
+    }
+
     void writeXMLOpenTag(std::ofstream &o, const std::string &tag) {
         o << "<" << tag << ">";
     }
@@ -393,6 +503,41 @@ namespace cnn {
         o << std::endl;
     }
 
+    void writeXMLTag(std::ofstream &o, const std::string &tag, const std::string &value) {
+        writeXMLOpenTag(o, tag);
+        o << value;
+        writeXMLCloseTag(o, tag);
+        o << std::endl;
+    }
+
+    void writeXMLTag(std::ofstream &o, const std::string &tag, int value) {
+        writeXMLOpenTag(o, tag);
+        o << value;
+        writeXMLCloseTag(o, tag);
+        o << std::endl;
+    }
+
+    // Write an element parsed by rapidxml back, with its children.
+    void writeXMLNode(std::ofstream &o, rapidxml::xml_node<> *node) {
+        if (node->type() == rapidxml::node_data) {
+            o << std::string(node->value(), node->value_size());
+            return;
+        }
+        if (node->type() != rapidxml::node_element) {
+            return;
+        }
+        std::string tag(node->name(), node->name_size());
+        writeXMLOpenTag(o, tag);
+        if (node->first_node() && node->first_node()->type() == rapidxml::node_element) {
+            o << std::endl;
+        }
+        for (rapidxml::xml_node<> *child = node->first_node(); child; child = child->next_sibling()) {
+            writeXMLNode(o, child);
+        }
+        writeXMLCloseTag(o, tag);
+        o << std::endl;
+    }
+
     void dumpVec(std::ofstream &o, const vec &out, size_t width, size_t height, size_t depth) {
         writeXMLOpenTag(o, "vec");
         size_t idx = 0;
@@ -409,6 +554,38 @@ namespace cnn {
         }
         writeXMLCloseTag(o, "vec");
     }
+
+    // The QUEUED, SUBMIT, START and END of the events of n inputs, events.size() / n each.
+    void dumpEventsProfile(std::ofstream &o, std::vector<cl_event> &events, size_t n) {
+        cl_int err;
+        cl_ulong t;
+        size_t eventForOneInput = events.size() / n;
+        for (size_t i = 0; i < n; ++i) {
+            writeXMLOpenTag(o, "input");
+            for (size_t e = 0; e < eventForOneInput; ++e) {
+                writeXMLOpenTag(o, "event");
+
+                err = clGetEventProfilingInfo(events[i * eventForOneInput + e], CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &t, NULL);
+                handleError(err, "Failed get profile. ");
+                writeXMLTag(o, "que", t);
+
+                err = clGetEventProfilingInfo(events[i * eventForOneInput + e], CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &t, NULL);
+                handleError(err, "Failed get profile. ");
+                writeXMLTag(o, "sub", t);
+
+                err = clGetEventProfilingInfo(events[i * eventForOneInput + e], CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &t, NULL);
+                handleError(err, "Failed get profile. ");
+                writeXMLTag(o, "sta", t);
+
+                err = clGetEventProfilingInfo(events[i * eventForOneInput + e], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &t, NULL);
+                handleError(err, "Failed get profile. ");
+                writeXMLTag(o, "end", t);
+
+                writeXMLCloseTag(o, "event");
+            }
+            writeXMLCloseTag(o, "input");
+        }
+    }
 }
 
 
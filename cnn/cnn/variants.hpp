@@ -0,0 +1,242 @@
+#ifndef VARIANTS_HEADER
+#define VARIANTS_HEADER
+
+#include "bench.hpp"
+
+/******************************************************************************************
+
+    Benchmark matrix of the conv1 optimization ladder.
+
+        cnn --conv1-variants [--kernel-dir kernel] [--device n] [--warmup n]
+            [--reps n] [--seed n] [--confidence c] [--json file] [--csv file]
+
+    Every variant is the one layer model kernel/conv1_<variant>.xml, built
+    from source on the chosen device, so any OpenCL runtime (CPU ones
+    included) can compare them without the FPGA toolchain. Its kernel is
+    the .cl next to the model, so --kernel-dir moves both. A variant is
+    checked against the CPU forward on a seeded input, then timed by the
+    profiled kernel time of --reps forwards after --warmup ones. The speedup
+    is the mean time of the baseline over the mean time of the variant, for
+    the variants that computed the right result only.
+
+    A variant the runtime fails to build, or whose work group or local
+    memory does not fit the device, is skipped with the reason, the xcl
+    attributes only matter to SDAccel.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace bench {
+
+        struct Variant {
+            std::string name;
+            // "ok", "wrong" or why the variant was skipped.
+            std::string status;
+            float maxError;
+            stats::Summary time;
+            double speedup;
+        };
+
+        // The ladder in the order the optimizations were applied.
+        inline std::vector<std::string> getConv1Variants() {
+            static const char *NAMES[] = {
+                "baseline", "workgroup", "pipeline", "unroll", "memory_partition",
+                "item_pipeline", "tile", "multi_cu", "winograd"
+            };
+            return std::vector<std::string>(NAMES, NAMES + sizeof(NAMES) / sizeof(NAMES[0]));
+        }
+
+        // Build every kernel file of the model on the device, false with the first line of the
+        // build log in reason if one fails, where the CNN would exit.
+        inline bool buildsOnDevice(const std::string &model, size_t deviceIndex, std::string *reason) {
+            std::string text = fileToString(model);
+            rapidxml::xml_document<> doc;
+            doc.parse<0>(&text[0]);
+            rapidxml::xml_node<> *root = doc.first_node();
+            std::vector<std::string> files;
+            if (hasNode(root, "kernelFileName")) {
+                files.push_back(getString(root, "kernelFileName"));
+            }
+            for (rapidxml::xml_node<> *layer = root->first_node("layer"); layer; layer = layer->next_sibling("layer")) {
+                if (hasNode(layer, "kernelFileName")) {
+                    files.push_back(getString(layer, "kernelFileName"));
+                }
+            }
+
+            std::pair<cl_platform_id, cl_device_id> device = getDevices()[deviceIndex];
+            cl_context_properties properties[] = {
+                CL_CONTEXT_PLATFORM, (cl_context_properties)device.first, 0
+            };
+            cl_int err;
+            cl_context context = clCreateContext(properties, 1, &device.second, NULL, NULL, &err);
+            handleError(err, "Failed creating context. ");
+            bool isBuilt = true;
+            for (size_t i = 0; i < files.size() && isBuilt; ++i) {
+                std::string fileName = resolveModelFile(model, files[i]);
+                if (!std::ifstream(fileName.c_str()).good()) {
+                    *reason = "no kernel " + fileName;
+                    isBuilt = false;
+                    continue;
+                }
+                std::string log;
+                cl_program program = tryBuildProgramFromSource(fileName, context, device.second, &log);
+                if (program) {
+                    clReleaseProgram(program);
+                }
+                else {
+                    *reason = "build failed: " + log.substr(0, log.find('\n'));
+                    isBuilt = false;
+                }
+            }
+            clReleaseContext(context);
+            return isBuilt;
+        }
+
+        inline Variant runVariant(const Options &options, const std::string &name) {
+            Variant variant;
+            variant.name = name;
+            variant.maxError = 0.0f;
+            variant.time = stats::summarize(std::vector<double>(), options.confidence);
+            variant.speedup = 0.0;
+
+            std::string model = options.kernelDir + "/conv1_" + name + ".xml";
+            if (!std::ifstream(model.c_str()).good()) {
+                variant.status = "no model " + model;
+                return variant;
+            }
+            if (!buildsOnDevice(model, options.device, &variant.status)) {
+                return variant;
+            }
+            CNN cnn(model, true, "NONE", options.device);
+            if (!cnn.fitsDevice(&variant.status)) {
+                return variant;
+            }
+
+            vec in;
+            fillInputs(in, 1, cnn.getInSize(), options.seed);
+            vec out(cnn.getOutSize());
+            cnn.forwardCL(&in[0], &out[0]);
+            cnn.forwardCPU(in);
+            const Tensor &reference = cnn.getOut();
+            for (size_t i = 0; i < out.size(); ++i) {
+                variant.maxError = std::max(variant.maxError, std::fabs(out[i] - reference[i]));
+            }
+            variant.status = variant.maxError < 0.0001f ? "ok" : "wrong";
+
+            std::vector<double> samples;
+            for (size_t r = 0; r < options.warmup + options.reps; ++r) {
+                unsigned long long nanoseconds = cnn.forwardCL(&in[0], &out[0]);
+                if (r >= options.warmup) {
+                    samples.push_back((double)nanoseconds * 1e-9);
+                }
+            }
+            variant.time = stats::summarize(samples, options.confidence);
+            return variant;
+        }
+
+        inline std::vector<Variant> runVariants(const Options &options) {
+            std::vector<std::string> names = getConv1Variants();
+            std::vector<Variant> variants;
+            for (size_t i = 0; i < names.size(); ++i) {
+                variants.push_back(runVariant(options, names[i]));
+            }
+            // A wrong result has no speedup, nor does anything over a wrong baseline.
+            const Variant &baseline = variants[0];
+            for (size_t i = 0; i < variants.size(); ++i) {
+                if (baseline.status == "ok" && variants[i].status == "ok" &&
+                    baseline.time.n > 0 && variants[i].time.n > 0 && variants[i].time.mean > 0.0) {
+                    variants[i].speedup = baseline.time.mean / variants[i].time.mean;
+                }
+            }
+            return variants;
+        }
+
+        inline void writeVariantTable(std::ostream &o, const std::string &device, const std::vector<Variant> &variants) {
+            o << "conv1 variants on " << device << ", kernel time in us" << std::endl;
+            o << std::left << std::setw(18) << "variant" << std::right << std::setw(10) << "mean"
+                << std::setw(24) << "CI" << std::setw(10) << "speedup" << std::setw(12) << "max error" << "  status" << std::endl;
+            for (size_t i = 0; i < variants.size(); ++i) {
+                const Variant &v = variants[i];
+                std::ostringstream ci;
+                std::ostringstream speedup;
+                if (v.time.n > 0) {
+                    ci << std::fixed << std::setprecision(2) << "[" << v.time.ciLow * 1e6 << ", " << v.time.ciHigh * 1e6 << "]";
+                }
+                if (v.speedup > 0.0) {
+                    speedup << std::fixed << std::setprecision(2) << v.speedup << "x";
+                }
+                o << std::left << std::setw(18) << v.name << std::right << std::fixed << std::setprecision(2)
+                    << std::setw(10) << v.time.mean * 1e6 << std::setw(24) << ci.str() << std::setw(10) << speedup.str()
+                    << std::scientific << std::setprecision(1) << std::setw(12) << v.maxError << "  " << v.status << std::endl;
+                o.unsetf(std::ios::floatfield);
+            }
+        }
+
+        inline void writeVariantJSON(std::ostream &o, const Options &options, const std::string &device, const std::vector<Variant> &variants) {
+            o << std::setprecision(9);
+            o << "{" << std::endl;
+            o << "  \"device\": " << jsonString(device) << "," << std::endl;
+            o << "  \"warmup\": " << options.warmup << "," << std::endl;
+            o << "  \"reps\": " << options.reps << "," << std::endl;
+            o << "  \"seed\": " << options.seed << "," << std::endl;
+            o << "  \"unit\": \"s\"," << std::endl;
+            o << "  \"variants\": [" << std::endl;
+            for (size_t i = 0; i < variants.size(); ++i) {
+                const Variant &v = variants[i];
+                o << "    {\"name\": " << jsonString(v.name) << ", \"status\": " << jsonString(v.status)
+                    << ", \"maxError\": " << v.maxError << ", \"n\": " << v.time.n << ", \"mean\": " << v.time.mean
+                    << ", \"ciLow\": " << v.time.ciLow << ", \"ciHigh\": " << v.time.ciHigh
+                    << ", \"speedup\": " << v.speedup << "}" << (i + 1 < variants.size() ? "," : "") << std::endl;
+            }
+            o << "  ]" << std::endl;
+            o << "}" << std::endl;
+        }
+
+        inline int mainVariants(const Options &options) {
+            std::vector<std::pair<cl_platform_id, cl_device_id> > devices = getDevices();
+            if (options.device >= devices.size()) {
+                std::cerr << "mainVariants: No OpenCL device " << options.device << ", found " << devices.size() << std::endl;
+                exit(-1);
+            }
+            std::vector<Variant> variants = runVariants(options);
+            std::string device = getDeviceName(devices[options.device].second);
+            writeVariantTable(std::cout, device, variants);
+
+            if (!options.json.empty()) {
+                std::ofstream o(options.json.c_str());
+                if (!o.is_open()) {
+                    std::cerr << "Can't open file " << options.json << std::endl;
+                    exit(-1);
+                }
+                writeVariantJSON(o, options, device, variants);
+            }
+            if (!options.csv.empty()) {
+                bool isNew = !std::ifstream(options.csv.c_str()).good();
+                std::ofstream o(options.csv.c_str(), std::ios::app);
+                if (!o.is_open()) {
+                    std::cerr << "Can't open file " << options.csv << std::endl;
+                    exit(-1);
+                }
+                if (isNew) {
+                    o << "device,variant,status,maxError,reps,mean,ciLow,ciHigh,speedup" << std::endl;
+                }
+                o << std::setprecision(9);
+                for (size_t i = 0; i < variants.size(); ++i) {
+                    const Variant &v = variants[i];
+                    o << device << "," << v.name << ",\"" << v.status << "\"," << v.maxError << "," << v.time.n << ","
+                        << v.time.mean << "," << v.time.ciLow << "," << v.time.ciHigh << "," << v.speedup << std::endl;
+                }
+            }
+
+            // Fail if any variant computes a wrong result.
+            for (size_t i = 0; i < variants.size(); ++i) {
+                if (variants[i].status == "wrong") {
+                    return 1;
+                }
+            }
+            return 0;
+        }
+    }
+}
+
+#endif
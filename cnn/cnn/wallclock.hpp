@@ -0,0 +1,301 @@
+#ifndef WALLCLOCK_HEADER
+#define WALLCLOCK_HEADER
+
+#include "bench.hpp"
+#include "sdaccel.hpp"
+
+/******************************************************************************************
+
+    Where the wall clock went: SDAccel profile summaries merged with our traces.
+
+        cnn --profile-report --sdaccel <csv> [--host-trace <json>] ...
+            [--baseline <json>] [--tolerance 0.10] [--json file]
+
+    Every --sdaccel summary is one run of a forward mode, the --host-trace
+    given after it the Chrome trace of the same run (bench --trace), which
+    names the mode, and no mode may run twice. The summary covers the whole
+    process: its API time is split into setup, enqueue, profiling, wait and
+    other (see sdaccel.hpp) against the device time of the kernels and of
+    the host transfers. The wait beyond the device time is the host blocked
+    on an idle device; the kernels of several compute units overlap, so the
+    device time may also exceed the wait. The trace covers one batch: its
+    wall time, its enqueue time and the mean command of every stage next to
+    the SDAccel mean of the same kernel.
+
+    Every number is a metric "<mode>.<name>" in milliseconds. --json writes
+    them, and a file written so is the --baseline of a later report: a
+    metric more than --tolerance above its baseline is a regression, and
+    the report exits with 1.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace wallclock {
+
+        // The part of a Chrome trace written by trace.hpp the report needs.
+        struct HostTrace {
+            std::string mode;
+            std::string schedule;
+            size_t inputs;
+            double wallMs;
+            double enqueueMs;
+            std::vector<std::string> stages;
+            std::vector<double> busyMs;
+            std::vector<size_t> commands;
+        };
+
+        inline HostTrace readTrace(const std::string &file) {
+            std::ifstream in(file.c_str());
+            if (!in.is_open()) {
+                std::cerr << "Can't open file " << file << std::endl;
+                exit(-1);
+            }
+            HostTrace trace;
+            trace.inputs = 0;
+            trace.enqueueMs = 0.0;
+            double first = 0.0;
+            double last = 0.0;
+            bool isFirst = true;
+            std::string line;
+            std::string value;
+            while (std::getline(in, line)) {
+                if (findJSONValue(line, "schedule", &value)) {
+                    trace.schedule = value;
+                    // Traces written before the mode was recorded only name the schedule.
+                    trace.mode = findJSONValue(line, "mode", &value) ? value : trace.schedule;
+                    findJSONValue(line, "inputs", &value);
+                    trace.inputs = (size_t)std::atol(value.c_str());
+                    continue;
+                }
+                std::string cat;
+                std::string ph;
+                if (!findJSONValue(line, "cat", &cat) || !findJSONValue(line, "ph", &ph) || ph != "X") {
+                    continue;
+                }
+                findJSONValue(line, "ts", &value);
+                double ts = std::atof(value.c_str()) * 1e-3;
+                findJSONValue(line, "dur", &value);
+                double dur = std::atof(value.c_str()) * 1e-3;
+                first = isFirst ? ts : std::min(first, ts);
+                last = isFirst ? ts + dur : std::max(last, ts + dur);
+                isFirst = false;
+                if (cat == "enqueue") {
+                    trace.enqueueMs += dur;
+                }
+                else if (cat == "device") {
+                    findJSONValue(line, "tid", &value);
+                    size_t stage = (size_t)std::atol(value.c_str());
+                    if (stage >= trace.stages.size()) {
+                        trace.stages.resize(stage + 1);
+                        trace.busyMs.resize(stage + 1, 0.0);
+                        trace.commands.resize(stage + 1, 0);
+                    }
+                    findJSONValue(line, "name", &trace.stages[stage]);
+                    trace.busyMs[stage] += dur;
+                    trace.commands[stage]++;
+                }
+            }
+            if (trace.schedule.empty() || trace.stages.empty()) {
+                std::cerr << "wallclock: " << file << " is not a trace of bench --trace" << std::endl;
+                exit(-1);
+            }
+            trace.wallMs = last - first;
+            return trace;
+        }
+
+        struct Run {
+            std::string mode;
+            std::string file;
+            sdaccel::Summary summary;
+            bool hasTrace;
+            HostTrace trace;
+        };
+
+        typedef std::vector<std::pair<std::string, double> > Metrics;
+
+        inline Metrics getMetrics(const Run &run) {
+            Metrics metrics;
+            std::vector<double> api = sdaccel::getApiTimes(run.summary);
+            for (size_t c = 0; c < sdaccel::NUM_API_CATEGORIES; ++c) {
+                metrics.push_back(std::make_pair(run.mode + ".api." + sdaccel::getApiCategoryName((sdaccel::ApiCategory)c), api[c]));
+            }
+            double kernels = sdaccel::getTotal(run.summary, "Kernel Execution");
+            double transfers = sdaccel::getTotal(run.summary, "Data Transfer: Host and Global Memory");
+            metrics.push_back(std::make_pair(run.mode + ".device.kernels", kernels));
+            metrics.push_back(std::make_pair(run.mode + ".device.transfers", transfers));
+            metrics.push_back(std::make_pair(run.mode + ".waitBeyondDevice", std::max(0.0, api[sdaccel::API_WAIT] - kernels - transfers)));
+            if (run.hasTrace) {
+                const HostTrace &trace = run.trace;
+                metrics.push_back(std::make_pair(run.mode + ".trace.wall", trace.wallMs));
+                metrics.push_back(std::make_pair(run.mode + ".trace.enqueue", trace.enqueueMs));
+                for (size_t s = 0; s < trace.stages.size(); ++s) {
+                    if (trace.commands[s] > 0) {
+                        std::ostringstream name;
+                        name << run.mode << ".trace.stage" << s << "." << trace.stages[s];
+                        metrics.push_back(std::make_pair(name.str(), trace.busyMs[s] / (double)trace.commands[s]));
+                    }
+                }
+            }
+            return metrics;
+        }
+
+        inline void writeReport(std::ostream &o, const Run &run) {
+            std::vector<double> api = sdaccel::getApiTimes(run.summary);
+            double apiTotal = 0.0;
+            for (size_t c = 0; c < api.size(); ++c) {
+                apiTotal += api[c];
+            }
+            double kernels = sdaccel::getTotal(run.summary, "Kernel Execution");
+            double transfers = sdaccel::getTotal(run.summary, "Data Transfer: Host and Global Memory");
+            double share = apiTotal > 0.0 ? 100.0 / apiTotal : 0.0;
+
+            o << std::fixed << std::setprecision(3);
+            o << "Where the wall clock went, " << run.mode << " (" << run.file << ")" << std::endl;
+            o << "  host API " << apiTotal << " ms" << std::endl;
+            for (size_t c = 0; c < api.size(); ++c) {
+                o << "    " << std::left << std::setw(12) << sdaccel::getApiCategoryName((sdaccel::ApiCategory)c) << std::right
+                    << std::setw(12) << api[c] << " ms" << std::setw(8) << std::setprecision(1) << api[c] * share << "%"
+                    << std::setprecision(3) << std::endl;
+            }
+            o << "  device " << kernels + transfers << " ms: kernels " << kernels << " ms, host transfers " << transfers << " ms" << std::endl;
+            o << "  host waiting beyond the device " << std::max(0.0, api[sdaccel::API_WAIT] - kernels - transfers) << " ms" << std::endl;
+            o << "  host overhead (enqueue, profiling, other) "
+                << api[sdaccel::API_ENQUEUE] + api[sdaccel::API_PROFILING] + api[sdaccel::API_OTHER] << " ms" << std::endl;
+
+            if (run.hasTrace) {
+                const HostTrace &trace = run.trace;
+                o << "  traced batch of " << trace.inputs << " inputs: wall " << trace.wallMs << " ms, enqueue "
+                    << trace.enqueueMs << " ms" << std::endl;
+                o << "    " << std::left << std::setw(20) << "stage" << std::right << std::setw(14) << "trace ms/cmd"
+                    << std::setw(16) << "sdaccel ms/cmd" << std::endl;
+                for (size_t s = 0; s < trace.stages.size(); ++s) {
+                    if (trace.commands[s] == 0) {
+                        continue;
+                    }
+                    size_t count;
+                    double total = sdaccel::getTotal(run.summary, "Kernel Execution", trace.stages[s], &count);
+                    o << "    " << std::left << std::setw(20) << trace.stages[s] << std::right
+                        << std::setw(14) << trace.busyMs[s] / (double)trace.commands[s];
+                    if (count > 0) {
+                        o << std::setw(16) << total / (double)count;
+                    }
+                    o << std::endl;
+                }
+            }
+            o.unsetf(std::ios::floatfield);
+        }
+
+        inline void writeJSON(std::ostream &o, const Metrics &metrics) {
+            o << std::setprecision(9);
+            o << "{" << std::endl;
+            o << "  \"unit\": \"ms\"," << std::endl;
+            o << "  \"metrics\": {" << std::endl;
+            for (size_t m = 0; m < metrics.size(); ++m) {
+                o << "    " << jsonString(metrics[m].first) << ": " << metrics[m].second
+                    << (m + 1 < metrics.size() ? "," : "") << std::endl;
+            }
+            o << "  }" << std::endl;
+            o << "}" << std::endl;
+        }
+
+        // The metrics of a file written by writeJSON.
+        inline Metrics readBaseline(const std::string &file) {
+            std::ifstream in(file.c_str());
+            if (!in.is_open()) {
+                std::cerr << "Can't open file " << file << std::endl;
+                exit(-1);
+            }
+            Metrics metrics;
+            std::string line;
+            while (std::getline(in, line)) {
+                size_t begin = line.find('"');
+                size_t end = line.find("\": ", begin + 1);
+                if (begin == std::string::npos || end == std::string::npos || line.find('{') != std::string::npos) {
+                    continue;
+                }
+                std::string name = line.substr(begin + 1, end - begin - 1);
+                if (name != "unit") {
+                    metrics.push_back(std::make_pair(name, std::atof(line.c_str() + end + 3)));
+                }
+            }
+            return metrics;
+        }
+
+        // Print every metric against its baseline, the number of regressions.
+        inline size_t compare(std::ostream &o, const Metrics &metrics, const Metrics &baseline, double tolerance) {
+            size_t regressions = 0;
+            o << std::fixed << std::setprecision(3);
+            o << std::left << std::setw(40) << "metric" << std::right << std::setw(12) << "baseline"
+                << std::setw(12) << "now" << std::setw(10) << "change" << std::endl;
+            for (size_t m = 0; m < metrics.size(); ++m) {
+                for (size_t b = 0; b < baseline.size(); ++b) {
+                    if (baseline[b].first != metrics[m].first) {
+                        continue;
+                    }
+                    double before = baseline[b].second;
+                    double now = metrics[m].second;
+                    double change = before > 0.0 ? now / before - 1.0 : 0.0;
+                    bool isRegression = before > 0.0 && change > tolerance;
+                    regressions += isRegression;
+                    o << std::left << std::setw(40) << metrics[m].first << std::right << std::setw(12) << before
+                        << std::setw(12) << now << std::setw(9) << std::setprecision(1) << change * 100.0 << "%"
+                        << std::setprecision(3) << (isRegression ? "  REGRESSION" : "") << std::endl;
+                }
+            }
+            o.unsetf(std::ios::floatfield);
+            return regressions;
+        }
+
+        inline int mainProfileReport(const bench::Options &options) {
+            if (options.sdaccel.empty() || (!options.hostTraces.empty() && options.hostTraces.size() != options.sdaccel.size())) {
+                std::cerr << "wallclock: Needs --sdaccel summaries and as many --host-trace files, or none" << std::endl;
+                exit(-1);
+            }
+            Metrics metrics;
+            std::vector<std::string> modes;
+            for (size_t r = 0; r < options.sdaccel.size(); ++r) {
+                Run run;
+                run.file = options.sdaccel[r];
+                run.summary = sdaccel::parseFile(run.file);
+                run.hasTrace = !options.hostTraces.empty();
+                std::ostringstream mode;
+                if (run.hasTrace) {
+                    run.trace = readTrace(options.hostTraces[r]);
+                    mode << run.trace.mode;
+                }
+                else {
+                    mode << "run" << r;
+                }
+                run.mode = mode.str();
+                // The metrics are named after the mode, compare() would match a repeated one twice.
+                for (size_t m = 0; m < modes.size(); ++m) {
+                    if (modes[m] == run.mode) {
+                        std::cerr << "wallclock: " << options.hostTraces[r] << " repeats the mode " << run.mode << std::endl;
+                        exit(-1);
+                    }
+                }
+                modes.push_back(run.mode);
+                writeReport(std::cout, run);
+                Metrics runMetrics = getMetrics(run);
+                metrics.insert(metrics.end(), runMetrics.begin(), runMetrics.end());
+            }
+
+            if (!options.json.empty()) {
+                std::ofstream o(options.json.c_str());
+                if (!o.is_open()) {
+                    std::cerr << "Can't open file " << options.json << std::endl;
+                    exit(-1);
+                }
+                writeJSON(o, metrics);
+            }
+            if (!options.baseline.empty()) {
+                size_t regressions = compare(std::cout, metrics, readBaseline(options.baseline), options.tolerance);
+                std::cout << regressions << " regressions over " << options.tolerance * 100.0 << "%" << std::endl;
+                return regressions > 0 ? 1 : 0;
+            }
+            return 0;
+        }
+    }
+}
+
+#endif
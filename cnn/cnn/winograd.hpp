@@ -0,0 +1,187 @@
+#ifndef WINOGRAD_HEADER
+#define WINOGRAD_HEADER
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+/******************************************************************************************
+
+    Winograd minimal filtering F(m x m, r x r).
+
+    An m x m output tile of an r x r correlation is computed from the
+    n x n input tile d (n = m + r - 1) as
+
+        Y = AT [ (G g GT) .* (BT d B) ] A
+
+    so each tile costs n * n multiplies per (input, output) map pair
+    instead of m * m * r * r: 36 instead of 100 for F(2x2, 5x5) and 64
+    instead of 400 for F(4x4, 5x5).
+
+    The matrices come from the Toom-Cook construction on the points
+    0, 1, -1, 2, -2, 1/2, -1/2, ... plus the point at infinity:
+        G   evaluates the filter polynomial at the points,
+        AT  is the transpose of evaluating the output polynomial,
+        BT  is the transpose of the interpolation (inverse Vandermonde).
+
+    This header only needs the standard library so the generator can share
+    it to transform the weights it writes into the model.
+
+*******************************************************************************************/
+
+namespace cnn {
+    namespace winograd {
+
+        // Row major transform matrices of F(m x m, r x r).
+        struct Transform {
+            size_t m;
+            size_t r;
+            size_t n;
+            // m x n.
+            std::vector<float> AT;
+            // n x r.
+            std::vector<float> G;
+            // n x n.
+            std::vector<float> BT;
+        };
+
+        // Evaluation matrix: rows [1, a, a^2, ..., a^(cols - 1)] for the finite points, [0, ..., 0, 1] for infinity.
+        inline std::vector<double> vandermonde(const std::vector<double> &points, size_t cols) {
+            size_t rows = points.size() + 1;
+            std::vector<double> v(rows * cols, 0.0);
+            for (size_t j = 0; j < points.size(); ++j) {
+                double p = 1.0;
+                for (size_t k = 0; k < cols; ++k) {
+                    v[j * cols + k] = p;
+                    p *= points[j];
+                }
+            }
+            v[(rows - 1) * cols + cols - 1] = 1.0;
+            return v;
+        }
+
+        // Inverse of a n x n matrix by Gauss-Jordan elimination with partial pivoting.
+        inline std::vector<double> inverse(std::vector<double> a, size_t n) {
+            std::vector<double> inv(n * n, 0.0);
+            for (size_t i = 0; i < n; ++i) {
+                inv[i * n + i] = 1.0;
+            }
+            for (size_t col = 0; col < n; ++col) {
+                size_t pivot = col;
+                for (size_t row = col + 1; row < n; ++row) {
+                    if (std::fabs(a[row * n + col]) > std::fabs(a[pivot * n + col])) {
+                        pivot = row;
+                    }
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    std::swap(a[col * n + k], a[pivot * n + k]);
+                    std::swap(inv[col * n + k], inv[pivot * n + k]);
+                }
+                double scale = 1.0 / a[col * n + col];
+                for (size_t k = 0; k < n; ++k) {
+                    a[col * n + k] *= scale;
+                    inv[col * n + k] *= scale;
+                }
+                for (size_t row = 0; row < n; ++row) {
+                    if (row != col) {
+                        double factor = a[row * n + col];
+                        for (size_t k = 0; k < n; ++k) {
+                            a[row * n + k] -= factor * a[col * n + k];
+                            inv[row * n + k] -= factor * inv[col * n + k];
+                        }
+                    }
+                }
+            }
+            return inv;
+        }
+
+        // Build the matrices of F(m x m, r x r).
+        inline Transform makeTransform(size_t m, size_t r) {
+            static const double POINTS[] = { 0.0, 1.0, -1.0, 2.0, -2.0, 0.5, -0.5, 3.0, -3.0, 1.0 / 3.0, -1.0 / 3.0 };
+            const size_t MAX_POINTS = sizeof(POINTS) / sizeof(POINTS[0]);
+
+            Transform t;
+            t.m = m;
+            t.r = r;
+            t.n = m + r - 1;
+            if (m == 0 || r == 0 || t.n - 1 > MAX_POINTS) {
+                std::cerr << "makeTransform: Unsupported Winograd F(" << m << ", " << r << ")" << std::endl;
+                exit(-1);
+            }
+            std::vector<double> points(POINTS, POINTS + t.n - 1);
+
+            // Filter and output evaluation.
+            std::vector<double> g = vandermonde(points, r);
+            std::vector<double> h = vandermonde(points, m);
+
+            // Interpolation from the n point values back to the coefficients.
+            std::vector<double> c = inverse(vandermonde(points, t.n), t.n);
+
+            t.G.resize(t.n * r);
+            for (size_t i = 0; i < t.n * r; ++i) {
+                t.G[i] = (float)g[i];
+            }
+            t.AT.resize(m * t.n);
+            for (size_t i = 0; i < m; ++i) {
+                for (size_t j = 0; j < t.n; ++j) {
+                    t.AT[i * t.n + j] = (float)h[j * m + i];
+                }
+            }
+            t.BT.resize(t.n * t.n);
+            for (size_t i = 0; i < t.n; ++i) {
+                for (size_t j = 0; j < t.n; ++j) {
+                    t.BT[i * t.n + j] = (float)c[j * t.n + i];
+                }
+            }
+            return t;
+        }
+
+        // U = G g GT for one r x r kernel, computed in double.
+        inline void transformKernel(const Transform &t, const float *g, float *u) {
+            std::vector<double> tmp(t.n * t.r, 0.0);
+            for (size_t i = 0; i < t.n; ++i) {
+                for (size_t k = 0; k < t.r; ++k) {
+                    for (size_t j = 0; j < t.r; ++j) {
+                        tmp[i * t.r + k] += (double)t.G[i * t.r + j] * g[j * t.r + k];
+                    }
+                }
+            }
+            for (size_t i = 0; i < t.n; ++i) {
+                for (size_t k = 0; k < t.n; ++k) {
+                    double sum = 0.0;
+                    for (size_t j = 0; j < t.r; ++j) {
+                        sum += tmp[i * t.r + j] * t.G[k * t.r + j];
+                    }
+                    u[i * t.n + k] = (float)sum;
+                }
+            }
+        }
+
+        // Transform a (oDepth, iDepth, r, r) weight into (oDepth, iDepth, n, n).
+        inline void transformWeight(const Transform &t, const float *weight, size_t oDepth, size_t iDepth, float *out) {
+            for (size_t p = 0; p < oDepth * iDepth; ++p) {
+                transformKernel(t, weight + p * t.r * t.r, out + p * t.n * t.n);
+            }
+        }
+
+        // Number of output tiles along a side of length size.
+        inline size_t numTiles(size_t size, size_t m) {
+            return (size + m - 1) / m;
+        }
+
+        // Multiplies of the direct convolution of one layer.
+        inline size_t directMultiplies(size_t r, size_t oWidth, size_t oHeight, size_t iDepth, size_t oDepth) {
+            return oWidth * oHeight * r * r * iDepth * oDepth;
+        }
+
+        // Multiplies of the elementwise stage of one layer, which dominates with many maps.
+        inline size_t winogradMultiplies(size_t m, size_t r, size_t oWidth, size_t oHeight, size_t iDepth, size_t oDepth) {
+            size_t n = m + r - 1;
+            return numTiles(oWidth, m) * numTiles(oHeight, m) * n * n * iDepth * oDepth;
+        }
+    }
+}
+
+#endif